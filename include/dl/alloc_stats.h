@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace dl {
+/**
+ * @brief 是否为分配统计构建，只有用 -DDL_ALLOC_STATS=ON 配置时才替换全局 operator new
+ */
+#ifdef DL_ALLOC_STATS
+inline constexpr bool ALLOC_STATS_ENABLED = true;
+#else
+inline constexpr bool ALLOC_STATS_ENABLED = false;
+#endif
+
+/**
+ * @brief 一段时间内的分配统计
+ */
+struct AllocStats
+{
+	// operator new 的次数与申请的字节数
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+	// 期间存活字节数比开始时多出的最大值
+	uint64_t peak_bytes = 0;
+	// Arena 与 ByteArena 分出的对象数与字节数，块本身已算在 operator new 里
+	uint64_t arena_count = 0;
+	uint64_t arena_bytes = 0;
+
+	/**
+	 * @brief 累加另一段的统计，峰值取两者中较大的
+	 */
+	AllocStats& operator+=(const AllocStats& other) noexcept
+	{
+		count += other.count;
+		bytes += other.bytes;
+		peak_bytes = std::max(peak_bytes, other.peak_bytes);
+		arena_count += other.arena_count;
+		arena_bytes += other.arena_bytes;
+		return *this;
+	}
+};
+
+/**
+ * @brief 当前线程的分配计数，由 operator new、operator delete 与 Arena 更新
+ * @details 在别的线程释放的内存会让 live 小于 0，峰值只在本线程内比较。
+ */
+struct ThreadAllocCounters
+{
+	uint64_t count       = 0;
+	uint64_t bytes       = 0;
+	uint64_t arena_count = 0;
+	uint64_t arena_bytes = 0;
+	int64_t  live        = 0;
+	int64_t  peak        = 0;
+};
+
+inline ThreadAllocCounters& thread_alloc_counters() noexcept
+{
+	thread_local ThreadAllocCounters counters;
+	return counters;
+}
+
+/**
+ * @brief Arena 分出一个对象时调用，非分配统计构建中为空
+ */
+inline void count_arena_alloc(size_t bytes) noexcept
+{
+	if constexpr (ALLOC_STATS_ENABLED) {
+		auto& counters = thread_alloc_counters();
+		++counters.arena_count;
+		counters.arena_bytes += bytes;
+	}
+}
+
+/**
+ * @brief 当前线程分配计数的快照，配对使用 Begin 与 End 统计一段代码的分配
+ * @details 可以嵌套：Begin 从当前存活字节数开始重新记峰值，End 再把外层的峰值恢复过来。
+ */
+class AllocMark
+{
+public:
+	static AllocMark Begin() noexcept
+	{
+		AllocMark mark;
+		auto&     counters = thread_alloc_counters();
+		mark.start_        = counters;
+		counters.peak      = counters.live;
+		return mark;
+	}
+
+	/**
+	 * @brief 把 Begin 以来的分配累加到 target
+	 */
+	void End(AllocStats& target) const noexcept
+	{
+		auto& counters = thread_alloc_counters();
+		AllocStats stats;
+		stats.count       = counters.count - start_.count;
+		stats.bytes       = counters.bytes - start_.bytes;
+		stats.peak_bytes  = static_cast<uint64_t>(std::max<int64_t>(counters.peak - start_.live, 0));
+		stats.arena_count = counters.arena_count - start_.arena_count;
+		stats.arena_bytes = counters.arena_bytes - start_.arena_bytes;
+		target += stats;
+		counters.peak = std::max(counters.peak, start_.peak);
+	}
+
+private:
+	ThreadAllocCounters start_;
+};
+}   // namespace dl
@@ -1,5 +1,10 @@
 #pragma once
+#include "dl/alloc_stats.h"
+#include "dl/span.h"
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <type_traits>
 #include <utility>
@@ -22,54 +27,204 @@ public:
 	Arena& operator=(Arena&&) noexcept = default;
 
 	// Construct an object in-place in the arena, return its pointer.
-	// The pointer will never be invalidated until clear() or destruction.
+	// The pointer will never be invalidated until clear(), reset() or destruction.
 	template<typename... Args> T* emplace(Args&&... args)
 	{
-		// Allocate a new block if needed.
-		if (blocks_.empty() || block_pos_ == BlockSize) {
-			blocks_.emplace_back(std::make_unique<Block>());
+		// Move to the next block if needed, reusing blocks kept by reset().
+		if (block_count_ == 0 || block_pos_ == BlockSize) {
+			if (block_count_ == blocks_.size()) {
+				// Default-initialized: the storage is not zeroed.
+				blocks_.emplace_back(new Block);
+			}
+			++block_count_;
 			block_pos_ = 0;
 		}
 		// Placement-new the object in the current block.
-		T* ptr = reinterpret_cast<T*>(&blocks_.back()->data[block_pos_]);
+		T* ptr = reinterpret_cast<T*>(&blocks_[block_count_ - 1]->data[block_pos_]);
 		new (ptr) T(std::forward<Args>(args)...);
 		++block_pos_;
 		++size_;
+		count_arena_alloc(sizeof(T));
 		return ptr;
 	}
 
 	// Destroy all objects and release all memory.
 	void clear()
 	{
-		for (auto& blk : blocks_) {
-			// Only the last block may be partially filled.
-			size_t n = (blk.get() == blocks_.back().get()) ? block_pos_ : BlockSize;
-			for (size_t i = 0; i < n; ++i) {
-				T* ptr = reinterpret_cast<T*>(&blk->data[i]);
-				ptr->~T();
-			}
-		}
+		destroy_all();
 		blocks_.clear();
-		block_pos_ = 0;
-		size_      = 0;
 	}
 
-	// size_t size() const { return size_; }
+	// Destroy all objects but keep the blocks for reuse. For trivially
+	// destructible T this is O(1).
+	void reset() { destroy_all(); }
+
+	// Bytes held by all blocks, in use or kept for reuse.
+	size_t reserved_bytes() const noexcept { return blocks_.size() * sizeof(Block); }
+
+	// Number of live objects.
+	size_t size() const noexcept { return size_; }
 	// bool   empty() const { return size_ == 0; }
 
 private:
+	void destroy_all()
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			for (size_t b = 0; b < block_count_; ++b) {
+				// Only the current block may be partially filled.
+				size_t n = (b + 1 == block_count_) ? block_pos_ : BlockSize;
+				for (size_t i = 0; i < n; ++i) {
+					T* ptr = reinterpret_cast<T*>(&blocks_[b]->data[i]);
+					ptr->~T();
+				}
+			}
+		}
+		block_count_ = 0;
+		block_pos_   = 0;
+		size_        = 0;
+	}
+
 	// A block of uninitialized storage for BlockSize objects of type T.
 	struct Block
 	{
 		// Use std::aligned_storage to ensure proper alignment.
 		typename std::aligned_storage<sizeof(T), alignof(T)>::type data[BlockSize];
 	};
-	// All allocated blocks.
+	// All allocated blocks, including those kept by reset() but not yet reused.
 	std::vector<std::unique_ptr<Block>> blocks_;
-	// Current position in the last block.
+	// Number of blocks in use; the last of them is the current block.
+	size_t block_count_ = 0;
+	// Current position in the current block.
 	size_t block_pos_ = 0;
 	// Total number of objects allocated.
 	size_t size_ = 0;
 };
 
+// Bump allocator for raw bytes. Each allocation is carved from the current
+// block; nothing is freed individually, everything goes at clear(), reset()
+// or destruction. Only trivially destructible data may live here.
+template<size_t BlockSize = 16384> class ByteArena
+{
+public:
+	ByteArena()  = default;
+	~ByteArena() = default;
+
+	// Non-copyable, movable.
+	ByteArena(const ByteArena&)                = delete;
+	ByteArena& operator=(const ByteArena&)     = delete;
+	ByteArena(ByteArena&&) noexcept            = default;
+	ByteArena& operator=(ByteArena&&) noexcept = default;
+
+	// Return `size` bytes aligned to `align`, valid until clear(), reset() or destruction.
+	void* allocate(size_t size, size_t align)
+	{
+		assert(align <= alignof(std::max_align_t));
+		count_arena_alloc(size);
+		// Oversized requests get a block of their own so the current block keeps
+		// serving small ones.
+		if (size > BlockSize / 4) {
+			large_bytes_ += size;
+			return large_blocks_.emplace_back(new std::byte[size]).get();
+		}
+		size_t offset = (block_pos_ + align - 1) & ~(align - 1);
+		if (block_count_ == 0 || offset + size > BlockSize) {
+			if (block_count_ == blocks_.size()) {
+				blocks_.emplace_back(new std::byte[BlockSize]);
+			}
+			++block_count_;
+			offset = 0;
+		}
+		block_pos_ = offset + size;
+		return blocks_[block_count_ - 1].get() + offset;
+	}
+
+	// Copy `size` trivially copyable objects into the arena as one contiguous
+	// slice, preceded by the 32-bit length header that Span reads.
+	template<typename T> Span<T> copy(const T* data, size_t size)
+	{
+		if (size == 0) {
+			return Span<T>();
+		}
+		assert(size <= UINT32_MAX);
+		constexpr size_t header_size = Span<T>::HEADER_SIZE;
+		auto* bytes = static_cast<std::byte*>(allocate(header_size + sizeof(T) * size, header_size));
+		const auto length = static_cast<uint32_t>(size);
+		std::memcpy(bytes, &length, sizeof(length));
+		T* ptr = reinterpret_cast<T*>(bytes + header_size);
+		std::memcpy(static_cast<void*>(ptr), data, sizeof(T) * size);
+		return Span<T>(ptr);
+	}
+
+	// Release all memory.
+	void clear()
+	{
+		blocks_.clear();
+		reset();
+	}
+
+	// Forget all allocations but keep the regular blocks for reuse. Oversized
+	// blocks are released, one big input must not pin them forever.
+	void reset()
+	{
+		large_blocks_.clear();
+		large_bytes_ = 0;
+		block_count_ = 0;
+		block_pos_   = 0;
+	}
+
+	// Bytes held by all blocks, in use or kept for reuse.
+	size_t reserved_bytes() const noexcept { return blocks_.size() * BlockSize + large_bytes_; }
+
+	// Bytes of the blocks used since the last reset(), the current one up to its last allocation.
+	size_t used_bytes() const noexcept
+	{
+		return (block_count_ ? (block_count_ - 1) * BlockSize + block_pos_ : 0) + large_bytes_;
+	}
+
+private:
+	// Blocks of BlockSize bytes, including those kept by reset() but not yet reused.
+	std::vector<std::unique_ptr<std::byte[]>> blocks_;
+	// Blocks holding a single oversized allocation.
+	std::vector<std::unique_ptr<std::byte[]>> large_blocks_;
+	// Number of blocks in use; the last of them is being bumped.
+	size_t block_count_ = 0;
+	// Bytes used in the current block.
+	size_t block_pos_ = 0;
+	// Total size of the oversized blocks.
+	size_t large_bytes_ = 0;
+};
+
+// LIFO staging area for lists whose length is unknown until they are parsed.
+// A list records mark(), pushes its elements, and commit() moves them into a
+// ByteArena as one contiguous Span. Nested lists push above the outer one and
+// are committed first, so a single stack serves the whole recursion.
+template<typename T> class ScratchStack
+{
+public:
+	size_t mark() const noexcept { return items_.size(); }
+
+	void push(const T& item) { items_.push_back(item); }
+	template<typename... Args> void emplace(Args&&... args)
+	{
+		items_.emplace_back(std::forward<Args>(args)...);
+	}
+
+	template<size_t BlockSize> Span<T> commit(size_t mark, ByteArena<BlockSize>& arena)
+	{
+		auto span = arena.copy(items_.data() + mark, items_.size() - mark);
+		items_.erase(items_.begin() + static_cast<std::ptrdiff_t>(mark), items_.end());
+		return span;
+	}
+
+	void clear() noexcept { items_.clear(); }
+	// Drop all elements and free the storage.
+	void release() noexcept { std::vector<T>().swap(items_); }
+
+	// Bytes held by the stack's storage.
+	size_t reserved_bytes() const noexcept { return items_.capacity() * sizeof(T); }
+
+private:
+	std::vector<T> items_;
+};
+
 }   // namespace dl
\ No newline at end of file
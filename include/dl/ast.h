@@ -1,9 +1,11 @@
 #pragma once
 
+#include "dl/span.h"
 #include "dl/token.h"
-#include <vector>
+#include <cstdint>
+#include <type_traits>
 namespace dl {
-enum class AstNodeType
+enum class AstNodeType : uint8_t
 {
 	ParenExpr,
 	VariableExpr,
@@ -134,29 +136,28 @@ public:
 
 	struct TableLiteral
 	{
-		std::vector<TableEntry> entry_list_;
-        Token* end_token_;
+		Span<TableEntry> entry_list_;
+		Token*           end_token_;
 	};
 
 	struct FunctionLiteral
 	{
-		std::vector<Token*>* arg_list_;
-		AstNode*            body_;
-		Token*              end_token_;
+		Span<Token*> arg_list_;
+		AstNode*     body_;
+		Token*       end_token_;
 	};
 
 	struct FunctionStat
 	{
-		std::vector<Token*>* name_chain_;
-		std::vector<Token*>* arg_list_;
-		AstNode*            body_;
-		Token*              end_token_;
-		bool                is_method_;
+		Span<Token*> name_chain_;
+		Span<Token*> arg_list_;
+		AstNode*     body_;
+		Token*       end_token_;
 	};
 
 	struct ArgCall
 	{
-		std::vector<AstNode*>* arg_list_;
+		Span<AstNode*> arg_list_;
 	};
 
 	struct TableCall
@@ -319,8 +320,8 @@ public:
 
 	struct AssignmentStat
 	{
-		std::vector<AstNode*>* lhs_;
-		std::vector<AstNode*>* rhs_;
+		Span<AstNode*> lhs_;
+		Span<AstNode*> rhs_;
 	};
 	enum class ElseClauseType
 	{
@@ -360,10 +361,10 @@ public:
 				new (&else_clause_) ElseClause(std::move(v));
 			}
 		};
-		AstNode*                       condition_;
-		AstNode*                       body_;
-		std::vector<GeneralElseClause>* else_clauses_;
-		Token*                         end_token_;
+		AstNode*                condition_;
+		AstNode*                body_;
+		Span<GeneralElseClause> else_clauses_;
+		Token*                  end_token_;
 	};
 
 	struct DoStat
@@ -381,18 +382,18 @@ public:
 
 	struct NumericForStat
 	{
-		std::vector<Token*>*   var_list_;
-		std::vector<AstNode*>* range_list_;
-		AstNode*              body_;
-		Token*                end_token_;
+		Span<Token*>   var_list_;
+		Span<AstNode*> range_list_;
+		AstNode*       body_;
+		Token*         end_token_;
 	};
 
 	struct GenericForStat
 	{
-		std::vector<Token*>*   var_list_;
-		std::vector<AstNode*>* generator_list_;
-		AstNode*              body_;
-		Token*                end_token_;
+		Span<Token*>   var_list_;
+		Span<AstNode*> generator_list_;
+		AstNode*       body_;
+		Token*         end_token_;
 	};
 
 	struct RepeatStat
@@ -409,20 +410,20 @@ public:
 
 	struct LocalVarStat
 	{
-		std::vector<Token*>*   var_list_;
-		std::vector<AstNode*>* expr_list_;
+		Span<Token*>   var_list_;
+		Span<AstNode*> expr_list_;
 	};
 
 	struct ReturnStat
 	{
-		std::vector<AstNode*>* expr_list_;
+		Span<AstNode*> expr_list_;
 	};
 
 	struct BreakStat
 	{};
 	struct StatList
 	{
-		std::vector<AstNode*>* statement_list_;
+		Span<AstNode*> statement_list_;
 	};
 
 	struct GotoStat
@@ -491,6 +492,8 @@ public:
 	};
 	Token*      first_token_;
 	AstNodeType type_;
+	// 仅 FunctionStat 使用：是否为 a:b() 形式的方法。放在节点头部的空隙里，免得把联合体撑大
+	bool is_method_ = false;
 	AstNode(ParenExpr&& v, Token* tok)
 		: first_token_(tok)
 		, type_(AstNodeType::ParenExpr)
@@ -515,9 +518,10 @@ public:
 	{
 		new (&function_literal_) FunctionLiteral(std::move(v));
 	}
-	AstNode(FunctionStat&& v, Token* tok)
+	AstNode(FunctionStat&& v, Token* tok, bool is_method)
 		: first_token_(tok)
 		, type_(AstNodeType::FunctionStat)
+		, is_method_(is_method)
 	{
 		new (&function_stat_) FunctionStat(std::move(v));
 	}
@@ -791,24 +795,10 @@ public:
 	{
 		new (&label_stat_) LabelStat(std::move(v));
 	}
-
-	~AstNode()
-	{
-		switch (type_) {
-		case AstNodeType::TableLiteral: table_literal_.~TableLiteral(); break;
-		// case AstNodeType::FunctionLiteral: function_literal_.~FunctionLiteral(); break;
-		// case AstNodeType::FunctionStat: function_stat_.~FunctionStat(); break;
-		// case AstNodeType::ArgCall: arg_call_.~ArgCall(); break;
-		// case AstNodeType::AssignmentStat: assignment_stat_.~AssignmentStat(); break;
-		// case AstNodeType::IfStat: if_stat_.~IfStat(); break;
-		// case AstNodeType::NumericForStat: numeric_for_stat_.~NumericForStat(); break;
-		// case AstNodeType::GenericForStat: generic_for_stat_.~GenericForStat(); break;
-		// case AstNodeType::LocalVarStat: local_var_stat_.~LocalVarStat(); break;
-		// case AstNodeType::ReturnStat: return_stat_.~ReturnStat(); break;
-		// case AstNodeType::StatList: stat_list_.~StatList(); break;
-		default: break;
-		}
-	}
 };
+// 节点只在 Arena 中成块释放，不能有需要析构的成员
+static_assert(std::is_trivially_destructible_v<AstNode>, "AstNode must be trivially destructible");
+// 最大的变体为 32 字节，加上首 token 与类型共 48 字节，新增字段前先确认不会撑大节点
+static_assert(sizeof(AstNode) <= 48, "AstNode grew beyond its compact layout");
 
 }   // namespace dl
\ No newline at end of file
@@ -0,0 +1,267 @@
+#pragma once
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace dl {
+/**
+ * @brief Parser 的构建策略
+ * @details Parser<Builder> 只通过下面的接口产出结果，不读取节点内容，因此构建策略可以不生成 AST：
+ * - 句柄类型 Node、TokenList、NodeList、TableEntryList、ElseClauseList，均可默认构造
+ * - 与 AstManager 同名同参数的 Make* 函数，返回 Node
+ * - 列表按 Begin*List 记下位置、Push* 压入元素、End*List 收尾的顺序构建，内层列表总是先于外层收尾
+ *
+ * AstManager 构建完整的 AST；NullAstBuilder 什么都不分配，用于只检查语法；EventAstBuilder 在每个
+ * 节点解析完成时回调一次，供流式处理使用。
+ */
+
+/**
+ * @brief 不构建任何东西的构建策略，解析只剩下语法检查
+ */
+class NullAstBuilder
+{
+public:
+	struct Node
+	{};
+	struct List
+	{};
+	using TokenList      = List;
+	using NodeList       = List;
+	using TableEntryList = List;
+	using ElseClauseList = List;
+
+	Node MakeParenExpr(Node, Token*) { return {}; }
+	Node MakeVariableExpr(Token*) { return {}; }
+	Node MakeTableLiteral(TableEntryList, Token*, Token*) { return {}; }
+	Node MakeFunctionLiteral(TokenList, Node, Token*, Token*) { return {}; }
+	Node MakeFunctionStat(TokenList, TokenList, Node, Token*, Token*, bool) { return {}; }
+	Node MakeArgCall(NodeList, Token*) { return {}; }
+	Node MakeTableCall(Node) { return {}; }
+	Node MakeStringCall(Token*) { return {}; }
+	Node MakeFieldExpr(Node, Token*) { return {}; }
+	Node MakeMethodExpr(Node, Token*, Node) { return {}; }
+	Node MakeIndexExpr(Node, Node) { return {}; }
+	Node MakeCallExpr(Node, Node) { return {}; }
+	Node MakeNumberLiteral(Token*) { return {}; }
+	Node MakeStringLiteral(Token*) { return {}; }
+	Node MakeNilLiteral(Token*) { return {}; }
+	Node MakeBooleanLiteral(Token*) { return {}; }
+	Node MakeVargLiteral(Token*) { return {}; }
+	Node MakeNotExpr(Node, Token*) { return {}; }
+	Node MakeNegativeExpr(Node, Token*) { return {}; }
+	Node MakeLengthExpr(Node, Token*) { return {}; }
+	Node MakeAddExpr(Node, Node) { return {}; }
+	Node MakeSubExpr(Node, Node) { return {}; }
+	Node MakeMulExpr(Node, Node) { return {}; }
+	Node MakeDivExpr(Node, Node) { return {}; }
+	Node MakePowExpr(Node, Node) { return {}; }
+	Node MakeModExpr(Node, Node) { return {}; }
+	Node MakeConcatExpr(Node, Node) { return {}; }
+	Node MakeEqExpr(Node, Node) { return {}; }
+	Node MakeNeqExpr(Node, Node) { return {}; }
+	Node MakeLtExpr(Node, Node) { return {}; }
+	Node MakeLeExpr(Node, Node) { return {}; }
+	Node MakeGtExpr(Node, Node) { return {}; }
+	Node MakeGeExpr(Node, Node) { return {}; }
+	Node MakeAndExpr(Node, Node) { return {}; }
+	Node MakeOrExpr(Node, Node) { return {}; }
+	Node MakeCallExprStat(Node) { return {}; }
+	Node MakeAssignmentStat(NodeList, NodeList) { return {}; }
+	Node MakeIfStat(Node, Node, ElseClauseList, Token*, Token*) { return {}; }
+	Node MakeDoStat(Node, Token*, Token*) { return {}; }
+	Node MakeWhileStat(Node, Node, Token*, Token*) { return {}; }
+	Node MakeNumericForStat(TokenList, NodeList, Node, Token*, Token*) { return {}; }
+	Node MakeGenericForStat(TokenList, NodeList, Node, Token*, Token*) { return {}; }
+	Node MakeRepeatStat(Node, Node, Token*, Token*) { return {}; }
+	Node MakeLocalFunctionStat(Node, Token*) { return {}; }
+	Node MakeLocalVarStat(TokenList, NodeList, Token*) { return {}; }
+	Node MakeReturnStat(NodeList, Token*) { return {}; }
+	Node MakeBreakStat(Token*) { return {}; }
+	Node MakeStatList(NodeList) { return {}; }
+	Node MakeGotoStat(Token*, Token*) { return {}; }
+	Node MakeLabelStat(Token*, Token*) { return {}; }
+
+	size_t   BeginTokenList() const noexcept { return 0; }
+	void     PushToken(Token*) noexcept {}
+	List     EndTokenList(size_t) noexcept { return {}; }
+	size_t   BeginNodeList() const noexcept { return 0; }
+	void     PushNode(Node) noexcept {}
+	List     EndNodeList(size_t) noexcept { return {}; }
+	size_t   BeginTableEntryList() const noexcept { return 0; }
+	void     PushIndexEntry(Token*, Node, Node) noexcept {}
+	void     PushFieldEntry(Token*, Node) noexcept {}
+	void     PushValueEntry(Node) noexcept {}
+	List     EndTableEntryList(size_t) noexcept { return {}; }
+	size_t   BeginElseClauseList() const noexcept { return 0; }
+	void     PushElseIfClause(Node, Node, Token*) noexcept {}
+	void     PushElseClause(Node, Token*) noexcept {}
+	List     EndElseClauseList(size_t) noexcept { return {}; }
+};
+
+/**
+ * @brief 每解析完一个节点就回调一次的构建策略
+ * @details 回调按后序触发，子节点先于父节点，参数为节点类型与节点的首个 token（空语句块为
+ * nullptr）。Node 句柄就是节点的首个 token，除了语句列表首元素的暂存，不保留任何节点。
+ */
+class EventAstBuilder
+{
+public:
+	using Callback = std::function<void(AstNodeType type, const Token* first_token)>;
+	using Node     = Token*;
+	struct List
+	{};
+	using TokenList      = List;
+	using NodeList       = Token*;
+	using TableEntryList = List;
+	using ElseClauseList = List;
+
+	EventAstBuilder() = default;
+	explicit EventAstBuilder(Callback callback)
+		: callback_(std::move(callback))
+	{}
+
+	Node MakeParenExpr(Node, Token* token_open_paren)
+	{
+		return emit(AstNodeType::ParenExpr, token_open_paren);
+	}
+	Node MakeVariableExpr(Token* token_variable)
+	{
+		return emit(AstNodeType::VariableExpr, token_variable);
+	}
+	Node MakeTableLiteral(TableEntryList, Token* token_open_brace, Token*)
+	{
+		return emit(AstNodeType::TableLiteral, token_open_brace);
+	}
+	Node MakeFunctionLiteral(TokenList, Node, Token* token_function, Token*)
+	{
+		return emit(AstNodeType::FunctionLiteral, token_function);
+	}
+	Node MakeFunctionStat(TokenList, TokenList, Node, Token* token_function, Token*, bool)
+	{
+		return emit(AstNodeType::FunctionStat, token_function);
+	}
+	Node MakeArgCall(NodeList, Token* token_open_paren)
+	{
+		return emit(AstNodeType::ArgCall, token_open_paren);
+	}
+	Node MakeTableCall(Node table_expr) { return emit(AstNodeType::TableCall, table_expr); }
+	Node MakeStringCall(Token* token_string) { return emit(AstNodeType::StringCall, token_string); }
+	Node MakeFieldExpr(Node base, Token*) { return emit(AstNodeType::FieldExpr, base); }
+	Node MakeMethodExpr(Node base, Token*, Node) { return emit(AstNodeType::MethodExpr, base); }
+	Node MakeIndexExpr(Node base, Node) { return emit(AstNodeType::IndexExpr, base); }
+	Node MakeCallExpr(Node base, Node) { return emit(AstNodeType::CallExpr, base); }
+	Node MakeNumberLiteral(Token* token) { return emit(AstNodeType::NumberLiteral, token); }
+	Node MakeStringLiteral(Token* token) { return emit(AstNodeType::StringLiteral, token); }
+	Node MakeNilLiteral(Token* token) { return emit(AstNodeType::NilLiteral, token); }
+	Node MakeBooleanLiteral(Token* token) { return emit(AstNodeType::BooleanLiteral, token); }
+	Node MakeVargLiteral(Token* token) { return emit(AstNodeType::VargLiteral, token); }
+	Node MakeNotExpr(Node, Token* token_not) { return emit(AstNodeType::NotExpr, token_not); }
+	Node MakeNegativeExpr(Node, Token* token_negative)
+	{
+		return emit(AstNodeType::NegativeExpr, token_negative);
+	}
+	Node MakeLengthExpr(Node, Token* token_pound)
+	{
+		return emit(AstNodeType::LengthExpr, token_pound);
+	}
+	Node MakeAddExpr(Node lhs, Node) { return emit(AstNodeType::AddExpr, lhs); }
+	Node MakeSubExpr(Node lhs, Node) { return emit(AstNodeType::SubExpr, lhs); }
+	Node MakeMulExpr(Node lhs, Node) { return emit(AstNodeType::MulExpr, lhs); }
+	Node MakeDivExpr(Node lhs, Node) { return emit(AstNodeType::DivExpr, lhs); }
+	Node MakePowExpr(Node lhs, Node) { return emit(AstNodeType::PowExpr, lhs); }
+	Node MakeModExpr(Node lhs, Node) { return emit(AstNodeType::ModExpr, lhs); }
+	Node MakeConcatExpr(Node lhs, Node) { return emit(AstNodeType::ConcatExpr, lhs); }
+	Node MakeEqExpr(Node lhs, Node) { return emit(AstNodeType::EqExpr, lhs); }
+	Node MakeNeqExpr(Node lhs, Node) { return emit(AstNodeType::NeqExpr, lhs); }
+	Node MakeLtExpr(Node lhs, Node) { return emit(AstNodeType::LtExpr, lhs); }
+	Node MakeLeExpr(Node lhs, Node) { return emit(AstNodeType::LeExpr, lhs); }
+	Node MakeGtExpr(Node lhs, Node) { return emit(AstNodeType::GtExpr, lhs); }
+	Node MakeGeExpr(Node lhs, Node) { return emit(AstNodeType::GeExpr, lhs); }
+	Node MakeAndExpr(Node lhs, Node) { return emit(AstNodeType::AndExpr, lhs); }
+	Node MakeOrExpr(Node lhs, Node) { return emit(AstNodeType::OrExpr, lhs); }
+	Node MakeCallExprStat(Node expr) { return emit(AstNodeType::CallExprStat, expr); }
+	Node MakeAssignmentStat(NodeList lhs, NodeList)
+	{
+		return emit(AstNodeType::AssignmentStat, lhs);
+	}
+	Node MakeIfStat(Node, Node, ElseClauseList, Token* token_if, Token*)
+	{
+		return emit(AstNodeType::IfStat, token_if);
+	}
+	Node MakeDoStat(Node, Token* token_do, Token*) { return emit(AstNodeType::DoStat, token_do); }
+	Node MakeWhileStat(Node, Node, Token* token_while, Token*)
+	{
+		return emit(AstNodeType::WhileStat, token_while);
+	}
+	Node MakeNumericForStat(TokenList, NodeList, Node, Token* token_for, Token*)
+	{
+		return emit(AstNodeType::NumericForStat, token_for);
+	}
+	Node MakeGenericForStat(TokenList, NodeList, Node, Token* token_for, Token*)
+	{
+		return emit(AstNodeType::GenericForStat, token_for);
+	}
+	Node MakeRepeatStat(Node, Node, Token* token_repeat, Token*)
+	{
+		return emit(AstNodeType::RepeatStat, token_repeat);
+	}
+	Node MakeLocalFunctionStat(Node, Token* token_local)
+	{
+		return emit(AstNodeType::LocalFunctionStat, token_local);
+	}
+	Node MakeLocalVarStat(TokenList, NodeList, Token* token_local)
+	{
+		return emit(AstNodeType::LocalVarStat, token_local);
+	}
+	Node MakeReturnStat(NodeList, Token* token_return)
+	{
+		return emit(AstNodeType::ReturnStat, token_return);
+	}
+	Node MakeBreakStat(Token* token_break) { return emit(AstNodeType::BreakStat, token_break); }
+	Node MakeStatList(NodeList stats) { return emit(AstNodeType::StatList, stats); }
+	Node MakeGotoStat(Token*, Token* token_goto) { return emit(AstNodeType::GotoStat, token_goto); }
+	Node MakeLabelStat(Token*, Token* token_label_start)
+	{
+		return emit(AstNodeType::LabelStat, token_label_start);
+	}
+
+	size_t BeginTokenList() const noexcept { return 0; }
+	void   PushToken(Token*) noexcept {}
+	List   EndTokenList(size_t) noexcept { return {}; }
+
+	// 节点列表只记下首元素，语句列表与赋值语句以它作为首个 token
+	size_t   BeginNodeList() const noexcept { return nodes_.size(); }
+	void     PushNode(Node node) { nodes_.push_back(node); }
+	NodeList EndNodeList(size_t mark)
+	{
+		Token* first = mark < nodes_.size() ? nodes_[mark] : nullptr;
+		nodes_.resize(mark);
+		return first;
+	}
+
+	size_t BeginTableEntryList() const noexcept { return 0; }
+	void   PushIndexEntry(Token*, Node, Node) noexcept {}
+	void   PushFieldEntry(Token*, Node) noexcept {}
+	void   PushValueEntry(Node) noexcept {}
+	List   EndTableEntryList(size_t) noexcept { return {}; }
+	size_t BeginElseClauseList() const noexcept { return 0; }
+	void   PushElseIfClause(Node, Node, Token*) noexcept {}
+	void   PushElseClause(Node, Token*) noexcept {}
+	List   EndElseClauseList(size_t) noexcept { return {}; }
+
+private:
+	Node emit(AstNodeType type, Token* first_token)
+	{
+		if (callback_) {
+			callback_(type, first_token);
+		}
+		return first_token;
+	}
+
+	Callback            callback_;
+	std::vector<Token*> nodes_;
+};
+}   // namespace dl
@@ -1,13 +1,24 @@
 #pragma once
 #include "dl/arena.h"
 #include "dl/ast.h"
+#include "dl/span.h"
 #include "dl/token.h"
-#include <vector>
+#include <cstddef>
 
 namespace dl {
+/**
+ * @brief 构建完整 AST 的构建器，Parser 的默认构建策略
+ * @details 构建策略需要提供的接口见 ast_builder.h
+ */
 class AstManager
 {
 public:
+	using Node           = AstNode*;
+	using TokenList      = Span<Token*>;
+	using NodeList       = Span<AstNode*>;
+	using TableEntryList = Span<AstNode::TableEntry>;
+	using ElseClauseList = Span<AstNode::IfStat::GeneralElseClause>;
+
 	// 基本表达式
 	AstNode* MakeParenExpr(AstNode* expr, Token* token_open_paren)
 	{
@@ -19,25 +30,25 @@ public:
 	}
 
 	// 复合结构
-	AstNode* MakeTableLiteral(std::vector<AstNode::TableEntry>&& entries, Token* token_open_brace,
+	AstNode* MakeTableLiteral(Span<AstNode::TableEntry> entries, Token* token_open_brace,
 							  Token* token_close_brace)
 	{
-		return ast_arena_.emplace(AstNode::TableLiteral{std::move(entries), token_close_brace},
+		return ast_arena_.emplace(AstNode::TableLiteral{entries, token_close_brace},
 								  token_open_brace);
 	}
-	AstNode* MakeFunctionLiteral(std::vector<Token*>* args, AstNode* body, Token* token_function,
+	AstNode* MakeFunctionLiteral(Span<Token*> args, AstNode* body, Token* token_function,
 								 Token* token_end)
 	{
 		return ast_arena_.emplace(AstNode::FunctionLiteral{args, body, token_end}, token_function);
 	}
-	AstNode* MakeFunctionStat(std::vector<Token*>* name_chain, std::vector<Token*>* args,
+	AstNode* MakeFunctionStat(Span<Token*> name_chain, Span<Token*> args,
 							  AstNode* body, Token* token_function, Token* token_end,
 							  bool is_method)
 	{
 		return ast_arena_.emplace(
-			AstNode::FunctionStat{name_chain, args, body, token_end, is_method}, token_function);
+			AstNode::FunctionStat{name_chain, args, body, token_end}, token_function, is_method);
 	}
-	AstNode* MakeArgCall(std::vector<AstNode*>* args, Token* token_open_paren)
+	AstNode* MakeArgCall(Span<AstNode*> args, Token* token_open_paren)
 	{
 		return ast_arena_.emplace(AstNode::ArgCall{args}, token_open_paren);
 	}
@@ -169,12 +180,12 @@ public:
 	{
 		return ast_arena_.emplace(AstNode::CallExprStat{expr}, expr->first_token_);
 	}
-	AstNode* MakeAssignmentStat(std::vector<AstNode*>* lhs, std::vector<AstNode*>* rhs)
+	AstNode* MakeAssignmentStat(Span<AstNode*> lhs, Span<AstNode*> rhs)
 	{
-		return ast_arena_.emplace(AstNode::AssignmentStat{lhs, rhs}, (*lhs)[0]->first_token_);
+		return ast_arena_.emplace(AstNode::AssignmentStat{lhs, rhs}, lhs[0]->first_token_);
 	}
 	AstNode* MakeIfStat(AstNode* cond, AstNode* body,
-						std::vector<AstNode::IfStat::GeneralElseClause>* else_clauses,
+						Span<AstNode::IfStat::GeneralElseClause> else_clauses,
 						Token* token_if, Token* token_end)
 	{
 		return ast_arena_.emplace(AstNode::IfStat{cond, body, else_clauses, token_end}, token_if);
@@ -187,12 +198,12 @@ public:
 	{
 		return ast_arena_.emplace(AstNode::WhileStat{cond, body, token_end}, token_while);
 	}
-	AstNode* MakeNumericForStat(std::vector<Token*>* vars, std::vector<AstNode*>* range,
+	AstNode* MakeNumericForStat(Span<Token*> vars, Span<AstNode*> range,
 								AstNode* body, Token* token_for, Token* token_end)
 	{
 		return ast_arena_.emplace(AstNode::NumericForStat{vars, range, body, token_end}, token_for);
 	}
-	AstNode* MakeGenericForStat(std::vector<Token*>* vars, std::vector<AstNode*>* gens,
+	AstNode* MakeGenericForStat(Span<Token*> vars, Span<AstNode*> gens,
 								AstNode* body, Token* token_for, Token* token_end)
 	{
 		return ast_arena_.emplace(AstNode::GenericForStat{vars, gens, body, token_end}, token_for);
@@ -205,12 +216,12 @@ public:
 	{
 		return ast_arena_.emplace(AstNode::LocalFunctionStat{func_stat}, token_local);
 	}
-	AstNode* MakeLocalVarStat(std::vector<Token*>* vars, std::vector<AstNode*>* exprs,
+	AstNode* MakeLocalVarStat(Span<Token*> vars, Span<AstNode*> exprs,
 							  Token* token_local)
 	{
 		return ast_arena_.emplace(AstNode::LocalVarStat{vars, exprs}, token_local);
 	}
-	AstNode* MakeReturnStat(std::vector<AstNode*>* exprs, Token* token_return)
+	AstNode* MakeReturnStat(Span<AstNode*> exprs, Token* token_return)
 	{
 		return ast_arena_.emplace(AstNode::ReturnStat{exprs}, token_return);
 	}
@@ -218,10 +229,10 @@ public:
 	{
 		return ast_arena_.emplace(AstNode::BreakStat{}, token_break);
 	}
-	AstNode* MakeStatList(std::vector<AstNode*>* stats)
+	AstNode* MakeStatList(Span<AstNode*> stats)
 	{
 		return ast_arena_.emplace(AstNode::StatList{stats},
-								  stats->empty() ? nullptr : (*stats)[0]->first_token_);
+								  stats.empty() ? nullptr : stats[0]->first_token_);
 	}
 	AstNode* MakeGotoStat(Token* label, Token* token_goto)
 	{
@@ -231,25 +242,103 @@ public:
 	{
 		return ast_arena_.emplace(AstNode::LabelStat{label}, token_label_start);
 	}
-	std::vector<Token*>*   MakeTokenVector() { return token_vector_arena_.emplace(); }
-	std::vector<AstNode*>* MakeAstNodeVector() { return ast_node_vector_arena_.emplace(); }
-	std::vector<AstNode::IfStat::GeneralElseClause>* MakeGeneralElseClauseVector()
+	// 变长列表先压入对应的暂存栈，整段解析完毕后再提交为 Span
+	size_t       BeginTokenList() const noexcept { return token_scratch_.mark(); }
+	void         PushToken(Token* token) { token_scratch_.push(token); }
+	Span<Token*> EndTokenList(size_t mark) { return token_scratch_.commit(mark, span_arena_); }
+
+	size_t         BeginNodeList() const noexcept { return ast_node_scratch_.mark(); }
+	void           PushNode(AstNode* node) { ast_node_scratch_.push(node); }
+	Span<AstNode*> EndNodeList(size_t mark) { return ast_node_scratch_.commit(mark, span_arena_); }
+
+	size_t BeginTableEntryList() const noexcept { return table_entry_scratch_.mark(); }
+	void   PushIndexEntry(Token* left_bracket, AstNode* index, AstNode* value)
+	{
+		table_entry_scratch_.emplace(AstNode::TableEntry::IndexEntry{left_bracket, index, value});
+	}
+	void PushFieldEntry(Token* field, AstNode* value)
+	{
+		table_entry_scratch_.emplace(AstNode::TableEntry::FieldEntry{field, value});
+	}
+	void PushValueEntry(AstNode* value)
 	{
-		return general_else_clause_vector_arena_.emplace();
+		table_entry_scratch_.emplace(AstNode::TableEntry::ValueEntry{value});
 	}
+	Span<AstNode::TableEntry> EndTableEntryList(size_t mark)
+	{
+		return table_entry_scratch_.commit(mark, span_arena_);
+	}
+
+	size_t BeginElseClauseList() const noexcept { return general_else_clause_scratch_.mark(); }
+	void   PushElseIfClause(AstNode* cond, AstNode* body, Token* token_elseif)
+	{
+		general_else_clause_scratch_.emplace(AstNode::IfStat::ElseIfClause{cond}, body, token_elseif);
+	}
+	void PushElseClause(AstNode* body, Token* token_else)
+	{
+		general_else_clause_scratch_.emplace(AstNode::IfStat::ElseClause{}, body, token_else);
+	}
+	Span<AstNode::IfStat::GeneralElseClause> EndElseClauseList(size_t mark)
+	{
+		return general_else_clause_scratch_.commit(mark, span_arena_);
+	}
+
+	/**
+	 * @brief 丢弃所有节点，保留已申请的内存块供下一个文件复用
+	 */
+	void Reset()
+	{
+		ast_arena_.reset();
+		span_arena_.reset();
+		token_scratch_.clear();
+		ast_node_scratch_.clear();
+		table_entry_scratch_.clear();
+		general_else_clause_scratch_.clear();
+	}
+
+	/**
+	 * @brief 已申请的内存总量，包括 Reset 后留着复用的部分
+	 */
+	size_t ReservedBytes() const noexcept
+	{
+		return ast_arena_.reserved_bytes() + span_arena_.reserved_bytes() +
+			   token_scratch_.reserved_bytes() + ast_node_scratch_.reserved_bytes() +
+			   table_entry_scratch_.reserved_bytes() +
+			   general_else_clause_scratch_.reserved_bytes();
+	}
+
+	/**
+	 * @brief 上次 Reset 以来节点与列表实际占用的内存
+	 */
+	size_t UsedBytes() const noexcept
+	{
+		return ast_arena_.size() * sizeof(AstNode) + span_arena_.used_bytes();
+	}
+
+	/**
+	 * @brief 上次 Reset 以来创建的节点数
+	 */
+	size_t NodeCount() const noexcept { return ast_arena_.size(); }
 
+	/**
+	 * @brief 丢弃所有节点并释放全部内存
+	 */
 	void Clear()
 	{
 		ast_arena_.clear();
-		token_vector_arena_.clear();
-		ast_node_vector_arena_.clear();
-		general_else_clause_vector_arena_.clear();
+		span_arena_.clear();
+		token_scratch_.release();
+		ast_node_scratch_.release();
+		table_entry_scratch_.release();
+		general_else_clause_scratch_.release();
 	}
 
 private:
-	Arena<AstNode, 2048>                                        ast_arena_;
-	Arena<std::vector<Token*>, 1024>                            token_vector_arena_;
-	Arena<std::vector<AstNode*>, 1024>                          ast_node_vector_arena_;
-	Arena<std::vector<AstNode::IfStat::GeneralElseClause>, 1024> general_else_clause_vector_arena_;
+	Arena<AstNode, 2048>                             ast_arena_;
+	ByteArena<>                                      span_arena_;
+	ScratchStack<Token*>                             token_scratch_;
+	ScratchStack<AstNode*>                           ast_node_scratch_;
+	ScratchStack<AstNode::TableEntry>                table_entry_scratch_;
+	ScratchStack<AstNode::IfStat::GeneralElseClause> general_else_clause_scratch_;
 };
-}   // namespace dl
\ No newline at end of file
+}   // namespace dl
@@ -1,6 +1,8 @@
 #pragma once
 #include "dl/ast.h"
+#include "dl/output_sink.h"
 #include "dl/token.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <ostream>
@@ -14,10 +16,14 @@ enum class AstPrintMode
 	Auto,
 	Manual,
 };
-template<AstPrintMode mode> class AstPrinter
+/**
+ * @brief 把 AST 打印成代码，输出先攒在 64 KB 的缓冲区里，再整块交给 Sink
+ * @details Sink 的接口见 output_sink.h，默认为 std::ostream
+ */
+template<AstPrintMode mode, typename Sink = std::ostream> class AstPrinter
 {
 public:
-	AstPrinter(std::ostream& out, const std::vector<CommentToken>* comment_tokens = nullptr)
+	AstPrinter(Sink& out, const std::vector<CommentToken>* comment_tokens = nullptr)
 		: out_(out)
 		, comment_tokens_(comment_tokens)
 		, indent_(0)
@@ -52,6 +58,13 @@ public:
 				++comment_index_;
 			}
 		}
+		else {
+			// 文件末尾保留一个换行
+			if (pending_separator_ != CompressSeparator::None) {
+				pending_separator_ = CompressSeparator::None;
+				append('\n');
+			}
+		}
 		flush();
 	}
 
@@ -68,6 +81,18 @@ private:
 		Call,
 		Goto
 	};
+	/**
+	 * @brief Separator that compress mode still owes the output, decided by the next character
+	 *
+	 */
+	enum class CompressSeparator
+	{
+		None,
+		// 块的开始（then、do、函数参数列表之后），仅在下一个字符为标识符字符时需要空格
+		BlockStart,
+		// 语句之间，下一条语句以 '(' 开头时必须用 ';' 消歧义，否则用空格
+		Statement
+	};
 	void print_token(const Token* token) noexcept
 	{
 		if constexpr (mode == AstPrintMode::Compress) {
@@ -131,7 +156,13 @@ private:
 		else if (type == AstNodeType::SubExpr) {
 			print_expr(expr->sub_expr_.lhs_);
 			if constexpr (mode == AstPrintMode::Compress) {
-				append('-');
+				// a - -b 不能写成 a--b，否则会变成注释
+				if (starts_with_negative(expr->sub_expr_.rhs_)) {
+					append("- ");
+				}
+				else {
+					append('-');
+				}
 			}
 			else {
 				append(" - ");
@@ -184,7 +215,14 @@ private:
 		else if (type == AstNodeType::ConcatExpr) {
 			print_expr(expr->concat_expr_.lhs_);
 			if constexpr (mode == AstPrintMode::Compress) {
+				// "2..x" and "x...5" would be read as other tokens
+				if (ends_with_number(expr->concat_expr_.lhs_)) {
+					space();
+				}
 				append("..");
+				if (starts_with_fraction(expr->concat_expr_.rhs_)) {
+					space();
+				}
 			}
 			else {
 				append(" .. ");
@@ -277,6 +315,10 @@ private:
 		}
 		else if (type == AstNodeType::NegativeExpr) {
 			print_token(expr->first_token_);
+			// - -a 不能写成 --a
+			if (starts_with_negative(expr->negative_expr_.rhs_)) {
+				space();
+			}
 			print_expr(expr->negative_expr_.rhs_);
 		}
 		else if (type == AstNodeType::NumberLiteral || type == AstNodeType::StringLiteral ||
@@ -307,7 +349,7 @@ private:
 				print_token(function_args->first_token_);
 			}
 			else if (call_type == AstNodeType::ArgCall) {
-				const auto& arg_list = *function_args->arg_call_.arg_list_;
+				const auto& arg_list = function_args->arg_call_.arg_list_;
 				append('(');
 				for (size_t i = 0; i < arg_list.size(); ++i) {
 					print_expr(arg_list[i]);
@@ -336,7 +378,7 @@ private:
 				print_token(function_args->first_token_);
 			}
 			else if (call_type == AstNodeType::ArgCall) {
-				const auto& arg_list = *function_args->arg_call_.arg_list_;
+				const auto& arg_list = function_args->arg_call_.arg_list_;
 				append('(');
 				for (size_t i = 0; i < arg_list.size(); ++i) {
 					print_expr(arg_list[i]);
@@ -358,7 +400,7 @@ private:
 			auto& node = expr->function_literal_;
 			print_token(expr->first_token_);
 			append('(');
-			const auto& arg_list = *node.arg_list_;
+			const auto& arg_list = node.arg_list_;
 			for (size_t i = 0; i < arg_list.size(); ++i) {
 				print_token(arg_list[i]);
 				if (i < arg_list.size() - 1) {
@@ -482,7 +524,7 @@ private:
 	void print_stat(const AstNode* stat) noexcept
 	{
 		if (stat->type_ == AstNodeType::StatList) {
-			const auto& statement_list = *stat->stat_list_.statement_list_;
+			const auto& statement_list = stat->stat_list_.statement_list_;
 			for (const auto& stat : statement_list) {
 				print_stat(stat);
 			}
@@ -499,13 +541,18 @@ private:
 		else if (stat->type_ == AstNodeType::ReturnStat) {
 			auto& node = stat->return_stat_;
 			print_token(stat->first_token_);
-			const auto& expr_list = *node.expr_list_;
+			const auto& expr_list = node.expr_list_;
 			if (!expr_list.empty()) {
 				space();
 				for (size_t i = 0; i < expr_list.size(); ++i) {
 					print_expr(expr_list[i]);
 					if (i < expr_list.size() - 1) {
-						append(", ");
+						if constexpr (mode != AstPrintMode::Compress) {
+							append(", ");
+						}
+						else {
+							append(',');
+						}
 					}
 				}
 			}
@@ -514,7 +561,7 @@ private:
 			auto& node = stat->local_var_stat_;
 			print_token(stat->first_token_);
 			space();
-			auto& var_list = *node.var_list_;
+			auto& var_list = node.var_list_;
 			for (size_t i = 0; i < var_list.size(); ++i) {
 				print_token(var_list[i]);
 				if (i < var_list.size() - 1) {
@@ -525,7 +572,7 @@ private:
                     }
 				}
 			}
-			const auto& expr_list = *node.expr_list_;
+			const auto& expr_list = node.expr_list_;
 			if (expr_list.size() > 0) {
 				if constexpr (mode != AstPrintMode::Compress) {
 					append(" = ");
@@ -553,9 +600,9 @@ private:
 			print_token(function_node->first_token_);
 			space();
 			auto& function_stat = function_node->function_stat_;
-			print_token((*function_stat.name_chain_)[0]);
+			print_token(function_stat.name_chain_[0]);
 			append('(');
-			const auto& arg_list = *function_stat.arg_list_;
+			const auto& arg_list = function_stat.arg_list_;
 			for (size_t i = 0; i < arg_list.size(); ++i) {
 				print_token(arg_list[i]);
 				if (i < arg_list.size() - 1) {
@@ -576,11 +623,11 @@ private:
 			auto& function_stat = stat->function_stat_;
 			print_token(stat->first_token_);
 			space();
-			auto& name_chain = *function_stat.name_chain_;
+			auto& name_chain = function_stat.name_chain_;
 			for (size_t i = 0; i < name_chain.size(); ++i) {
 				print_token(name_chain[i]);
 				if (i < name_chain.size() - 1) {
-					if (function_stat.is_method_ && i == name_chain.size() - 2) {
+					if (stat->is_method_ && i == name_chain.size() - 2) {
 						append(':');
 					}
 					else {
@@ -589,7 +636,7 @@ private:
 				}
 			}
 			append('(');
-			auto& arg_list = *function_stat.arg_list_;
+			auto& arg_list = function_stat.arg_list_;
 			for (size_t i = 0; i < arg_list.size(); ++i) {
 				print_token(arg_list[i]);
 				if (i < arg_list.size() - 1) {
@@ -620,7 +667,7 @@ private:
 			auto& node = stat->generic_for_stat_;
 			print_token(stat->first_token_);
 			space();
-			const auto& var_list = *node.var_list_;
+			const auto& var_list = node.var_list_;
 			for (size_t i = 0; i < var_list.size(); ++i) {
 				print_token(var_list[i]);
 				if (i < var_list.size() - 1) {
@@ -632,7 +679,7 @@ private:
 				}
 			}
 			append(" in ");
-			const auto& generator_list = *node.generator_list_;
+			const auto& generator_list = node.generator_list_;
 			for (size_t i = 0; i < generator_list.size(); ++i) {
 				print_expr(generator_list[i]);
 				if (i < generator_list.size() - 1) {
@@ -653,7 +700,7 @@ private:
 			auto& node = stat->numeric_for_stat_;
 			print_token(stat->first_token_);
 			space();
-			const auto& var_list = *node.var_list_;
+			const auto& var_list = node.var_list_;
 			for (size_t i = 0; i < var_list.size(); ++i) {
 				print_token(var_list[i]);
 				if (i < var_list.size() - 1) {
@@ -670,7 +717,7 @@ private:
 			else {
 				append('=');
 			}
-			const auto& range_list = *node.range_list_;
+			const auto& range_list = node.range_list_;
 			for (size_t i = 0; i < range_list.size(); ++i) {
 				print_expr(range_list[i]);
 				if (i < range_list.size() - 1) {
@@ -715,7 +762,7 @@ private:
 			enter_group();
 			print_stat(node.body_);
 			exit_group();
-			const auto& else_clauses = *node.else_clauses_;
+			const auto& else_clauses = node.else_clauses_;
 			for (size_t i = 0; i < else_clauses.size(); ++i) {
 				auto& clause = else_clauses[i];
 				print_token(clause.else_token_);
@@ -735,7 +782,7 @@ private:
 		}
 		else if (stat->type_ == AstNodeType::AssignmentStat) {
 			auto&       node = stat->assignment_stat_;
-			const auto& lhs  = *node.lhs_;
+			const auto& lhs  = node.lhs_;
 			for (size_t i = 0; i < lhs.size(); ++i) {
 				print_expr(lhs[i]);
 				if (i < lhs.size() - 1) {
@@ -752,7 +799,7 @@ private:
 			else {
 				append('=');
 			}
-			const auto& rhs = *node.rhs_;
+			const auto& rhs = node.rhs_;
 			for (size_t i = 0; i < rhs.size(); ++i) {
 				print_expr(rhs[i]);
 				if (i < rhs.size() - 1) {
@@ -831,13 +878,100 @@ private:
 		default: return FormatStatGroup::None;
 		}
 	}
+	/**
+	 * @brief Whether the printed form of expr begins with a unary minus
+	 *
+	 */
+	static bool starts_with_negative(const AstNode* expr) noexcept
+	{
+		while (true) {
+			switch (expr->type_) {
+			case AstNodeType::NegativeExpr: return true;
+			case AstNodeType::AddExpr: expr = expr->add_expr_.lhs_; break;
+			case AstNodeType::SubExpr: expr = expr->sub_expr_.lhs_; break;
+			case AstNodeType::MulExpr: expr = expr->mul_expr_.lhs_; break;
+			case AstNodeType::DivExpr: expr = expr->div_expr_.lhs_; break;
+			case AstNodeType::PowExpr: expr = expr->pow_expr_.lhs_; break;
+			case AstNodeType::ModExpr: expr = expr->mod_expr_.lhs_; break;
+			case AstNodeType::ConcatExpr: expr = expr->concat_expr_.lhs_; break;
+			case AstNodeType::EqExpr: expr = expr->eq_expr_.lhs_; break;
+			case AstNodeType::NeqExpr: expr = expr->neq_expr_.lhs_; break;
+			case AstNodeType::LtExpr: expr = expr->lt_expr_.lhs_; break;
+			case AstNodeType::LeExpr: expr = expr->le_expr_.lhs_; break;
+			case AstNodeType::GtExpr: expr = expr->gt_expr_.lhs_; break;
+			case AstNodeType::GeExpr: expr = expr->ge_expr_.lhs_; break;
+			case AstNodeType::AndExpr: expr = expr->and_expr_.lhs_; break;
+			case AstNodeType::OrExpr: expr = expr->or_expr_.lhs_; break;
+			default: return false;
+			}
+		}
+	}
+	/**
+	 * @brief Whether the printed form of expr begins with a number literal like ".5"
+	 *
+	 */
+	static bool starts_with_fraction(const AstNode* expr) noexcept
+	{
+		while (true) {
+			switch (expr->type_) {
+			case AstNodeType::NumberLiteral: return expr->first_token_->source_.front() == '.';
+			case AstNodeType::AddExpr: expr = expr->add_expr_.lhs_; break;
+			case AstNodeType::SubExpr: expr = expr->sub_expr_.lhs_; break;
+			case AstNodeType::MulExpr: expr = expr->mul_expr_.lhs_; break;
+			case AstNodeType::DivExpr: expr = expr->div_expr_.lhs_; break;
+			case AstNodeType::PowExpr: expr = expr->pow_expr_.lhs_; break;
+			case AstNodeType::ModExpr: expr = expr->mod_expr_.lhs_; break;
+			case AstNodeType::ConcatExpr: expr = expr->concat_expr_.lhs_; break;
+			case AstNodeType::EqExpr: expr = expr->eq_expr_.lhs_; break;
+			case AstNodeType::NeqExpr: expr = expr->neq_expr_.lhs_; break;
+			case AstNodeType::LtExpr: expr = expr->lt_expr_.lhs_; break;
+			case AstNodeType::LeExpr: expr = expr->le_expr_.lhs_; break;
+			case AstNodeType::GtExpr: expr = expr->gt_expr_.lhs_; break;
+			case AstNodeType::GeExpr: expr = expr->ge_expr_.lhs_; break;
+			case AstNodeType::AndExpr: expr = expr->and_expr_.lhs_; break;
+			case AstNodeType::OrExpr: expr = expr->or_expr_.lhs_; break;
+			default: return false;
+			}
+		}
+	}
+	/**
+	 * @brief Whether the printed form of expr ends with a number literal
+	 *
+	 */
+	static bool ends_with_number(const AstNode* expr) noexcept
+	{
+		while (true) {
+			switch (expr->type_) {
+			case AstNodeType::NumberLiteral: return true;
+			case AstNodeType::NotExpr: expr = expr->not_expr_.rhs_; break;
+			case AstNodeType::NegativeExpr: expr = expr->negative_expr_.rhs_; break;
+			case AstNodeType::LengthExpr: expr = expr->length_expr_.rhs_; break;
+			case AstNodeType::AddExpr: expr = expr->add_expr_.rhs_; break;
+			case AstNodeType::SubExpr: expr = expr->sub_expr_.rhs_; break;
+			case AstNodeType::MulExpr: expr = expr->mul_expr_.rhs_; break;
+			case AstNodeType::DivExpr: expr = expr->div_expr_.rhs_; break;
+			case AstNodeType::PowExpr: expr = expr->pow_expr_.rhs_; break;
+			case AstNodeType::ModExpr: expr = expr->mod_expr_.rhs_; break;
+			case AstNodeType::ConcatExpr: expr = expr->concat_expr_.rhs_; break;
+			case AstNodeType::EqExpr: expr = expr->eq_expr_.rhs_; break;
+			case AstNodeType::NeqExpr: expr = expr->neq_expr_.rhs_; break;
+			case AstNodeType::LtExpr: expr = expr->lt_expr_.rhs_; break;
+			case AstNodeType::LeExpr: expr = expr->le_expr_.rhs_; break;
+			case AstNodeType::GtExpr: expr = expr->gt_expr_.rhs_; break;
+			case AstNodeType::GeExpr: expr = expr->ge_expr_.rhs_; break;
+			case AstNodeType::AndExpr: expr = expr->and_expr_.rhs_; break;
+			case AstNodeType::OrExpr: expr = expr->or_expr_.rhs_; break;
+			default: return false;
+			}
+		}
+	}
 	const CommentToken* comment_token() const noexcept
 	{
 		return &(*comment_tokens_)[comment_index_];
 	}
 
 	/**
-	 * @brief Simply I don't think indent would exceed 32 in normal use
+	 * @brief Indent is rarely deeper than 31, deeper indents are written in several chunks
 	 * @note this function should be called only when line_start_ is true, as every indent is at the
 	 * line start
 	 *
@@ -847,17 +981,24 @@ private:
 		static constexpr int  MAX_INDENT = 32;
 		static constexpr char tabs[MAX_INDENT] =
 			"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
-		append(tabs, indent_);
+		int remaining = indent_;
+		while (remaining > 0) {
+			const int count = std::min(remaining, MAX_INDENT - 1);
+			append(tabs, count);
+			remaining -= count;
+		}
 	}
 	void space() noexcept { append(' '); }
 	/**
 	 * @brief Break line, and set line_start_ to true in non-compress mode
+	 * @note In compress mode statements are joined on one line, the separator is deferred until the
+	 * next character is known
 	 *
 	 */
 	void breakline() noexcept
 	{
 		if constexpr (mode == AstPrintMode::Compress) {
-			append('\n');
+			pending_separator_ = CompressSeparator::Statement;
 		}
 		else {
 			if (comment_index_ < comment_tokens_->size()) {
@@ -901,8 +1042,11 @@ private:
 
 	void enter_group() noexcept
 	{
-		breakline();
-		if constexpr (mode != AstPrintMode::Compress) {
+		if constexpr (mode == AstPrintMode::Compress) {
+			pending_separator_ = CompressSeparator::BlockStart;
+		}
+		else {
+			breakline();
 			++indent_;
 			set_format_stat_group(FormatStatGroup::None);
 		}
@@ -930,6 +1074,11 @@ private:
 	 */
 	void append(const char* data, size_t size) noexcept
 	{
+		if constexpr (mode == AstPrintMode::Compress) {
+			if (pending_separator_ != CompressSeparator::None && size > 0) {
+				write_separator(data[0]);
+			}
+		}
 		if (buffer_pos_ + size > BUFFERSIZE) {
 			flush();
 		}
@@ -939,6 +1088,11 @@ private:
 
 	void append(char c) noexcept
 	{
+		if constexpr (mode == AstPrintMode::Compress) {
+			if (pending_separator_ != CompressSeparator::None) {
+				write_separator(c);
+			}
+		}
 		if (buffer_pos_ + 1 > BUFFERSIZE) {
 			flush();
 		}
@@ -947,9 +1101,26 @@ private:
 
 	void append(const std::string_view& str) noexcept { append(str.data(), str.size()); }
 
+	/**
+	 * @brief Write the pending compress separator that goes before next
+	 *
+	 * @param next the first character about to be appended
+	 */
+	void write_separator(char next) noexcept
+	{
+		const auto separator = pending_separator_;
+		pending_separator_   = CompressSeparator::None;
+		if (separator == CompressSeparator::Statement) {
+			append(next == '(' ? ';' : ' ');
+		}
+		else if (is_identifier_char(next)) {
+			append(' ');
+		}
+	}
+
 	// 64 KB buffer size
 	static constexpr size_t          BUFFERSIZE = 64 * 1024;
-	std::ostream&                    out_;
+	Sink&                            out_;
 	char                             buffer_[BUFFERSIZE];
 	size_t                           buffer_pos_     = 0;
 	std::size_t                      line_           = 1;
@@ -960,5 +1131,6 @@ private:
 	bool                             line_start_             = true;
 	bool                             last_is_block_stat_     = false;
 	bool                             is_block_start_         = true;
+	CompressSeparator                pending_separator_      = CompressSeparator::None;
 };
 }   // namespace dl
\ No newline at end of file
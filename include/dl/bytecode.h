@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+namespace dl {
+/**
+ * @brief Lua 5.1 虚拟机指令，顺序与 lopcodes.h 一致
+ *
+ */
+enum class OpCode : uint8_t
+{
+	MOVE,
+	LOADK,
+	LOADBOOL,
+	LOADNIL,
+	GETUPVAL,
+	GETGLOBAL,
+	GETTABLE,
+	SETGLOBAL,
+	SETUPVAL,
+	SETTABLE,
+	NEWTABLE,
+	SELF,
+	ADD,
+	SUB,
+	MUL,
+	DIV,
+	MOD,
+	POW,
+	UNM,
+	NOT,
+	LEN,
+	CONCAT,
+	JMP,
+	EQ,
+	LT,
+	LE,
+	TEST,
+	TESTSET,
+	CALL,
+	TAILCALL,
+	RETURN,
+	FORLOOP,
+	FORPREP,
+	TFORLOOP,
+	SETLIST,
+	CLOSE,
+	CLOSURE,
+	VARARG,
+};
+
+using Instruction = uint32_t;
+
+// 指令格式：低 6 位为操作码，之后依次为 A(8) C(9) B(9)，Bx 与 sBx 占用 C 与 B 的 18 位
+constexpr int SIZE_OP = 6;
+constexpr int SIZE_A  = 8;
+constexpr int SIZE_B  = 9;
+constexpr int SIZE_C  = 9;
+constexpr int SIZE_BX = SIZE_B + SIZE_C;
+constexpr int POS_A   = SIZE_OP;
+constexpr int POS_C   = POS_A + SIZE_A;
+constexpr int POS_B   = POS_C + SIZE_C;
+constexpr int POS_BX  = POS_C;
+
+constexpr int MAXARG_A   = (1 << SIZE_A) - 1;
+constexpr int MAXARG_B   = (1 << SIZE_B) - 1;
+constexpr int MAXARG_C   = (1 << SIZE_C) - 1;
+constexpr int MAXARG_BX  = (1 << SIZE_BX) - 1;
+constexpr int MAXARG_SBX = MAXARG_BX >> 1;
+
+// B、C 操作数最高位为 1 时表示常量表下标
+constexpr int BITRK      = 1 << (SIZE_B - 1);
+constexpr int MAXINDEXRK = BITRK - 1;
+// 表示“没有寄存器”的 A 操作数
+constexpr int NO_REG = MAXARG_A;
+// 表构造时每条 SETLIST 写入的数组元素数
+constexpr int LFIELDS_PER_FLUSH = 50;
+// 一个函数最多使用的寄存器数
+constexpr int MAXSTACK = 250;
+
+// Proto::is_vararg 的标志位
+constexpr uint8_t VARARG_HASARG   = 1;
+constexpr uint8_t VARARG_ISVARARG = 2;
+constexpr uint8_t VARARG_NEEDSARG = 4;
+
+constexpr bool is_constant(int rk)
+{
+	return (rk & BITRK) != 0;
+}
+constexpr int rk_constant(int index)
+{
+	return index | BITRK;
+}
+
+constexpr Instruction create_abc(OpCode op, int a, int b, int c)
+{
+	return static_cast<Instruction>(op) | (static_cast<Instruction>(a) << POS_A) |
+		   (static_cast<Instruction>(b) << POS_B) | (static_cast<Instruction>(c) << POS_C);
+}
+constexpr Instruction create_abx(OpCode op, int a, int bx)
+{
+	return static_cast<Instruction>(op) | (static_cast<Instruction>(a) << POS_A) |
+		   (static_cast<Instruction>(bx) << POS_BX);
+}
+
+constexpr OpCode get_opcode(Instruction i)
+{
+	return static_cast<OpCode>(i & ((1u << SIZE_OP) - 1));
+}
+constexpr int get_arg_a(Instruction i)
+{
+	return static_cast<int>((i >> POS_A) & MAXARG_A);
+}
+constexpr int get_arg_b(Instruction i)
+{
+	return static_cast<int>((i >> POS_B) & MAXARG_B);
+}
+constexpr int get_arg_c(Instruction i)
+{
+	return static_cast<int>((i >> POS_C) & MAXARG_C);
+}
+constexpr int get_arg_sbx(Instruction i)
+{
+	return static_cast<int>((i >> POS_BX) & MAXARG_BX) - MAXARG_SBX;
+}
+
+inline void set_opcode(Instruction& i, OpCode op)
+{
+	i = (i & ~((1u << SIZE_OP) - 1)) | static_cast<Instruction>(op);
+}
+inline void set_arg_a(Instruction& i, int a)
+{
+	i = (i & ~(static_cast<Instruction>(MAXARG_A) << POS_A)) | (static_cast<Instruction>(a) << POS_A);
+}
+inline void set_arg_b(Instruction& i, int b)
+{
+	i = (i & ~(static_cast<Instruction>(MAXARG_B) << POS_B)) | (static_cast<Instruction>(b) << POS_B);
+}
+inline void set_arg_c(Instruction& i, int c)
+{
+	i = (i & ~(static_cast<Instruction>(MAXARG_C) << POS_C)) | (static_cast<Instruction>(c) << POS_C);
+}
+inline void set_arg_sbx(Instruction& i, int sbx)
+{
+	i = (i & ~(static_cast<Instruction>(MAXARG_BX) << POS_BX)) |
+		(static_cast<Instruction>(sbx + MAXARG_SBX) << POS_BX);
+}
+
+/**
+ * @brief 条件跳转类指令，其后必须紧跟一条 JMP
+ *
+ */
+constexpr bool is_test_mode(OpCode op)
+{
+	return op == OpCode::EQ || op == OpCode::LT || op == OpCode::LE || op == OpCode::TEST ||
+		   op == OpCode::TESTSET || op == OpCode::TFORLOOP;
+}
+
+enum class ConstantType : uint8_t
+{
+	Nil     = 0,
+	Boolean = 1,
+	Number  = 3,
+	String  = 4,
+};
+
+struct Constant
+{
+	ConstantType type_    = ConstantType::Nil;
+	bool         boolean_ = false;
+	double       number_  = 0;
+	std::string  string_;
+};
+
+struct LocalVar
+{
+	std::string name_;
+	int         start_pc_;
+	int         end_pc_;
+};
+
+/**
+ * @brief 一个函数编译后的原型，对应 lobject.h 中的 Proto
+ *
+ */
+struct Proto
+{
+	std::vector<Instruction> code_;
+	// 每条指令对应的源码行号
+	std::vector<int>         line_info_;
+	std::vector<Constant>    constants_;
+	std::vector<Proto>       protos_;
+	std::vector<LocalVar>    local_vars_;
+	std::vector<std::string> upvalue_names_;
+	std::string              source_;
+	int                      line_defined_      = 0;
+	int                      last_line_defined_ = 0;
+	uint8_t                  num_upvalues_      = 0;
+	uint8_t                  num_params_        = 0;
+	uint8_t                  is_vararg_         = 0;
+	// 寄存器 0 与 1 总是可用
+	uint8_t                  max_stack_size_    = 2;
+};
+
+/**
+ * @brief 按 ldump.c 的格式把主函数原型写成二进制代码块，可直接被 Lua 5.1 的 loadstring/loadfile 加载
+ * @note 头部按本机的 size_t 宽度与字节序写入，与同平台 luac 的输出一致
+ *
+ * @param main 主函数原型
+ * @param strip 是否去掉行号、局部变量名与上值名等调试信息，对应 luac -s
+ * @return std::string
+ */
+std::string DumpChunk(const Proto& main, bool strip);
+}   // namespace dl
@@ -0,0 +1,221 @@
+#pragma once
+
+#include "dl/ast.h"
+#include "dl/bytecode.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+namespace dl {
+/**
+ * @brief 把 Parser 产生的 AST 编译为 Lua 5.1 函数原型
+ * @details 寄存器分配、常量表、上值解析与跳转链表的处理照搬 lparser.c 与 lcode.c（5.1.5），生成的
+ * 指令与 luac 基本一致，可用 DumpChunk 写成二进制代码块。
+ * @note goto 与标签是 Lua 5.2 的语法，遇到时报错
+ */
+class Compiler
+{
+public:
+	/**
+	 * @brief 编译以 root 为根的主代码块
+	 *
+	 * @param root
+	 * @param chunk_name 代码块名，如 "@path/to/file.lua"，出现在运行时错误信息中
+	 */
+	Compiler(AstNode* root, const std::string& chunk_name);
+	const Proto& GetProto() const noexcept { return main_; }
+
+private:
+	// 表达式的求值状态，对应 lparser.h 中的 expkind
+	enum class ExpKind
+	{
+		Void,        // 没有值
+		Nil,
+		True,
+		False,
+		K,           // info 为常量表下标
+		KNum,        // nval 为数值
+		Local,       // info 为局部变量的寄存器
+		Upval,       // info 为上值下标
+		Global,      // info 为全局变量名在常量表中的下标
+		Indexed,     // info 为表所在寄存器，aux 为键的 RK 操作数
+		Jmp,         // info 为条件跳转指令的位置
+		Relocable,   // info 为结果寄存器待定的指令位置
+		NonReloc,    // info 为结果所在寄存器
+		Call,        // info 为 CALL 指令的位置
+		Vararg,      // info 为 VARARG 指令的位置
+	};
+
+	struct ExpDesc
+	{
+		ExpKind k    = ExpKind::Void;
+		int     info = 0;
+		int     aux  = 0;
+		double  nval = 0;
+		// 值为真时的跳转链表
+		int     t    = -1;
+		// 值为假时的跳转链表
+		int     f    = -1;
+	};
+
+	struct UpvalDesc
+	{
+		ExpKind k;
+		int     info;
+	};
+
+	struct BlockCnt
+	{
+		BlockCnt* previous;
+		// break 跳转链表
+		int       break_list;
+		// 进入块时的活跃局部变量数
+		int       nactvar;
+		// 块中有局部变量被内层函数作为上值
+		bool      upval;
+		bool      is_breakable;
+	};
+
+	struct FuncState
+	{
+		Proto*                               f;
+		FuncState*                           prev;
+		BlockCnt*                            bl = nullptr;
+		// 最后一个跳转目标的位置
+		int                                  last_target = 0;
+		// 跳到当前位置的待回填跳转链表
+		int                                  jpc = -1;
+		int                                  freereg = 0;
+		int                                  nactvar = 0;
+		std::unordered_map<std::string, int> constant_index;
+		std::vector<UpvalDesc>               upvalues;
+		// 活跃局部变量在 Proto::local_vars_ 中的下标
+		std::vector<int>                     actvar;
+		int pc() const { return static_cast<int>(f->code_.size()); }
+	};
+
+	[[noreturn]] void error(const std::string_view message) const;
+
+	static bool has_jumps(const ExpDesc& e) { return e.t != e.f; }
+	static bool has_multret(ExpKind k) { return k == ExpKind::Call || k == ExpKind::Vararg; }
+	static bool is_numeral(const ExpDesc& e)
+	{
+		return e.k == ExpKind::KNum && e.t == -1 && e.f == -1;
+	}
+
+	/**
+	 * @brief 两个操作数都是数值常量时在编译期求值，结果为 NaN 或除数为 0 时放弃
+	 *
+	 * @param op
+	 * @param e1 折叠成功时保存结果
+	 * @param e2
+	 * @return true 折叠成功
+	 */
+	static bool const_folding(OpCode op, ExpDesc& e1, const ExpDesc& e2);
+
+	// lcode.c
+	int          code(Instruction i);
+	int          code_abc(OpCode op, int a, int b, int c);
+	int          code_abx(OpCode op, int a, int bx);
+	int          code_asbx(OpCode op, int a, int sbx);
+	Instruction& get_code(const ExpDesc& e);
+	void         fix_line(int line);
+	void         nil(int from, int n);
+	int          jump();
+	void         ret(int first, int nret);
+	int          cond_jump(OpCode op, int a, int b, int c);
+	void         fix_jump(int pc, int dest);
+	int          get_label();
+	int          get_jump(int pc) const;
+	Instruction& get_jump_control(int pc);
+	bool         need_value(int list);
+	bool         patch_test_reg(int node, int reg);
+	void         remove_values(int list);
+	void         patch_list_aux(int list, int vtarget, int reg, int dtarget);
+	void         discharge_jpc();
+	void         patch_list(int list, int target);
+	void         patch_to_here(int list);
+	void         concat(int& l1, int l2);
+	void         check_stack(int n);
+	void         reserve_regs(int n);
+	void         free_reg(int reg);
+	void         free_exp(const ExpDesc& e);
+	int          add_constant(const std::string& key, Constant&& value);
+	int          string_constant(std::string_view s);
+	int          number_constant(double n);
+	int          bool_constant(bool b);
+	int          nil_constant();
+	void         set_returns(ExpDesc& e, int nresults);
+	void         set_one_ret(ExpDesc& e);
+	void         discharge_vars(ExpDesc& e);
+	int          code_label(int a, int b, int jump);
+	void         discharge_to_reg(ExpDesc& e, int reg);
+	void         discharge_to_any_reg(ExpDesc& e);
+	void         exp_to_reg(ExpDesc& e, int reg);
+	void         exp_to_next_reg(ExpDesc& e);
+	int          exp_to_any_reg(ExpDesc& e);
+	void         exp_to_val(ExpDesc& e);
+	int          exp_to_rk(ExpDesc& e);
+	void         store_var(const ExpDesc& var, ExpDesc& ex);
+	void         self(ExpDesc& e, ExpDesc& key);
+	void         invert_jump(const ExpDesc& e);
+	int          jump_on_cond(ExpDesc& e, bool cond);
+	void         go_if_true(ExpDesc& e);
+	void         go_if_false(ExpDesc& e);
+	void         code_not(ExpDesc& e);
+	void         indexed(ExpDesc& t, ExpDesc& k);
+	void         code_arith(OpCode op, ExpDesc& e1, ExpDesc& e2);
+	void         code_comp(OpCode op, bool cond, ExpDesc& e1, ExpDesc& e2);
+	void         infix(AstNodeType op, ExpDesc& v);
+	void         posfix(AstNodeType op, ExpDesc& e1, ExpDesc& e2);
+	void         set_list(int base, int nelems, int tostore);
+
+	// lparser.c
+	void open_function(FuncState& fs, Proto* f);
+	void close_function();
+	int  register_local_var(std::string_view name);
+	void new_local_var(std::string_view name, int n);
+	void adjust_local_vars(int nvars);
+	void remove_vars(int to_level);
+	int  index_upvalue(FuncState* fs, std::string_view name, const ExpDesc& v);
+	int  search_var(FuncState* fs, std::string_view name) const;
+	void mark_upval(FuncState* fs, int level);
+	ExpKind single_var_aux(FuncState* fs, std::string_view name, ExpDesc& var, bool base);
+	void single_var(Token* name, ExpDesc& var);
+	void adjust_assign(int nvars, int nexps, ExpDesc& e);
+	void enter_block(BlockCnt& bl, bool is_breakable);
+	void leave_block();
+	void body(ExpDesc& e, Span<Token*>& args, AstNode* body, bool need_self, Token* function_token,
+			  Token* end_token);
+	int  explist(Span<AstNode*>& exprs, ExpDesc& v);
+	void function_args(ExpDesc& f, AstNode* args);
+	void constructor(AstNode* table, ExpDesc& t);
+	void expr(AstNode* node, ExpDesc& v);
+	void block(AstNode* body);
+	void chunk(AstNode* body);
+	void statement(AstNode* stat);
+	void assignment(Span<AstNode*>& lhs, Span<AstNode*>& rhs);
+	int  cond(AstNode* node);
+	void break_stat();
+	void while_stat(AstNode* stat);
+	void repeat_stat(AstNode* stat);
+	void for_body(int base, int line, int nvars, bool is_num, AstNode* body);
+	void numeric_for_stat(AstNode* stat);
+	void generic_for_stat(AstNode* stat);
+	void if_stat(AstNode* stat);
+	int  test_then_block(AstNode* condition, AstNode* body);
+	void local_function_stat(AstNode* stat);
+	void local_var_stat(AstNode* stat);
+	void function_stat(AstNode* stat);
+	void return_stat(AstNode* stat);
+
+	std::string chunk_name_;
+	Proto       main_;
+	FuncState*  fs_ = nullptr;
+	// 当前正在编译的源码行号
+	int         line_ = 0;
+};
+}   // namespace dl
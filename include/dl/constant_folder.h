@@ -0,0 +1,131 @@
+#pragma once
+
+#include "dl/arena.h"
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace dl {
+/**
+ * @brief 压缩模式下的常量折叠
+ * @details 在 Parser 与 AstPrinter 之间改写 AST：数字字面量的算术、字符串字面量的拼接、常量上的
+ * not、比较与 and/or 按 Lua 5.1 的语义求值。只有折叠后的文本不比原文更长时才替换原来的子树。
+ * @note 与 Lua 5.1 编译器一致，不折叠除以 0、取模 0 以及结果为 NaN 或无穷的运算；乘方只在结果是能精确
+ * 表示的整数时折叠，避免依赖目标平台 libm 的舍入
+ * @note 新建的节点与 token 属于 ConstantFolder，因此它必须活得比打印 AST 更久
+ */
+class ConstantFolder
+{
+public:
+	enum class ConstantType
+	{
+		Nil,
+		Boolean,
+		Number,
+		String
+	};
+
+	struct Constant
+	{
+		ConstantType type_;
+		bool         boolean_ = false;
+		double       number_  = 0;
+		std::string  string_;
+	};
+
+	/**
+	 * @brief 求值时遇到变量如何处理，返回空表示不是常量
+	 */
+	using VariableValue = std::function<std::optional<Constant>(const AstNode* variable)>;
+
+	explicit ConstantFolder(AstNode* root);
+
+	/**
+	 * @brief 不改写 AST，按与折叠相同的规则求 expr 的常量值；不是常量时为空
+	 *
+	 * @param expr
+	 * @param variable 为空时变量都不是常量
+	 */
+	static std::optional<Constant> evaluate(const AstNode*       expr,
+											const VariableValue& variable = {});
+
+	/**
+	 * @brief 值作为条件时是否为真，只有 nil 与 false 为假
+	 */
+	static bool truthy(const Constant& value) noexcept;
+
+private:
+	/**
+	 * @brief 折叠 expr 的子表达式
+	 *
+	 * @param expr
+	 * @return std::optional<Constant> expr 整体为常量时返回它的值，此时 expr 本身尚未被替换
+	 */
+	std::optional<Constant> fold(AstNode*& expr);
+
+	/**
+	 * @brief 折叠作为前缀表达式（调用、索引、字段、方法的主体）出现的 expr，括号必须保留
+	 *
+	 * @param expr
+	 */
+	void fold_prefix(AstNode*& expr);
+
+	/**
+	 * @brief 折叠一个不会再参与更外层折叠的表达式
+	 *
+	 * @param expr
+	 */
+	void fold_and_settle(AstNode*& expr);
+	void fold_and_settle(Span<AstNode*>& exprs);
+
+	/**
+	 * @brief 把值为 value 的常量子树换成字面量；若字面量更长，则改为分别处理它的子表达式
+	 *
+	 * @param expr
+	 * @param value
+	 */
+	void settle(AstNode*& expr, const Constant& value);
+
+	std::optional<Constant> fold_binop(AstNode*& lhs, AstNode*& rhs, AstNodeType type);
+	static std::optional<Constant> fold_literal(const AstNode* expr);
+
+	/**
+	 * @brief 两边都是常量时二元运算的结果，无法在压缩时求值时为空
+	 */
+	static std::optional<Constant> apply_binop(const Constant& l, const Constant& r,
+											   AstNodeType type);
+
+	/**
+	 * @brief expr 是二元运算时取出两边
+	 */
+	static bool binop_operands(const AstNode* expr, const AstNode*& lhs, const AstNode*& rhs);
+
+	void fold_stat(AstNode* stat);
+
+	/**
+	 * @brief 构造表示 value 的字面量节点
+	 *
+	 * @param value
+	 * @param line 新 token 使用的行号
+	 * @return AstNode*
+	 */
+	AstNode* make_literal(const Constant& value, std::size_t line);
+
+	/**
+	 * @brief 以压缩模式输出时 expr 的大致长度
+	 *
+	 * @param expr
+	 * @return size_t
+	 */
+	static size_t printed_length(const AstNode* expr);
+
+	Arena<AstNode, 256>     nodes_;
+	std::deque<Token>       tokens_;
+	std::deque<std::string> texts_;
+};
+}   // namespace dl
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "dl/arena.h"
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+namespace dl {
+/**
+ * @brief 压缩模式下删除调试代码
+ * @details 删除被调用者的名字链（如 log.debug、assert、logger:trace）在配置列表中的调用语句，以及条件
+ * 恒为假的 if/elseif 分支。条件恒为真时，其后的分支同样不可达。
+ * @note 条件中的全局变量可通过 defines 视为常量（如 DEBUG = false），被局部变量遮蔽时不生效
+ * @note 新建的节点与 token 属于 DeadCodeStripper，因此它必须活得比打印 AST 更久
+ */
+class DeadCodeStripper
+{
+public:
+	/**
+	 * @brief 就地改写以 root 为根的 AST
+	 *
+	 * @param root
+	 * @param calls 要删除的调用的名字链，字段用 '.'，方法用 ':' 连接
+	 * @param defines 视为常量的全局变量及其真值
+	 * @param strip_branches 是否删除不可达的 if 分支
+	 */
+	DeadCodeStripper(AstNode* root, const std::vector<std::string>& calls,
+					 const std::unordered_map<std::string, bool>& defines, bool strip_branches);
+
+private:
+	/**
+	 * @brief 处理一条语句
+	 *
+	 * @param stat 可能被替换为新的语句
+	 * @return true 整条语句都可以删除
+	 */
+	bool strip_stat(AstNode*& stat);
+	void strip_block(AstNode* body);
+	void strip_expr(AstNode* expr);
+	void strip_exprs(Span<AstNode*>& exprs);
+	void strip_function(Span<Token*>& args, AstNode* body, bool is_method);
+
+	/**
+	 * @brief 化简 if 语句的分支
+	 *
+	 * @param stat
+	 * @return true 整条语句都可以删除
+	 */
+	bool strip_if(AstNode*& stat);
+
+	/**
+	 * @brief 表达式作为条件时的真值，按 ConstantFolder::evaluate 的规则求值
+	 *
+	 * @param expr
+	 * @return std::optional<bool> 无法在压缩时确定时为空
+	 */
+	std::optional<bool> truthiness(const AstNode* expr) const;
+
+	/**
+	 * @brief 调用语句的被调用者是否在删除列表中
+	 *
+	 * @param expr
+	 */
+	bool is_stripped_call(const AstNode* expr) const;
+
+	/**
+	 * @brief 把 a.b.c 形式的前缀表达式拼成名字链
+	 *
+	 * @param expr
+	 * @param chain
+	 * @return false 不是名字链
+	 */
+	static bool name_chain(const AstNode* expr, std::string& chain);
+
+	void declare(std::string_view name) { locals_.push_back(name); }
+	void enter_scope() { scope_marks_.push_back(locals_.size()); }
+	void exit_scope()
+	{
+		locals_.resize(scope_marks_.back());
+		scope_marks_.pop_back();
+	}
+	bool is_local(std::string_view name) const;
+
+	std::unordered_set<std::string>              calls_;
+	const std::unordered_map<std::string, bool>& defines_;
+	bool                                         strip_branches_;
+	std::vector<std::string_view>                locals_;
+	std::vector<size_t>                          scope_marks_;
+	Arena<AstNode, 64>                           nodes_;
+	std::deque<Token>                            tokens_;
+};
+}   // namespace dl
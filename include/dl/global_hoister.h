@@ -0,0 +1,131 @@
+#pragma once
+
+#include "dl/arena.h"
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+namespace dl {
+/**
+ * @brief 压缩模式下把只读的全局变量提升为主代码块顶部的局部变量
+ * @details 统计标准库全局函数（ipairs、type……）、标准库表的字段（math.floor、table.insert……）以及
+ * 额外配置的全局变量的读取，在代码块开头插入 local math_floor = math.floor 形式的别名，并把引用处
+ * 改为别名。被赋值过的全局变量、被局部变量遮蔽的引用不处理；出现 setfenv、getfenv、module 或无法
+ * 确定用途的 _G 时整个代码块保持原样。
+ * @note 别名在代码块加载时取值，之后其他代码对这些全局变量的修改对本文件不再可见
+ * @note 主函数的活跃局部变量不超过 200 个，每个函数的上值不超过 60 个，与 Lua 5.1 的限制一致
+ * @note 新建的节点与 token 属于 GlobalHoister，因此它必须活得比打印 AST 更久
+ */
+class GlobalHoister
+{
+public:
+	/**
+	 * @brief 就地改写以 root 为根的 AST
+	 *
+	 * @param root
+	 * @param extra_globals 额外要提升的全局变量，形如 name 或 name.field
+	 */
+	GlobalHoister(AstNode* root, const std::vector<std::string>& extra_globals);
+
+private:
+	using FunctionId = uint32_t;
+
+	struct Variable
+	{
+		std::string_view name_;
+		// 声明所在函数在函数栈中的深度
+		size_t function_depth_;
+		uint32_t id_;
+	};
+
+	struct Candidate
+	{
+		// 全局变量名
+		std::string_view global_;
+		// 字段名，为空时提升全局变量本身
+		std::string_view field_;
+		// 引用处，提升后改为指向别名
+		std::vector<AstNode**> sites_;
+		// 在循环中的引用数
+		size_t loop_uses_ = 0;
+		// 需要把别名作为上值的函数
+		std::unordered_set<FunctionId> functions_;
+	};
+
+	void enter_scope();
+	void exit_scope();
+	void declare(std::string_view name);
+
+	/**
+	 * @brief 解析一次名字引用
+	 *
+	 * @param name
+	 * @return true 引用的是全局变量
+	 */
+	bool reference(std::string_view name);
+
+	/**
+	 * @brief 记录对全局变量 global（或其字段 field）的一次读取
+	 *
+	 * @param site
+	 * @param global
+	 * @param field
+	 */
+	void add_site(AstNode** site, std::string_view global, std::string_view field);
+
+	/**
+	 * @brief 记录一次赋值目标，被赋值的全局变量与字段不能提升
+	 *
+	 * @param target
+	 */
+	void visit_target(AstNode*& target);
+
+	void visit_stat(AstNode* stat);
+	void visit_expr(AstNode*& expr);
+	void visit_exprs(Span<AstNode*>& exprs);
+	void visit_block(AstNode* body);
+	void visit_function(Span<Token*>& args, AstNode* body, bool is_method);
+
+	/**
+	 * @brief 在限制内挑选收益最大的候选，插入别名声明并改写引用处
+	 *
+	 * @param root
+	 */
+	void hoist(AstNode* root);
+
+	/**
+	 * @brief 挑选一个在代码块中没有出现过的名字
+	 *
+	 * @param base
+	 * @return std::string_view
+	 */
+	std::string_view alias_name(const std::string& base);
+
+	bool is_hoistable(std::string_view global, std::string_view field) const;
+
+	std::unordered_set<std::string>           extra_globals_;
+	std::unordered_map<std::string, size_t>   candidate_index_;
+	std::deque<Candidate>                     candidates_;
+	std::unordered_set<std::string>           written_;
+	std::unordered_set<std::string_view>      names_;
+	std::vector<Variable>                     scope_stack_;
+	std::vector<size_t>                       scope_marks_;
+	std::vector<FunctionId>                   function_stack_;
+	std::vector<std::unordered_set<uint32_t>> upvalues_;
+	uint32_t                                  next_variable_id_ = 0;
+	size_t                                    main_locals_     = 0;
+	size_t                                    max_main_locals_ = 0;
+	size_t                                    loop_depth_      = 0;
+	bool                                      unsafe_          = false;
+	Arena<AstNode, 256>                       nodes_;
+	std::deque<Token>                         tokens_;
+	std::deque<std::string>                   texts_;
+	ByteArena<1024>                           spans_;
+};
+}   // namespace dl
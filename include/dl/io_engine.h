@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dl {
+/**
+ * @brief IoEngine 的后台实现
+ */
+enum class IoBackend : uint8_t
+{
+	Auto,      // 优先 io_uring，不可用时退回线程池
+	Uring,     // Linux io_uring，一个后台线程成批提交读写
+	Threads,   // 几个后台线程各自做阻塞读写
+};
+
+/**
+ * @brief 目录任务的文件读写引擎，让读写文件与处理文件的线程并行
+ * @details 后台按顺序提前读入后面的文件，处理线程用 Next 取走已读完的文件；处理结果用 Write 排队，
+ * 由后台写出，处理线程不等待。提前读入的文件数与字节数、排队写入的字节数都有上限，内存占用有界。
+ * io_uring 后端只有读写本身是异步的，打开与关闭文件仍在后台线程中同步完成。
+ */
+class IoEngine
+{
+public:
+	struct File
+	{
+		std::string path;
+		std::string content;
+		// 读取失败时为原因，content 为空
+		std::string error;
+	};
+
+	/**
+	 * @brief 创建后立即开始读入 paths 中的文件
+	 *
+	 * @param backend 要求 Uring 但不可用时同样退回线程池
+	 * @param buffer_bytes 提前读入与排队写入各自的字节数上限，为 0 时用默认的 64 MB
+	 */
+	explicit IoEngine(std::vector<std::string> paths, IoBackend backend = IoBackend::Auto,
+					  size_t buffer_bytes = 0);
+	~IoEngine();
+	IoEngine(const IoEngine&)            = delete;
+	IoEngine& operator=(const IoEngine&) = delete;
+
+	/**
+	 * @brief 取一个读完的文件，大致按 paths 的顺序；所有文件都已取走时返回 false。线程安全
+	 */
+	bool Next(File& file);
+
+	/**
+	 * @brief 排队写入，覆盖原有内容；排队的字节数超过上限时等待。线程安全
+	 */
+	void Write(std::string path, std::string content);
+
+	/**
+	 * @brief 等待排队的写入完成并停止后台线程，返回写入失败的文件及原因
+	 */
+	std::vector<std::pair<std::string, std::string>> Finish();
+
+	/**
+	 * @brief 后台有文件在读的墙钟时间，单位为纳秒，同时读的几个文件只算一次。在 Finish 之后调用
+	 */
+	uint64_t ReadNs() const noexcept;
+
+	/**
+	 * @brief 处理线程在 Next 中等文件读完的累计耗时，单位为纳秒。在 Finish 之后调用
+	 */
+	uint64_t WaitNs() const noexcept;
+
+	/**
+	 * @brief 实际使用的后端名，uring 或 threads
+	 */
+	const char* BackendName() const noexcept;
+
+private:
+	struct State;
+	std::unique_ptr<State> state_;
+};
+}   // namespace dl
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+namespace dl {
+/**
+ * @brief 压缩模式下的局部变量重命名
+ * @details 解析 Parser 产生的 AST 的词法作用域，把局部变量、参数和上值改名为作用域内可用的最短名字，
+ * 引用越多的变量越先挑选名字。全局变量、字段名、方法名和标签保持不变。
+ * @note 改名直接改写 Token::source_，新名字的存储属于 LocalRenamer，因此它必须活得比打印 AST 更久
+ */
+class LocalRenamer
+{
+public:
+	explicit LocalRenamer(AstNode* root);
+
+private:
+	using VariableId = uint32_t;
+
+	struct Variable
+	{
+		// 原始名字
+		std::string_view name_;
+		// 声明处与所有引用处的 token，改名时一并改写
+		std::vector<Token*> tokens_;
+		// 不能与之同名的变量
+		std::vector<VariableId> conflicts_;
+		// 栈上 id 小于此值的变量都已记录过冲突
+		VariableId covered_;
+		// 全局变量与方法的隐式 self 没有可改写的声明，只能保持原名
+		bool pinned_;
+		// 分配到的名字下标
+		size_t name_index_;
+	};
+
+	/**
+	 * @brief 进入一个新的词法作用域
+	 *
+	 */
+	void enter_scope();
+
+	/**
+	 * @brief 离开当前词法作用域，其中声明的变量不再可见
+	 *
+	 */
+	void exit_scope();
+
+	/**
+	 * @brief 在当前作用域声明一个局部变量
+	 *
+	 * @param token
+	 */
+	void declare(Token* token);
+
+	/**
+	 * @brief 在当前作用域声明一个不能改名的局部变量（方法的隐式 self）
+	 *
+	 * @param name
+	 */
+	void declare_pinned(std::string_view name);
+
+	/**
+	 * @brief 解析一次名字引用，记录它与可见范围内后声明的变量之间的冲突
+	 *
+	 * @param token
+	 */
+	void reference(Token* token);
+
+	/**
+	 * @brief 记录 id 与栈上所有比它后声明的变量之间的冲突
+	 *
+	 * @param id
+	 * @param stack_begin 第一个比 id 后声明的变量在栈中的位置
+	 */
+	void add_conflicts(VariableId id, size_t stack_begin);
+
+	VariableId new_variable(std::string_view name, bool pinned);
+
+	void visit_stat(AstNode* stat);
+	void visit_expr(AstNode* expr);
+	void visit_exprs(Span<AstNode*>& exprs);
+	void visit_block(AstNode* body);
+	void visit_function(Span<Token*>& args, AstNode* body, bool is_method);
+
+	/**
+	 * @brief 按引用次数从多到少为每个局部变量挑选不冲突的最短名字，并改写 token
+	 *
+	 */
+	void assign_names();
+
+	/**
+	 * @brief 获取第 index 个候选名字（跳过关键字），按需生成
+	 *
+	 * @param index
+	 * @return std::string_view
+	 */
+	std::string_view candidate_name(size_t index);
+
+	std::vector<Variable>                            variables_;
+	std::vector<VariableId>                          scope_stack_;
+	std::vector<size_t>                              scope_marks_;
+	std::unordered_map<std::string_view, VariableId> globals_;
+	std::deque<std::string>                          names_;
+	size_t                                           next_name_sequence_ = 0;
+};
+}   // namespace dl
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+namespace dl {
+/**
+ * @brief 按 Lua 5.1 词法解析数字字面量
+ *
+ * @param text 字面量原文
+ * @param value 解析结果
+ * @param strict 为 true 时十六进制只接受至多 13 位，保证在任何实现下都能精确表示，且拒绝溢出为无穷大的数；
+ * 否则与 luaO_str2d 一致
+ * @return false 不是合法的数字
+ */
+bool parse_number_literal(std::string_view text, double& value, bool strict);
+
+/**
+ * @brief 按 Lua 5.1 词法解码字符串字面量（含长字符串）
+ *
+ * @param text 字面量原文，包括引号或定界符
+ * @param value 解码结果
+ * @param strict 为 true 时拒绝 \x、\z 等在 Lua 5.1 与 LuaJIT/5.2 中含义不同的转义；否则按 Lua 5.1
+ * 把未知转义解释为字符本身
+ * @return false 不是合法的字符串
+ */
+bool decode_string_literal(std::string_view text, std::string& value, bool strict);
+}   // namespace dl
@@ -0,0 +1,98 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace dl {
+/**
+ * @brief 目录任务的内存预算，限制同时在处理的文件估计占用的内存
+ * @details 处理一个文件要同时持有源码、token、AST 与输出，总量约为文件大小乘一个膨胀系数。处理前用
+ * Acquire 按估计占用排队，总量超出上限时等待；估计占用本身就超出上限的文件等其他文件都处理完后单独
+ * 处理。处理完用 Observe 报告实际占用，系数取实测比值的最大值，之后的估计随之校正。
+ * 排队按先来后到，大文件不会被源源不断的小文件饿死。
+ */
+class MemoryBudget
+{
+public:
+	// 还没有实测时的膨胀系数，样例语料中实测最大约为 15
+	static constexpr double DEFAULT_EXPANSION = 16.0;
+	// 小于这个大小的文件不参与校正，内存块的粒度会让它们的比值偏大
+	static constexpr size_t MIN_OBSERVED_BYTES = 64 * 1024;
+
+	/**
+	 * @brief 一个文件占着的预算，析构时归还
+	 */
+	class Reservation
+	{
+	public:
+		Reservation() = default;
+		~Reservation() { reset(); }
+		Reservation(Reservation&& other) noexcept;
+		Reservation& operator=(Reservation&& other) noexcept;
+		Reservation(const Reservation&)            = delete;
+		Reservation& operator=(const Reservation&) = delete;
+
+	private:
+		friend class MemoryBudget;
+		void reset() noexcept;
+
+		MemoryBudget* budget_ = nullptr;
+		size_t        bytes_  = 0;
+	};
+
+	/**
+	 * @param limit_bytes 同时在处理的文件估计占用的上限
+	 */
+	explicit MemoryBudget(size_t limit_bytes) noexcept
+		: limit_(limit_bytes)
+	{}
+	MemoryBudget(const MemoryBudget&)            = delete;
+	MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+	/**
+	 * @brief 为处理 file_bytes 字节的文件申请预算，不够时等待。线程安全
+	 */
+	[[nodiscard]] Reservation Acquire(size_t file_bytes);
+
+	/**
+	 * @brief 报告处理 file_bytes 字节的文件实际用到的内存，校正膨胀系数。线程安全
+	 */
+	void Observe(size_t file_bytes, size_t used_bytes) noexcept;
+
+	/**
+	 * @brief 处理 file_bytes 字节的文件估计要用的内存
+	 */
+	size_t Estimate(size_t file_bytes) const noexcept;
+
+	size_t Limit() const noexcept { return limit_; }
+
+	/**
+	 * @brief 同时在处理的文件估计占用之和的峰值
+	 */
+	size_t PeakBytes() const noexcept;
+
+	/**
+	 * @brief 因估计占用超出上限而单独处理的文件数
+	 */
+	size_t SoloCount() const noexcept;
+
+private:
+	size_t estimate(size_t file_bytes) const noexcept;
+	void   release(size_t bytes) noexcept;
+
+	const size_t            limit_;
+	mutable std::mutex      mutex_;
+	std::condition_variable cv_;
+	size_t                  in_flight_ = 0;
+	size_t                  peak_      = 0;
+	size_t                  solo_      = 0;
+	// 在 cv_ 上等待的线程数，没有时不必唤醒
+	size_t                  waiting_   = 0;
+	// 排队的号码，按号依次放行
+	uint64_t                next_ticket_ = 0;
+	uint64_t                serving_     = 0;
+	double                  expansion_   = DEFAULT_EXPANSION;
+	bool                    observed_    = false;
+};
+}   // namespace dl
@@ -0,0 +1,55 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace dl {
+/**
+ * @brief 多生产者、单消费者的无锁队列
+ * @details Push 用 CAS 把节点挂到链表头，任何线程都可以同时调用，不会互相阻塞。Drain 一次取走
+ * 全部节点，同一时间只能有一个线程调用；整条链表一起取走，不会有逐个弹出时的 ABA 问题。
+ */
+template<typename T> class MpscQueue
+{
+public:
+	MpscQueue() = default;
+	~MpscQueue() { Drain(); }
+	MpscQueue(const MpscQueue&)            = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void Push(T value)
+	{
+		auto* node = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+		while (!head_.compare_exchange_weak(
+			node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+
+	/**
+	 * @brief 取走目前所有的元素，同一线程 Push 的元素保持先后顺序
+	 */
+	std::vector<T> Drain()
+	{
+		Node*          node = head_.exchange(nullptr, std::memory_order_acquire);
+		std::vector<T> items;
+		while (node) {
+			items.push_back(std::move(node->value));
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+		std::reverse(items.begin(), items.end());
+		return items;
+	}
+
+private:
+	struct Node
+	{
+		T     value;
+		Node* next;
+	};
+
+	std::atomic<Node*> head_{nullptr};
+};
+}   // namespace dl
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace dl {
+/*
+ * AstPrinter 的输出目标。printer 先把输出攒在自己的缓冲区里，满了或打印结束时整块交给 sink：
+ *
+ *     void write(const char* data, size_t size);
+ *
+ * std::ostream 本身满足这个接口，是 AstPrinter 的默认 sink。下面的 sink 绕开 iostream：写入内存、
+ * 直接 write(2) 到文件描述符，或写进预先放大的 mmap 文件。写文件失败不能在 printer 中抛出
+ * （append 为 noexcept），因此只记下错误，由 Close 抛出。
+ */
+
+/**
+ * @brief 写入可增长的内存缓冲区，跨文件复用时先 clear，容量保留
+ */
+class StringSink
+{
+public:
+	void write(const char* data, size_t size) { buffer_.append(data, size); }
+
+	std::string&       str() noexcept { return buffer_; }
+	const std::string& str() const noexcept { return buffer_; }
+	void               clear() noexcept { buffer_.clear(); }
+
+private:
+	std::string buffer_;
+};
+
+/**
+ * @brief 边写边与给定文本比较，不保存输出
+ */
+class CompareSink
+{
+public:
+	explicit CompareSink(std::string_view expected)
+		: expected_(expected)
+	{}
+
+	void write(const char* data, size_t size) noexcept
+	{
+		if (same_ && (offset_ + size > expected_.size() ||
+					  std::memcmp(expected_.data() + offset_, data, size) != 0)) {
+			same_ = false;
+		}
+		offset_ += size;
+	}
+
+	// 写入的内容是否与给定文本完全相同
+	bool Matches() const noexcept { return same_ && offset_ == expected_.size(); }
+
+private:
+	std::string_view expected_;
+	size_t           offset_ = 0;
+	bool             same_   = true;
+};
+
+/**
+ * @brief 以截断方式打开文件，每次 write 直接交给 write(2)，没有额外的缓冲
+ */
+class FdSink
+{
+public:
+	/**
+	 * @brief 打开失败时抛出 std::runtime_error
+	 */
+	explicit FdSink(const std::string& path);
+	~FdSink();
+	FdSink(const FdSink&)            = delete;
+	FdSink& operator=(const FdSink&) = delete;
+
+	void write(const char* data, size_t size) noexcept;
+
+	/**
+	 * @brief 关闭文件，之前有写入失败或关闭失败时抛出 std::runtime_error
+	 */
+	void Close();
+
+private:
+	std::string path_;
+	int         fd_    = -1;
+	int         error_ = 0;
+};
+
+/**
+ * @brief 先把文件放大到预估大小再 mmap，write 只是 memcpy，不够时翻倍重新映射，Close 时截到实际大小
+ * @details 没有 mmap 的平台上退化为先写入内存，Close 时一次写出。
+ */
+class MmapFileSink
+{
+public:
+	/**
+	 * @brief 打开或映射失败时抛出 std::runtime_error
+	 *
+	 * @param size_hint 预估的输出大小，估大了只占地址空间，Close 时会截掉
+	 */
+	MmapFileSink(const std::string& path, size_t size_hint);
+	~MmapFileSink();
+	MmapFileSink(const MmapFileSink&)            = delete;
+	MmapFileSink& operator=(const MmapFileSink&) = delete;
+
+	void write(const char* data, size_t size) noexcept;
+
+	/**
+	 * @brief 解除映射并把文件截到实际写入的大小，之前有失败时抛出 std::runtime_error
+	 */
+	void Close();
+
+private:
+	bool remap(size_t capacity) noexcept;
+
+	std::string path_;
+	int         fd_       = -1;
+	char*       data_     = nullptr;
+	size_t      size_     = 0;
+	size_t      capacity_ = 0;
+	int         error_    = 0;
+	// 没有 mmap 时的内存缓冲
+	std::string fallback_;
+};
+
+/**
+ * @brief 用一次 write(2) 把内容写入文件，覆盖原有内容，失败时抛出 std::runtime_error
+ */
+void write_file(const std::string& path, std::string_view content);
+}   // namespace dl
@@ -1,24 +1,43 @@
 #pragma once
-#pragma once
 
 #include "dl/ast.h"
+#include "dl/ast_builder.h"
 #include "dl/ast_manager.h"
 #include "dl/token.h"
 #include <cstddef>
 #include <vector>
 namespace dl {
 #define UNARY_PRIORITY 8
-class Parser
+/**
+ * @brief 递归下降的 Lua 语法分析器
+ * @details 解析结果交给构建策略 Builder 产出，默认的 AstManager 构建完整的 AST，NullAstBuilder
+ * 只做语法检查，EventAstBuilder 按节点回调。构建策略需要提供的接口见 ast_builder.h。
+ */
+template<typename Builder = AstManager> class Parser
 {
 public:
+	using Node           = typename Builder::Node;
+	using TokenList      = typename Builder::TokenList;
+	using NodeList       = typename Builder::NodeList;
+	using TableEntryList = typename Builder::TableEntryList;
+	using ElseClauseList = typename Builder::ElseClauseList;
+
 	Parser(std::vector<Token>& tokens, const std::string& file_name);
-	AstNode* GetAstRoot() noexcept { return ast_root_; }
+	/**
+	 * @brief 由外部的 builder 产出结果，使用 AstManager 时调用方负责在下次使用前 Reset 它
+	 *
+	 * @param tokens
+	 * @param file_name
+	 * @param builder
+	 */
+	Parser(std::vector<Token>& tokens, const std::string& file_name, Builder& builder);
+	Node GetAstRoot() noexcept { return ast_root_; }
 
 private:
 	// 获得当前位置的 token，并将位置后移一位
 	[[nodiscard]] Token* get() noexcept;
 	[[nodiscard]] Token* peek(size_t offset) const noexcept;
-    [[nodiscard]] Token* peek() const noexcept;
+	[[nodiscard]] Token* peek() const noexcept;
 	void                 step() noexcept;
 	void                 step_trust_me() noexcept;
 	std::string          get_token_start_position(const Token* token) const noexcept;
@@ -59,38 +78,50 @@ private:
 	 */
 	[[noreturn]] void error(const std::string_view message);
 
+	/**
+	 * @brief 记录带位置的错误信息，并以同样的信息抛出异常
+	 *
+	 * @param description
+	 */
+	[[noreturn]] void fail(const std::string_view description);
+
 	/**
 	 * @brief 解析表达式列表
 	 *
-	 * @details a+b, c, d+e 解析为 expr_list=[a+b, c, d+e], comma_list=[',', ',']
-	 * @param expr_list
-	 * @param comma_list
+	 * @details a+b, c, d+e 解析为 [a+b, c, d+e]
+	 * @return NodeList
+	 */
+	NodeList exprlist();
+	/**
+	 * @brief 解析表达式列表，并通过 count 返回表达式个数
+	 *
+	 * @param count
+	 * @return NodeList
 	 */
-	void exprlist(std::vector<AstNode*>& expr_list);
+	NodeList exprlist(size_t& count);
 	/**
 	 * @brief 解析前缀表达式
 	 * @details (expr) 或 identifier
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* prefixexpr();
+	Node prefixexpr();
 
 	/**
 	 * @brief 解析表构造表达式
 	 * @details { ["a"] = 1, b = 2, 3, 4 }
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* tableexpr();
+	Node tableexpr();
 
 	/**
 	 * @brief 解析变量列表
-	 * @details a, b, c 解析为 var_list=[a, b, c], comma_list=[',', ',']
+	 * @details a, b, c 解析为 [a, b, c]
 	 *
-	 * @param var_list
-	 * @param comma_list
+	 * @return TokenList
 	 */
-	void varlist(std::vector<Token*>& var_list);
+	TokenList varlist();
 
 	/**
 	 * @brief 解析代码块主体
@@ -99,155 +130,159 @@ private:
 	 * @param body
 	 * @param after
 	 */
-	void blockbody(std::string_view terminator, AstNode*& body, Token*& after);
+	void blockbody(std::string_view terminator, Node& body, Token*& after);
 
 	/**
 	 * @brief 解析匿名函数声明
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* funcdecl_anonymous();
+	Node funcdecl_anonymous();
 
 	/**
 	 * @brief 解析具名函数声明
 	 *
-	 * @return AstNode*
+	 * @param is_local local function 的名字只能是单个标识符
+	 * @return Node
 	 */
-	AstNode* funcdecl_named();
+	Node funcdecl_named(bool is_local);
 
 	/**
 	 * @brief 解析函数参数列表
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* functionargs();
+	Node functionargs();
 
 	/**
 	 * @brief 解析主表达式
 	 * @details a.* , a:*, a[*], a(*), a{*}
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* primaryexpr();
+	Node primaryexpr();
 
 	/**
 	 * @brief 解析简单表达式
 	 * @details 各种字面量，还有基本表达式
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* simpleexpr();
+	Node simpleexpr();
 
 	/**
 	 * @brief 解析子表达式( a + b * c ^ d )，递归实现
 	 *
 	 * @param priority_limit
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* subexpr(const size_t priority_limit);
+	Node subexpr(const size_t priority_limit);
 
 	/**
 	 * @brief 解析表达式的入口函数，可解析任何表达式
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	inline AstNode* expr();
+	inline Node expr();
 
 	/**
 	 * @brief 解析表达式语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* exprstat();
+	Node exprstat();
 
 	/**
 	 * @brief 解析 if 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* ifstat();
+	Node ifstat();
 
 	/**
 	 * @brief 解析 do 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* dostat();
+	Node dostat();
 
 	/**
 	 * @brief 解析 while 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* whilestat();
+	Node whilestat();
 
 	/**
 	 * @brief 解析 for 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* forstat();
+	Node forstat();
 
 	/**
 	 * @brief 解析 repeat 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* repeatstat();
+	Node repeatstat();
 
 	/**
 	 * @brief 解析局部变量声明语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* localdecl();
+	Node localdecl();
 
 	/**
 	 * @brief 解析返回语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* retstat();
+	Node retstat();
 
 	/**
 	 * @brief 解析 break 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* breakstat();
+	Node breakstat();
 
 	/**
 	 * @brief 解析 goto 语句
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* gotostat();
+	Node gotostat();
 
 	/**
 	 * @brief 解析 label 语句
 	 *
 	 */
-	AstNode* labelstat();
+	Node labelstat();
 
 	/**
 	 * @brief 解析单条语句
 	 *
 	 * @param is_last
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode* statement(bool& is_last);
+	Node statement(bool& is_last);
 
 	/**
 	 * @brief 解析代码块
 	 *
-	 * @return AstNode*
+	 * @return Node
 	 */
-	AstNode*            block();
+	Node                block();
 	std::string         file_name_;
 	size_t              position_;
 	std::vector<Token>& tokens_;
-	AstNode*            ast_root_;
-	AstManager          ast_manager_;
+	Node                ast_root_;
+	Builder             own_builder_;
+	Builder&            builder_;
 	bool                reached_eof_;
+	// 最近一次解析的主表达式是否以函数调用结尾，用于区分调用语句与赋值语句
+	bool                primary_is_call_ = false;
 };
 }   // namespace dl
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dl {
+/**
+ * @brief 采集的硬件事件，只计用户态
+ */
+enum class PerfEvent : uint8_t
+{
+	Cycles,         // CPU 周期
+	Instructions,   // 退役的指令数
+	Branches,       // 分支指令数
+	BranchMisses,   // 分支预测失败数
+	L1dMisses,      // L1 数据缓存读缺失
+	LlcMisses,      // 末级缓存读缺失
+	Count
+};
+
+inline constexpr size_t PERF_EVENT_COUNT = static_cast<size_t>(PerfEvent::Count);
+
+/**
+ * @brief 事件名，用于报告
+ */
+const char* perf_event_name(PerfEvent event) noexcept;
+
+/**
+ * @brief 一段时间内各事件的计数
+ */
+struct PerfCounts
+{
+	std::array<uint64_t, PERF_EVENT_COUNT> values{};
+
+	uint64_t operator[](PerfEvent event) const noexcept
+	{
+		return values[static_cast<size_t>(event)];
+	}
+
+	PerfCounts& operator+=(const PerfCounts& other) noexcept
+	{
+		for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+			values[i] += other.values[i];
+		}
+		return *this;
+	}
+};
+
+/**
+ * @brief 当前线程上用 perf_event_open 打开的一组计数器，只在 Linux 上可用
+ * @details 所有事件放在一个组里，一次 read 读出，保证各事件在同一时间段内计数。事件多于硬件计数器时
+ * 内核会轮流调度，读数按实际计数时间的比例放大。打不开的事件（虚拟机里常见）计为 0 并在报告中标为不可用。
+ */
+class PerfCounters
+{
+public:
+	/**
+	 * @brief 当前线程的计数器，第一次调用时打开，一个事件都打不开时返回空
+	 */
+	static const PerfCounters* ThreadLocal();
+
+	/**
+	 * @brief 在当前线程上试着打开计数器，不可用时 reason 为原因
+	 */
+	static bool Probe(std::string& reason);
+
+	~PerfCounters();
+	PerfCounters(const PerfCounters&)            = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	bool Available(PerfEvent event) const noexcept
+	{
+		return slots_[static_cast<size_t>(event)] >= 0;
+	}
+
+	/**
+	 * @brief 读出各事件自打开以来的计数，组没有被调度过时返回 false
+	 */
+	bool Read(PerfCounts& counts) const noexcept;
+
+private:
+	PerfCounters();
+	static PerfCounters& local();
+
+	// 组长的 fd，所有事件都打不开时为 -1
+	int                               leader_ = -1;
+	std::array<int, PERF_EVENT_COUNT> fds_;
+	// 各事件在组读数中的位置，打不开的为 -1
+	std::array<int, PERF_EVENT_COUNT> slots_;
+	int                               opened_ = 0;
+	// 第一个事件打开失败的 errno
+	int                               error_  = 0;
+};
+}   // namespace dl
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace dl {
+/**
+ * @brief 收集代码块中 require("name") 形式的调用依赖的模块名
+ * @details 只识别参数为单个字符串字面量的调用（require "a.b"、require("a.b")），被局部变量遮蔽的
+ * require 不计入。模块名按首次出现的顺序记录，不重复。
+ */
+class RequireCollector
+{
+public:
+	explicit RequireCollector(const AstNode* root);
+	const std::vector<std::string>& GetModules() const noexcept { return modules_; }
+
+private:
+	void visit_stat(const AstNode* stat);
+	void visit_expr(const AstNode* expr);
+	void visit_exprs(const Span<AstNode*>& exprs);
+	void visit_block(const AstNode* body);
+	void visit_function(const Span<Token*>& args, const AstNode* body, bool is_method);
+
+	/**
+	 * @brief 记录 call 依赖的模块
+	 *
+	 * @param call CallExpr 节点
+	 */
+	void check_call(const AstNode* call);
+
+	void declare(std::string_view name) { locals_.push_back(name); }
+	void enter_scope() { scope_marks_.push_back(locals_.size()); }
+	void exit_scope()
+	{
+		locals_.resize(scope_marks_.back());
+		scope_marks_.pop_back();
+	}
+	bool is_local(std::string_view name) const;
+
+	std::vector<std::string>      modules_;
+	std::vector<std::string_view> locals_;
+	std::vector<size_t>           scope_marks_;
+};
+}   // namespace dl
@@ -0,0 +1,89 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace dl {
+
+/**
+ * @brief 指向一段连续元素的非拥有视图，AST 中的变长子节点列表都用它存放
+ * @details 元素由 ByteArena 持有，长度以 32 位整数存放在元素前面的头部里，Span 本身只有一个指针，
+ * 这样 AST 节点里的每个列表只占 8 字节。元素必须可平凡复制，提交到字节池和删除元素都只需按字节
+ * 搬运，释放时也不必逐个析构。Span 不能增长，只支持原地删除，删除会修改共享的长度头。
+ */
+template<typename T> class Span
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Span elements must be trivially copyable");
+
+public:
+	using value_type = T;
+	using iterator   = T*;
+
+	// 长度头占用的字节数，保证其后的元素仍按 T 对齐
+	static constexpr size_t HEADER_SIZE =
+		alignof(T) > sizeof(uint32_t) ? alignof(T) : sizeof(uint32_t);
+
+	Span() noexcept = default;
+	/**
+	 * @brief data 前面必须紧挨着 HEADER_SIZE 字节的长度头，由 ByteArena::copy 创建
+	 */
+	explicit Span(T* data) noexcept
+		: data_(data)
+	{}
+
+	T*     data() const noexcept { return data_; }
+	size_t size() const noexcept { return data_ ? header() : 0; }
+	bool   empty() const noexcept { return size() == 0; }
+	T*     begin() const noexcept { return data_; }
+	T*     end() const noexcept { return data_ + size(); }
+
+	T& operator[](size_t i) const noexcept
+	{
+		assert(i < size());
+		return data_[i];
+	}
+	T& front() const noexcept { return data_[0]; }
+	T& back() const noexcept { return data_[size() - 1]; }
+
+	/**
+	 * @brief 删除 [first, last) 中的元素，后面的元素依次前移
+	 *
+	 * @return T* 指向被删除区间之后的第一个元素
+	 */
+	T* erase(T* first, T* last) noexcept
+	{
+		T* out = first;
+		for (T* it = last; it != end(); ++it) {
+			*out++ = *it;
+		}
+		if (first != last) {
+			header() -= static_cast<uint32_t>(last - first);
+		}
+		return first;
+	}
+	T* erase(T* pos) noexcept { return erase(pos, pos + 1); }
+
+	/**
+	 * @brief 只保留前 size 个元素
+	 *
+	 * @param size 不能超过当前长度
+	 */
+	void truncate(size_t size) noexcept
+	{
+		assert(size <= this->size());
+		if (data_) {
+			header() = static_cast<uint32_t>(size);
+		}
+	}
+
+private:
+	uint32_t& header() const noexcept
+	{
+		return *reinterpret_cast<uint32_t*>(reinterpret_cast<std::byte*>(data_) - HEADER_SIZE);
+	}
+
+	T* data_ = nullptr;
+};
+
+}   // namespace dl
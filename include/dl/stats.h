@@ -0,0 +1,261 @@
+#pragma once
+#include "dl/alloc_stats.h"
+#include "dl/perf_counters.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dl {
+/**
+ * @brief 统计耗时的处理阶段
+ */
+enum class StatsPhase : uint8_t
+{
+	Collect,     // 遍历目录、收集文件
+	Read,        // 读入源码
+	IoRead,      // IoEngine 在后台有文件在读的墙钟时间，不在处理线程上
+	IoWait,      // 处理线程等 IoEngine 读完文件
+	Tokenize,    // 词法分析
+	Parse,       // 语法分析
+	Transform,   // 压缩前的各个 AST 变换
+	Print,       // 输出代码，包括写入输出流缓冲
+	Write,       // 打开、刷新并关闭输出文件
+	CacheIo,     // 读写 json 任务缓存
+	Count
+};
+
+inline constexpr size_t STATS_PHASE_COUNT = static_cast<size_t>(StatsPhase::Count);
+
+/**
+ * @brief 阶段名，用于报告
+ */
+const char* stats_phase_name(StatsPhase phase) noexcept;
+
+/**
+ * @brief steady_clock 的时刻，单位为纳秒
+ */
+inline uint64_t steady_ns(std::chrono::steady_clock::time_point time) noexcept
+{
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+}
+
+/**
+ * @brief trace 中的一段阶段耗时
+ */
+struct TraceSpan
+{
+	StatsPhase phase;
+	uint64_t   start_ns;
+	uint64_t   duration_ns;
+};
+
+/**
+ * @brief ScopedPhase 记录的位置
+ */
+struct PhaseSlot
+{
+	// 累加耗时的位置，为空时不计时
+	uint64_t*               ns = nullptr;
+	// 不为空时另外记下这一段的起止，用于 trace
+	std::vector<TraceSpan>* spans = nullptr;
+	StatsPhase              phase = StatsPhase::Count;
+	// 分配统计构建中累加分配的位置，为空时不统计
+	AllocStats*             alloc = nullptr;
+	// 开启硬件计数器时累加计数的位置，为空时不读计数器
+	PerfCounts*             perf  = nullptr;
+};
+
+/**
+ * @brief 单个文件的统计
+ */
+struct FileStats
+{
+	std::string                               path;
+	// 处理该文件的线程编号
+	int                                       thread    = 0;
+	size_t                                    bytes     = 0;
+	size_t                                    tokens    = 0;
+	size_t                                    ast_nodes = 0;
+	std::array<uint64_t, STATS_PHASE_COUNT>   phase_ns{};
+	// 以下只在分配统计构建中记录
+	std::array<AllocStats, STATS_PHASE_COUNT> phase_alloc{};
+	AllocStats                                alloc;
+	// 以下只在开启硬件计数器时记录
+	std::array<PerfCounts, STATS_PHASE_COUNT> phase_perf{};
+	// 以下只在开启 trace 时记录
+	uint64_t                                  start_ns = 0;
+	uint64_t                                  end_ns   = 0;
+	std::vector<TraceSpan>                    spans;
+
+	uint64_t TotalNs() const noexcept;
+};
+
+/**
+ * @brief 把作用域内经过的纳秒数累加到 slot 上，slot 为空时什么都不做，也不读时钟
+ */
+class ScopedPhase
+{
+public:
+	explicit ScopedPhase(PhaseSlot slot) noexcept
+		: slot_(slot)
+	{
+		if (slot_.ns) {
+			start_ = steady_ns(std::chrono::steady_clock::now());
+		}
+		if constexpr (ALLOC_STATS_ENABLED) {
+			if (slot_.alloc) {
+				alloc_start_ = AllocMark::Begin();
+			}
+		}
+		if (slot_.perf) {
+			perf_ = PerfCounters::ThreadLocal();
+			if (perf_ && !perf_->Read(perf_start_)) {
+				perf_ = nullptr;
+			}
+		}
+	}
+	~ScopedPhase()
+	{
+		if (perf_) {
+			PerfCounts perf_end;
+			if (perf_->Read(perf_end)) {
+				for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+					// 按比例放大的读数可能比上次略小
+					if (perf_end.values[i] > perf_start_.values[i]) {
+						slot_.perf->values[i] += perf_end.values[i] - perf_start_.values[i];
+					}
+				}
+			}
+		}
+		if constexpr (ALLOC_STATS_ENABLED) {
+			if (slot_.alloc) {
+				alloc_start_.End(*slot_.alloc);
+			}
+		}
+		if (slot_.ns) {
+			const uint64_t duration = steady_ns(std::chrono::steady_clock::now()) - start_;
+			*slot_.ns += duration;
+			if (slot_.spans) {
+				slot_.spans->push_back({slot_.phase, start_, duration});
+			}
+		}
+	}
+	ScopedPhase(const ScopedPhase&)            = delete;
+	ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+	PhaseSlot slot_;
+	uint64_t  start_ = 0;
+	AllocMark alloc_start_;
+	// 开始时读到的计数，当前线程的计数器不可用时 perf_ 为空
+	const PerfCounters* perf_ = nullptr;
+	PerfCounts          perf_start_;
+};
+
+/**
+ * @brief 进程内的统计汇总，默认关闭，关闭时各处不记录任何数据
+ * @details 每个文件处理完后整条提交一次，不属于某个文件的耗时（收集文件、读写缓存）单独累加。
+ * 报告按阶段、线程与文件汇总，给出吞吐量与最慢的若干文件。开启 trace 时还记下每个文件与阶段的起止，
+ * 可导出为 Chrome trace event 格式。分配统计构建中还按阶段与文件汇总堆分配与 Arena 分配。
+ */
+class Stats
+{
+public:
+	static Stats& Instance();
+
+	void Enable() noexcept { enabled_ = true; }
+	bool Enabled() const noexcept { return enabled_; }
+
+	/**
+	 * @brief 开启 trace，同时开启统计
+	 */
+	void EnableTrace() noexcept
+	{
+		enabled_ = true;
+		tracing_ = true;
+	}
+	bool Tracing() const noexcept { return tracing_; }
+
+	/**
+	 * @brief 开启硬件计数器，同时开启统计；当前线程打不开计数器时只开启统计，reason 为原因
+	 * @details 只在 tokenize、parse 与 print 阶段前后读计数器
+	 */
+	bool EnablePerf(std::string& reason);
+	bool PerfEnabled() const noexcept { return perf_; }
+
+	/**
+	 * @brief 不属于某个文件的耗时累加到这里，统计关闭时为空
+	 * @details 只在并行区域外使用，记录 trace 时不加锁
+	 */
+	PhaseSlot GlobalSlot(StatsPhase phase) noexcept
+	{
+		if (!enabled_) {
+			return {};
+		}
+		return {&global_ns_[static_cast<size_t>(phase)],
+				tracing_ ? &global_spans_ : nullptr,
+				phase,
+				ALLOC_STATS_ENABLED ? &global_alloc_[static_cast<size_t>(phase)] : nullptr};
+	}
+
+	/**
+	 * @brief 累加别处计好的、不属于某个文件的耗时，不记 trace。只在并行区域外使用
+	 */
+	void AddGlobalNs(StatsPhase phase, uint64_t ns) noexcept
+	{
+		if (enabled_) {
+			global_ns_[static_cast<size_t>(phase)] += ns;
+		}
+	}
+
+	void AddFile(FileStats&& file);
+
+	/**
+	 * @brief 清空已记录的数据，开关状态不变
+	 */
+	void Reset();
+
+	/**
+	 * @brief 线程 0 到 threads - 1 处理文件的总耗时，下标为线程编号
+	 */
+	std::vector<uint64_t> ThreadBusyNs(size_t threads) const;
+
+	/**
+	 * @brief 生成文本报告
+	 *
+	 * @param wall_ns 整个任务的墙钟时间
+	 * @param top 列出最慢的文件数
+	 */
+	std::string TextReport(uint64_t wall_ns, size_t top) const;
+
+	/**
+	 * @brief 生成 JSON 报告，内容与文本报告相同，另含每个文件的明细
+	 */
+	std::string JsonReport(uint64_t wall_ns, size_t top) const;
+
+	/**
+	 * @brief 生成 Chrome trace event 格式的 JSON，可用 chrome://tracing 或 Perfetto 打开
+	 * @details 每个线程一条轨道，每个文件一段，其下为各阶段；时间从最早的一段开始计
+	 */
+	std::string TraceReport() const;
+
+private:
+	Stats() = default;
+
+	bool                                      enabled_ = false;
+	bool                                      tracing_ = false;
+	bool                                      perf_    = false;
+	// 各事件在主线程上是否打开成功，用于在报告中标出不可用的事件
+	std::array<bool, PERF_EVENT_COUNT>        perf_available_{};
+	std::array<uint64_t, STATS_PHASE_COUNT>   global_ns_{};
+	std::vector<TraceSpan>                    global_spans_;
+	std::array<AllocStats, STATS_PHASE_COUNT> global_alloc_{};
+	mutable std::mutex                        mutex_;
+	std::vector<FileStats>                    files_;
+};
+}   // namespace dl
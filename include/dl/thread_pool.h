@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dl {
+/**
+ * @brief 一组一起等待、一起取消的任务
+ * @details 组内第一个抛出的异常会取消整组：还没开始的任务不再执行，等待的线程在全部结束后
+ * 重新抛出它。
+ */
+class TaskGroup
+{
+public:
+	TaskGroup() = default;
+	TaskGroup(const TaskGroup&)            = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void Cancel() noexcept { cancelled_.store(true, std::memory_order_relaxed); }
+	bool Cancelled() const noexcept { return cancelled_.load(std::memory_order_relaxed); }
+
+private:
+	friend class ThreadPool;
+
+	// 已提交但还没结束的任务数
+	std::atomic<size_t> pending_{0};
+	std::atomic<bool>   cancelled_{false};
+	// 只有第一个抛出异常的任务写入 error_，等待的线程在 pending_ 归零后读取
+	std::atomic<bool>   failed_{false};
+	std::exception_ptr  error_;
+};
+
+/**
+ * @brief 工作窃取线程池
+ * @details 每个线程有自己的任务队列，新任务放进当前线程的队列，自己从队尾取（后进先出，缓存更热），
+ * 空闲的线程从别的队列的队头偷（先进先出，偷到的是拆分前更大的区间）。等待任务组的线程也执行任务，
+ * 因此任务中可以再嵌套 ParallelFor，不会因为线程都在等待而死锁。没有任务时线程睡在条件变量上。
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * @param threads 执行任务的线程数，包括调用 Wait 的线程，另外创建 threads - 1 个工作线程
+	 * @param pin_threads 把工作线程依次绑定到进程可用的 CPU 上，只在 Linux 上生效
+	 */
+	explicit ThreadPool(size_t threads, bool pin_threads = false);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&)            = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t Size() const noexcept { return slots_.size(); }
+
+	/**
+	 * @brief 进程可用的 CPU 数，受 CPU 亲和性限制，是 --jobs 的默认值
+	 */
+	static size_t DefaultThreads() noexcept;
+
+	/**
+	 * @brief 目录任务共用的线程池，第一次调用时按 Configure 的设置创建
+	 */
+	static ThreadPool& Global();
+
+	/**
+	 * @brief 设置全局线程池，已创建的池被销毁，下次 Global 时按新设置重建。不能在池中的任务里调用
+	 *
+	 * @param threads 为 0 时取 DefaultThreads
+	 */
+	static void Configure(size_t threads, bool pin_threads = false);
+
+	/**
+	 * @brief 当前线程在所属线程池中的编号，工作线程为 1 到 Size() - 1，池外的线程为 0
+	 */
+	static size_t CurrentIndex() noexcept;
+
+	/**
+	 * @brief 在 group 中提交一个任务。线程安全
+	 */
+	void Submit(TaskGroup& group, std::function<void()> task);
+
+	/**
+	 * @brief 等待 group 中的任务全部结束，等待期间执行池中的任务；有任务抛出异常时重新抛出第一个
+	 */
+	void Wait(TaskGroup& group);
+
+	/**
+	 * @brief 对 [0, count) 中的每个 i 并行执行 body(i)，返回前全部结束
+	 * @details 区间不断对半拆分，后一半放进队列等别的线程来偷，前一半留给自己，直到只剩一个下标。
+	 * body 抛出异常时其余还没开始的下标被取消，第一个异常在全部结束后重新抛出。
+	 */
+	template<typename Body> void ParallelFor(size_t count, Body&& body)
+	{
+		if (count == 0) {
+			return;
+		}
+		TaskGroup                           group;
+		std::function<void(size_t, size_t)> run = [&](size_t begin, size_t end) {
+			while (end - begin > 1) {
+				const size_t middle = begin + (end - begin) / 2;
+				Submit(group, [&run, middle, end] { run(middle, end); });
+				end = middle;
+			}
+			if (!group.Cancelled()) {
+				body(begin);
+			}
+		};
+		Submit(group, [&run, count] { run(0, count); });
+		Wait(group);
+	}
+
+private:
+	struct Task
+	{
+		std::function<void()> run;
+		TaskGroup*            group = nullptr;
+	};
+
+	// 一个线程的任务队列，独占缓存行，避免相邻队列的锁互相干扰
+	struct alignas(64) Slot
+	{
+		std::mutex       mutex;
+		std::deque<Task> tasks;
+	};
+
+	void   worker(size_t index, int cpu);
+	size_t current_slot() const noexcept;
+	bool   find_task(size_t self, Task& task);
+	void   run(Task& task) noexcept;
+	void   wake_all();
+
+	std::vector<Slot>        slots_;
+	std::vector<std::thread> threads_;
+	// 各队列中的任务总数，取走与放入之间可能短暂为负
+	std::atomic<int64_t>     queued_{0};
+	// 睡在 sleep_cv_ 上的线程数，没有时提交任务不必唤醒
+	std::atomic<size_t>      sleepers_{0};
+	std::mutex               sleep_mutex_;
+	std::condition_variable  sleep_cv_;
+	bool                     stop_ = false;
+};
+}   // namespace dl
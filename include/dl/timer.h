@@ -1,5 +1,6 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
 
 #include <string>
 class Timer
@@ -9,6 +10,11 @@ public:
 	void setLabel(const std::string& lbl) { label = lbl; }
 	void start() { start_time = std::chrono::high_resolution_clock::now(); }
 	void stop() { end_time = std::chrono::high_resolution_clock::now(); }
+	// elapsed time between start and stop in ns
+	int64_t elapsedNs() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+	}
 	/**
 	 * @brief print the elapsed time between start and stop in ms with label prefix
 	 *
@@ -1,8 +1,9 @@
 #pragma once
 #include <bitset>
+#include <cstdint>
 #include <string_view>
 namespace dl {
-enum class TokenType
+enum class TokenType : uint8_t
 {
 	Eof,
 	Identifier,
@@ -37,13 +38,13 @@ struct Token
 {
 	// Token 内容
 	std::string_view source_;
-	// Token 所在行号
-	std::size_t line_;
+	// Token 所在行号，32 位足够，让 Token 只占 24 字节
+	uint32_t line_;
 	// Token 类型
 	TokenType type_;
 	Token(std::string_view source, std::size_t line, TokenType type)
 		: source_(source)
-		, line_(line)
+		, line_(static_cast<uint32_t>(line))
 		, type_(type)
 	{}
 };
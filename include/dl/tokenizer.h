@@ -1,6 +1,7 @@
 #pragma once
 #include "dl/token.h"
 #include <cstdarg>
+#include <fmt/format.h>
 #include <magic_enum/magic_enum.hpp>
 #include <spdlog/spdlog.h>
 #include <string>
@@ -19,13 +20,26 @@ enum class TokenizeMode
 template<TokenizeMode mode> class Tokenizer
 {
 public:
-	Tokenizer(std::string&& text, const std::string& file_name)
-		: file_name_(file_name)
-		, text_(std::move(text))
-		, position_(0)
-		, tokens_()
-		, length_(text_.length())
+	Tokenizer() = default;
+	Tokenizer(std::string&& text, const std::string& file_name) { Reset(text, file_name); }
+
+	/**
+	 * @brief 复用已有的缓冲区切分一份新的源码
+	 * @details text 与上一份源码交换，调用方拿回的旧缓冲区可以用来读下一个文件。之前得到的 token
+	 * 全部失效。
+	 *
+	 * @param text
+	 * @param file_name
+	 */
+	void Reset(std::string& text, const std::string& file_name)
 	{
+		file_name_ = file_name;
+		text_.swap(text);
+		position_ = 0;
+		length_   = text_.length();
+		line_     = 1;
+		tokens_.clear();
+		comment_tokens_.clear();
 		tokens_.reserve(length_ / 4);
 		if (length_ >= 3 && static_cast<unsigned char>(text_[0]) == 0xEF &&
 			static_cast<unsigned char>(text_[1]) == 0xBB &&
@@ -34,6 +48,25 @@ public:
 		}
 		tokenize();
 	}
+
+	/**
+	 * @brief 释放容量超过 max_bytes 的缓冲区，之前得到的 token 全部失效
+	 *
+	 * @param max_bytes
+	 */
+	void TrimBuffers(size_t max_bytes) noexcept
+	{
+		if (text_.capacity() > max_bytes) {
+			std::string().swap(text_);
+			length_ = 0;
+		}
+		if (tokens_.capacity() * sizeof(Token) > max_bytes) {
+			std::vector<Token>().swap(tokens_);
+		}
+		if (comment_tokens_.capacity() * sizeof(CommentToken) > max_bytes) {
+			std::vector<CommentToken>().swap(comment_tokens_);
+		}
+	}
 #ifndef NDEBUG
 	/**
 	 * @brief 打印所有的 token
@@ -55,6 +88,8 @@ public:
 #endif
 	std::vector<Token>&        getTokens() noexcept { return tokens_; }
 	std::vector<CommentToken>& getCommentTokens() noexcept { return comment_tokens_; }
+	// 当前切分的源码，token 都指向它
+	const std::string&         getText() const noexcept { return text_; }
 
 private:
 	// 查看当前位置往前看第offset个字符
@@ -481,9 +516,10 @@ private:
 				++line_;
 			}
 			else if (c == ']') {
+				// 未能闭合时已读过的 = 不会是 ]，也不会是换行，直接跳过即可
 				bool ready_to_end = true;
 				for (int i = 0; i < delimiter_length; ++i) {
-					if (peek(i) != '=') {
+					if (peek() != '=') {
 						ready_to_end = false;
 						break;
 					}
@@ -493,34 +529,19 @@ private:
 					++position_;
 					return;
 				}
-				if (peek() == '\n') {
-					++line_;
-				}
 			}
 		}
 	}
 
-	// 接收类似于 printf 接收的参数
+	// 接收类似于 printf 接收的参数。异常信息带上位置，由捕获它的调用方报告
 	void error(const char* fmt, ...) const
 	{
-		SPDLOG_ERROR("Tokenizer Error at {}:{}", file_name_, line_);
 		char    buf[512];
 		va_list args;
 		va_start(args, fmt);
 		vsnprintf(buf, sizeof(buf), fmt, args);
 		va_end(args);
-
-		SPDLOG_ERROR("{}", buf);
-
-		// 尝试打印上一条 token 和 这一条 token
-		if (!tokens_.empty()) {
-			const Token& last_token = tokens_.back();
-			SPDLOG_ERROR("Last Token: Type: {}, Text: {}",
-						 std::string(magic_enum::enum_name(last_token.type_)),
-						 last_token.source_);
-		}
-
-		throw std::runtime_error("Tokenizer Error");
+		throw std::runtime_error(fmt::format("{}:{}: {}", file_name_, line_, buf));
 	}
 
 	std::string               file_name_;
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+namespace dl {
+/**
+ * @brief 按行比较两份文本，生成 unified diff 格式的差异
+ * @details 使用 Myers 算法求最短编辑脚本。编辑距离过大时不再细分，中间差异整段作为删除与插入输出，
+ * 结果依然正确，只是不一定最短。
+ *
+ * @param old_text 原文本
+ * @param new_text 新文本
+ * @param old_name --- 行中的名字
+ * @param new_name +++ 行中的名字
+ * @param context 每段差异前后保留的上下文行数
+ * @return std::string 两份文本相同时为空
+ */
+std::string unified_diff(std::string_view old_text, std::string_view new_text,
+						 std::string_view old_name, std::string_view new_name,
+						 size_t context = 3);
+}   // namespace dl
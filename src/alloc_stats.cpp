@@ -0,0 +1,93 @@
+#include "dl/alloc_stats.h"
+
+#ifdef DL_ALLOC_STATS
+#	include <cstdlib>
+#	include <new>
+
+// 替换全局 operator new / delete，在每块内存前放一个头记下大小，释放时才能扣减存活字节数。
+// 对齐版本没有替换，仍由标准库成对处理，不计入统计。
+namespace {
+constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+void* counted_alloc(size_t size) noexcept
+{
+	auto* base = static_cast<std::byte*>(std::malloc(size + HEADER_SIZE));
+	if (!base) {
+		return nullptr;
+	}
+	*reinterpret_cast<size_t*>(base) = size;
+	auto& counters                   = dl::thread_alloc_counters();
+	++counters.count;
+	counters.bytes += size;
+	counters.live += static_cast<int64_t>(size);
+	counters.peak = std::max(counters.peak, counters.live);
+	return base + HEADER_SIZE;
+}
+
+void* counted_alloc_or_throw(size_t size)
+{
+	void* ptr = counted_alloc(size);
+	while (!ptr) {
+		// 与标准库的行为一致：有 new_handler 就让它腾出内存后重试，否则抛出
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) {
+			throw std::bad_alloc();
+		}
+		handler();
+		ptr = counted_alloc(size);
+	}
+	return ptr;
+}
+
+void counted_free(void* ptr) noexcept
+{
+	if (!ptr) {
+		return;
+	}
+	auto* base = static_cast<std::byte*>(ptr) - HEADER_SIZE;
+	dl::thread_alloc_counters().live -= static_cast<int64_t>(*reinterpret_cast<size_t*>(base));
+	std::free(base);
+}
+}   // namespace
+
+void* operator new(size_t size)
+{
+	return counted_alloc_or_throw(size);
+}
+void* operator new[](size_t size)
+{
+	return counted_alloc_or_throw(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(size);
+}
+void operator delete(void* ptr) noexcept
+{
+	counted_free(ptr);
+}
+void operator delete[](void* ptr) noexcept
+{
+	counted_free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+	counted_free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept
+{
+	counted_free(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	counted_free(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	counted_free(ptr);
+}
+#endif
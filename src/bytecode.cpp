@@ -0,0 +1,132 @@
+#include "dl/bytecode.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+using namespace dl;
+
+namespace {
+class ChunkWriter
+{
+public:
+	explicit ChunkWriter(bool strip)
+		: strip_(strip)
+	{}
+
+	void header()
+	{
+		out_ += "\x1bLua";
+		byte(0x51);   // 版本号
+		byte(0);      // 官方格式
+		byte(is_little_endian());
+		byte(sizeof(int32_t));
+		byte(sizeof(size_t));
+		byte(sizeof(Instruction));
+		byte(sizeof(double));
+		byte(0);   // lua_Number 为浮点数
+	}
+
+	void function(const Proto& f, const std::string* parent_source)
+	{
+		// 与父函数同源时不重复写入源文件名
+		if (strip_ || (parent_source && *parent_source == f.source_)) {
+			null_string();
+		}
+		else {
+			string(f.source_);
+		}
+		integer(f.line_defined_);
+		integer(f.last_line_defined_);
+		byte(f.num_upvalues_);
+		byte(f.num_params_);
+		byte(f.is_vararg_);
+		byte(f.max_stack_size_);
+
+		integer(static_cast<int>(f.code_.size()));
+		for (const Instruction i : f.code_) {
+			raw(&i, sizeof(i));
+		}
+
+		integer(static_cast<int>(f.constants_.size()));
+		for (const auto& k : f.constants_) {
+			byte(static_cast<uint8_t>(k.type_));
+			switch (k.type_) {
+			case ConstantType::Boolean: byte(k.boolean_); break;
+			case ConstantType::Number: raw(&k.number_, sizeof(k.number_)); break;
+			case ConstantType::String: string(k.string_); break;
+			default: break;
+			}
+		}
+		integer(static_cast<int>(f.protos_.size()));
+		for (const auto& p : f.protos_) {
+			function(p, &f.source_);
+		}
+
+		if (strip_) {
+			integer(0);
+			integer(0);
+			integer(0);
+			return;
+		}
+		integer(static_cast<int>(f.line_info_.size()));
+		for (const int line : f.line_info_) {
+			integer(line);
+		}
+		integer(static_cast<int>(f.local_vars_.size()));
+		for (const auto& var : f.local_vars_) {
+			string(var.name_);
+			integer(var.start_pc_);
+			integer(var.end_pc_);
+		}
+		integer(static_cast<int>(f.upvalue_names_.size()));
+		for (const auto& name : f.upvalue_names_) {
+			string(name);
+		}
+	}
+
+	std::string take() { return std::move(out_); }
+
+private:
+	static uint8_t is_little_endian()
+	{
+		const uint16_t probe = 1;
+		uint8_t        low;
+		std::memcpy(&low, &probe, 1);
+		return low;
+	}
+
+	void raw(const void* data, size_t size)
+	{
+		out_.append(static_cast<const char*>(data), size);
+	}
+	void byte(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+	void integer(int value)
+	{
+		const auto v = static_cast<int32_t>(value);
+		raw(&v, sizeof(v));
+	}
+	void null_string()
+	{
+		const size_t size = 0;
+		raw(&size, sizeof(size));
+	}
+	// 长度包含结尾的 '\0'
+	void string(const std::string& value)
+	{
+		const size_t size = value.size() + 1;
+		raw(&size, sizeof(size));
+		raw(value.c_str(), size);
+	}
+
+	std::string out_;
+	bool        strip_;
+};
+}   // namespace
+
+std::string dl::DumpChunk(const Proto& main, bool strip)
+{
+	ChunkWriter writer(strip);
+	writer.header();
+	writer.function(main, nullptr);
+	return writer.take();
+}
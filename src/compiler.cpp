@@ -0,0 +1,1664 @@
+#include "dl/compiler.h"
+#include "dl/ast.h"
+#include "dl/bytecode.h"
+#include "dl/lua_literal.h"
+#include "dl/token.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace dl;
+
+// 跳转链表的结束标记
+static constexpr int NO_JUMP = -1;
+// 返回值或参数个数不定
+static constexpr int MULTRET = -1;
+// 一个函数最多的活跃局部变量数
+static constexpr int MAX_VARS = 200;
+// 一个函数最多的上值数
+static constexpr int MAX_UPVALUES = 60;
+
+static int line_of(const Token* token)
+{
+	return static_cast<int>(token->line_);
+}
+
+/**
+ * @brief 把整数编码为 NEWTABLE 使用的“浮点字节”，eeeeexxx 表示 (1xxx) * 2^(eeeee - 1)
+ *
+ */
+static int int_to_fb(unsigned int x)
+{
+	int e = 0;
+	while (x >= 16) {
+		x = (x + 1) >> 1;
+		++e;
+	}
+	if (x < 8) {
+		return static_cast<int>(x);
+	}
+	return ((e + 1) << 3) | (static_cast<int>(x) - 8);
+}
+
+Compiler::Compiler(AstNode* root, const std::string& chunk_name)
+	: chunk_name_(chunk_name)
+{
+	FuncState fs;
+	open_function(fs, &main_);
+	// 主函数总是可变参数函数
+	main_.is_vararg_ = VARARG_ISVARARG;
+	chunk(root);
+	close_function();
+}
+
+void Compiler::error(const std::string_view message) const
+{
+	SPDLOG_ERROR("Error at {}:{}: {}", chunk_name_, line_, message);
+	throw std::runtime_error("Compiling error");
+}
+
+// ----------------------------------------------------------------------------
+// 代码生成，对应 lcode.c
+// ----------------------------------------------------------------------------
+
+int Compiler::code(Instruction i)
+{
+	// 跳到这里的待回填跳转都指向这条新指令
+	discharge_jpc();
+	fs_->f->code_.push_back(i);
+	fs_->f->line_info_.push_back(line_);
+	return fs_->pc() - 1;
+}
+
+int Compiler::code_abc(OpCode op, int a, int b, int c)
+{
+	return code(create_abc(op, a, b, c));
+}
+
+int Compiler::code_abx(OpCode op, int a, int bx)
+{
+	return code(create_abx(op, a, bx));
+}
+
+int Compiler::code_asbx(OpCode op, int a, int sbx)
+{
+	return code_abx(op, a, sbx + MAXARG_SBX);
+}
+
+Instruction& Compiler::get_code(const ExpDesc& e)
+{
+	return fs_->f->code_[e.info];
+}
+
+void Compiler::fix_line(int line)
+{
+	fs_->f->line_info_.back() = line;
+}
+
+void Compiler::nil(int from, int n)
+{
+	FuncState& fs = *fs_;
+	// 没有跳转指向当前位置时，可以省略或合并 LOADNIL
+	if (fs.pc() > fs.last_target) {
+		if (fs.pc() == 0) {
+			// 函数开头的寄存器本来就是 nil
+			if (from >= fs.nactvar) {
+				return;
+			}
+		}
+		else {
+			Instruction& previous = fs.f->code_.back();
+			if (get_opcode(previous) == OpCode::LOADNIL) {
+				const int pfrom = get_arg_a(previous);
+				const int pto   = get_arg_b(previous);
+				if (pfrom <= from && from <= pto + 1) {
+					if (from + n - 1 > pto) {
+						set_arg_b(previous, from + n - 1);
+					}
+					return;
+				}
+			}
+		}
+	}
+	code_abc(OpCode::LOADNIL, from, from + n - 1, 0);
+}
+
+int Compiler::jump()
+{
+	const int jpc = fs_->jpc;
+	fs_->jpc      = NO_JUMP;
+	int j         = code_asbx(OpCode::JMP, 0, NO_JUMP);
+	concat(j, jpc);
+	return j;
+}
+
+void Compiler::ret(int first, int nret)
+{
+	code_abc(OpCode::RETURN, first, nret + 1, 0);
+}
+
+int Compiler::cond_jump(OpCode op, int a, int b, int c)
+{
+	code_abc(op, a, b, c);
+	return jump();
+}
+
+void Compiler::fix_jump(int pc, int dest)
+{
+	const int offset = dest - (pc + 1);
+	if (std::abs(offset) > MAXARG_SBX) {
+		error("control structure too long");
+	}
+	set_arg_sbx(fs_->f->code_[pc], offset);
+}
+
+int Compiler::get_label()
+{
+	fs_->last_target = fs_->pc();
+	return fs_->pc();
+}
+
+int Compiler::get_jump(int pc) const
+{
+	const int offset = get_arg_sbx(fs_->f->code_[pc]);
+	// 指向自身表示链表结束
+	if (offset == NO_JUMP) {
+		return NO_JUMP;
+	}
+	return pc + 1 + offset;
+}
+
+Instruction& Compiler::get_jump_control(int pc)
+{
+	auto& code = fs_->f->code_;
+	if (pc >= 1 && is_test_mode(get_opcode(code[pc - 1]))) {
+		return code[pc - 1];
+	}
+	return code[pc];
+}
+
+bool Compiler::need_value(int list)
+{
+	for (; list != NO_JUMP; list = get_jump(list)) {
+		if (get_opcode(get_jump_control(list)) != OpCode::TESTSET) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Compiler::patch_test_reg(int node, int reg)
+{
+	Instruction& i = get_jump_control(node);
+	if (get_opcode(i) != OpCode::TESTSET) {
+		return false;
+	}
+	if (reg != NO_REG && reg != get_arg_b(i)) {
+		set_arg_a(i, reg);
+	}
+	else {
+		// 不需要保存值，退化为 TEST
+		i = create_abc(OpCode::TEST, get_arg_b(i), 0, get_arg_c(i));
+	}
+	return true;
+}
+
+void Compiler::remove_values(int list)
+{
+	for (; list != NO_JUMP; list = get_jump(list)) {
+		patch_test_reg(list, NO_REG);
+	}
+}
+
+void Compiler::patch_list_aux(int list, int vtarget, int reg, int dtarget)
+{
+	while (list != NO_JUMP) {
+		const int next = get_jump(list);
+		if (patch_test_reg(list, reg)) {
+			fix_jump(list, vtarget);
+		}
+		else {
+			fix_jump(list, dtarget);
+		}
+		list = next;
+	}
+}
+
+void Compiler::discharge_jpc()
+{
+	patch_list_aux(fs_->jpc, fs_->pc(), NO_REG, fs_->pc());
+	fs_->jpc = NO_JUMP;
+}
+
+void Compiler::patch_list(int list, int target)
+{
+	if (target == fs_->pc()) {
+		patch_to_here(list);
+	}
+	else {
+		patch_list_aux(list, target, NO_REG, target);
+	}
+}
+
+void Compiler::patch_to_here(int list)
+{
+	get_label();
+	concat(fs_->jpc, list);
+}
+
+void Compiler::concat(int& l1, int l2)
+{
+	if (l2 == NO_JUMP) {
+		return;
+	}
+	if (l1 == NO_JUMP) {
+		l1 = l2;
+		return;
+	}
+	int list = l1;
+	int next;
+	while ((next = get_jump(list)) != NO_JUMP) {
+		list = next;
+	}
+	fix_jump(list, l2);
+}
+
+void Compiler::check_stack(int n)
+{
+	const int new_stack = fs_->freereg + n;
+	if (new_stack > fs_->f->max_stack_size_) {
+		if (new_stack >= MAXSTACK) {
+			error("function or expression too complex");
+		}
+		fs_->f->max_stack_size_ = static_cast<uint8_t>(new_stack);
+	}
+}
+
+void Compiler::reserve_regs(int n)
+{
+	check_stack(n);
+	fs_->freereg += n;
+}
+
+void Compiler::free_reg(int reg)
+{
+	if (!is_constant(reg) && reg >= fs_->nactvar) {
+		--fs_->freereg;
+	}
+}
+
+void Compiler::free_exp(const ExpDesc& e)
+{
+	if (e.k == ExpKind::NonReloc) {
+		free_reg(e.info);
+	}
+}
+
+int Compiler::add_constant(const std::string& key, Constant&& value)
+{
+	auto& constants = fs_->f->constants_;
+	const auto [it, inserted] =
+		fs_->constant_index.emplace(key, static_cast<int>(constants.size()));
+	if (inserted) {
+		if (static_cast<int>(constants.size()) >= MAXARG_BX) {
+			error("constant table overflow");
+		}
+		constants.push_back(std::move(value));
+	}
+	return it->second;
+}
+
+int Compiler::string_constant(std::string_view s)
+{
+	Constant k;
+	k.type_   = ConstantType::String;
+	k.string_ = s;
+	return add_constant("s" + k.string_, std::move(k));
+}
+
+int Compiler::number_constant(double n)
+{
+	// 与 Lua 表一样，0 与 -0 是同一个键
+	const double value = n == 0 ? 0.0 : n;
+	std::string  key(1 + sizeof(value), 'n');
+	std::memcpy(&key[1], &value, sizeof(value));
+	Constant k;
+	k.type_   = ConstantType::Number;
+	k.number_ = n;
+	return add_constant(key, std::move(k));
+}
+
+int Compiler::bool_constant(bool b)
+{
+	Constant k;
+	k.type_    = ConstantType::Boolean;
+	k.boolean_ = b;
+	return add_constant(b ? "T" : "F", std::move(k));
+}
+
+int Compiler::nil_constant()
+{
+	return add_constant("N", Constant{});
+}
+
+void Compiler::set_returns(ExpDesc& e, int nresults)
+{
+	if (e.k == ExpKind::Call) {
+		set_arg_c(get_code(e), nresults + 1);
+	}
+	else if (e.k == ExpKind::Vararg) {
+		set_arg_b(get_code(e), nresults + 1);
+		set_arg_a(get_code(e), fs_->freereg);
+		reserve_regs(1);
+	}
+}
+
+void Compiler::set_one_ret(ExpDesc& e)
+{
+	if (e.k == ExpKind::Call) {
+		e.k    = ExpKind::NonReloc;
+		e.info = get_arg_a(get_code(e));
+	}
+	else if (e.k == ExpKind::Vararg) {
+		set_arg_b(get_code(e), 2);
+		e.k = ExpKind::Relocable;
+	}
+}
+
+void Compiler::discharge_vars(ExpDesc& e)
+{
+	switch (e.k) {
+	case ExpKind::Local: e.k = ExpKind::NonReloc; break;
+	case ExpKind::Upval:
+		e.info = code_abc(OpCode::GETUPVAL, 0, e.info, 0);
+		e.k    = ExpKind::Relocable;
+		break;
+	case ExpKind::Global:
+		e.info = code_abx(OpCode::GETGLOBAL, 0, e.info);
+		e.k    = ExpKind::Relocable;
+		break;
+	case ExpKind::Indexed:
+		free_reg(e.aux);
+		free_reg(e.info);
+		e.info = code_abc(OpCode::GETTABLE, 0, e.info, e.aux);
+		e.k    = ExpKind::Relocable;
+		break;
+	case ExpKind::Vararg:
+	case ExpKind::Call: set_one_ret(e); break;
+	default: break;
+	}
+}
+
+int Compiler::code_label(int a, int b, int jump)
+{
+	// 这些指令可能是跳转目标
+	get_label();
+	return code_abc(OpCode::LOADBOOL, a, b, jump);
+}
+
+void Compiler::discharge_to_reg(ExpDesc& e, int reg)
+{
+	discharge_vars(e);
+	switch (e.k) {
+	case ExpKind::Nil: nil(reg, 1); break;
+	case ExpKind::False:
+	case ExpKind::True: code_abc(OpCode::LOADBOOL, reg, e.k == ExpKind::True, 0); break;
+	case ExpKind::K: code_abx(OpCode::LOADK, reg, e.info); break;
+	case ExpKind::KNum: code_abx(OpCode::LOADK, reg, number_constant(e.nval)); break;
+	case ExpKind::Relocable: set_arg_a(get_code(e), reg); break;
+	case ExpKind::NonReloc:
+		if (reg != e.info) {
+			code_abc(OpCode::MOVE, reg, e.info, 0);
+		}
+		break;
+	default:
+		// Void 或 Jmp，没有要放入寄存器的值
+		return;
+	}
+	e.info = reg;
+	e.k    = ExpKind::NonReloc;
+}
+
+void Compiler::discharge_to_any_reg(ExpDesc& e)
+{
+	if (e.k != ExpKind::NonReloc) {
+		reserve_regs(1);
+		discharge_to_reg(e, fs_->freereg - 1);
+	}
+}
+
+void Compiler::exp_to_reg(ExpDesc& e, int reg)
+{
+	discharge_to_reg(e, reg);
+	if (e.k == ExpKind::Jmp) {
+		concat(e.t, e.info);
+	}
+	if (has_jumps(e)) {
+		// 可能要用 LOADBOOL 把条件的结果转成值
+		int p_f = NO_JUMP;
+		int p_t = NO_JUMP;
+		if (need_value(e.t) || need_value(e.f)) {
+			const int fj = e.k == ExpKind::Jmp ? NO_JUMP : jump();
+			p_f          = code_label(reg, 0, 1);
+			p_t          = code_label(reg, 1, 0);
+			patch_to_here(fj);
+		}
+		const int final = get_label();
+		patch_list_aux(e.f, final, reg, p_f);
+		patch_list_aux(e.t, final, reg, p_t);
+	}
+	e.f = e.t = NO_JUMP;
+	e.info    = reg;
+	e.k       = ExpKind::NonReloc;
+}
+
+void Compiler::exp_to_next_reg(ExpDesc& e)
+{
+	discharge_vars(e);
+	free_exp(e);
+	reserve_regs(1);
+	exp_to_reg(e, fs_->freereg - 1);
+}
+
+int Compiler::exp_to_any_reg(ExpDesc& e)
+{
+	discharge_vars(e);
+	if (e.k == ExpKind::NonReloc) {
+		if (!has_jumps(e)) {
+			return e.info;
+		}
+		// 寄存器不是局部变量时可以直接放结果
+		if (e.info >= fs_->nactvar) {
+			exp_to_reg(e, e.info);
+			return e.info;
+		}
+	}
+	exp_to_next_reg(e);
+	return e.info;
+}
+
+void Compiler::exp_to_val(ExpDesc& e)
+{
+	if (has_jumps(e)) {
+		exp_to_any_reg(e);
+	}
+	else {
+		discharge_vars(e);
+	}
+}
+
+int Compiler::exp_to_rk(ExpDesc& e)
+{
+	exp_to_val(e);
+	switch (e.k) {
+	case ExpKind::KNum:
+	case ExpKind::True:
+	case ExpKind::False:
+	case ExpKind::Nil:
+		if (static_cast<int>(fs_->f->constants_.size()) <= MAXINDEXRK) {
+			e.info = e.k == ExpKind::Nil    ? nil_constant()
+				   : e.k == ExpKind::KNum ? number_constant(e.nval)
+										  : bool_constant(e.k == ExpKind::True);
+			e.k = ExpKind::K;
+			return rk_constant(e.info);
+		}
+		break;
+	case ExpKind::K:
+		if (e.info <= MAXINDEXRK) {
+			return rk_constant(e.info);
+		}
+		break;
+	default: break;
+	}
+	// 常量下标超出 RK 操作数的范围，放入寄存器
+	return exp_to_any_reg(e);
+}
+
+void Compiler::store_var(const ExpDesc& var, ExpDesc& ex)
+{
+	switch (var.k) {
+	case ExpKind::Local:
+		free_exp(ex);
+		exp_to_reg(ex, var.info);
+		return;
+	case ExpKind::Upval:
+	{
+		const int e = exp_to_any_reg(ex);
+		code_abc(OpCode::SETUPVAL, e, var.info, 0);
+		break;
+	}
+	case ExpKind::Global:
+	{
+		const int e = exp_to_any_reg(ex);
+		code_abx(OpCode::SETGLOBAL, e, var.info);
+		break;
+	}
+	case ExpKind::Indexed:
+	{
+		const int e = exp_to_rk(ex);
+		code_abc(OpCode::SETTABLE, var.info, var.aux, e);
+		break;
+	}
+	default: error("cannot assign to this expression");
+	}
+	free_exp(ex);
+}
+
+void Compiler::self(ExpDesc& e, ExpDesc& key)
+{
+	exp_to_any_reg(e);
+	free_exp(e);
+	const int func = fs_->freereg;
+	reserve_regs(2);
+	code_abc(OpCode::SELF, func, e.info, exp_to_rk(key));
+	free_exp(key);
+	e.info = func;
+	e.k    = ExpKind::NonReloc;
+}
+
+void Compiler::invert_jump(const ExpDesc& e)
+{
+	Instruction& i = get_jump_control(e.info);
+	set_arg_a(i, !get_arg_a(i));
+}
+
+int Compiler::jump_on_cond(ExpDesc& e, bool cond)
+{
+	if (e.k == ExpKind::Relocable) {
+		const Instruction ie = get_code(e);
+		if (get_opcode(ie) == OpCode::NOT) {
+			// 去掉 NOT，反转测试条件
+			fs_->f->code_.pop_back();
+			fs_->f->line_info_.pop_back();
+			return cond_jump(OpCode::TEST, get_arg_b(ie), 0, !cond);
+		}
+	}
+	discharge_to_any_reg(e);
+	free_exp(e);
+	return cond_jump(OpCode::TESTSET, NO_REG, e.info, cond);
+}
+
+void Compiler::go_if_true(ExpDesc& e)
+{
+	int pc;
+	discharge_vars(e);
+	switch (e.k) {
+	case ExpKind::K:
+	case ExpKind::KNum:
+	case ExpKind::True:
+		// 恒为真，不需要跳转
+		pc = NO_JUMP;
+		break;
+	case ExpKind::Jmp:
+		invert_jump(e);
+		pc = e.info;
+		break;
+	default: pc = jump_on_cond(e, false); break;
+	}
+	concat(e.f, pc);
+	patch_to_here(e.t);
+	e.t = NO_JUMP;
+}
+
+void Compiler::go_if_false(ExpDesc& e)
+{
+	int pc;
+	discharge_vars(e);
+	switch (e.k) {
+	case ExpKind::Nil:
+	case ExpKind::False:
+		// 恒为假，不需要跳转
+		pc = NO_JUMP;
+		break;
+	case ExpKind::Jmp: pc = e.info; break;
+	default: pc = jump_on_cond(e, true); break;
+	}
+	concat(e.t, pc);
+	patch_to_here(e.f);
+	e.f = NO_JUMP;
+}
+
+void Compiler::code_not(ExpDesc& e)
+{
+	discharge_vars(e);
+	switch (e.k) {
+	case ExpKind::Nil:
+	case ExpKind::False: e.k = ExpKind::True; break;
+	case ExpKind::K:
+	case ExpKind::KNum:
+	case ExpKind::True: e.k = ExpKind::False; break;
+	case ExpKind::Jmp: invert_jump(e); break;
+	case ExpKind::Relocable:
+	case ExpKind::NonReloc:
+		discharge_to_any_reg(e);
+		free_exp(e);
+		e.info = code_abc(OpCode::NOT, 0, e.info, 0);
+		e.k    = ExpKind::Relocable;
+		break;
+	default: break;
+	}
+	std::swap(e.t, e.f);
+	remove_values(e.f);
+	remove_values(e.t);
+}
+
+void Compiler::indexed(ExpDesc& t, ExpDesc& k)
+{
+	t.aux = exp_to_rk(k);
+	t.k   = ExpKind::Indexed;
+}
+
+bool Compiler::const_folding(OpCode op, ExpDesc& e1, const ExpDesc& e2)
+{
+	if (!is_numeral(e1) || !is_numeral(e2)) {
+		return false;
+	}
+	const double v1 = e1.nval;
+	const double v2 = e2.nval;
+	double       r;
+	switch (op) {
+	case OpCode::ADD: r = v1 + v2; break;
+	case OpCode::SUB: r = v1 - v2; break;
+	case OpCode::MUL: r = v1 * v2; break;
+	case OpCode::DIV:
+		if (v2 == 0) {
+			return false;
+		}
+		r = v1 / v2;
+		break;
+	case OpCode::MOD:
+		if (v2 == 0) {
+			return false;
+		}
+		r = v1 - std::floor(v1 / v2) * v2;
+		break;
+	case OpCode::POW: r = std::pow(v1, v2); break;
+	case OpCode::UNM: r = -v1; break;
+	default: return false;
+	}
+	if (std::isnan(r)) {
+		return false;
+	}
+	e1.nval = r;
+	return true;
+}
+
+void Compiler::code_arith(OpCode op, ExpDesc& e1, ExpDesc& e2)
+{
+	if (const_folding(op, e1, e2)) {
+		return;
+	}
+	const int o2 = op != OpCode::UNM && op != OpCode::LEN ? exp_to_rk(e2) : 0;
+	const int o1 = exp_to_rk(e1);
+	// 按栈的顺序释放寄存器
+	if (o1 > o2) {
+		free_exp(e1);
+		free_exp(e2);
+	}
+	else {
+		free_exp(e2);
+		free_exp(e1);
+	}
+	e1.info = code_abc(op, 0, o1, o2);
+	e1.k    = ExpKind::Relocable;
+}
+
+void Compiler::code_comp(OpCode op, bool cond, ExpDesc& e1, ExpDesc& e2)
+{
+	int o1 = exp_to_rk(e1);
+	int o2 = exp_to_rk(e2);
+	free_exp(e2);
+	free_exp(e1);
+	// a > b 改写为 b < a，a >= b 改写为 b <= a
+	if (!cond && op != OpCode::EQ) {
+		std::swap(o1, o2);
+		cond = true;
+	}
+	e1.info = cond_jump(op, cond, o1, o2);
+	e1.k    = ExpKind::Jmp;
+}
+
+void Compiler::infix(AstNodeType op, ExpDesc& v)
+{
+	switch (op) {
+	case AstNodeType::AndExpr: go_if_true(v); break;
+	case AstNodeType::OrExpr: go_if_false(v); break;
+	case AstNodeType::ConcatExpr:
+		// 操作数必须在连续的寄存器中
+		exp_to_next_reg(v);
+		break;
+	case AstNodeType::AddExpr:
+	case AstNodeType::SubExpr:
+	case AstNodeType::MulExpr:
+	case AstNodeType::DivExpr:
+	case AstNodeType::ModExpr:
+	case AstNodeType::PowExpr:
+		// 保留数值常量以便折叠
+		if (!is_numeral(v)) {
+			exp_to_rk(v);
+		}
+		break;
+	default: exp_to_rk(v); break;
+	}
+}
+
+void Compiler::posfix(AstNodeType op, ExpDesc& e1, ExpDesc& e2)
+{
+	switch (op) {
+	case AstNodeType::AndExpr:
+		discharge_vars(e2);
+		concat(e2.f, e1.f);
+		e1 = e2;
+		break;
+	case AstNodeType::OrExpr:
+		discharge_vars(e2);
+		concat(e2.t, e1.t);
+		e1 = e2;
+		break;
+	case AstNodeType::ConcatExpr:
+		exp_to_val(e2);
+		// a .. b .. c 合并为一条 CONCAT
+		if (e2.k == ExpKind::Relocable && get_opcode(get_code(e2)) == OpCode::CONCAT) {
+			free_exp(e1);
+			set_arg_b(get_code(e2), e1.info);
+			e1.k    = ExpKind::Relocable;
+			e1.info = e2.info;
+		}
+		else {
+			exp_to_next_reg(e2);
+			code_arith(OpCode::CONCAT, e1, e2);
+		}
+		break;
+	case AstNodeType::AddExpr: code_arith(OpCode::ADD, e1, e2); break;
+	case AstNodeType::SubExpr: code_arith(OpCode::SUB, e1, e2); break;
+	case AstNodeType::MulExpr: code_arith(OpCode::MUL, e1, e2); break;
+	case AstNodeType::DivExpr: code_arith(OpCode::DIV, e1, e2); break;
+	case AstNodeType::ModExpr: code_arith(OpCode::MOD, e1, e2); break;
+	case AstNodeType::PowExpr: code_arith(OpCode::POW, e1, e2); break;
+	case AstNodeType::EqExpr: code_comp(OpCode::EQ, true, e1, e2); break;
+	case AstNodeType::NeqExpr: code_comp(OpCode::EQ, false, e1, e2); break;
+	case AstNodeType::LtExpr: code_comp(OpCode::LT, true, e1, e2); break;
+	case AstNodeType::LeExpr: code_comp(OpCode::LE, true, e1, e2); break;
+	case AstNodeType::GtExpr: code_comp(OpCode::LT, false, e1, e2); break;
+	case AstNodeType::GeExpr: code_comp(OpCode::LE, false, e1, e2); break;
+	default: error("unexpected binary operator");
+	}
+}
+
+void Compiler::set_list(int base, int nelems, int tostore)
+{
+	const int c = (nelems - 1) / LFIELDS_PER_FLUSH + 1;
+	const int b = tostore == MULTRET ? 0 : tostore;
+	if (c <= MAXARG_C) {
+		code_abc(OpCode::SETLIST, base, b, c);
+	}
+	else {
+		// C 放不下时写在下一条“指令”中
+		code_abc(OpCode::SETLIST, base, b, 0);
+		code(static_cast<Instruction>(c));
+	}
+	fs_->freereg = base + 1;
+}
+
+// ----------------------------------------------------------------------------
+// 语法制导的翻译，对应 lparser.c
+// ----------------------------------------------------------------------------
+
+void Compiler::open_function(FuncState& fs, Proto* f)
+{
+	fs.f              = f;
+	fs.prev           = fs_;
+	f->source_        = chunk_name_;
+	f->max_stack_size_ = 2;
+	fs_               = &fs;
+}
+
+void Compiler::close_function()
+{
+	remove_vars(0);
+	ret(0, 0);
+	fs_->f->num_upvalues_ = static_cast<uint8_t>(fs_->upvalues.size());
+	fs_                   = fs_->prev;
+}
+
+int Compiler::register_local_var(std::string_view name)
+{
+	auto& vars = fs_->f->local_vars_;
+	vars.push_back({std::string(name), 0, 0});
+	return static_cast<int>(vars.size()) - 1;
+}
+
+void Compiler::new_local_var(std::string_view name, int n)
+{
+	FuncState& fs = *fs_;
+	if (fs.nactvar + n + 1 > MAX_VARS) {
+		error("too many local variables (limit is 200)");
+	}
+	if (static_cast<int>(fs.actvar.size()) < fs.nactvar + n + 1) {
+		fs.actvar.resize(fs.nactvar + n + 1);
+	}
+	fs.actvar[fs.nactvar + n] = register_local_var(name);
+}
+
+void Compiler::adjust_local_vars(int nvars)
+{
+	FuncState& fs = *fs_;
+	fs.nactvar += nvars;
+	for (; nvars; --nvars) {
+		fs.f->local_vars_[fs.actvar[fs.nactvar - nvars]].start_pc_ = fs.pc();
+	}
+}
+
+void Compiler::remove_vars(int to_level)
+{
+	FuncState& fs = *fs_;
+	while (fs.nactvar > to_level) {
+		fs.f->local_vars_[fs.actvar[--fs.nactvar]].end_pc_ = fs.pc();
+	}
+}
+
+int Compiler::index_upvalue(FuncState* fs, std::string_view name, const ExpDesc& v)
+{
+	for (size_t i = 0; i < fs->upvalues.size(); ++i) {
+		if (fs->upvalues[i].k == v.k && fs->upvalues[i].info == v.info) {
+			return static_cast<int>(i);
+		}
+	}
+	if (static_cast<int>(fs->upvalues.size()) + 1 > MAX_UPVALUES) {
+		error("too many upvalues (limit is 60)");
+	}
+	fs->f->upvalue_names_.emplace_back(name);
+	fs->upvalues.push_back({v.k, v.info});
+	return static_cast<int>(fs->upvalues.size()) - 1;
+}
+
+int Compiler::search_var(FuncState* fs, std::string_view name) const
+{
+	for (int i = fs->nactvar - 1; i >= 0; --i) {
+		if (fs->f->local_vars_[fs->actvar[i]].name_ == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void Compiler::mark_upval(FuncState* fs, int level)
+{
+	BlockCnt* bl = fs->bl;
+	while (bl && bl->nactvar > level) {
+		bl = bl->previous;
+	}
+	// 离开这个块时需要 CLOSE
+	if (bl) {
+		bl->upval = true;
+	}
+}
+
+Compiler::ExpKind Compiler::single_var_aux(FuncState* fs, std::string_view name, ExpDesc& var,
+										   bool base)
+{
+	if (fs == nullptr) {
+		var      = ExpDesc{};
+		var.k    = ExpKind::Global;
+		var.info = NO_REG;
+		return ExpKind::Global;
+	}
+	const int v = search_var(fs, name);
+	if (v >= 0) {
+		var      = ExpDesc{};
+		var.k    = ExpKind::Local;
+		var.info = v;
+		// 被内层函数引用，成为上值
+		if (!base) {
+			mark_upval(fs, v);
+		}
+		return ExpKind::Local;
+	}
+	if (single_var_aux(fs->prev, name, var, false) == ExpKind::Global) {
+		return ExpKind::Global;
+	}
+	var.info = index_upvalue(fs, name, var);
+	var.k    = ExpKind::Upval;
+	return ExpKind::Upval;
+}
+
+void Compiler::single_var(Token* name, ExpDesc& var)
+{
+	if (single_var_aux(fs_, name->source_, var, true) == ExpKind::Global) {
+		var.info = string_constant(name->source_);
+	}
+}
+
+void Compiler::adjust_assign(int nvars, int nexps, ExpDesc& e)
+{
+	int extra = nvars - nexps;
+	if (has_multret(e.k)) {
+		// 最后一个表达式补足差额
+		++extra;
+		if (extra < 0) {
+			extra = 0;
+		}
+		set_returns(e, extra);
+		if (extra > 1) {
+			reserve_regs(extra - 1);
+		}
+	}
+	else {
+		if (e.k != ExpKind::Void) {
+			exp_to_next_reg(e);
+		}
+		if (extra > 0) {
+			const int reg = fs_->freereg;
+			reserve_regs(extra);
+			nil(reg, extra);
+		}
+	}
+}
+
+void Compiler::enter_block(BlockCnt& bl, bool is_breakable)
+{
+	bl.break_list   = NO_JUMP;
+	bl.is_breakable = is_breakable;
+	bl.nactvar      = fs_->nactvar;
+	bl.upval        = false;
+	bl.previous     = fs_->bl;
+	fs_->bl         = &bl;
+}
+
+void Compiler::leave_block()
+{
+	BlockCnt* bl = fs_->bl;
+	fs_->bl      = bl->previous;
+	remove_vars(bl->nactvar);
+	if (bl->upval) {
+		code_abc(OpCode::CLOSE, bl->nactvar, 0, 0);
+	}
+	fs_->freereg = fs_->nactvar;
+	patch_to_here(bl->break_list);
+}
+
+void Compiler::body(ExpDesc& e, Span<Token*>& args, AstNode* body, bool need_self,
+					Token* function_token, Token* end_token)
+{
+	Proto     f;
+	FuncState new_fs;
+	open_function(new_fs, &f);
+	f.line_defined_ = line_of(function_token);
+	if (need_self) {
+		new_local_var("self", 0);
+		adjust_local_vars(1);
+	}
+
+	int nparams = 0;
+	for (const Token* arg : args) {
+		if (arg->source_ == "...") {
+			// 兼容 Lua 5.0，可变参数同时存入局部变量 arg
+			new_local_var("arg", nparams++);
+			f.is_vararg_ = VARARG_HASARG | VARARG_NEEDSARG | VARARG_ISVARARG;
+			break;
+		}
+		new_local_var(arg->source_, nparams++);
+	}
+	adjust_local_vars(nparams);
+	f.num_params_ = static_cast<uint8_t>(new_fs.nactvar - (f.is_vararg_ & VARARG_HASARG));
+	reserve_regs(new_fs.nactvar);
+
+	chunk(body);
+	line_                = line_of(end_token);
+	f.last_line_defined_ = line_;
+	close_function();
+
+	// 在外层函数中创建闭包，随后的伪指令告诉虚拟机每个上值从哪里取
+	auto& protos = fs_->f->protos_;
+	protos.push_back(std::move(f));
+	e      = ExpDesc{};
+	e.k    = ExpKind::Relocable;
+	e.info = code_abx(OpCode::CLOSURE, 0, static_cast<int>(protos.size()) - 1);
+	for (const auto& upvalue : new_fs.upvalues) {
+		const OpCode op = upvalue.k == ExpKind::Local ? OpCode::MOVE : OpCode::GETUPVAL;
+		code_abc(op, 0, upvalue.info, 0);
+	}
+}
+
+int Compiler::explist(Span<AstNode*>& exprs, ExpDesc& v)
+{
+	expr(exprs[0], v);
+	for (size_t i = 1; i < exprs.size(); ++i) {
+		exp_to_next_reg(v);
+		expr(exprs[i], v);
+	}
+	return static_cast<int>(exprs.size());
+}
+
+void Compiler::function_args(ExpDesc& f, AstNode* args)
+{
+	const int line = line_of(args->first_token_);
+	ExpDesc   a;
+	switch (args->type_) {
+	case AstNodeType::ArgCall:
+	{
+		auto& arg_list = args->arg_call_.arg_list_;
+		if (!arg_list.empty()) {
+			explist(arg_list, a);
+			set_returns(a, MULTRET);
+		}
+		break;
+	}
+	case AstNodeType::TableCall: constructor(args->table_call_.table_expr_, a); break;
+	case AstNodeType::StringCall:
+	{
+		std::string value;
+		if (!decode_string_literal(args->first_token_->source_, value, false)) {
+			error("malformed string");
+		}
+		a.k    = ExpKind::K;
+		a.info = string_constant(value);
+		break;
+	}
+	default: error("function arguments expected");
+	}
+
+	const int base = f.info;
+	int       nparams;
+	if (has_multret(a.k)) {
+		nparams = MULTRET;
+	}
+	else {
+		if (a.k != ExpKind::Void) {
+			exp_to_next_reg(a);
+		}
+		nparams = fs_->freereg - (base + 1);
+	}
+	f      = ExpDesc{};
+	f.k    = ExpKind::Call;
+	f.info = code_abc(OpCode::CALL, base, nparams + 1, 2);
+	fix_line(line);
+	// 调用移除函数与参数，默认留下一个返回值
+	fs_->freereg = base + 1;
+}
+
+void Compiler::constructor(AstNode* table, ExpDesc& t)
+{
+	const int pc      = code_abc(OpCode::NEWTABLE, 0, 0, 0);
+	int       na      = 0;
+	int       nh      = 0;
+	int       tostore = 0;
+	// 最近一个还没有放入寄存器的数组元素
+	ExpDesc   v;
+	t      = ExpDesc{};
+	t.k    = ExpKind::Relocable;
+	t.info = pc;
+	exp_to_next_reg(t);
+
+	for (auto& entry : table->table_literal_.entry_list_) {
+		if (v.k != ExpKind::Void) {
+			exp_to_next_reg(v);
+			v.k = ExpKind::Void;
+			if (tostore == LFIELDS_PER_FLUSH) {
+				set_list(t.info, na, tostore);
+				tostore = 0;
+			}
+		}
+		switch (entry.type_) {
+		case AstNode::TableEntryType::Value:
+			expr(entry.value_entry_.value_, v);
+			++na;
+			++tostore;
+			break;
+		case AstNode::TableEntryType::Field:
+		case AstNode::TableEntryType::Index:
+		{
+			const int reg = fs_->freereg;
+			ExpDesc   key;
+			AstNode*  value;
+			if (entry.type_ == AstNode::TableEntryType::Field) {
+				key.k    = ExpKind::K;
+				key.info = string_constant(entry.field_entry_.field_->source_);
+				value    = entry.field_entry_.value_;
+			}
+			else {
+				expr(entry.index_entry_.index_, key);
+				exp_to_val(key);
+				value = entry.index_entry_.value_;
+			}
+			++nh;
+			const int rk_key = exp_to_rk(key);
+			ExpDesc   val;
+			expr(value, val);
+			code_abc(OpCode::SETTABLE, t.info, rk_key, exp_to_rk(val));
+			fs_->freereg = reg;
+			break;
+		}
+		}
+	}
+
+	if (tostore != 0) {
+		if (has_multret(v.k)) {
+			// 最后一个元素是调用或 ...，展开全部返回值
+			set_returns(v, MULTRET);
+			set_list(t.info, na, MULTRET);
+			--na;
+		}
+		else {
+			if (v.k != ExpKind::Void) {
+				exp_to_next_reg(v);
+			}
+			set_list(t.info, na, tostore);
+		}
+	}
+	// 预分配数组部分与哈希部分的大小
+	set_arg_b(fs_->f->code_[pc], int_to_fb(static_cast<unsigned int>(na)));
+	set_arg_c(fs_->f->code_[pc], int_to_fb(static_cast<unsigned int>(nh)));
+}
+
+void Compiler::expr(AstNode* node, ExpDesc& v)
+{
+	line_ = line_of(node->first_token_);
+	v     = ExpDesc{};
+	switch (node->type_) {
+	case AstNodeType::NumberLiteral:
+		if (!parse_number_literal(node->first_token_->source_, v.nval, false)) {
+			error("malformed number");
+		}
+		v.k = ExpKind::KNum;
+		break;
+	case AstNodeType::StringLiteral:
+	{
+		std::string value;
+		if (!decode_string_literal(node->first_token_->source_, value, false)) {
+			error("malformed string");
+		}
+		v.k    = ExpKind::K;
+		v.info = string_constant(value);
+		break;
+	}
+	case AstNodeType::NilLiteral: v.k = ExpKind::Nil; break;
+	case AstNodeType::BooleanLiteral:
+		v.k = node->first_token_->source_ == "true" ? ExpKind::True : ExpKind::False;
+		break;
+	case AstNodeType::VargLiteral:
+		if (!fs_->f->is_vararg_) {
+			error("cannot use '...' outside a vararg function");
+		}
+		// 用到了 ...，不再需要兼容的 arg 表
+		fs_->f->is_vararg_ &= ~VARARG_NEEDSARG;
+		v.k    = ExpKind::Vararg;
+		v.info = code_abc(OpCode::VARARG, 0, 1, 0);
+		break;
+	case AstNodeType::TableLiteral: constructor(node, v); break;
+	case AstNodeType::FunctionLiteral:
+		body(v,
+			 node->function_literal_.arg_list_,
+			 node->function_literal_.body_,
+			 false,
+			 node->first_token_,
+			 node->function_literal_.end_token_);
+		break;
+	case AstNodeType::VariableExpr: single_var(node->variable_expr_.token_, v); break;
+	case AstNodeType::ParenExpr:
+		// 括号把多返回值截断为一个
+		expr(node->paren_expr_.expression_, v);
+		discharge_vars(v);
+		break;
+	case AstNodeType::FieldExpr:
+	{
+		expr(node->field_expr_.base_, v);
+		exp_to_any_reg(v);
+		ExpDesc key;
+		key.k    = ExpKind::K;
+		key.info = string_constant(node->field_expr_.field_->source_);
+		indexed(v, key);
+		break;
+	}
+	case AstNodeType::IndexExpr:
+	{
+		expr(node->index_expr_.base_, v);
+		exp_to_any_reg(v);
+		ExpDesc key;
+		expr(node->index_expr_.index_, key);
+		exp_to_val(key);
+		indexed(v, key);
+		break;
+	}
+	case AstNodeType::MethodExpr:
+	{
+		expr(node->method_expr_.base_, v);
+		ExpDesc key;
+		key.k    = ExpKind::K;
+		key.info = string_constant(node->method_expr_.method_->source_);
+		self(v, key);
+		function_args(v, node->method_expr_.function_arguments_);
+		break;
+	}
+	case AstNodeType::CallExpr:
+		expr(node->call_expr_.base_, v);
+		exp_to_next_reg(v);
+		function_args(v, node->call_expr_.function_arguments_);
+		break;
+	case AstNodeType::NotExpr:
+		expr(node->not_expr_.rhs_, v);
+		code_not(v);
+		break;
+	case AstNodeType::NegativeExpr:
+	{
+		expr(node->negative_expr_.rhs_, v);
+		// 数值常量留给常量折叠
+		if (!is_numeral(v)) {
+			exp_to_any_reg(v);
+		}
+		ExpDesc e2;
+		e2.k = ExpKind::KNum;
+		code_arith(OpCode::UNM, v, e2);
+		break;
+	}
+	case AstNodeType::LengthExpr:
+	{
+		expr(node->length_expr_.rhs_, v);
+		exp_to_any_reg(v);
+		ExpDesc e2;
+		e2.k = ExpKind::KNum;
+		code_arith(OpCode::LEN, v, e2);
+		break;
+	}
+	case AstNodeType::AddExpr:
+	case AstNodeType::SubExpr:
+	case AstNodeType::MulExpr:
+	case AstNodeType::DivExpr:
+	case AstNodeType::PowExpr:
+	case AstNodeType::ModExpr:
+	case AstNodeType::ConcatExpr:
+	case AstNodeType::EqExpr:
+	case AstNodeType::NeqExpr:
+	case AstNodeType::LtExpr:
+	case AstNodeType::LeExpr:
+	case AstNodeType::GtExpr:
+	case AstNodeType::GeExpr:
+	case AstNodeType::AndExpr:
+	case AstNodeType::OrExpr:
+	{
+		// 所有二元表达式的 lhs_ 与 rhs_ 布局相同
+		expr(node->add_expr_.lhs_, v);
+		infix(node->type_, v);
+		ExpDesc v2;
+		expr(node->add_expr_.rhs_, v2);
+		posfix(node->type_, v, v2);
+		break;
+	}
+	default: error("unexpected expression");
+	}
+}
+
+void Compiler::block(AstNode* body)
+{
+	BlockCnt bl;
+	enter_block(bl, false);
+	chunk(body);
+	leave_block();
+}
+
+void Compiler::chunk(AstNode* body)
+{
+	for (AstNode* stat : body->stat_list_.statement_list_) {
+		statement(stat);
+		// 语句之间不保留临时寄存器
+		fs_->freereg = fs_->nactvar;
+	}
+}
+
+void Compiler::statement(AstNode* stat)
+{
+	line_ = line_of(stat->first_token_);
+	switch (stat->type_) {
+	case AstNodeType::IfStat: if_stat(stat); break;
+	case AstNodeType::WhileStat: while_stat(stat); break;
+	case AstNodeType::DoStat: block(stat->do_stat_.body_); break;
+	case AstNodeType::NumericForStat:
+	case AstNodeType::GenericForStat:
+	{
+		// 循环变量与控制变量的作用域，break 跳到它的结尾
+		BlockCnt bl;
+		enter_block(bl, true);
+		if (stat->type_ == AstNodeType::NumericForStat) {
+			numeric_for_stat(stat);
+		}
+		else {
+			generic_for_stat(stat);
+		}
+		leave_block();
+		break;
+	}
+	case AstNodeType::RepeatStat: repeat_stat(stat); break;
+	case AstNodeType::FunctionStat: function_stat(stat); break;
+	case AstNodeType::LocalFunctionStat: local_function_stat(stat); break;
+	case AstNodeType::LocalVarStat: local_var_stat(stat); break;
+	case AstNodeType::ReturnStat: return_stat(stat); break;
+	case AstNodeType::BreakStat: break_stat(); break;
+	case AstNodeType::CallExprStat:
+	{
+		ExpDesc v;
+		expr(stat->call_expr_stat_.expression_, v);
+		if (v.k != ExpKind::Call) {
+			error("syntax error");
+		}
+		// 调用语句不需要返回值
+		set_arg_c(get_code(v), 1);
+		break;
+	}
+	case AstNodeType::AssignmentStat:
+		assignment(stat->assignment_stat_.lhs_, stat->assignment_stat_.rhs_);
+		break;
+	case AstNodeType::GotoStat:
+	case AstNodeType::LabelStat: error("goto and labels are not supported in Lua 5.1");
+	default: error("unexpected statement");
+	}
+}
+
+void Compiler::assignment(Span<AstNode*>& lhs, Span<AstNode*>& rhs)
+{
+	std::vector<ExpDesc> vars(lhs.size());
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		expr(lhs[i], vars[i]);
+		const ExpKind k = vars[i].k;
+		if (k != ExpKind::Local && k != ExpKind::Upval && k != ExpKind::Global &&
+			k != ExpKind::Indexed) {
+			error("syntax error");
+		}
+		if (k != ExpKind::Local) {
+			continue;
+		}
+		// 先前的目标若用这个局部变量作表或键，赋值前要用它的副本
+		const int extra    = fs_->freereg;
+		bool      conflict = false;
+		for (size_t j = 0; j < i; ++j) {
+			if (vars[j].k != ExpKind::Indexed) {
+				continue;
+			}
+			if (vars[j].info == vars[i].info) {
+				conflict     = true;
+				vars[j].info = extra;
+			}
+			if (vars[j].aux == vars[i].info) {
+				conflict    = true;
+				vars[j].aux = extra;
+			}
+		}
+		if (conflict) {
+			code_abc(OpCode::MOVE, fs_->freereg, vars[i].info, 0);
+			reserve_regs(1);
+		}
+	}
+
+	const int nvars = static_cast<int>(vars.size());
+	ExpDesc   e;
+	const int nexps = explist(rhs, e);
+	if (nexps == nvars) {
+		set_one_ret(e);
+		store_var(vars.back(), e);
+	}
+	else {
+		adjust_assign(nvars, nexps, e);
+		if (nexps > nvars) {
+			// 丢弃多余的值
+			fs_->freereg -= nexps - nvars;
+		}
+		e      = ExpDesc{};
+		e.k    = ExpKind::NonReloc;
+		e.info = fs_->freereg - 1;
+		store_var(vars.back(), e);
+	}
+	// 其余的值从栈顶依次取出
+	for (int i = nvars - 2; i >= 0; --i) {
+		e      = ExpDesc{};
+		e.k    = ExpKind::NonReloc;
+		e.info = fs_->freereg - 1;
+		store_var(vars[i], e);
+	}
+}
+
+int Compiler::cond(AstNode* node)
+{
+	ExpDesc v;
+	expr(node, v);
+	// 条件中 nil 与 false 等价
+	if (v.k == ExpKind::Nil) {
+		v.k = ExpKind::False;
+	}
+	go_if_true(v);
+	return v.f;
+}
+
+void Compiler::break_stat()
+{
+	BlockCnt* bl    = fs_->bl;
+	bool      upval = false;
+	while (bl && !bl->is_breakable) {
+		upval |= bl->upval;
+		bl = bl->previous;
+	}
+	if (!bl) {
+		error("no loop to break");
+	}
+	if (upval) {
+		code_abc(OpCode::CLOSE, bl->nactvar, 0, 0);
+	}
+	concat(bl->break_list, jump());
+}
+
+void Compiler::while_stat(AstNode* stat)
+{
+	auto&     while_stat = stat->while_stat_;
+	const int while_init = get_label();
+	const int cond_exit  = cond(while_stat.condition_);
+	BlockCnt  bl;
+	enter_block(bl, true);
+	block(while_stat.body_);
+	patch_list(jump(), while_init);
+	leave_block();
+	// 条件为假时结束循环
+	patch_to_here(cond_exit);
+}
+
+void Compiler::repeat_stat(AstNode* stat)
+{
+	auto&     repeat_stat = stat->repeat_stat_;
+	const int repeat_init = get_label();
+	BlockCnt  loop_block;
+	BlockCnt  scope_block;
+	enter_block(loop_block, true);
+	enter_block(scope_block, false);
+	chunk(repeat_stat.body_);
+	// until 的条件可以看到循环体中的局部变量
+	const int cond_exit = cond(repeat_stat.condition_);
+	if (!scope_block.upval) {
+		leave_block();
+		patch_list(cond_exit, repeat_init);
+	}
+	else {
+		// 局部变量被闭包引用时，每次迭代都要先 CLOSE 再跳回开头
+		break_stat();
+		patch_to_here(cond_exit);
+		leave_block();
+		patch_list(jump(), repeat_init);
+	}
+	leave_block();
+}
+
+void Compiler::for_body(int base, int line, int nvars, bool is_num, AstNode* body)
+{
+	BlockCnt bl;
+	// 三个隐藏的控制变量
+	adjust_local_vars(3);
+	const int prep = is_num ? code_asbx(OpCode::FORPREP, base, NO_JUMP) : jump();
+	enter_block(bl, false);
+	adjust_local_vars(nvars);
+	reserve_regs(nvars);
+	block(body);
+	leave_block();
+	patch_to_here(prep);
+	const int end_for = is_num ? code_asbx(OpCode::FORLOOP, base, NO_JUMP)
+							   : code_abc(OpCode::TFORLOOP, base, 0, nvars);
+	fix_line(line);
+	patch_list(is_num ? end_for : jump(), prep + 1);
+}
+
+void Compiler::numeric_for_stat(AstNode* stat)
+{
+	auto&     for_stat = stat->numeric_for_stat_;
+	const int base     = fs_->freereg;
+	new_local_var("(for index)", 0);
+	new_local_var("(for limit)", 1);
+	new_local_var("(for step)", 2);
+	new_local_var(for_stat.var_list_[0]->source_, 3);
+	for (AstNode* range : for_stat.range_list_) {
+		ExpDesc e;
+		expr(range, e);
+		exp_to_next_reg(e);
+	}
+	// 默认步长为 1
+	if (for_stat.range_list_.size() == 2) {
+		code_abx(OpCode::LOADK, fs_->freereg, number_constant(1));
+		reserve_regs(1);
+	}
+	for_body(base, line_of(stat->first_token_), 1, true, for_stat.body_);
+}
+
+void Compiler::generic_for_stat(AstNode* stat)
+{
+	auto&     for_stat = stat->generic_for_stat_;
+	const int base     = fs_->freereg;
+	int       nvars    = 0;
+	new_local_var("(for generator)", nvars++);
+	new_local_var("(for state)", nvars++);
+	new_local_var("(for control)", nvars++);
+	for (const Token* var : for_stat.var_list_) {
+		new_local_var(var->source_, nvars++);
+	}
+	auto&     generators = for_stat.generator_list_;
+	const int line       = line_of(generators[0]->first_token_);
+	ExpDesc   e;
+	adjust_assign(3, explist(generators, e), e);
+	// 调用迭代器需要额外的空间
+	check_stack(3);
+	for_body(base, line, nvars - 3, false, for_stat.body_);
+}
+
+int Compiler::test_then_block(AstNode* condition, AstNode* body)
+{
+	const int cond_exit = cond(condition);
+	block(body);
+	return cond_exit;
+}
+
+void Compiler::if_stat(AstNode* stat)
+{
+	auto& if_stat     = stat->if_stat_;
+	int   escape_list = NO_JUMP;
+	int   false_list  = test_then_block(if_stat.condition_, if_stat.body_);
+	bool  has_else    = false;
+	for (auto& clause : if_stat.else_clauses_) {
+		concat(escape_list, jump());
+		patch_to_here(false_list);
+		line_ = line_of(clause.else_token_);
+		if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+			false_list = test_then_block(clause.else_if_clause_.condition_, clause.body_);
+		}
+		else {
+			block(clause.body_);
+			has_else = true;
+		}
+	}
+	if (!has_else) {
+		concat(escape_list, false_list);
+	}
+	patch_to_here(escape_list);
+}
+
+void Compiler::local_function_stat(AstNode* stat)
+{
+	AstNode* function = stat->local_function_stat_.function_stat_;
+	auto&    func     = function->function_stat_;
+	new_local_var(func.name_chain_[0]->source_, 0);
+	ExpDesc v;
+	v.k    = ExpKind::Local;
+	v.info = fs_->freereg;
+	reserve_regs(1);
+	// 函数体内可以引用自身
+	adjust_local_vars(1);
+	ExpDesc b;
+	body(b, func.arg_list_, func.body_, false, function->first_token_, func.end_token_);
+	store_var(v, b);
+	// 调试信息中的作用域从赋值之后开始
+	fs_->f->local_vars_[fs_->actvar[fs_->nactvar - 1]].start_pc_ = fs_->pc();
+}
+
+void Compiler::local_var_stat(AstNode* stat)
+{
+	auto& local_stat = stat->local_var_stat_;
+	int   nvars      = 0;
+	for (const Token* var : local_stat.var_list_) {
+		new_local_var(var->source_, nvars++);
+	}
+	ExpDesc e;
+	int     nexps = 0;
+	if (!local_stat.expr_list_.empty()) {
+		nexps = explist(local_stat.expr_list_, e);
+	}
+	adjust_assign(nvars, nexps, e);
+	// 初始化表达式中看不到正在声明的变量
+	adjust_local_vars(nvars);
+}
+
+void Compiler::function_stat(AstNode* stat)
+{
+	auto&     func       = stat->function_stat_;
+	auto&     name_chain = func.name_chain_;
+	const int line       = line_of(stat->first_token_);
+	ExpDesc   v;
+	single_var(name_chain[0], v);
+	for (size_t i = 1; i < name_chain.size(); ++i) {
+		exp_to_any_reg(v);
+		ExpDesc key;
+		key.k    = ExpKind::K;
+		key.info = string_constant(name_chain[i]->source_);
+		indexed(v, key);
+	}
+	ExpDesc b;
+	body(b, func.arg_list_, func.body_, stat->is_method_, stat->first_token_, func.end_token_);
+	store_var(v, b);
+	// 定义“发生”在 function 所在的行
+	fix_line(line);
+}
+
+void Compiler::return_stat(AstNode* stat)
+{
+	auto& exprs = stat->return_stat_.expr_list_;
+	int   first = 0;
+	int   nret  = 0;
+	if (!exprs.empty()) {
+		ExpDesc e;
+		nret = explist(exprs, e);
+		if (has_multret(e.k)) {
+			set_returns(e, MULTRET);
+			// return f() 改为尾调用
+			if (e.k == ExpKind::Call && nret == 1) {
+				set_opcode(get_code(e), OpCode::TAILCALL);
+			}
+			first = fs_->nactvar;
+			nret  = MULTRET;
+		}
+		else if (nret == 1) {
+			first = exp_to_any_reg(e);
+		}
+		else {
+			// 多个返回值必须在连续的寄存器中
+			exp_to_next_reg(e);
+			first = fs_->nactvar;
+		}
+	}
+	ret(first, nret);
+}
@@ -0,0 +1,779 @@
+#include "dl/constant_folder.h"
+#include "dl/ast.h"
+#include "dl/lua_literal.h"
+#include "dl/token.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace dl;
+
+// 2^53，超过它的整数不再能被 double 精确表示
+static constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+
+/**
+ * @brief 把字符串编码为带引号的 Lua 字面量，选用需要转义较少的引号
+ *
+ */
+static std::string encode_string(const std::string& value)
+{
+	size_t double_quotes = 0;
+	size_t single_quotes = 0;
+	for (const char c : value) {
+		double_quotes += c == '"';
+		single_quotes += c == '\'';
+	}
+	const char  quote = double_quotes > single_quotes ? '\'' : '"';
+	std::string text;
+	text.reserve(value.size() + 2);
+	text.push_back(quote);
+	for (size_t i = 0; i < value.size(); ++i) {
+		const auto c = static_cast<unsigned char>(value[i]);
+		switch (c) {
+		case '\\': text += "\\\\"; break;
+		case '\n': text += "\\n"; break;
+		case '\r': text += "\\r"; break;
+		case '\a': text += "\\a"; break;
+		case '\b': text += "\\b"; break;
+		case '\f': text += "\\f"; break;
+		case '\v': text += "\\v"; break;
+		default:
+		{
+			if (c == static_cast<unsigned char>(quote)) {
+				text.push_back('\\');
+				text.push_back(quote);
+			}
+			else if ((c < 0x20 && c != '\t') || c == 0x7f) {
+				// 十进制转义后面紧跟数字时必须写满三位
+				char buffer[8];
+				const bool next_is_digit = i + 1 < value.size() && is_digit_char(value[i + 1]);
+				std::snprintf(buffer, sizeof(buffer), next_is_digit ? "\\%03u" : "\\%u", c);
+				text += buffer;
+			}
+			else {
+				text.push_back(static_cast<char>(c));
+			}
+			break;
+		}
+		}
+	}
+	text.push_back(quote);
+	return text;
+}
+
+/**
+ * @brief 数字转字符串，与 Lua 5.1 的 lua_number2str（"%.14g"）一致，用于 .. 拼接
+ *
+ */
+static std::string number_to_string(double value)
+{
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "%.14g", value);
+	return buffer;
+}
+
+/**
+ * @brief 输出非负有限数的最短字面量，保证 strtod 能读回完全相同的值
+ *
+ */
+static std::string format_number(double value)
+{
+	char buffer[32];
+	for (int precision = 14; precision <= 17; ++precision) {
+		std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+		if (std::strtod(buffer, nullptr) == value) {
+			break;
+		}
+	}
+	std::string text = buffer;
+
+	// 1e+20 -> 1e20，1e-05 -> 1e-5
+	const auto e = text.find('e');
+	if (e != std::string::npos) {
+		std::string exponent = text.substr(e + 1);
+		const bool  negative = exponent[0] == '-';
+		if (exponent[0] == '+' || exponent[0] == '-') {
+			exponent.erase(0, 1);
+		}
+		exponent.erase(0, std::min(exponent.find_first_not_of('0'), exponent.size() - 1));
+		text = text.substr(0, e + 1) + (negative ? "-" : "") + exponent;
+	}
+	// 86400000 -> 864e5
+	else if (text.find('.') == std::string::npos) {
+		const auto last_non_zero = text.find_last_not_of('0');
+		const auto zeros         = text.size() - 1 - last_non_zero;
+		if (zeros >= 3) {
+			auto candidate = text.substr(0, last_non_zero + 1) + "e" + std::to_string(zeros);
+			if (candidate.size() < text.size()) {
+				text = std::move(candidate);
+			}
+		}
+	}
+	return text;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::fold_literal(const AstNode* expr)
+{
+	Constant value;
+	switch (expr->type_) {
+	case AstNodeType::NilLiteral: value.type_ = ConstantType::Nil; return value;
+	case AstNodeType::BooleanLiteral:
+		value.type_    = ConstantType::Boolean;
+		value.boolean_ = expr->first_token_->source_ == "true";
+		return value;
+	case AstNodeType::NumberLiteral:
+		value.type_ = ConstantType::Number;
+		if (parse_number_literal(expr->first_token_->source_, value.number_, true)) {
+			return value;
+		}
+		return std::nullopt;
+	case AstNodeType::StringLiteral:
+		value.type_ = ConstantType::String;
+		if (decode_string_literal(expr->first_token_->source_, value.string_, true)) {
+			return value;
+		}
+		return std::nullopt;
+	default: return std::nullopt;
+	}
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::apply_binop(const Constant& l,
+																	const Constant& r,
+																	AstNodeType     type)
+{
+	Constant result;
+	bool     folded = false;
+	switch (type) {
+	case AstNodeType::AddExpr:
+	case AstNodeType::SubExpr:
+	case AstNodeType::MulExpr:
+	case AstNodeType::DivExpr:
+	case AstNodeType::ModExpr:
+	case AstNodeType::PowExpr:
+	{
+		if (l.type_ != ConstantType::Number || r.type_ != ConstantType::Number) {
+			break;
+		}
+		const double a = l.number_;
+		const double b = r.number_;
+		double       v = 0;
+		folded         = true;
+		switch (type) {
+		case AstNodeType::AddExpr: v = a + b; break;
+		case AstNodeType::SubExpr: v = a - b; break;
+		case AstNodeType::MulExpr: v = a * b; break;
+		case AstNodeType::DivExpr:
+			folded = b != 0;
+			v      = folded ? a / b : 0;
+			break;
+		case AstNodeType::ModExpr:
+			// luai_nummod
+			folded = b != 0;
+			v      = folded ? a - std::floor(a / b) * b : 0;
+			break;
+		default:
+		{
+			// 乘方只折叠结果为精确整数的情况
+			if (a != std::floor(a) || b != std::floor(b) || b < 0 || b > 64) {
+				folded = false;
+				break;
+			}
+			v = 1;
+			for (int i = 0; i < static_cast<int>(b) && folded; ++i) {
+				v *= a;
+				folded = std::fabs(v) <= MAX_EXACT_INTEGER;
+			}
+			break;
+		}
+		}
+		if (folded && std::isfinite(v)) {
+			result.type_   = ConstantType::Number;
+			result.number_ = v;
+		}
+		else {
+			folded = false;
+		}
+		break;
+	}
+	case AstNodeType::ConcatExpr:
+	{
+		const auto to_string = [](const Constant& value, std::string& out) {
+			if (value.type_ == ConstantType::String) {
+				out += value.string_;
+				return true;
+			}
+			if (value.type_ == ConstantType::Number) {
+				out += number_to_string(value.number_);
+				return true;
+			}
+			return false;
+		};
+		result.type_ = ConstantType::String;
+		folded       = to_string(l, result.string_) && to_string(r, result.string_);
+		break;
+	}
+	case AstNodeType::EqExpr:
+	case AstNodeType::NeqExpr:
+	{
+		bool equal = l.type_ == r.type_;
+		if (equal) {
+			switch (l.type_) {
+			case ConstantType::Nil: break;
+			case ConstantType::Boolean: equal = l.boolean_ == r.boolean_; break;
+			case ConstantType::Number: equal = l.number_ == r.number_; break;
+			case ConstantType::String: equal = l.string_ == r.string_; break;
+			}
+		}
+		result.type_    = ConstantType::Boolean;
+		result.boolean_ = type == AstNodeType::EqExpr ? equal : !equal;
+		folded          = true;
+		break;
+	}
+	case AstNodeType::LtExpr:
+	case AstNodeType::LeExpr:
+	case AstNodeType::GtExpr:
+	case AstNodeType::GeExpr:
+	{
+		// 字符串的大小比较依赖 strcoll 与运行时的 locale，不折叠；不同类型比较会在运行时报错
+		if (l.type_ != ConstantType::Number || r.type_ != ConstantType::Number) {
+			break;
+		}
+		const double a  = l.number_;
+		const double b  = r.number_;
+		result.type_    = ConstantType::Boolean;
+		result.boolean_ = type == AstNodeType::LtExpr   ? a < b
+						  : type == AstNodeType::LeExpr ? a <= b
+						  : type == AstNodeType::GtExpr ? a > b
+														: a >= b;
+		folded          = true;
+		break;
+	}
+	case AstNodeType::AndExpr: return truthy(l) ? r : l;
+	case AstNodeType::OrExpr: return truthy(l) ? l : r;
+	default: break;
+	}
+	if (folded) {
+		return result;
+	}
+	return std::nullopt;
+}
+
+bool ConstantFolder::truthy(const Constant& value) noexcept
+{
+	return !(value.type_ == ConstantType::Nil ||
+			 (value.type_ == ConstantType::Boolean && !value.boolean_));
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::fold_binop(AstNode*& lhs, AstNode*& rhs,
+																   AstNodeType type)
+{
+	const auto l = fold(lhs);
+	const auto r = fold(rhs);
+
+	// and/or 只要左边是常量且能决定结果就可以折叠，右边本来就不会被求值
+	if (l && !r) {
+		if ((type == AstNodeType::AndExpr && !truthy(*l)) ||
+			(type == AstNodeType::OrExpr && truthy(*l))) {
+			return l;
+		}
+	}
+
+	if (l && r) {
+		if (auto result = apply_binop(*l, *r, type)) {
+			return result;
+		}
+	}
+
+	if (l) {
+		settle(lhs, *l);
+	}
+	if (r) {
+		settle(rhs, *r);
+	}
+	return std::nullopt;
+}
+
+bool ConstantFolder::binop_operands(const AstNode* expr, const AstNode*& lhs, const AstNode*& rhs)
+{
+	switch (expr->type_) {
+	case AstNodeType::AddExpr:
+		lhs = expr->add_expr_.lhs_;
+		rhs = expr->add_expr_.rhs_;
+		return true;
+	case AstNodeType::SubExpr:
+		lhs = expr->sub_expr_.lhs_;
+		rhs = expr->sub_expr_.rhs_;
+		return true;
+	case AstNodeType::MulExpr:
+		lhs = expr->mul_expr_.lhs_;
+		rhs = expr->mul_expr_.rhs_;
+		return true;
+	case AstNodeType::DivExpr:
+		lhs = expr->div_expr_.lhs_;
+		rhs = expr->div_expr_.rhs_;
+		return true;
+	case AstNodeType::PowExpr:
+		lhs = expr->pow_expr_.lhs_;
+		rhs = expr->pow_expr_.rhs_;
+		return true;
+	case AstNodeType::ModExpr:
+		lhs = expr->mod_expr_.lhs_;
+		rhs = expr->mod_expr_.rhs_;
+		return true;
+	case AstNodeType::ConcatExpr:
+		lhs = expr->concat_expr_.lhs_;
+		rhs = expr->concat_expr_.rhs_;
+		return true;
+	case AstNodeType::EqExpr:
+		lhs = expr->eq_expr_.lhs_;
+		rhs = expr->eq_expr_.rhs_;
+		return true;
+	case AstNodeType::NeqExpr:
+		lhs = expr->neq_expr_.lhs_;
+		rhs = expr->neq_expr_.rhs_;
+		return true;
+	case AstNodeType::LtExpr:
+		lhs = expr->lt_expr_.lhs_;
+		rhs = expr->lt_expr_.rhs_;
+		return true;
+	case AstNodeType::LeExpr:
+		lhs = expr->le_expr_.lhs_;
+		rhs = expr->le_expr_.rhs_;
+		return true;
+	case AstNodeType::GtExpr:
+		lhs = expr->gt_expr_.lhs_;
+		rhs = expr->gt_expr_.rhs_;
+		return true;
+	case AstNodeType::GeExpr:
+		lhs = expr->ge_expr_.lhs_;
+		rhs = expr->ge_expr_.rhs_;
+		return true;
+	case AstNodeType::AndExpr:
+		lhs = expr->and_expr_.lhs_;
+		rhs = expr->and_expr_.rhs_;
+		return true;
+	case AstNodeType::OrExpr:
+		lhs = expr->or_expr_.lhs_;
+		rhs = expr->or_expr_.rhs_;
+		return true;
+	default: return false;
+	}
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::evaluate(const AstNode*       expr,
+																 const VariableValue& variable)
+{
+	switch (expr->type_) {
+	case AstNodeType::NilLiteral:
+	case AstNodeType::BooleanLiteral:
+	case AstNodeType::NumberLiteral:
+	case AstNodeType::StringLiteral: return fold_literal(expr);
+	case AstNodeType::ParenExpr: return evaluate(expr->paren_expr_.expression_, variable);
+	case AstNodeType::NotExpr:
+	{
+		const auto value = evaluate(expr->not_expr_.rhs_, variable);
+		if (!value) {
+			return std::nullopt;
+		}
+		Constant result;
+		result.type_    = ConstantType::Boolean;
+		result.boolean_ = !truthy(*value);
+		return result;
+	}
+	case AstNodeType::NegativeExpr:
+	{
+		auto value = evaluate(expr->negative_expr_.rhs_, variable);
+		if (value && value->type_ == ConstantType::Number) {
+			value->number_ = -value->number_;
+			return value;
+		}
+		return std::nullopt;
+	}
+	case AstNodeType::VariableExpr: return variable ? variable(expr) : std::nullopt;
+	default:
+	{
+		const AstNode* lhs = nullptr;
+		const AstNode* rhs = nullptr;
+		if (!binop_operands(expr, lhs, rhs)) {
+			return std::nullopt;
+		}
+		const auto l = evaluate(lhs, variable);
+		if (!l) {
+			return std::nullopt;
+		}
+		// 左边已经决定 and/or 的结果时，右边不会被求值
+		if ((expr->type_ == AstNodeType::AndExpr && !truthy(*l)) ||
+			(expr->type_ == AstNodeType::OrExpr && truthy(*l))) {
+			return l;
+		}
+		const auto r = evaluate(rhs, variable);
+		if (!r) {
+			return std::nullopt;
+		}
+		return apply_binop(*l, *r, expr->type_);
+	}
+	}
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::fold(AstNode*& expr)
+{
+	switch (expr->type_) {
+	case AstNodeType::NilLiteral:
+	case AstNodeType::BooleanLiteral:
+	case AstNodeType::NumberLiteral:
+	case AstNodeType::StringLiteral: return fold_literal(expr);
+	// 常量只有一个值，括号不改变它
+	case AstNodeType::ParenExpr: return fold(expr->paren_expr_.expression_);
+	case AstNodeType::NotExpr:
+	{
+		const auto value = fold(expr->not_expr_.rhs_);
+		if (!value) {
+			return std::nullopt;
+		}
+		Constant result;
+		result.type_    = ConstantType::Boolean;
+		result.boolean_ = value->type_ == ConstantType::Nil ||
+						  (value->type_ == ConstantType::Boolean && !value->boolean_);
+		return result;
+	}
+	case AstNodeType::NegativeExpr:
+	{
+		auto value = fold(expr->negative_expr_.rhs_);
+		if (value && value->type_ == ConstantType::Number) {
+			value->number_ = -value->number_;
+			return value;
+		}
+		if (value) {
+			settle(expr->negative_expr_.rhs_, *value);
+		}
+		return std::nullopt;
+	}
+	case AstNodeType::LengthExpr: fold_and_settle(expr->length_expr_.rhs_); return std::nullopt;
+	case AstNodeType::AddExpr:
+		return fold_binop(expr->add_expr_.lhs_, expr->add_expr_.rhs_, expr->type_);
+	case AstNodeType::SubExpr:
+		return fold_binop(expr->sub_expr_.lhs_, expr->sub_expr_.rhs_, expr->type_);
+	case AstNodeType::MulExpr:
+		return fold_binop(expr->mul_expr_.lhs_, expr->mul_expr_.rhs_, expr->type_);
+	case AstNodeType::DivExpr:
+		return fold_binop(expr->div_expr_.lhs_, expr->div_expr_.rhs_, expr->type_);
+	case AstNodeType::PowExpr:
+		return fold_binop(expr->pow_expr_.lhs_, expr->pow_expr_.rhs_, expr->type_);
+	case AstNodeType::ModExpr:
+		return fold_binop(expr->mod_expr_.lhs_, expr->mod_expr_.rhs_, expr->type_);
+	case AstNodeType::ConcatExpr:
+		return fold_binop(expr->concat_expr_.lhs_, expr->concat_expr_.rhs_, expr->type_);
+	case AstNodeType::EqExpr:
+		return fold_binop(expr->eq_expr_.lhs_, expr->eq_expr_.rhs_, expr->type_);
+	case AstNodeType::NeqExpr:
+		return fold_binop(expr->neq_expr_.lhs_, expr->neq_expr_.rhs_, expr->type_);
+	case AstNodeType::LtExpr:
+		return fold_binop(expr->lt_expr_.lhs_, expr->lt_expr_.rhs_, expr->type_);
+	case AstNodeType::LeExpr:
+		return fold_binop(expr->le_expr_.lhs_, expr->le_expr_.rhs_, expr->type_);
+	case AstNodeType::GtExpr:
+		return fold_binop(expr->gt_expr_.lhs_, expr->gt_expr_.rhs_, expr->type_);
+	case AstNodeType::GeExpr:
+		return fold_binop(expr->ge_expr_.lhs_, expr->ge_expr_.rhs_, expr->type_);
+	case AstNodeType::AndExpr:
+		return fold_binop(expr->and_expr_.lhs_, expr->and_expr_.rhs_, expr->type_);
+	case AstNodeType::OrExpr:
+		return fold_binop(expr->or_expr_.lhs_, expr->or_expr_.rhs_, expr->type_);
+	case AstNodeType::TableLiteral:
+	{
+		for (auto& entry : expr->table_literal_.entry_list_) {
+			switch (entry.type_) {
+			case AstNode::TableEntryType::Index:
+				fold_and_settle(entry.index_entry_.index_);
+				fold_and_settle(entry.index_entry_.value_);
+				break;
+			case AstNode::TableEntryType::Field: fold_and_settle(entry.field_entry_.value_); break;
+			case AstNode::TableEntryType::Value: fold_and_settle(entry.value_entry_.value_); break;
+			}
+		}
+		return std::nullopt;
+	}
+	case AstNodeType::FunctionLiteral: fold_stat(expr->function_literal_.body_); return std::nullopt;
+	case AstNodeType::ArgCall: fold_and_settle(expr->arg_call_.arg_list_); return std::nullopt;
+	case AstNodeType::TableCall: fold(expr->table_call_.table_expr_); return std::nullopt;
+	case AstNodeType::FieldExpr: fold_prefix(expr->field_expr_.base_); return std::nullopt;
+	case AstNodeType::MethodExpr:
+		fold_prefix(expr->method_expr_.base_);
+		fold(expr->method_expr_.function_arguments_);
+		return std::nullopt;
+	case AstNodeType::IndexExpr:
+		fold_prefix(expr->index_expr_.base_);
+		fold_and_settle(expr->index_expr_.index_);
+		return std::nullopt;
+	case AstNodeType::CallExpr:
+		fold_prefix(expr->call_expr_.base_);
+		fold(expr->call_expr_.function_arguments_);
+		return std::nullopt;
+	default: return std::nullopt;
+	}
+}
+
+void ConstantFolder::fold_prefix(AstNode*& expr)
+{
+	// ("abc"):rep(2) 的括号不能去掉
+	if (expr->type_ == AstNodeType::ParenExpr) {
+		fold_and_settle(expr->paren_expr_.expression_);
+	}
+	else {
+		fold(expr);
+	}
+}
+
+void ConstantFolder::fold_and_settle(AstNode*& expr)
+{
+	if (const auto value = fold(expr)) {
+		settle(expr, *value);
+	}
+}
+
+void ConstantFolder::fold_and_settle(Span<AstNode*>& exprs)
+{
+	for (auto& expr : exprs) {
+		fold_and_settle(expr);
+	}
+}
+
+void ConstantFolder::settle(AstNode*& expr, const Constant& value)
+{
+	const auto type = expr->type_;
+	// 已经是字面量的不再改写
+	if (type == AstNodeType::NilLiteral || type == AstNodeType::BooleanLiteral ||
+		type == AstNodeType::NumberLiteral || type == AstNodeType::StringLiteral ||
+		(type == AstNodeType::NegativeExpr &&
+		 expr->negative_expr_.rhs_->type_ == AstNodeType::NumberLiteral)) {
+		return;
+	}
+
+	// 负数换掉括号后可能改变优先级，如 (1-2)^x，此时保留括号
+	const bool negative = value.type_ == ConstantType::Number && std::signbit(value.number_);
+	if (!(type == AstNodeType::ParenExpr && negative)) {
+		size_t literal_length = 0;
+		switch (value.type_) {
+		case ConstantType::Nil: literal_length = 3; break;
+		case ConstantType::Boolean: literal_length = value.boolean_ ? 4 : 5; break;
+		case ConstantType::Number:
+			literal_length = format_number(std::fabs(value.number_)).size() + negative;
+			break;
+		case ConstantType::String: literal_length = encode_string(value.string_).size(); break;
+		}
+		if (literal_length <= printed_length(expr)) {
+			expr = make_literal(value, expr->first_token_->line_);
+			return;
+		}
+	}
+
+	// 字面量更长，退而分别处理子表达式
+	switch (type) {
+	case AstNodeType::ParenExpr: settle(expr->paren_expr_.expression_, value); break;
+	case AstNodeType::NotExpr: fold_and_settle(expr->not_expr_.rhs_); break;
+	case AstNodeType::NegativeExpr: fold_and_settle(expr->negative_expr_.rhs_); break;
+	case AstNodeType::AddExpr:
+		fold_and_settle(expr->add_expr_.lhs_);
+		fold_and_settle(expr->add_expr_.rhs_);
+		break;
+	case AstNodeType::SubExpr:
+		fold_and_settle(expr->sub_expr_.lhs_);
+		fold_and_settle(expr->sub_expr_.rhs_);
+		break;
+	case AstNodeType::MulExpr:
+		fold_and_settle(expr->mul_expr_.lhs_);
+		fold_and_settle(expr->mul_expr_.rhs_);
+		break;
+	case AstNodeType::DivExpr:
+		fold_and_settle(expr->div_expr_.lhs_);
+		fold_and_settle(expr->div_expr_.rhs_);
+		break;
+	case AstNodeType::PowExpr:
+		fold_and_settle(expr->pow_expr_.lhs_);
+		fold_and_settle(expr->pow_expr_.rhs_);
+		break;
+	case AstNodeType::ModExpr:
+		fold_and_settle(expr->mod_expr_.lhs_);
+		fold_and_settle(expr->mod_expr_.rhs_);
+		break;
+	case AstNodeType::ConcatExpr:
+		fold_and_settle(expr->concat_expr_.lhs_);
+		fold_and_settle(expr->concat_expr_.rhs_);
+		break;
+	case AstNodeType::EqExpr:
+		fold_and_settle(expr->eq_expr_.lhs_);
+		fold_and_settle(expr->eq_expr_.rhs_);
+		break;
+	case AstNodeType::NeqExpr:
+		fold_and_settle(expr->neq_expr_.lhs_);
+		fold_and_settle(expr->neq_expr_.rhs_);
+		break;
+	case AstNodeType::LtExpr:
+		fold_and_settle(expr->lt_expr_.lhs_);
+		fold_and_settle(expr->lt_expr_.rhs_);
+		break;
+	case AstNodeType::LeExpr:
+		fold_and_settle(expr->le_expr_.lhs_);
+		fold_and_settle(expr->le_expr_.rhs_);
+		break;
+	case AstNodeType::GtExpr:
+		fold_and_settle(expr->gt_expr_.lhs_);
+		fold_and_settle(expr->gt_expr_.rhs_);
+		break;
+	case AstNodeType::GeExpr:
+		fold_and_settle(expr->ge_expr_.lhs_);
+		fold_and_settle(expr->ge_expr_.rhs_);
+		break;
+	case AstNodeType::AndExpr:
+		fold_and_settle(expr->and_expr_.lhs_);
+		fold_and_settle(expr->and_expr_.rhs_);
+		break;
+	case AstNodeType::OrExpr:
+		fold_and_settle(expr->or_expr_.lhs_);
+		fold_and_settle(expr->or_expr_.rhs_);
+		break;
+	default: break;
+	}
+}
+
+AstNode* ConstantFolder::make_literal(const Constant& value, std::size_t line)
+{
+	switch (value.type_) {
+	case ConstantType::Nil:
+		return nodes_.emplace(AstNode::NilLiteral{},
+							  &tokens_.emplace_back("nil", line, TokenType::Keyword));
+	case ConstantType::Boolean:
+		return nodes_.emplace(
+			AstNode::BooleanLiteral{},
+			&tokens_.emplace_back(value.boolean_ ? "true" : "false", line, TokenType::Keyword));
+	case ConstantType::String:
+		return nodes_.emplace(
+			AstNode::StringLiteral{},
+			&tokens_.emplace_back(
+				texts_.emplace_back(encode_string(value.string_)), line, TokenType::String));
+	case ConstantType::Number:
+	default:
+	{
+		auto literal = nodes_.emplace(
+			AstNode::NumberLiteral{},
+			&tokens_.emplace_back(texts_.emplace_back(format_number(std::fabs(value.number_))),
+								  line,
+								  TokenType::Number));
+		if (!std::signbit(value.number_)) {
+			return literal;
+		}
+		return nodes_.emplace(AstNode::NegativeExpr{literal},
+							  &tokens_.emplace_back("-", line, TokenType::Symbol));
+	}
+	}
+}
+
+size_t ConstantFolder::printed_length(const AstNode* expr)
+{
+	switch (expr->type_) {
+	case AstNodeType::NilLiteral:
+	case AstNodeType::BooleanLiteral:
+	case AstNodeType::NumberLiteral:
+	case AstNodeType::StringLiteral: return expr->first_token_->source_.size();
+	case AstNodeType::ParenExpr: return 2 + printed_length(expr->paren_expr_.expression_);
+	case AstNodeType::NotExpr: return 4 + printed_length(expr->not_expr_.rhs_);
+	case AstNodeType::NegativeExpr: return 1 + printed_length(expr->negative_expr_.rhs_);
+	case AstNodeType::AddExpr:
+		return 1 + printed_length(expr->add_expr_.lhs_) + printed_length(expr->add_expr_.rhs_);
+	case AstNodeType::SubExpr:
+		return 1 + printed_length(expr->sub_expr_.lhs_) + printed_length(expr->sub_expr_.rhs_);
+	case AstNodeType::MulExpr:
+		return 1 + printed_length(expr->mul_expr_.lhs_) + printed_length(expr->mul_expr_.rhs_);
+	case AstNodeType::DivExpr:
+		return 1 + printed_length(expr->div_expr_.lhs_) + printed_length(expr->div_expr_.rhs_);
+	case AstNodeType::PowExpr:
+		return 1 + printed_length(expr->pow_expr_.lhs_) + printed_length(expr->pow_expr_.rhs_);
+	case AstNodeType::ModExpr:
+		return 1 + printed_length(expr->mod_expr_.lhs_) + printed_length(expr->mod_expr_.rhs_);
+	case AstNodeType::ConcatExpr:
+		return 2 + printed_length(expr->concat_expr_.lhs_) +
+			   printed_length(expr->concat_expr_.rhs_);
+	case AstNodeType::EqExpr:
+		return 2 + printed_length(expr->eq_expr_.lhs_) + printed_length(expr->eq_expr_.rhs_);
+	case AstNodeType::NeqExpr:
+		return 2 + printed_length(expr->neq_expr_.lhs_) + printed_length(expr->neq_expr_.rhs_);
+	case AstNodeType::LtExpr:
+		return 1 + printed_length(expr->lt_expr_.lhs_) + printed_length(expr->lt_expr_.rhs_);
+	case AstNodeType::LeExpr:
+		return 2 + printed_length(expr->le_expr_.lhs_) + printed_length(expr->le_expr_.rhs_);
+	case AstNodeType::GtExpr:
+		return 1 + printed_length(expr->gt_expr_.lhs_) + printed_length(expr->gt_expr_.rhs_);
+	case AstNodeType::GeExpr:
+		return 2 + printed_length(expr->ge_expr_.lhs_) + printed_length(expr->ge_expr_.rhs_);
+	case AstNodeType::AndExpr:
+		return 5 + printed_length(expr->and_expr_.lhs_) + printed_length(expr->and_expr_.rhs_);
+	case AstNodeType::OrExpr:
+		return 4 + printed_length(expr->or_expr_.lhs_) + printed_length(expr->or_expr_.rhs_);
+	// and/or 短路时被丢弃的一侧可能是任意表达式，按较长估计
+	default: return 16;
+	}
+}
+
+void ConstantFolder::fold_stat(AstNode* stat)
+{
+	switch (stat->type_) {
+	case AstNodeType::StatList:
+	{
+		for (auto child : stat->stat_list_.statement_list_) {
+			fold_stat(child);
+		}
+		break;
+	}
+	case AstNodeType::CallExprStat: fold(stat->call_expr_stat_.expression_); break;
+	case AstNodeType::AssignmentStat:
+		fold_and_settle(stat->assignment_stat_.lhs_);
+		fold_and_settle(stat->assignment_stat_.rhs_);
+		break;
+	case AstNodeType::IfStat:
+	{
+		auto& node = stat->if_stat_;
+		fold_and_settle(node.condition_);
+		fold_stat(node.body_);
+		for (auto& clause : node.else_clauses_) {
+			if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+				fold_and_settle(clause.else_if_clause_.condition_);
+			}
+			fold_stat(clause.body_);
+		}
+		break;
+	}
+	case AstNodeType::DoStat: fold_stat(stat->do_stat_.body_); break;
+	case AstNodeType::WhileStat:
+		fold_and_settle(stat->while_stat_.condition_);
+		fold_stat(stat->while_stat_.body_);
+		break;
+	case AstNodeType::NumericForStat:
+		fold_and_settle(stat->numeric_for_stat_.range_list_);
+		fold_stat(stat->numeric_for_stat_.body_);
+		break;
+	case AstNodeType::GenericForStat:
+		fold_and_settle(stat->generic_for_stat_.generator_list_);
+		fold_stat(stat->generic_for_stat_.body_);
+		break;
+	case AstNodeType::RepeatStat:
+		fold_stat(stat->repeat_stat_.body_);
+		fold_and_settle(stat->repeat_stat_.condition_);
+		break;
+	case AstNodeType::LocalFunctionStat:
+		fold_stat(stat->local_function_stat_.function_stat_->function_stat_.body_);
+		break;
+	case AstNodeType::FunctionStat: fold_stat(stat->function_stat_.body_); break;
+	case AstNodeType::LocalVarStat: fold_and_settle(stat->local_var_stat_.expr_list_); break;
+	case AstNodeType::ReturnStat: fold_and_settle(stat->return_stat_.expr_list_); break;
+	default: break;
+	}
+}
+
+ConstantFolder::ConstantFolder(AstNode* root)
+{
+	fold_stat(root);
+}
@@ -0,0 +1,389 @@
+#include "dl/dead_code_stripper.h"
+#include "dl/ast.h"
+#include "dl/constant_folder.h"
+#include "dl/token.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace dl;
+
+bool DeadCodeStripper::is_local(std::string_view name) const
+{
+	return std::find(locals_.begin(), locals_.end(), name) != locals_.end();
+}
+
+bool DeadCodeStripper::name_chain(const AstNode* expr, std::string& chain)
+{
+	switch (expr->type_) {
+	case AstNodeType::VariableExpr: chain += expr->variable_expr_.token_->source_; return true;
+	case AstNodeType::FieldExpr:
+		if (!name_chain(expr->field_expr_.base_, chain)) {
+			return false;
+		}
+		chain += '.';
+		chain += expr->field_expr_.field_->source_;
+		return true;
+	default: return false;
+	}
+}
+
+bool DeadCodeStripper::is_stripped_call(const AstNode* expr) const
+{
+	std::string chain;
+	if (expr->type_ == AstNodeType::CallExpr) {
+		if (!name_chain(expr->call_expr_.base_, chain)) {
+			return false;
+		}
+	}
+	else if (expr->type_ == AstNodeType::MethodExpr) {
+		if (!name_chain(expr->method_expr_.base_, chain)) {
+			return false;
+		}
+		chain += ':';
+		chain += expr->method_expr_.method_->source_;
+	}
+	else {
+		return false;
+	}
+	return calls_.count(chain) != 0;
+}
+
+std::optional<bool> DeadCodeStripper::truthiness(const AstNode* expr) const
+{
+	// 与 ConstantFolder 用同一套求值，1 == 2 这类折叠后不更短、因而没被改写的条件也能判断
+	const auto value = ConstantFolder::evaluate(expr, [this](const AstNode* variable) {
+		std::optional<ConstantFolder::Constant> value;
+		const auto                              name = variable->variable_expr_.token_->source_;
+		const auto                              it   = defines_.find(std::string(name));
+		if (it != defines_.end() && !is_local(name)) {
+			value.emplace();
+			value->type_    = ConstantFolder::ConstantType::Boolean;
+			value->boolean_ = it->second;
+		}
+		return value;
+	});
+	if (!value) {
+		return std::nullopt;
+	}
+	return ConstantFolder::truthy(*value);
+}
+
+bool DeadCodeStripper::strip_if(AstNode*& stat)
+{
+	auto& node    = stat->if_stat_;
+	auto& clauses = node.else_clauses_;
+
+	// 先处理 elseif：恒假的删掉，恒真的变成 else 并截断其后的分支
+	for (size_t i = 0; i < clauses.size();) {
+		auto& clause = clauses[i];
+		if (clause.type_ != AstNode::ElseClauseType::ElseIfClause) {
+			break;
+		}
+		const auto value = truthiness(clause.else_if_clause_.condition_);
+		if (value && !*value) {
+			clauses.erase(clauses.begin() + i);
+			continue;
+		}
+		if (value && *value) {
+			clauses.erase(clauses.begin() + i + 1, clauses.end());
+			clause = AstNode::IfStat::GeneralElseClause(
+				AstNode::IfStat::ElseClause{},
+				clause.body_,
+				&tokens_.emplace_back("else", clause.else_token_->line_, TokenType::Keyword));
+			break;
+		}
+		++i;
+	}
+
+	// 再处理 if：恒假时由下一个分支顶上
+	while (true) {
+		const auto value = truthiness(node.condition_);
+		if (!value) {
+			return false;
+		}
+		AstNode* body = nullptr;
+		if (*value) {
+			body = node.body_;
+		}
+		else if (clauses.empty()) {
+			return true;
+		}
+		else if (clauses.front().type_ == AstNode::ElseClauseType::ElseIfClause) {
+			node.condition_ = clauses.front().else_if_clause_.condition_;
+			node.body_      = clauses.front().body_;
+			clauses.erase(clauses.begin());
+			continue;
+		}
+		else {
+			body = clauses.front().body_;
+		}
+		// 留下的分支可能声明局部变量，用 do ... end 保住它的作用域
+		stat = nodes_.emplace(
+			AstNode::DoStat{body, node.end_token_},
+			&tokens_.emplace_back("do", stat->first_token_->line_, TokenType::Keyword));
+		return false;
+	}
+}
+
+bool DeadCodeStripper::strip_stat(AstNode*& stat)
+{
+	switch (stat->type_) {
+	case AstNodeType::StatList:
+	{
+		auto&  list = stat->stat_list_.statement_list_;
+		size_t kept = 0;
+		for (size_t i = 0; i < list.size(); ++i) {
+			AstNode* child = list[i];
+			if (!strip_stat(child)) {
+				list[kept++] = child;
+			}
+		}
+		list.truncate(kept);
+		break;
+	}
+	case AstNodeType::CallExprStat:
+	{
+		if (is_stripped_call(stat->call_expr_stat_.expression_)) {
+			return true;
+		}
+		strip_expr(stat->call_expr_stat_.expression_);
+		break;
+	}
+	case AstNodeType::AssignmentStat:
+		strip_exprs(stat->assignment_stat_.rhs_);
+		strip_exprs(stat->assignment_stat_.lhs_);
+		break;
+	case AstNodeType::IfStat:
+	{
+		if (strip_branches_ && strip_if(stat)) {
+			return true;
+		}
+		// 整条 if 可能已被换成 do 语句
+		if (stat->type_ == AstNodeType::DoStat) {
+			return strip_stat(stat);
+		}
+		auto& node = stat->if_stat_;
+		strip_expr(node.condition_);
+		strip_block(node.body_);
+		for (auto& clause : node.else_clauses_) {
+			if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+				strip_expr(clause.else_if_clause_.condition_);
+			}
+			strip_block(clause.body_);
+		}
+		break;
+	}
+	case AstNodeType::DoStat:
+		strip_block(stat->do_stat_.body_);
+		return stat->do_stat_.body_->type_ == AstNodeType::StatList &&
+			   stat->do_stat_.body_->stat_list_.statement_list_.empty();
+	case AstNodeType::WhileStat:
+		strip_expr(stat->while_stat_.condition_);
+		strip_block(stat->while_stat_.body_);
+		break;
+	case AstNodeType::NumericForStat:
+	{
+		auto& node = stat->numeric_for_stat_;
+		strip_exprs(node.range_list_);
+		enter_scope();
+		for (auto var : node.var_list_) {
+			declare(var->source_);
+		}
+		strip_stat(node.body_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::GenericForStat:
+	{
+		auto& node = stat->generic_for_stat_;
+		strip_exprs(node.generator_list_);
+		enter_scope();
+		for (auto var : node.var_list_) {
+			declare(var->source_);
+		}
+		strip_stat(node.body_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::RepeatStat:
+	{
+		// until 的条件仍能看到循环体内声明的局部变量
+		enter_scope();
+		strip_stat(stat->repeat_stat_.body_);
+		strip_expr(stat->repeat_stat_.condition_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::LocalFunctionStat:
+	{
+		auto& function_stat = stat->local_function_stat_.function_stat_->function_stat_;
+		declare(function_stat.name_chain_[0]->source_);
+		strip_function(function_stat.arg_list_, function_stat.body_, false);
+		break;
+	}
+	case AstNodeType::FunctionStat:
+	{
+		auto& node = stat->function_stat_;
+		strip_function(node.arg_list_, node.body_, stat->is_method_);
+		break;
+	}
+	case AstNodeType::LocalVarStat:
+	{
+		auto& node = stat->local_var_stat_;
+		strip_exprs(node.expr_list_);
+		for (auto var : node.var_list_) {
+			declare(var->source_);
+		}
+		break;
+	}
+	case AstNodeType::ReturnStat: strip_exprs(stat->return_stat_.expr_list_); break;
+	default: break;
+	}
+	return false;
+}
+
+void DeadCodeStripper::strip_block(AstNode* body)
+{
+	enter_scope();
+	strip_stat(body);
+	exit_scope();
+}
+
+void DeadCodeStripper::strip_function(Span<Token*>& args, AstNode* body, bool is_method)
+{
+	enter_scope();
+	if (is_method) {
+		declare("self");
+	}
+	for (auto arg : args) {
+		declare(arg->source_);
+	}
+	strip_stat(body);
+	exit_scope();
+}
+
+void DeadCodeStripper::strip_exprs(Span<AstNode*>& exprs)
+{
+	for (auto expr : exprs) {
+		strip_expr(expr);
+	}
+}
+
+void DeadCodeStripper::strip_expr(AstNode* expr)
+{
+	// 表达式本身不会被删除，只需找到其中的函数体
+	switch (expr->type_) {
+	case AstNodeType::ParenExpr: strip_expr(expr->paren_expr_.expression_); break;
+	case AstNodeType::TableLiteral:
+	{
+		for (auto& entry : expr->table_literal_.entry_list_) {
+			switch (entry.type_) {
+			case AstNode::TableEntryType::Index:
+				strip_expr(entry.index_entry_.index_);
+				strip_expr(entry.index_entry_.value_);
+				break;
+			case AstNode::TableEntryType::Field: strip_expr(entry.field_entry_.value_); break;
+			case AstNode::TableEntryType::Value: strip_expr(entry.value_entry_.value_); break;
+			}
+		}
+		break;
+	}
+	case AstNodeType::FunctionLiteral:
+	{
+		auto& node = expr->function_literal_;
+		strip_function(node.arg_list_, node.body_, false);
+		break;
+	}
+	case AstNodeType::ArgCall: strip_exprs(expr->arg_call_.arg_list_); break;
+	case AstNodeType::TableCall: strip_expr(expr->table_call_.table_expr_); break;
+	case AstNodeType::FieldExpr: strip_expr(expr->field_expr_.base_); break;
+	case AstNodeType::MethodExpr:
+		strip_expr(expr->method_expr_.base_);
+		strip_expr(expr->method_expr_.function_arguments_);
+		break;
+	case AstNodeType::IndexExpr:
+		strip_expr(expr->index_expr_.base_);
+		strip_expr(expr->index_expr_.index_);
+		break;
+	case AstNodeType::CallExpr:
+		strip_expr(expr->call_expr_.base_);
+		strip_expr(expr->call_expr_.function_arguments_);
+		break;
+	case AstNodeType::NotExpr: strip_expr(expr->not_expr_.rhs_); break;
+	case AstNodeType::NegativeExpr: strip_expr(expr->negative_expr_.rhs_); break;
+	case AstNodeType::LengthExpr: strip_expr(expr->length_expr_.rhs_); break;
+	case AstNodeType::AddExpr:
+		strip_expr(expr->add_expr_.lhs_);
+		strip_expr(expr->add_expr_.rhs_);
+		break;
+	case AstNodeType::SubExpr:
+		strip_expr(expr->sub_expr_.lhs_);
+		strip_expr(expr->sub_expr_.rhs_);
+		break;
+	case AstNodeType::MulExpr:
+		strip_expr(expr->mul_expr_.lhs_);
+		strip_expr(expr->mul_expr_.rhs_);
+		break;
+	case AstNodeType::DivExpr:
+		strip_expr(expr->div_expr_.lhs_);
+		strip_expr(expr->div_expr_.rhs_);
+		break;
+	case AstNodeType::PowExpr:
+		strip_expr(expr->pow_expr_.lhs_);
+		strip_expr(expr->pow_expr_.rhs_);
+		break;
+	case AstNodeType::ModExpr:
+		strip_expr(expr->mod_expr_.lhs_);
+		strip_expr(expr->mod_expr_.rhs_);
+		break;
+	case AstNodeType::ConcatExpr:
+		strip_expr(expr->concat_expr_.lhs_);
+		strip_expr(expr->concat_expr_.rhs_);
+		break;
+	case AstNodeType::EqExpr:
+		strip_expr(expr->eq_expr_.lhs_);
+		strip_expr(expr->eq_expr_.rhs_);
+		break;
+	case AstNodeType::NeqExpr:
+		strip_expr(expr->neq_expr_.lhs_);
+		strip_expr(expr->neq_expr_.rhs_);
+		break;
+	case AstNodeType::LtExpr:
+		strip_expr(expr->lt_expr_.lhs_);
+		strip_expr(expr->lt_expr_.rhs_);
+		break;
+	case AstNodeType::LeExpr:
+		strip_expr(expr->le_expr_.lhs_);
+		strip_expr(expr->le_expr_.rhs_);
+		break;
+	case AstNodeType::GtExpr:
+		strip_expr(expr->gt_expr_.lhs_);
+		strip_expr(expr->gt_expr_.rhs_);
+		break;
+	case AstNodeType::GeExpr:
+		strip_expr(expr->ge_expr_.lhs_);
+		strip_expr(expr->ge_expr_.rhs_);
+		break;
+	case AstNodeType::AndExpr:
+		strip_expr(expr->and_expr_.lhs_);
+		strip_expr(expr->and_expr_.rhs_);
+		break;
+	case AstNodeType::OrExpr:
+		strip_expr(expr->or_expr_.lhs_);
+		strip_expr(expr->or_expr_.rhs_);
+		break;
+	default: break;
+	}
+}
+
+DeadCodeStripper::DeadCodeStripper(AstNode* root, const std::vector<std::string>& calls,
+								   const std::unordered_map<std::string, bool>& defines,
+								   bool                                         strip_branches)
+	: calls_(calls.begin(), calls.end())
+	, defines_(defines)
+	, strip_branches_(strip_branches)
+{
+	strip_block(root);
+}
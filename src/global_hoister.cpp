@@ -0,0 +1,580 @@
+#include "dl/global_hoister.h"
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace dl;
+
+// Lua 5.1 的 LUAI_MAXVARS 与 LUAI_MAXUPVALUES
+static constexpr size_t MAX_LOCALS   = 200;
+static constexpr size_t MAX_UPVALUES = 60;
+
+// 标准库中的全局函数
+static const std::unordered_set<std::string_view> STD_FUNCTIONS = {
+	"assert",   "collectgarbage", "dofile",       "error",  "getmetatable", "ipairs",
+	"load",     "loadfile",       "loadstring",   "next",   "pairs",        "pcall",
+	"print",    "rawequal",       "rawget",       "rawset", "require",      "select",
+	"setmetatable", "tonumber",   "tostring",     "type",   "unpack",       "xpcall"};
+
+// 字段可以提升的标准库表
+static const std::unordered_set<std::string_view> STD_LIBRARIES = {
+	"coroutine", "io", "math", "os", "string", "table"};
+
+// 能改变函数环境的全局函数，出现时不做任何提升
+static const std::unordered_set<std::string_view> ENVIRONMENT_FUNCTIONS = {
+	"getfenv", "module", "setfenv"};
+
+void GlobalHoister::enter_scope()
+{
+	scope_marks_.push_back(scope_stack_.size());
+}
+
+void GlobalHoister::exit_scope()
+{
+	const size_t mark = scope_marks_.back();
+	scope_marks_.pop_back();
+	for (size_t i = mark; i < scope_stack_.size(); ++i) {
+		if (scope_stack_[i].function_depth_ == 0) {
+			--main_locals_;
+		}
+	}
+	scope_stack_.resize(mark);
+}
+
+void GlobalHoister::declare(std::string_view name)
+{
+	const size_t depth = function_stack_.size() - 1;
+	scope_stack_.push_back(Variable{name, depth, next_variable_id_++});
+	names_.insert(name);
+	if (depth == 0) {
+		++main_locals_;
+		max_main_locals_ = std::max(max_main_locals_, main_locals_);
+	}
+}
+
+bool GlobalHoister::reference(std::string_view name)
+{
+	names_.insert(name);
+	for (auto it = scope_stack_.rbegin(); it != scope_stack_.rend(); ++it) {
+		if (it->name_ != name) {
+			continue;
+		}
+		// 在声明它的函数与当前函数之间的每一层函数中，它都是上值
+		for (size_t depth = it->function_depth_ + 1; depth < function_stack_.size(); ++depth) {
+			upvalues_[function_stack_[depth]].insert(it->id_);
+		}
+		return false;
+	}
+	if (ENVIRONMENT_FUNCTIONS.count(name)) {
+		unsafe_ = true;
+	}
+	return true;
+}
+
+bool GlobalHoister::is_hoistable(std::string_view global, std::string_view field) const
+{
+	if (field.empty()) {
+		return STD_FUNCTIONS.count(global) || extra_globals_.count(std::string(global));
+	}
+	return STD_LIBRARIES.count(global) ||
+		   extra_globals_.count(std::string(global) + "." + std::string(field));
+}
+
+void GlobalHoister::add_site(AstNode** site, std::string_view global, std::string_view field)
+{
+	if (!is_hoistable(global, field)) {
+		return;
+	}
+	std::string key(global);
+	if (!field.empty()) {
+		key += '.';
+		key += field;
+	}
+	auto [it, inserted] = candidate_index_.try_emplace(key, candidates_.size());
+	if (inserted) {
+		auto& candidate   = candidates_.emplace_back();
+		candidate.global_ = global;
+		candidate.field_  = field;
+	}
+	auto& candidate = candidates_[it->second];
+	candidate.sites_.push_back(site);
+	if (loop_depth_ > 0) {
+		++candidate.loop_uses_;
+	}
+	for (size_t depth = 1; depth < function_stack_.size(); ++depth) {
+		candidate.functions_.insert(function_stack_[depth]);
+	}
+}
+
+void GlobalHoister::visit_target(AstNode*& target)
+{
+	switch (target->type_) {
+	case AstNodeType::VariableExpr:
+	{
+		const auto name = target->variable_expr_.token_->source_;
+		if (reference(name)) {
+			written_.emplace(name);
+			if (name == "_G") {
+				unsafe_ = true;
+			}
+		}
+		break;
+	}
+	case AstNodeType::FieldExpr:
+	{
+		auto& node = target->field_expr_;
+		if (node.base_->type_ != AstNodeType::VariableExpr) {
+			visit_expr(node.base_);
+			break;
+		}
+		const auto name = node.base_->variable_expr_.token_->source_;
+		if (reference(name)) {
+			// _G.x = ... 等价于给全局变量 x 赋值
+			if (name == "_G") {
+				written_.emplace(node.field_->source_);
+			}
+			else {
+				written_.emplace(std::string(name) + "." + std::string(node.field_->source_));
+			}
+		}
+		break;
+	}
+	case AstNodeType::IndexExpr:
+	{
+		auto& node = target->index_expr_;
+		if (node.base_->type_ == AstNodeType::VariableExpr) {
+			const auto name = node.base_->variable_expr_.token_->source_;
+			if (reference(name)) {
+				if (name == "_G") {
+					unsafe_ = true;
+				}
+				// 无法确定写入哪个字段，视为整张表的字段都被改写
+				written_.emplace(std::string(name) + ".*");
+			}
+		}
+		else {
+			visit_expr(node.base_);
+		}
+		visit_expr(node.index_);
+		break;
+	}
+	default: visit_expr(target); break;
+	}
+}
+
+void GlobalHoister::visit_exprs(Span<AstNode*>& exprs)
+{
+	for (auto& expr : exprs) {
+		visit_expr(expr);
+	}
+}
+
+void GlobalHoister::visit_expr(AstNode*& expr)
+{
+	switch (expr->type_) {
+	case AstNodeType::ParenExpr: visit_expr(expr->paren_expr_.expression_); break;
+	case AstNodeType::VariableExpr:
+	{
+		const auto name = expr->variable_expr_.token_->source_;
+		if (reference(name)) {
+			// _G 作为值传出去后可能被用来改写任何全局变量
+			if (name == "_G") {
+				unsafe_ = true;
+			}
+			add_site(&expr, name, {});
+		}
+		break;
+	}
+	case AstNodeType::TableLiteral:
+	{
+		for (auto& entry : expr->table_literal_.entry_list_) {
+			switch (entry.type_) {
+			case AstNode::TableEntryType::Index:
+				visit_expr(entry.index_entry_.index_);
+				visit_expr(entry.index_entry_.value_);
+				break;
+			case AstNode::TableEntryType::Field: visit_expr(entry.field_entry_.value_); break;
+			case AstNode::TableEntryType::Value: visit_expr(entry.value_entry_.value_); break;
+			}
+		}
+		break;
+	}
+	case AstNodeType::FunctionLiteral:
+	{
+		auto& node = expr->function_literal_;
+		visit_function(node.arg_list_, node.body_, false);
+		break;
+	}
+	case AstNodeType::ArgCall: visit_exprs(expr->arg_call_.arg_list_); break;
+	case AstNodeType::TableCall: visit_expr(expr->table_call_.table_expr_); break;
+	case AstNodeType::FieldExpr:
+	{
+		auto& node = expr->field_expr_;
+		if (node.base_->type_ != AstNodeType::VariableExpr) {
+			visit_expr(node.base_);
+			break;
+		}
+		const auto name = node.base_->variable_expr_.token_->source_;
+		if (!reference(name) || name == "_G") {
+			break;
+		}
+		if (is_hoistable(name, node.field_->source_)) {
+			add_site(&expr, name, node.field_->source_);
+		}
+		else {
+			add_site(&node.base_, name, {});
+		}
+		break;
+	}
+	case AstNodeType::MethodExpr:
+		visit_expr(expr->method_expr_.base_);
+		visit_expr(expr->method_expr_.function_arguments_);
+		break;
+	case AstNodeType::IndexExpr:
+	{
+		auto& node = expr->index_expr_;
+		// _G[k] 只是读取，不影响提升
+		if (!(node.base_->type_ == AstNodeType::VariableExpr &&
+			  node.base_->variable_expr_.token_->source_ == "_G" &&
+			  reference(node.base_->variable_expr_.token_->source_))) {
+			visit_expr(node.base_);
+		}
+		visit_expr(node.index_);
+		break;
+	}
+	case AstNodeType::CallExpr:
+		visit_expr(expr->call_expr_.base_);
+		visit_expr(expr->call_expr_.function_arguments_);
+		break;
+	case AstNodeType::NotExpr: visit_expr(expr->not_expr_.rhs_); break;
+	case AstNodeType::NegativeExpr: visit_expr(expr->negative_expr_.rhs_); break;
+	case AstNodeType::LengthExpr: visit_expr(expr->length_expr_.rhs_); break;
+	case AstNodeType::AddExpr:
+		visit_expr(expr->add_expr_.lhs_);
+		visit_expr(expr->add_expr_.rhs_);
+		break;
+	case AstNodeType::SubExpr:
+		visit_expr(expr->sub_expr_.lhs_);
+		visit_expr(expr->sub_expr_.rhs_);
+		break;
+	case AstNodeType::MulExpr:
+		visit_expr(expr->mul_expr_.lhs_);
+		visit_expr(expr->mul_expr_.rhs_);
+		break;
+	case AstNodeType::DivExpr:
+		visit_expr(expr->div_expr_.lhs_);
+		visit_expr(expr->div_expr_.rhs_);
+		break;
+	case AstNodeType::PowExpr:
+		visit_expr(expr->pow_expr_.lhs_);
+		visit_expr(expr->pow_expr_.rhs_);
+		break;
+	case AstNodeType::ModExpr:
+		visit_expr(expr->mod_expr_.lhs_);
+		visit_expr(expr->mod_expr_.rhs_);
+		break;
+	case AstNodeType::ConcatExpr:
+		visit_expr(expr->concat_expr_.lhs_);
+		visit_expr(expr->concat_expr_.rhs_);
+		break;
+	case AstNodeType::EqExpr:
+		visit_expr(expr->eq_expr_.lhs_);
+		visit_expr(expr->eq_expr_.rhs_);
+		break;
+	case AstNodeType::NeqExpr:
+		visit_expr(expr->neq_expr_.lhs_);
+		visit_expr(expr->neq_expr_.rhs_);
+		break;
+	case AstNodeType::LtExpr:
+		visit_expr(expr->lt_expr_.lhs_);
+		visit_expr(expr->lt_expr_.rhs_);
+		break;
+	case AstNodeType::LeExpr:
+		visit_expr(expr->le_expr_.lhs_);
+		visit_expr(expr->le_expr_.rhs_);
+		break;
+	case AstNodeType::GtExpr:
+		visit_expr(expr->gt_expr_.lhs_);
+		visit_expr(expr->gt_expr_.rhs_);
+		break;
+	case AstNodeType::GeExpr:
+		visit_expr(expr->ge_expr_.lhs_);
+		visit_expr(expr->ge_expr_.rhs_);
+		break;
+	case AstNodeType::AndExpr:
+		visit_expr(expr->and_expr_.lhs_);
+		visit_expr(expr->and_expr_.rhs_);
+		break;
+	case AstNodeType::OrExpr:
+		visit_expr(expr->or_expr_.lhs_);
+		visit_expr(expr->or_expr_.rhs_);
+		break;
+	default: break;
+	}
+}
+
+void GlobalHoister::visit_block(AstNode* body)
+{
+	enter_scope();
+	visit_stat(body);
+	exit_scope();
+}
+
+void GlobalHoister::visit_function(Span<Token*>& args, AstNode* body, bool is_method)
+{
+	function_stack_.push_back(static_cast<FunctionId>(upvalues_.size()));
+	upvalues_.emplace_back();
+	// 函数体是否在循环中执行取决于调用方，按函数自身的循环重新计数
+	const size_t loop_depth = loop_depth_;
+	loop_depth_             = 0;
+	enter_scope();
+	if (is_method) {
+		declare("self");
+	}
+	for (auto arg : args) {
+		if (arg->source_ != "...") {
+			declare(arg->source_);
+		}
+	}
+	visit_stat(body);
+	exit_scope();
+	loop_depth_ = loop_depth;
+	function_stack_.pop_back();
+}
+
+void GlobalHoister::visit_stat(AstNode* stat)
+{
+	switch (stat->type_) {
+	case AstNodeType::StatList:
+	{
+		for (auto child : stat->stat_list_.statement_list_) {
+			visit_stat(child);
+		}
+		break;
+	}
+	case AstNodeType::CallExprStat: visit_expr(stat->call_expr_stat_.expression_); break;
+	case AstNodeType::AssignmentStat:
+	{
+		visit_exprs(stat->assignment_stat_.rhs_);
+		for (auto& target : stat->assignment_stat_.lhs_) {
+			visit_target(target);
+		}
+		break;
+	}
+	case AstNodeType::IfStat:
+	{
+		auto& node = stat->if_stat_;
+		visit_expr(node.condition_);
+		visit_block(node.body_);
+		for (auto& clause : node.else_clauses_) {
+			if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+				visit_expr(clause.else_if_clause_.condition_);
+			}
+			visit_block(clause.body_);
+		}
+		break;
+	}
+	case AstNodeType::DoStat: visit_block(stat->do_stat_.body_); break;
+	case AstNodeType::WhileStat:
+		visit_expr(stat->while_stat_.condition_);
+		++loop_depth_;
+		visit_block(stat->while_stat_.body_);
+		--loop_depth_;
+		break;
+	case AstNodeType::NumericForStat:
+	{
+		auto& node = stat->numeric_for_stat_;
+		visit_exprs(node.range_list_);
+		++loop_depth_;
+		enter_scope();
+		// 循环内部使用的三个隐藏变量
+		declare("(for index)");
+		declare("(for limit)");
+		declare("(for step)");
+		for (auto var : node.var_list_) {
+			declare(var->source_);
+		}
+		visit_stat(node.body_);
+		exit_scope();
+		--loop_depth_;
+		break;
+	}
+	case AstNodeType::GenericForStat:
+	{
+		auto& node = stat->generic_for_stat_;
+		visit_exprs(node.generator_list_);
+		++loop_depth_;
+		enter_scope();
+		declare("(for generator)");
+		declare("(for state)");
+		declare("(for control)");
+		for (auto var : node.var_list_) {
+			declare(var->source_);
+		}
+		visit_stat(node.body_);
+		exit_scope();
+		--loop_depth_;
+		break;
+	}
+	case AstNodeType::RepeatStat:
+	{
+		++loop_depth_;
+		enter_scope();
+		visit_stat(stat->repeat_stat_.body_);
+		visit_expr(stat->repeat_stat_.condition_);
+		exit_scope();
+		--loop_depth_;
+		break;
+	}
+	case AstNodeType::LocalFunctionStat:
+	{
+		auto& function_stat = stat->local_function_stat_.function_stat_->function_stat_;
+		declare(function_stat.name_chain_[0]->source_);
+		visit_function(function_stat.arg_list_, function_stat.body_, false);
+		break;
+	}
+	case AstNodeType::FunctionStat:
+	{
+		// function a() 给 a 赋值，function a.b() 与 function a:b() 给 a.b 赋值
+		auto&      node = stat->function_stat_;
+		const auto name = node.name_chain_[0]->source_;
+		if (reference(name)) {
+			if (node.name_chain_.size() == 1) {
+				written_.emplace(name);
+			}
+			else if (name == "_G") {
+				written_.emplace(node.name_chain_[1]->source_);
+			}
+			else {
+				written_.emplace(std::string(name) + "." +
+								 std::string(node.name_chain_[1]->source_));
+			}
+		}
+		visit_function(node.arg_list_, node.body_, stat->is_method_);
+		break;
+	}
+	case AstNodeType::LocalVarStat:
+	{
+		auto& node = stat->local_var_stat_;
+		visit_exprs(node.expr_list_);
+		for (auto var : node.var_list_) {
+			declare(var->source_);
+		}
+		break;
+	}
+	case AstNodeType::ReturnStat: visit_exprs(stat->return_stat_.expr_list_); break;
+	default: break;
+	}
+}
+
+std::string_view GlobalHoister::alias_name(const std::string& base)
+{
+	std::string name = base;
+	for (size_t suffix = 1; names_.count(name) || is_keyword(name); ++suffix) {
+		name = base + "_" + std::to_string(suffix);
+	}
+	const auto& text = texts_.emplace_back(std::move(name));
+	names_.insert(text);
+	return text;
+}
+
+void GlobalHoister::hoist(AstNode* root)
+{
+	if (unsafe_ || root->type_ != AstNodeType::StatList) {
+		return;
+	}
+
+	// 只引用一次且不在循环中的全局变量不值得占用一个局部变量
+	std::vector<Candidate*> chosen;
+	for (auto& candidate : candidates_) {
+		const std::string global(candidate.global_);
+		if (written_.count(global)) {
+			continue;
+		}
+		if (!candidate.field_.empty() &&
+			(written_.count(global + "." + std::string(candidate.field_)) ||
+			 written_.count(global + ".*"))) {
+			continue;
+		}
+		if (candidate.sites_.size() < 2 && candidate.loop_uses_ == 0) {
+			continue;
+		}
+		chosen.push_back(&candidate);
+	}
+	std::stable_sort(chosen.begin(), chosen.end(), [](const Candidate* a, const Candidate* b) {
+		if (a->loop_uses_ != b->loop_uses_) {
+			return a->loop_uses_ > b->loop_uses_;
+		}
+		return a->sites_.size() > b->sites_.size();
+	});
+
+	// 别名是主函数的局部变量，也是引用它的函数的上值
+	std::unordered_map<FunctionId, size_t> added_upvalues;
+	size_t                                 added_locals = 0;
+	std::vector<Token*>                    vars;
+	std::vector<AstNode*>                  exprs;
+	for (auto candidate : chosen) {
+		if (max_main_locals_ + added_locals + 1 > MAX_LOCALS) {
+			break;
+		}
+		const bool fits = std::all_of(
+			candidate->functions_.begin(), candidate->functions_.end(), [&](FunctionId id) {
+				return upvalues_[id].size() + added_upvalues[id] + 1 <= MAX_UPVALUES;
+			});
+		if (!fits) {
+			continue;
+		}
+		for (auto id : candidate->functions_) {
+			++added_upvalues[id];
+		}
+		++added_locals;
+
+		auto global = nodes_.emplace(AstNode::VariableExpr{
+			&tokens_.emplace_back(candidate->global_, 1, TokenType::Identifier)});
+		// 全局变量本身用同名局部变量遮蔽即可，引用处不必改写
+		if (candidate->field_.empty()) {
+			vars.push_back(&tokens_.emplace_back(candidate->global_, 1, TokenType::Identifier));
+			exprs.push_back(global);
+			continue;
+		}
+		const auto alias =
+			alias_name(std::string(candidate->global_) + "_" + std::string(candidate->field_));
+		vars.push_back(&tokens_.emplace_back(alias, 1, TokenType::Identifier));
+		exprs.push_back(nodes_.emplace(
+			AstNode::FieldExpr{global,
+							   &tokens_.emplace_back(candidate->field_, 1, TokenType::Identifier)},
+			global->first_token_));
+		for (auto site : candidate->sites_) {
+			*site = nodes_.emplace(AstNode::VariableExpr{
+				&tokens_.emplace_back(alias, (*site)->first_token_->line_, TokenType::Identifier)});
+		}
+	}
+	if (vars.empty()) {
+		return;
+	}
+
+	// Span 不能增长，在新列表里把声明放到最前面
+	auto&                 old = root->stat_list_.statement_list_;
+	std::vector<AstNode*> statements;
+	statements.reserve(old.size() + 1);
+	statements.push_back(nodes_.emplace(
+		AstNode::LocalVarStat{spans_.copy(vars.data(), vars.size()),
+							  spans_.copy(exprs.data(), exprs.size())},
+		&tokens_.emplace_back("local", 1, TokenType::Keyword)));
+	statements.insert(statements.end(), old.begin(), old.end());
+	old = spans_.copy(statements.data(), statements.size());
+}
+
+GlobalHoister::GlobalHoister(AstNode* root, const std::vector<std::string>& extra_globals)
+	: extra_globals_(extra_globals.begin(), extra_globals.end())
+{
+	function_stack_.push_back(0);
+	upvalues_.emplace_back();
+	visit_block(root);
+	hoist(root);
+}
@@ -0,0 +1,669 @@
+#include "dl/io_engine.h"
+#include "dl/output_sink.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#	include <fcntl.h>
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <sys/uio.h>
+#	include <unistd.h>
+#endif
+
+using namespace dl;
+
+namespace {
+std::string read_file(const std::string& path, std::string& content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return "Failed to open file: " + path;
+	}
+	file.seekg(0, std::ios::end);
+	content.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	if (!content.empty() && !file.read(&content[0], static_cast<std::streamsize>(content.size()))) {
+		content.clear();
+		return "Failed to read file: " + path;
+	}
+	return {};
+}
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point started)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+									 std::chrono::steady_clock::now() - started)
+									 .count());
+}
+
+#ifdef __linux__
+/**
+ * @brief 直接用系统调用操作的 io_uring 实例，只提供这里用到的提交与收割
+ */
+class Ring
+{
+public:
+	static constexpr unsigned ENTRIES = 64;
+
+	Ring() = default;
+	~Ring()
+	{
+		if (sqes_) {
+			munmap(sqes_, sqes_size_);
+		}
+		if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+			munmap(cq_ptr_, cq_size_);
+		}
+		if (sq_ptr_) {
+			munmap(sq_ptr_, sq_size_);
+		}
+		if (fd_ >= 0) {
+			close(fd_);
+		}
+	}
+	Ring(const Ring&)            = delete;
+	Ring& operator=(const Ring&) = delete;
+
+	/**
+	 * @brief 创建并映射队列，内核不支持或被禁用时返回 errno
+	 */
+	int Init()
+	{
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+		fd_ = static_cast<int>(syscall(__NR_io_uring_setup, ENTRIES, &params));
+		if (fd_ < 0) {
+			return errno;
+		}
+		sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		// 新内核中两个队列共用一次映射
+		const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (single) {
+			sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+		}
+		sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+		if (!sq_ptr_) {
+			return errno;
+		}
+		cq_ptr_ = single ? sq_ptr_ : map(cq_size_, IORING_OFF_CQ_RING);
+		if (!cq_ptr_) {
+			return errno;
+		}
+		sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+		sqes_      = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+		if (!sqes_) {
+			return errno;
+		}
+		auto* sq   = static_cast<char*>(sq_ptr_);
+		auto* cq   = static_cast<char*>(cq_ptr_);
+		sq_head_   = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sq_tail_   = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask_   = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array_  = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		sq_count_  = params.sq_entries;
+		cq_head_   = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail_   = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask_   = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes_      = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		local_tail_ = *sq_tail_;
+		return 0;
+	}
+
+	/**
+	 * @brief 取一个空的提交项，队列满时返回空
+	 */
+	io_uring_sqe* GetSqe() noexcept
+	{
+		const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+		if (local_tail_ - head >= sq_count_) {
+			return nullptr;
+		}
+		const unsigned index = local_tail_ & sq_mask_;
+		sq_array_[index]     = index;
+		++local_tail_;
+		++pending_;
+		io_uring_sqe* sqe = &sqes_[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		return sqe;
+	}
+
+	/**
+	 * @brief 提交取出的提交项，并等待至少 wait 个完成，返回 0 或 errno
+	 */
+	int Submit(unsigned wait) noexcept
+	{
+		__atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+		while (true) {
+			const long submitted = syscall(__NR_io_uring_enter,
+										   fd_,
+										   pending_,
+										   wait,
+										   wait ? IORING_ENTER_GETEVENTS : 0u,
+										   nullptr,
+										   0);
+			if (submitted >= 0) {
+				pending_ -= static_cast<unsigned>(submitted);
+				return 0;
+			}
+			if (errno != EINTR) {
+				return errno;
+			}
+		}
+	}
+
+	/**
+	 * @brief 收回已填好但还没提交给内核的提交项，从后往前依次交给 handler
+	 */
+	template<typename Handler> void Reclaim(Handler handler)
+	{
+		for (; pending_ > 0; --pending_) {
+			--local_tail_;
+			handler(static_cast<const io_uring_sqe&>(sqes_[sq_array_[local_tail_ & sq_mask_]]));
+		}
+		__atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+	}
+
+	template<typename Handler> void Reap(Handler handler)
+	{
+		unsigned       head = *cq_head_;
+		const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			handler(cqes_[head & cq_mask_]);
+		}
+		__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+	}
+
+private:
+	void* map(size_t size, off_t offset) noexcept
+	{
+		void* ptr =
+			mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+		return ptr == MAP_FAILED ? nullptr : ptr;
+	}
+
+	int           fd_        = -1;
+	void*         sq_ptr_    = nullptr;
+	void*         cq_ptr_    = nullptr;
+	size_t        sq_size_   = 0;
+	size_t        cq_size_   = 0;
+	io_uring_sqe* sqes_      = nullptr;
+	size_t        sqes_size_ = 0;
+	unsigned*     sq_head_   = nullptr;
+	unsigned*     sq_tail_   = nullptr;
+	unsigned*     sq_array_  = nullptr;
+	unsigned      sq_mask_   = 0;
+	unsigned      sq_count_  = 0;
+	unsigned*     cq_head_   = nullptr;
+	unsigned*     cq_tail_   = nullptr;
+	unsigned      cq_mask_   = 0;
+	io_uring_cqe* cqes_      = nullptr;
+	// 已填好但还没提交的提交项
+	unsigned      local_tail_ = 0;
+	unsigned      pending_    = 0;
+};
+
+/**
+ * @brief io_uring 中一次未完成的读或写，读写不完整时从 done 处接着提交
+ */
+struct UringOp
+{
+	bool        write = false;
+	int         fd    = -1;
+	std::string path;
+	std::string data;
+	size_t      done = 0;
+	iovec       iov{};
+};
+
+std::string errno_message(const char* action, const std::string& path, int error)
+{
+	return fmt::format("{} file: {} ({})", action, path, std::strerror(error));
+}
+
+#endif
+}   // namespace
+
+struct IoEngine::State
+{
+	// 提前读入的文件数上限
+	static constexpr size_t READ_AHEAD_FILES = 64;
+	// 提前读入与排队写入的默认字节数上限
+	static constexpr size_t DEFAULT_BUFFER_BYTES = 64 * 1024 * 1024;
+	// 读完待取的文件少于这个数时，线程池先读后写
+	static constexpr size_t READ_LOW_WATER = 8;
+	// 线程池后端的线程数，读写以等待为主，不必与核数相同
+	static constexpr int IO_THREADS = 4;
+
+	struct WriteJob
+	{
+		std::string path;
+		std::string content;
+	};
+
+	std::vector<std::string> paths;
+	const char*              backend_name = "threads";
+	// 提前读入的字节数上限，排队与正在写的字节数上限
+	size_t                   read_ahead_bytes  = DEFAULT_BUFFER_BYTES;
+	size_t                   write_queue_bytes = DEFAULT_BUFFER_BYTES;
+
+	std::mutex              mutex;
+	// 有文件读完，或所有文件都已取走
+	std::condition_variable ready_cv;
+	// 后台有新活：读入窗口空出、有写入排队或要停止
+	std::condition_variable work_cv;
+	// 排队写入的字节数降下来了
+	std::condition_variable space_cv;
+
+	// 下一个要读的文件、正在读的文件数与已取走的文件数
+	size_t           next_read = 0;
+	size_t           reading   = 0;
+	size_t           taken     = 0;
+	std::deque<File> ready;
+	size_t           ready_bytes = 0;
+
+	std::deque<WriteJob> writes;
+	size_t               write_bytes = 0;
+	bool                 stop        = false;
+
+	// 有文件在读的墙钟时间，同时读的几个文件只算一次；read_since 为 reading 由 0 变 1 的时刻
+	uint64_t                              read_ns = 0;
+	std::chrono::steady_clock::time_point read_since;
+	// 处理线程在 Next 中等待的累计耗时
+	uint64_t                              wait_ns = 0;
+
+	std::vector<std::pair<std::string, std::string>> failures;
+	std::vector<std::thread>                         threads;
+
+	void RunThreads();
+#ifdef __linux__
+	void RunUring(Ring& ring);
+#endif
+
+	// 以下在持有 mutex 时调用
+	bool CanRead() const noexcept
+	{
+		return !stop && next_read < paths.size() && ready.size() + reading < READ_AHEAD_FILES &&
+			   ready_bytes < read_ahead_bytes;
+	}
+
+	// 取下一个要读的文件
+	size_t StartRead()
+	{
+		if (reading++ == 0) {
+			read_since = std::chrono::steady_clock::now();
+		}
+		return next_read++;
+	}
+
+	void Deliver(File&& file)
+	{
+		if (--reading == 0) {
+			read_ns += elapsed_ns(read_since);
+		}
+		ready_bytes += file.content.size();
+		ready.push_back(std::move(file));
+		ready_cv.notify_one();
+	}
+
+	void Written(const std::string& path, size_t size, std::string error)
+	{
+		write_bytes -= size;
+		if (!error.empty()) {
+			failures.emplace_back(path, std::move(error));
+		}
+		space_cv.notify_all();
+	}
+};
+
+/**
+ * @brief 线程池后端：每个线程取一个读或写，阻塞完成后再取下一个
+ */
+void IoEngine::State::RunThreads()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		const bool read_first = ready.size() < READ_LOW_WATER;
+		if (CanRead() && (read_first || writes.empty())) {
+			IoEngine::File file;
+			file.path = paths[StartRead()];
+			lock.unlock();
+			file.error = read_file(file.path, file.content);
+			lock.lock();
+			Deliver(std::move(file));
+		}
+		else if (!writes.empty()) {
+			auto job = std::move(writes.front());
+			writes.pop_front();
+			lock.unlock();
+			std::string error;
+			try {
+				write_file(job.path, job.content);
+			}
+			catch (const std::exception& e) {
+				error = e.what();
+			}
+			lock.lock();
+			Written(job.path, job.content.size(), std::move(error));
+		}
+		else if (stop) {
+			return;
+		}
+		else {
+			work_cv.wait(lock);
+		}
+	}
+}
+
+#ifdef __linux__
+/**
+ * @brief io_uring 后端：一个线程同步打开文件，读写成批提交给内核，完成后关闭
+ */
+void IoEngine::State::RunUring(Ring& ring)
+{
+	std::vector<std::unique_ptr<UringOp>> queued;
+	size_t                                in_flight = 0;
+
+	// 读写结束后交回结果，调用时不持有锁
+	const auto finish = [&](std::unique_ptr<UringOp> op, std::string error) {
+		if (op->fd >= 0 && close(op->fd) != 0 && error.empty()) {
+			const char* action = op->write ? "Failed to write" : "Failed to read";
+			error              = errno_message(action, op->path, errno);
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (op->write) {
+			Written(op->path, op->data.size(), std::move(error));
+		}
+		else {
+			if (!error.empty()) {
+				op->data.clear();
+			}
+			Deliver({std::move(op->path), std::move(op->data), std::move(error)});
+		}
+	};
+
+	// 收割一个完成项，被打断或读写不完整的放回 queued
+	const auto reap = [&](const io_uring_cqe& cqe) {
+		std::unique_ptr<UringOp> op(reinterpret_cast<UringOp*>(cqe.user_data));
+		--in_flight;
+		if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+			queued.push_back(std::move(op));
+			return;
+		}
+		if (cqe.res < 0) {
+			const char* action = op->write ? "Failed to write" : "Failed to read";
+			std::string error  = errno_message(action, op->path, -cqe.res);
+			finish(std::move(op), std::move(error));
+			return;
+		}
+		op->done += static_cast<size_t>(cqe.res);
+		if (cqe.res == 0 && !op->write) {
+			// 文件在读的过程中变短了
+			op->data.resize(op->done);
+		}
+		if (op->done < op->data.size()) {
+			queued.push_back(std::move(op));
+			return;
+		}
+		finish(std::move(op), {});
+	};
+
+	// 不经 io_uring，用阻塞的 pread/pwrite 读写完剩下的部分
+	const auto finish_blocking = [&](std::unique_ptr<UringOp> op) {
+		std::string error;
+		while (op->done < op->data.size()) {
+			char*         data   = op->data.data() + op->done;
+			const size_t  size   = op->data.size() - op->done;
+			const off_t   offset = static_cast<off_t>(op->done);
+			const ssize_t count  = op->write ? pwrite(op->fd, data, size, offset)
+											 : pread(op->fd, data, size, offset);
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+			if (count < 0 || (count == 0 && op->write)) {
+				const char* action = op->write ? "Failed to write" : "Failed to read";
+				error              = errno_message(action, op->path, count < 0 ? errno : EIO);
+				break;
+			}
+			if (count == 0) {
+				op->data.resize(op->done);
+				break;
+			}
+			op->done += static_cast<size_t>(count);
+		}
+		finish(std::move(op), std::move(error));
+	};
+
+	while (true) {
+		// 在队列容量内取新的读写
+		std::vector<size_t>   batch_reads;
+		std::vector<WriteJob> batch_writes;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (in_flight + queued.size() + batch_reads.size() + batch_writes.size() <
+				   Ring::ENTRIES) {
+				if (CanRead()) {
+					batch_reads.push_back(StartRead());
+				}
+				else if (!writes.empty()) {
+					batch_writes.push_back(std::move(writes.front()));
+					writes.pop_front();
+				}
+				else {
+					break;
+				}
+			}
+			if (in_flight == 0 && queued.empty() && batch_reads.empty() && batch_writes.empty()) {
+				if (stop) {
+					return;
+				}
+				work_cv.wait(lock);
+				continue;
+			}
+		}
+
+		for (const size_t index : batch_reads) {
+			auto op  = std::make_unique<UringOp>();
+			op->path = paths[index];
+			op->fd   = open(op->path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (op->fd < 0) {
+				finish(std::move(op), "Failed to open file: " + paths[index]);
+				continue;
+			}
+			struct stat info;
+			if (fstat(op->fd, &info) != 0) {
+				finish(std::move(op), errno_message("Failed to read", paths[index], errno));
+				continue;
+			}
+			op->data.resize(static_cast<size_t>(info.st_size));
+			if (op->data.empty()) {
+				finish(std::move(op), {});
+				continue;
+			}
+			queued.push_back(std::move(op));
+		}
+		for (auto& job : batch_writes) {
+			auto op   = std::make_unique<UringOp>();
+			op->write = true;
+			op->path  = std::move(job.path);
+			op->data  = std::move(job.content);
+			op->fd    = open(op->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+			if (op->fd < 0) {
+				std::string error = errno_message("Failed to open", op->path, errno);
+				finish(std::move(op), std::move(error));
+				continue;
+			}
+			if (op->data.empty()) {
+				finish(std::move(op), {});
+				continue;
+			}
+			queued.push_back(std::move(op));
+		}
+
+		// 取新读写时保证 in_flight + queued 不超过 ENTRIES，而队列中占着的提交项
+		// 都已算在 in_flight 里，ENTRIES 又不大于队列长度，所以这里总能取到空的提交项；
+		// 万一取不到，剩下的留到下一轮
+		size_t placed = 0;
+		for (; placed < queued.size(); ++placed) {
+			io_uring_sqe* sqe = ring.GetSqe();
+			assert(sqe && "in_flight + queued <= Ring::ENTRIES");
+			if (!sqe) {
+				break;
+			}
+			auto& op         = queued[placed];
+			op->iov.iov_base = op->data.data() + op->done;
+			op->iov.iov_len  = op->data.size() - op->done;
+			sqe->opcode      = op->write ? IORING_OP_WRITEV : IORING_OP_READV;
+			sqe->fd          = op->fd;
+			sqe->off         = op->done;
+			sqe->addr        = reinterpret_cast<uint64_t>(&op->iov);
+			sqe->len         = 1;
+			sqe->user_data   = reinterpret_cast<uint64_t>(op.release());
+			++in_flight;
+		}
+		queued.erase(queued.begin(), queued.begin() + static_cast<std::ptrdiff_t>(placed));
+		if (in_flight == 0) {
+			continue;
+		}
+
+		if (const int error = ring.Submit(1); error != 0 && error != EAGAIN && error != EBUSY) {
+			// io_uring 无法再用：收回还没交给内核的读写，等已提交的完成，剩下的阻塞读写完，
+			// 之后在这个线程上按线程池后端继续
+			SPDLOG_ERROR("io_uring_enter failed ({}), falling back to blocking I/O",
+						 std::strerror(error));
+			ring.Reclaim([&](const io_uring_sqe& sqe) {
+				queued.emplace_back(reinterpret_cast<UringOp*>(sqe.user_data));
+				--in_flight;
+			});
+			while (in_flight > 0) {
+				ring.Reap(reap);
+				if (in_flight > 0 && ring.Submit(1) != 0) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+			for (auto& op : queued) {
+				finish_blocking(std::move(op));
+			}
+			queued.clear();
+			RunThreads();
+			return;
+		}
+		ring.Reap(reap);
+	}
+}
+#endif
+
+IoEngine::IoEngine(std::vector<std::string> paths, IoBackend backend, size_t buffer_bytes)
+	: state_(std::make_unique<State>())
+{
+	state_->paths = std::move(paths);
+	if (buffer_bytes) {
+		state_->read_ahead_bytes  = buffer_bytes;
+		state_->write_queue_bytes = buffer_bytes;
+	}
+#ifdef __linux__
+	if (backend != IoBackend::Threads) {
+		auto ring = std::make_unique<Ring>();
+		if (const int error = ring->Init(); error == 0) {
+			state_->backend_name = "uring";
+			state_->threads.emplace_back(
+				[state = state_.get(), ring = std::move(ring)] { state->RunUring(*ring); });
+			return;
+		}
+		else {
+			SPDLOG_DEBUG("io_uring is unavailable ({}), falling back to threads",
+						 std::strerror(error));
+		}
+	}
+#else
+	(void)backend;
+#endif
+	for (int i = 0; i < State::IO_THREADS; ++i) {
+		state_->threads.emplace_back([state = state_.get()] { state->RunThreads(); });
+	}
+}
+
+IoEngine::~IoEngine()
+{
+	Finish();
+}
+
+bool IoEngine::Next(File& file)
+{
+	std::unique_lock<std::mutex> lock(state_->mutex);
+	const auto ready = [&] {
+		return !state_->ready.empty() || state_->taken == state_->paths.size();
+	};
+	if (!ready()) {
+		const auto started = std::chrono::steady_clock::now();
+		state_->ready_cv.wait(lock, ready);
+		state_->wait_ns += elapsed_ns(started);
+	}
+	if (state_->ready.empty()) {
+		return false;
+	}
+	file = std::move(state_->ready.front());
+	state_->ready.pop_front();
+	state_->ready_bytes -= file.content.size();
+	++state_->taken;
+	if (state_->taken == state_->paths.size()) {
+		state_->ready_cv.notify_all();
+	}
+	state_->work_cv.notify_one();
+	return true;
+}
+
+void IoEngine::Write(std::string path, std::string content)
+{
+	std::unique_lock<std::mutex> lock(state_->mutex);
+	state_->space_cv.wait(lock, [&] { return state_->write_bytes < state_->write_queue_bytes; });
+	state_->write_bytes += content.size();
+	state_->writes.push_back({std::move(path), std::move(content)});
+	state_->work_cv.notify_one();
+}
+
+std::vector<std::pair<std::string, std::string>> IoEngine::Finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		state_->stop = true;
+		state_->work_cv.notify_all();
+	}
+	for (auto& thread : state_->threads) {
+		thread.join();
+	}
+	state_->threads.clear();
+	return std::move(state_->failures);
+}
+
+uint64_t IoEngine::ReadNs() const noexcept
+{
+	return state_->read_ns;
+}
+
+uint64_t IoEngine::WaitNs() const noexcept
+{
+	return state_->wait_ns;
+}
+
+const char* IoEngine::BackendName() const noexcept
+{
+	return state_->backend_name;
+}
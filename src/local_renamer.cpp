@@ -0,0 +1,408 @@
+#include "dl/local_renamer.h"
+#include "dl/ast.h"
+#include "dl/token.h"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace dl;
+
+static constexpr std::string_view NAME_START_CHARS =
+	"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+static constexpr std::string_view NAME_CHARS =
+	"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+
+LocalRenamer::VariableId LocalRenamer::new_variable(std::string_view name, bool pinned)
+{
+	const auto id = static_cast<VariableId>(variables_.size());
+	variables_.push_back(Variable{name, {}, {}, id + 1, pinned, 0});
+	return id;
+}
+
+void LocalRenamer::enter_scope()
+{
+	scope_marks_.push_back(scope_stack_.size());
+}
+
+void LocalRenamer::exit_scope()
+{
+	scope_stack_.resize(scope_marks_.back());
+	scope_marks_.pop_back();
+}
+
+void LocalRenamer::declare(Token* token)
+{
+	const auto id = new_variable(token->source_, false);
+	variables_[id].tokens_.push_back(token);
+	scope_stack_.push_back(id);
+}
+
+void LocalRenamer::declare_pinned(std::string_view name)
+{
+	scope_stack_.push_back(new_variable(name, true));
+}
+
+void LocalRenamer::add_conflicts(VariableId id, size_t stack_begin)
+{
+	if (scope_stack_.size() <= stack_begin) {
+		return;
+	}
+	// 栈上的 id 自底向上递增，已记录过的部分可以直接跳过
+	auto& variable = variables_[id];
+	for (size_t i = scope_stack_.size(); i > stack_begin; --i) {
+		const auto other = scope_stack_[i - 1];
+		if (other < variable.covered_) {
+			break;
+		}
+		variable.conflicts_.push_back(other);
+		variables_[other].conflicts_.push_back(id);
+	}
+	variable.covered_ = std::max(variable.covered_, scope_stack_.back() + 1);
+}
+
+void LocalRenamer::reference(Token* token)
+{
+	for (size_t i = scope_stack_.size(); i > 0; --i) {
+		const auto id = scope_stack_[i - 1];
+		if (variables_[id].name_ == token->source_) {
+			if (!variables_[id].pinned_) {
+				variables_[id].tokens_.push_back(token);
+			}
+			add_conflicts(id, i);
+			return;
+		}
+	}
+
+	// 全局变量：此处可见的所有局部变量都不能改成这个名字
+	auto it = globals_.find(token->source_);
+	if (it == globals_.end()) {
+		it = globals_.emplace(token->source_, new_variable(token->source_, true)).first;
+		// 全局变量不在栈上，栈上任何变量都可能与它冲突
+		variables_[it->second].covered_ = 0;
+	}
+	add_conflicts(it->second, 0);
+}
+
+void LocalRenamer::visit_exprs(Span<AstNode*>& exprs)
+{
+	for (auto expr : exprs) {
+		visit_expr(expr);
+	}
+}
+
+void LocalRenamer::visit_block(AstNode* body)
+{
+	enter_scope();
+	visit_stat(body);
+	exit_scope();
+}
+
+void LocalRenamer::visit_function(Span<Token*>& args, AstNode* body, bool is_method)
+{
+	enter_scope();
+	if (is_method) {
+		declare_pinned("self");
+	}
+	for (auto arg : args) {
+		if (arg->source_ != "...") {
+			declare(arg);
+		}
+	}
+	visit_stat(body);
+	exit_scope();
+}
+
+void LocalRenamer::visit_expr(AstNode* expr)
+{
+	switch (expr->type_) {
+	case AstNodeType::ParenExpr: visit_expr(expr->paren_expr_.expression_); break;
+	case AstNodeType::VariableExpr: reference(expr->variable_expr_.token_); break;
+	case AstNodeType::TableLiteral:
+	{
+		for (auto& entry : expr->table_literal_.entry_list_) {
+			switch (entry.type_) {
+			case AstNode::TableEntryType::Index:
+				visit_expr(entry.index_entry_.index_);
+				visit_expr(entry.index_entry_.value_);
+				break;
+			case AstNode::TableEntryType::Field: visit_expr(entry.field_entry_.value_); break;
+			case AstNode::TableEntryType::Value: visit_expr(entry.value_entry_.value_); break;
+			}
+		}
+		break;
+	}
+	case AstNodeType::FunctionLiteral:
+	{
+		auto& node = expr->function_literal_;
+		visit_function(node.arg_list_, node.body_, false);
+		break;
+	}
+	case AstNodeType::ArgCall: visit_exprs(expr->arg_call_.arg_list_); break;
+	case AstNodeType::TableCall: visit_expr(expr->table_call_.table_expr_); break;
+	case AstNodeType::FieldExpr: visit_expr(expr->field_expr_.base_); break;
+	case AstNodeType::MethodExpr:
+		visit_expr(expr->method_expr_.base_);
+		visit_expr(expr->method_expr_.function_arguments_);
+		break;
+	case AstNodeType::IndexExpr:
+		visit_expr(expr->index_expr_.base_);
+		visit_expr(expr->index_expr_.index_);
+		break;
+	case AstNodeType::CallExpr:
+		visit_expr(expr->call_expr_.base_);
+		visit_expr(expr->call_expr_.function_arguments_);
+		break;
+	case AstNodeType::NotExpr: visit_expr(expr->not_expr_.rhs_); break;
+	case AstNodeType::NegativeExpr: visit_expr(expr->negative_expr_.rhs_); break;
+	case AstNodeType::LengthExpr: visit_expr(expr->length_expr_.rhs_); break;
+	case AstNodeType::AddExpr:
+		visit_expr(expr->add_expr_.lhs_);
+		visit_expr(expr->add_expr_.rhs_);
+		break;
+	case AstNodeType::SubExpr:
+		visit_expr(expr->sub_expr_.lhs_);
+		visit_expr(expr->sub_expr_.rhs_);
+		break;
+	case AstNodeType::MulExpr:
+		visit_expr(expr->mul_expr_.lhs_);
+		visit_expr(expr->mul_expr_.rhs_);
+		break;
+	case AstNodeType::DivExpr:
+		visit_expr(expr->div_expr_.lhs_);
+		visit_expr(expr->div_expr_.rhs_);
+		break;
+	case AstNodeType::PowExpr:
+		visit_expr(expr->pow_expr_.lhs_);
+		visit_expr(expr->pow_expr_.rhs_);
+		break;
+	case AstNodeType::ModExpr:
+		visit_expr(expr->mod_expr_.lhs_);
+		visit_expr(expr->mod_expr_.rhs_);
+		break;
+	case AstNodeType::ConcatExpr:
+		visit_expr(expr->concat_expr_.lhs_);
+		visit_expr(expr->concat_expr_.rhs_);
+		break;
+	case AstNodeType::EqExpr:
+		visit_expr(expr->eq_expr_.lhs_);
+		visit_expr(expr->eq_expr_.rhs_);
+		break;
+	case AstNodeType::NeqExpr:
+		visit_expr(expr->neq_expr_.lhs_);
+		visit_expr(expr->neq_expr_.rhs_);
+		break;
+	case AstNodeType::LtExpr:
+		visit_expr(expr->lt_expr_.lhs_);
+		visit_expr(expr->lt_expr_.rhs_);
+		break;
+	case AstNodeType::LeExpr:
+		visit_expr(expr->le_expr_.lhs_);
+		visit_expr(expr->le_expr_.rhs_);
+		break;
+	case AstNodeType::GtExpr:
+		visit_expr(expr->gt_expr_.lhs_);
+		visit_expr(expr->gt_expr_.rhs_);
+		break;
+	case AstNodeType::GeExpr:
+		visit_expr(expr->ge_expr_.lhs_);
+		visit_expr(expr->ge_expr_.rhs_);
+		break;
+	case AstNodeType::AndExpr:
+		visit_expr(expr->and_expr_.lhs_);
+		visit_expr(expr->and_expr_.rhs_);
+		break;
+	case AstNodeType::OrExpr:
+		visit_expr(expr->or_expr_.lhs_);
+		visit_expr(expr->or_expr_.rhs_);
+		break;
+	// StringCall 与字面量中没有名字
+	default: break;
+	}
+}
+
+void LocalRenamer::visit_stat(AstNode* stat)
+{
+	switch (stat->type_) {
+	case AstNodeType::StatList:
+	{
+		for (auto child : stat->stat_list_.statement_list_) {
+			visit_stat(child);
+		}
+		break;
+	}
+	case AstNodeType::CallExprStat: visit_expr(stat->call_expr_stat_.expression_); break;
+	case AstNodeType::AssignmentStat:
+		visit_exprs(stat->assignment_stat_.rhs_);
+		visit_exprs(stat->assignment_stat_.lhs_);
+		break;
+	case AstNodeType::IfStat:
+	{
+		auto& node = stat->if_stat_;
+		visit_expr(node.condition_);
+		visit_block(node.body_);
+		for (auto& clause : node.else_clauses_) {
+			if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+				visit_expr(clause.else_if_clause_.condition_);
+			}
+			visit_block(clause.body_);
+		}
+		break;
+	}
+	case AstNodeType::DoStat: visit_block(stat->do_stat_.body_); break;
+	case AstNodeType::WhileStat:
+		visit_expr(stat->while_stat_.condition_);
+		visit_block(stat->while_stat_.body_);
+		break;
+	case AstNodeType::NumericForStat:
+	{
+		auto& node = stat->numeric_for_stat_;
+		visit_exprs(node.range_list_);
+		enter_scope();
+		for (auto var : node.var_list_) {
+			declare(var);
+		}
+		visit_stat(node.body_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::GenericForStat:
+	{
+		auto& node = stat->generic_for_stat_;
+		visit_exprs(node.generator_list_);
+		enter_scope();
+		for (auto var : node.var_list_) {
+			declare(var);
+		}
+		visit_stat(node.body_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::RepeatStat:
+	{
+		// until 的条件仍能看到循环体内声明的局部变量
+		enter_scope();
+		visit_stat(stat->repeat_stat_.body_);
+		visit_expr(stat->repeat_stat_.condition_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::LocalFunctionStat:
+	{
+		// local function f 先声明 f，函数体内可以递归引用自己
+		auto& function_stat = stat->local_function_stat_.function_stat_->function_stat_;
+		declare(function_stat.name_chain_[0]);
+		visit_function(function_stat.arg_list_, function_stat.body_, false);
+		break;
+	}
+	case AstNodeType::FunctionStat:
+	{
+		// function a.b:c() 只有 a 是名字引用，其余都是字段
+		auto& node = stat->function_stat_;
+		reference(node.name_chain_[0]);
+		visit_function(node.arg_list_, node.body_, stat->is_method_);
+		break;
+	}
+	case AstNodeType::LocalVarStat:
+	{
+		// local a = a 中右边的 a 引用的是外层的 a
+		auto& node = stat->local_var_stat_;
+		visit_exprs(node.expr_list_);
+		for (auto var : node.var_list_) {
+			declare(var);
+		}
+		break;
+	}
+	case AstNodeType::ReturnStat: visit_exprs(stat->return_stat_.expr_list_); break;
+	// break、goto 与标签中没有变量
+	default: break;
+	}
+}
+
+std::string_view LocalRenamer::candidate_name(size_t index)
+{
+	while (names_.size() <= index) {
+		// 把序号看作变长进制数：首位取自 NAME_START_CHARS，其余位取自 NAME_CHARS
+		size_t      sequence = next_name_sequence_++;
+		size_t      length   = 1;
+		size_t      count    = NAME_START_CHARS.size();
+		std::string name;
+		while (sequence >= count) {
+			sequence -= count;
+			count *= NAME_CHARS.size();
+			++length;
+		}
+		name.resize(length);
+		for (size_t i = length; i > 1; --i) {
+			name[i - 1] = NAME_CHARS[sequence % NAME_CHARS.size()];
+			sequence /= NAME_CHARS.size();
+		}
+		name[0] = NAME_START_CHARS[sequence];
+		if (!is_keyword(name)) {
+			names_.push_back(std::move(name));
+		}
+	}
+	return names_[index];
+}
+
+void LocalRenamer::assign_names()
+{
+	std::vector<VariableId> order;
+	for (VariableId id = 0; id < variables_.size(); ++id) {
+		if (!variables_[id].pinned_) {
+			order.push_back(id);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](VariableId a, VariableId b) {
+		return variables_[a].tokens_.size() > variables_[b].tokens_.size();
+	});
+
+	std::vector<bool>             assigned(variables_.size(), false);
+	std::vector<bool>             used_index;
+	std::vector<std::string_view> pinned_names;
+	for (const auto id : order) {
+		auto& variable = variables_[id];
+		used_index.assign(used_index.size(), false);
+		pinned_names.clear();
+		for (const auto other : variable.conflicts_) {
+			if (variables_[other].pinned_) {
+				pinned_names.push_back(variables_[other].name_);
+			}
+			else if (assigned[other]) {
+				const auto index = variables_[other].name_index_;
+				if (index >= used_index.size()) {
+					used_index.resize(index + 1, false);
+				}
+				used_index[index] = true;
+			}
+		}
+
+		size_t index = 0;
+		while (true) {
+			if (index >= used_index.size() || !used_index[index]) {
+				const auto name = candidate_name(index);
+				if (std::find(pinned_names.begin(), pinned_names.end(), name) ==
+					pinned_names.end()) {
+					break;
+				}
+			}
+			++index;
+		}
+		variable.name_index_ = index;
+		assigned[id]         = true;
+
+		const auto name = candidate_name(index);
+		for (auto token : variable.tokens_) {
+			token->source_ = name;
+		}
+	}
+}
+
+LocalRenamer::LocalRenamer(AstNode* root)
+{
+	// 主代码块本身就是最外层的作用域
+	enter_scope();
+	visit_stat(root);
+	exit_scope();
+	assign_names();
+}
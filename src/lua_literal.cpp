@@ -0,0 +1,155 @@
+#include "dl/lua_literal.h"
+#include "dl/token.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+using namespace dl;
+
+bool dl::parse_number_literal(std::string_view text, double& value, bool strict)
+{
+	if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+		if (text.size() - 2 > 13) {
+			if (strict) {
+				return false;
+			}
+			// 与 luaO_str2d 一样交给 strtoul，溢出时得到 ULONG_MAX
+			const std::string buffer(text);
+			char*             end = nullptr;
+			value = static_cast<double>(std::strtoul(buffer.c_str(), &end, 16));
+			return end == buffer.c_str() + buffer.size();
+		}
+		double result = 0;
+		for (size_t i = 2; i < text.size(); ++i) {
+			const char c = text[i];
+			int        digit;
+			if (c >= '0' && c <= '9') {
+				digit = c - '0';
+			}
+			else if (c >= 'a' && c <= 'f') {
+				digit = c - 'a' + 10;
+			}
+			else if (c >= 'A' && c <= 'F') {
+				digit = c - 'A' + 10;
+			}
+			else {
+				return false;
+			}
+			result = result * 16 + digit;
+		}
+		value = result;
+		return true;
+	}
+	const std::string buffer(text);
+	char*             end = nullptr;
+	value                 = std::strtod(buffer.c_str(), &end);
+	return end == buffer.c_str() + buffer.size() && (!strict || std::isfinite(value));
+}
+
+/**
+ * @brief 跳过一个换行序列（\n、\r、\n\r 或 \r\n），与 Lua 5.1 的 inclinenumber 一致
+ *
+ */
+static size_t skip_newline(std::string_view text, size_t i)
+{
+	const char c = text[i++];
+	if (i < text.size() && (text[i] == '\n' || text[i] == '\r') && text[i] != c) {
+		++i;
+	}
+	return i;
+}
+
+bool dl::decode_string_literal(std::string_view text, std::string& value, bool strict)
+{
+	value.clear();
+	if (text.size() < 2) {
+		return false;
+	}
+
+	// 长字符串
+	if (text[0] == '[') {
+		size_t level = 1;
+		while (level < text.size() && text[level] == '=') {
+			++level;
+		}
+		// [==[ 与 ]==] 各占 level + 1 个字符
+		const size_t delimiter = level + 1;
+		if (text.size() < delimiter * 2) {
+			return false;
+		}
+		const auto content = text.substr(delimiter, text.size() - delimiter * 2);
+		size_t     i       = 0;
+		// 紧跟在开始定界符后的第一个换行被忽略
+		if (!content.empty() && (content[0] == '\n' || content[0] == '\r')) {
+			i = skip_newline(content, 0);
+		}
+		while (i < content.size()) {
+			if (content[i] == '\n' || content[i] == '\r') {
+				value.push_back('\n');
+				i = skip_newline(content, i);
+			}
+			else {
+				value.push_back(content[i++]);
+			}
+		}
+		return true;
+	}
+
+	const char quote = text[0];
+	if ((quote != '"' && quote != '\'') || text.back() != quote) {
+		return false;
+	}
+	const auto content = text.substr(1, text.size() - 2);
+	size_t     i       = 0;
+	while (i < content.size()) {
+		const char c = content[i];
+		if (c != '\\') {
+			value.push_back(c);
+			++i;
+			continue;
+		}
+		if (++i >= content.size()) {
+			return false;
+		}
+		const char e = content[i];
+		switch (e) {
+		case 'a': value.push_back('\a'); ++i; break;
+		case 'b': value.push_back('\b'); ++i; break;
+		case 'f': value.push_back('\f'); ++i; break;
+		case 'n': value.push_back('\n'); ++i; break;
+		case 'r': value.push_back('\r'); ++i; break;
+		case 't': value.push_back('\t'); ++i; break;
+		case 'v': value.push_back('\v'); ++i; break;
+		case '\\':
+		case '"':
+		case '\'': value.push_back(e); ++i; break;
+		case '\n':
+		case '\r':
+			value.push_back('\n');
+			i = skip_newline(content, i);
+			break;
+		default:
+		{
+			if (!is_digit_char(e)) {
+				if (strict) {
+					return false;
+				}
+				value.push_back(e);
+				++i;
+				break;
+			}
+			int code = 0;
+			for (int n = 0; n < 3 && i < content.size() && is_digit_char(content[i]); ++n, ++i) {
+				code = code * 10 + (content[i] - '0');
+			}
+			if (code > 255) {
+				return false;
+			}
+			value.push_back(static_cast<char>(code));
+			break;
+		}
+		}
+	}
+	return true;
+}
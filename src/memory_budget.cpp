@@ -0,0 +1,109 @@
+#include "dl/memory_budget.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace dl;
+
+MemoryBudget::Reservation::Reservation(Reservation&& other) noexcept
+	: budget_(other.budget_)
+	, bytes_(other.bytes_)
+{
+	other.budget_ = nullptr;
+}
+
+MemoryBudget::Reservation& MemoryBudget::Reservation::operator=(Reservation&& other) noexcept
+{
+	if (this != &other) {
+		reset();
+		budget_       = other.budget_;
+		bytes_        = other.bytes_;
+		other.budget_ = nullptr;
+	}
+	return *this;
+}
+
+void MemoryBudget::Reservation::reset() noexcept
+{
+	if (budget_) {
+		budget_->release(bytes_);
+		budget_ = nullptr;
+	}
+}
+
+MemoryBudget::Reservation MemoryBudget::Acquire(size_t file_bytes)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	const uint64_t               ticket = next_ticket_++;
+	size_t                       bytes  = 0;
+	const auto                   admit  = [&] {
+		if (ticket != serving_) {
+			return false;
+		}
+		// 等待期间系数可能已被校正，每次都重新估计
+		bytes = estimate(file_bytes);
+		return in_flight_ == 0 || in_flight_ + bytes <= limit_;
+	};
+	if (!admit()) {
+		++waiting_;
+		cv_.wait(lock, admit);
+		--waiting_;
+	}
+	++serving_;
+	if (bytes > limit_) {
+		++solo_;
+	}
+	in_flight_ += bytes;
+	peak_ = std::max(peak_, in_flight_);
+	if (waiting_) {
+		// 下一个号码也许放得下
+		cv_.notify_all();
+	}
+
+	Reservation reservation;
+	reservation.budget_ = this;
+	reservation.bytes_  = bytes;
+	return reservation;
+}
+
+void MemoryBudget::Observe(size_t file_bytes, size_t used_bytes) noexcept
+{
+	if (file_bytes < MIN_OBSERVED_BYTES) {
+		return;
+	}
+	const double                ratio = static_cast<double>(used_bytes) / file_bytes;
+	std::lock_guard<std::mutex> lock(mutex_);
+	expansion_ = observed_ ? std::max(expansion_, ratio) : ratio;
+	observed_  = true;
+}
+
+size_t MemoryBudget::Estimate(size_t file_bytes) const noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return estimate(file_bytes);
+}
+
+size_t MemoryBudget::PeakBytes() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return peak_;
+}
+
+size_t MemoryBudget::SoloCount() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return solo_;
+}
+
+size_t MemoryBudget::estimate(size_t file_bytes) const noexcept
+{
+	return static_cast<size_t>(std::ceil(expansion_ * static_cast<double>(file_bytes)));
+}
+
+void MemoryBudget::release(size_t bytes) noexcept
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	in_flight_ -= bytes;
+	if (waiting_) {
+		cv_.notify_all();
+	}
+}
@@ -0,0 +1,222 @@
+#include "dl/output_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#	include <io.h>
+#	include <sys/stat.h>
+#	define DL_OPEN_FLAGS (_O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY)
+#	define DL_OPEN_MODE (_S_IREAD | _S_IWRITE)
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#	define DL_OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC)
+#	define DL_OPEN_MODE 0666
+#endif
+
+using namespace dl;
+
+namespace {
+int open_for_write(const std::string& path, int flags)
+{
+#ifdef _WIN32
+	const int fd = _open(path.c_str(), flags, DL_OPEN_MODE);
+#else
+	const int fd = open(path.c_str(), flags, DL_OPEN_MODE);
+#endif
+	// 只抛出，由捕获者报告
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open file: " + path + " (" + std::strerror(errno) + ")");
+	}
+	return fd;
+}
+
+/**
+ * @brief 写完全部内容，被信号打断时重试，返回 0 或 errno
+ */
+int write_all(int fd, const char* data, size_t size) noexcept
+{
+	while (size > 0) {
+#ifdef _WIN32
+		const auto chunk   = static_cast<unsigned>(std::min<size_t>(size, 1u << 30));
+		const auto written = _write(fd, data, chunk);
+#else
+		const auto written = ::write(fd, data, size);
+#endif
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno;
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return 0;
+}
+
+int close_fd(int fd) noexcept
+{
+#ifdef _WIN32
+	return _close(fd) == 0 ? 0 : errno;
+#else
+	return ::close(fd) == 0 ? 0 : errno;
+#endif
+}
+
+[[noreturn]] void throw_write_error(const std::string& path, int error)
+{
+	throw std::runtime_error("Failed to write file: " + path + " (" + std::strerror(error) + ")");
+}
+}   // namespace
+
+FdSink::FdSink(const std::string& path)
+	: path_(path)
+	, fd_(open_for_write(path, DL_OPEN_FLAGS))
+{}
+
+FdSink::~FdSink()
+{
+	if (fd_ >= 0) {
+		close_fd(fd_);
+	}
+}
+
+void FdSink::write(const char* data, size_t size) noexcept
+{
+	if (!error_) {
+		error_ = write_all(fd_, data, size);
+	}
+}
+
+void FdSink::Close()
+{
+	const int error = close_fd(fd_);
+	fd_             = -1;
+	if (error_ || error) {
+		throw_write_error(path_, error_ ? error_ : error);
+	}
+}
+
+void dl::write_file(const std::string& path, std::string_view content)
+{
+	FdSink sink(path);
+	sink.write(content.data(), content.size());
+	sink.Close();
+}
+
+#ifdef _WIN32
+MmapFileSink::MmapFileSink(const std::string& path, size_t size_hint)
+	: path_(path)
+	, fd_(open_for_write(path, DL_OPEN_FLAGS))
+{
+	fallback_.reserve(size_hint);
+}
+
+MmapFileSink::~MmapFileSink()
+{
+	if (fd_ >= 0) {
+		close_fd(fd_);
+	}
+}
+
+bool MmapFileSink::remap(size_t) noexcept
+{
+	return false;
+}
+
+void MmapFileSink::write(const char* data, size_t size) noexcept
+{
+	fallback_.append(data, size);
+}
+
+void MmapFileSink::Close()
+{
+	int error = write_all(fd_, fallback_.data(), fallback_.size());
+	if (const int close_error = close_fd(fd_); !error) {
+		error = close_error;
+	}
+	fd_ = -1;
+	if (error) {
+		throw_write_error(path_, error);
+	}
+}
+#else
+MmapFileSink::MmapFileSink(const std::string& path, size_t size_hint)
+	: path_(path)
+	// 映射要求以读写方式打开
+	, fd_(open_for_write(path, (DL_OPEN_FLAGS & ~O_WRONLY) | O_RDWR))
+{
+	if (!remap(std::max<size_t>(size_hint, 4096))) {
+		close_fd(fd_);
+		fd_ = -1;
+		throw_write_error(path_, error_);
+	}
+}
+
+MmapFileSink::~MmapFileSink()
+{
+	if (data_) {
+		munmap(data_, capacity_);
+	}
+	if (fd_ >= 0) {
+		close_fd(fd_);
+	}
+}
+
+bool MmapFileSink::remap(size_t capacity) noexcept
+{
+	if (data_) {
+		munmap(data_, capacity_);
+		data_ = nullptr;
+	}
+	if (ftruncate(fd_, static_cast<off_t>(capacity)) != 0) {
+		error_ = errno;
+		return false;
+	}
+	void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+	if (data == MAP_FAILED) {
+		error_ = errno;
+		return false;
+	}
+	data_     = static_cast<char*>(data);
+	capacity_ = capacity;
+	return true;
+}
+
+void MmapFileSink::write(const char* data, size_t size) noexcept
+{
+	if (error_) {
+		return;
+	}
+	if (size_ + size > capacity_ && !remap(std::max(capacity_ * 2, size_ + size))) {
+		return;
+	}
+	std::memcpy(data_ + size_, data, size);
+	size_ += size;
+}
+
+void MmapFileSink::Close()
+{
+	int error = error_;
+	if (data_) {
+		munmap(data_, capacity_);
+		data_ = nullptr;
+	}
+	if (!error && ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+		error = errno;
+	}
+	if (const int close_error = close_fd(fd_); !error) {
+		error = close_error;
+	}
+	fd_ = -1;
+	if (error) {
+		throw_write_error(path_, error);
+	}
+}
+#endif
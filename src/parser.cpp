@@ -13,7 +13,8 @@
 #include <vector>
 using namespace dl;
 
-void Parser::step() noexcept
+template<typename Builder>
+void Parser<Builder>::step() noexcept
 {
 	if (position_ < tokens_.size() - 1) {
 		++position_;
@@ -23,12 +24,14 @@ void Parser::step() noexcept
 	}
 }
 
-void Parser::step_trust_me() noexcept
+template<typename Builder>
+void Parser<Builder>::step_trust_me() noexcept
 {
 	++position_;
 }
 
-Token* Parser::get() noexcept
+template<typename Builder>
+Token* Parser<Builder>::get() noexcept
 {
 	Token* token = &tokens_[position_];
 	if (position_ < tokens_.size() - 1) {
@@ -40,23 +43,27 @@ Token* Parser::get() noexcept
 	return token;
 }
 
-Token* Parser::peek(size_t offset) const noexcept
+template<typename Builder>
+Token* Parser<Builder>::peek(size_t offset) const noexcept
 {
 	offset += position_;
 	return offset < tokens_.size() ? &tokens_[offset] : &tokens_.back();
 }
 
-Token* Parser::peek() const noexcept
+template<typename Builder>
+Token* Parser<Builder>::peek() const noexcept
 {
 	return &tokens_[position_];
 }
 
-std::string Parser::get_token_start_position(const Token* token) const noexcept
+template<typename Builder>
+std::string Parser<Builder>::get_token_start_position(const Token* token) const noexcept
 {
 	return fmt::format("{}:{}:", file_name_, token->line_);
 }
 
-bool Parser::is_block_follow() const noexcept
+template<typename Builder>
+bool Parser<Builder>::is_block_follow() const noexcept
 {
 	if (reached_eof_) {
 		return true;
@@ -65,106 +72,123 @@ bool Parser::is_block_follow() const noexcept
 	return token->type_ == TokenType::Keyword && is_block_follow_keyword(token->source_);
 }
 
-bool Parser::is_binop() const noexcept
+template<typename Builder>
+bool Parser<Builder>::is_binop() const noexcept
 {
 	return is_binop_op(peek()->source_);
 }
 
-Token* Parser::expect(TokenType type)
+template<typename Builder>
+Token* Parser<Builder>::expect(TokenType type)
 {
 	const auto& token = peek();
 	if (token->type_ == type) {
 		return get();
 	}
-	SPDLOG_ERROR("Expected token of type {}, but got {} at {}",
-				 magic_enum::enum_name(type),
-				 magic_enum::enum_name(token->type_),
-				 get_token_start_position(token));
-	throw std::runtime_error("Unexpected token");
+	fail(fmt::format("Expected token of type {}, but got {}",
+					 magic_enum::enum_name(type),
+					 magic_enum::enum_name(token->type_)));
 }
 
-void Parser::expect_and_drop(TokenType type)
+template<typename Builder>
+void Parser<Builder>::expect_and_drop(TokenType type)
 {
 	const auto& token = peek();
 	if (token->type_ == type) {
 		step();
 		return;
 	}
-	SPDLOG_ERROR("Expected token of type {}, but got {} at {}",
-				 magic_enum::enum_name(type),
-				 magic_enum::enum_name(token->type_),
-				 get_token_start_position(token));
-	throw std::runtime_error("Unexpected token");
+	fail(fmt::format("Expected token of type {}, but got {}",
+					 magic_enum::enum_name(type),
+					 magic_enum::enum_name(token->type_)));
 }
 
-Token* Parser::expect(TokenType type, const std::string_view value)
+template<typename Builder>
+Token* Parser<Builder>::expect(TokenType type, const std::string_view value)
 {
 	const auto& token = peek();
 	if (token->type_ == type && token->source_ == value) {
 		return get();
 	}
-	SPDLOG_ERROR("Expected token of type {} with value '{}', but got {} with value '{}' at {}",
-				 magic_enum::enum_name(type),
-				 value,
-				 magic_enum::enum_name(token->type_),
-				 token->source_,
-				 get_token_start_position(token));
-	throw std::runtime_error("Unexpected token");
+	fail(fmt::format("Expected token of type {} with value '{}', but got {} with value '{}'",
+					 magic_enum::enum_name(type),
+					 value,
+					 magic_enum::enum_name(token->type_),
+					 token->source_));
 }
 
-void Parser::expect_and_drop(TokenType type, const std::string_view value)
+template<typename Builder>
+void Parser<Builder>::expect_and_drop(TokenType type, const std::string_view value)
 {
 	const auto& token = peek();
 	if (token->type_ == type && token->source_ == value) {
 		step();
 		return;
 	}
-	SPDLOG_ERROR("Expected token of type {} with value '{}', but got {} with value '{}' at {}",
-				 magic_enum::enum_name(type),
-				 value,
-				 magic_enum::enum_name(token->type_),
-				 token->source_,
-				 get_token_start_position(token));
-	throw std::runtime_error("Unexpected token");
+	fail(fmt::format("Expected token of type {} with value '{}', but got {} with value '{}'",
+					 magic_enum::enum_name(type),
+					 value,
+					 magic_enum::enum_name(token->type_),
+					 token->source_));
 }
 
-void Parser::error(const std::string_view message)
+template<typename Builder>
+void Parser<Builder>::error(const std::string_view message)
 {
-	const auto& token = peek();
-	SPDLOG_ERROR(
-		"Error at {} {}, token {}", get_token_start_position(token), message, token->source_);
-	throw std::runtime_error("Parsing error");
+	fail(fmt::format("{}, token {}", message, peek()->source_));
+}
+
+template<typename Builder>
+void Parser<Builder>::fail(const std::string_view description)
+{
+	// 异常信息带上位置，由捕获它的调用方报告，这里不再打印，免得同一个错误出现两次
+	throw std::runtime_error(
+		fmt::format("{} {}", get_token_start_position(peek()), description));
 }
 
-void Parser::exprlist(std::vector<AstNode*>& expr_list)
+template<typename Builder>
+typename Parser<Builder>::NodeList Parser<Builder>::exprlist()
 {
-	expr_list.push_back(expr());
+	size_t count;
+	return exprlist(count);
+}
+
+template<typename Builder>
+typename Parser<Builder>::NodeList Parser<Builder>::exprlist(size_t& count)
+{
+	const size_t mark = builder_.BeginNodeList();
+	builder_.PushNode(expr());
+	count = 1;
 	while (peek()->source_ == ",") {
 		step();
-		expr_list.push_back(expr());
+		builder_.PushNode(expr());
+		++count;
 	}
+	return builder_.EndNodeList(mark);
 }
 
-AstNode* Parser::prefixexpr()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::prefixexpr()
 {
 	Token* token = peek();
 	if (token->source_ == "(") {
 		Token*   open_paren = get();
-		AstNode* inner      = expr();
+		Node     inner      = expr();
 		expect_and_drop(TokenType::Symbol, ")");
-		return ast_manager_.MakeParenExpr(inner, open_paren);
+		return builder_.MakeParenExpr(inner, open_paren);
 	}
 
 	if (token->type_ == TokenType::Identifier) {
-		return ast_manager_.MakeVariableExpr(get());
+		return builder_.MakeVariableExpr(get());
 	}
 	error("Unexpected symbol in prefix expression");
 }
 
-AstNode* Parser::tableexpr()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::tableexpr()
 {
-	Token*                           open_brace = expect(TokenType::Symbol, "{");
-	std::vector<AstNode::TableEntry> entries;
+	Token*       open_brace = expect(TokenType::Symbol, "{");
+	const size_t mark       = builder_.BeginTableEntryList();
 
 	while (peek()->source_ != "}") {
 		if (peek()->source_ == "[") {
@@ -173,17 +197,17 @@ AstNode* Parser::tableexpr()
 			expect_and_drop(TokenType::Symbol, "]");
 			expect_and_drop(TokenType::Symbol, "=");
 			auto value_expr = expr();
-			entries.emplace_back(AstNode::TableEntry::IndexEntry{left_bracket, index_expr, value_expr});
+			builder_.PushIndexEntry(left_bracket, index_expr, value_expr);
 		}
 		else if (peek()->type_ == TokenType::Identifier && peek(1)->source_ == "=") {
 			auto field = get();
 			step();
 			auto value_expr = expr();
-			entries.emplace_back(AstNode::TableEntry::FieldEntry{field, value_expr});
+			builder_.PushFieldEntry(field, value_expr);
 		}
 		else {
 			auto value_expr = expr();
-			entries.emplace_back(AstNode::TableEntry::ValueEntry{value_expr});
+			builder_.PushValueEntry(value_expr);
 		}
 
 		if (peek()->source_ == "," || peek()->source_ == ";") {
@@ -194,22 +218,27 @@ AstNode* Parser::tableexpr()
 		}
 	}
 	Token* token_close_brace = expect(TokenType::Symbol, "}");
-	return ast_manager_.MakeTableLiteral(std::move(entries), open_brace, token_close_brace);
+	return builder_.MakeTableLiteral(
+		builder_.EndTableEntryList(mark), open_brace, token_close_brace);
 }
 
-void Parser::varlist(std::vector<Token*>& var_list)
+template<typename Builder>
+typename Parser<Builder>::TokenList Parser<Builder>::varlist()
 {
+	const size_t mark = builder_.BeginTokenList();
 	if (peek()->type_ == TokenType::Identifier) {
-		var_list.push_back(get());
+		builder_.PushToken(get());
 	}
 	while (peek()->source_ == ",") {
 		step();
 		auto identifier = expect(TokenType::Identifier);
-		var_list.push_back(identifier);
+		builder_.PushToken(identifier);
 	}
+	return builder_.EndTokenList(mark);
 }
 
-void Parser::blockbody(std::string_view terminator, AstNode*& body, Token*& after)
+template<typename Builder>
+void Parser<Builder>::blockbody(std::string_view terminator, Node& body, Token*& after)
 {
 	auto _body  = block();
 	auto _after = peek();
@@ -223,57 +252,59 @@ void Parser::blockbody(std::string_view terminator, AstNode*& body, Token*& afte
 	error(fmt::format("Expected '{}' to close block", terminator).c_str());
 }
 
-AstNode* Parser::funcdecl_anonymous()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::funcdecl_anonymous()
 {
 	auto function_keyword = get();
 	expect_and_drop(TokenType::Symbol, "(");
-	auto arg_list = ast_manager_.MakeTokenVector();
-	varlist(*arg_list);
+	auto arg_list = varlist();
 	expect_and_drop(TokenType::Symbol, ")");
-	AstNode* body;
+	Node     body;
 	Token*   end_token;
 	blockbody("end", body, end_token);
 
-	return ast_manager_.MakeFunctionLiteral(arg_list, body, function_keyword, end_token);
+	return builder_.MakeFunctionLiteral(arg_list, body, function_keyword, end_token);
 }
 
-AstNode* Parser::funcdecl_named()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::funcdecl_named(bool is_local)
 {
-	auto function_keyword = get();
-	auto  name_chain_ptr = ast_manager_.MakeTokenVector();
-	auto& name_chain     = *name_chain_ptr;
-	name_chain.push_back(expect(TokenType::Identifier));
+	auto         function_keyword = get();
+	const size_t mark             = builder_.BeginTokenList();
+	builder_.PushToken(expect(TokenType::Identifier));
+	if (is_local && (peek()->source_ == "." || peek()->source_ == ":")) {
+		error("Invalid function name in local function declaration");
+	}
 	bool is_method = false;
 	while (peek()->source_ == ".") {
 		step();
-		name_chain.push_back(expect(TokenType::Identifier));
+		builder_.PushToken(expect(TokenType::Identifier));
 	}
 	if (peek()->source_ == ":") {
 		step();
-		name_chain.push_back(expect(TokenType::Identifier));
+		builder_.PushToken(expect(TokenType::Identifier));
 		is_method = true;
 	}
+	auto name_chain_span = builder_.EndTokenList(mark);
 	expect_and_drop(TokenType::Symbol, "(");
-	auto arg_list = ast_manager_.MakeTokenVector();
-
-	varlist(*arg_list);
+	auto arg_list = varlist();
 	expect_and_drop(TokenType::Symbol, ")");
-	AstNode* body;
+	Node     body;
 	Token*   end_token;
 	blockbody("end", body, end_token);
-	return ast_manager_.MakeFunctionStat(
-		name_chain_ptr, arg_list, body, function_keyword, end_token, is_method);
+	return builder_.MakeFunctionStat(
+		name_chain_span, arg_list, body, function_keyword, end_token, is_method);
 }
 
-AstNode* Parser::functionargs()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::functionargs()
 {
 	Token* token = peek();
 	if (token->source_ == "(") {
-		auto  open_paren   = get();
-		auto  arg_list_ptr = ast_manager_.MakeAstNodeVector();
-		auto& arg_list     = *arg_list_ptr;
+		auto         open_paren = get();
+		const size_t mark       = builder_.BeginNodeList();
 		while (peek()->source_ != ")") {
-			arg_list.push_back(expr());
+			builder_.PushNode(expr());
 			if (peek()->source_ == ",") {
 				step();
 			}
@@ -283,76 +314,85 @@ AstNode* Parser::functionargs()
 		}
 		expect_and_drop(TokenType::Symbol, ")");
 
-		return ast_manager_.MakeArgCall(arg_list_ptr, open_paren);
+		return builder_.MakeArgCall(builder_.EndNodeList(mark), open_paren);
 	}
 
 	if (token->source_ == "{") {
 		// return std::make_unique<TableCall>(expr());
-		return ast_manager_.MakeTableCall(expr());
+		return builder_.MakeTableCall(expr());
 	}
 
 	if (token->type_ == TokenType::String) {
 		// return std::make_unique<StringCall>(get());
-		return ast_manager_.MakeStringCall(get());
+		return builder_.MakeStringCall(get());
 	}
 	error("Function arguments expected");
 }
 
-AstNode* Parser::primaryexpr()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::primaryexpr()
 {
-	AstNode* base = prefixexpr();
+	Node base    = prefixexpr();
+	bool is_call = false;
 	while (true) {
 		Token* token = peek();
 		if (token->source_ == ".") {
 			step();
 			auto field = expect(TokenType::Identifier);
-			base       = ast_manager_.MakeFieldExpr(base, field);
+			base       = builder_.MakeFieldExpr(base, field);
 		}
 		else if (token->source_ == ":") {
 			step();
 			auto method    = expect(TokenType::Identifier);
 			auto func_args = functionargs();
-			base           = ast_manager_.MakeMethodExpr(base, method, func_args);
+			base           = builder_.MakeMethodExpr(base, method, func_args);
+			is_call        = true;
+			continue;
 		}
 		else if (token->source_ == "{" || token->source_ == "(" ||
 				 token->type_ == TokenType::String) {
-			base = ast_manager_.MakeCallExpr(base, functionargs());
+			base    = builder_.MakeCallExpr(base, functionargs());
+			is_call = true;
+			continue;
 		}
 		else if (token->source_ == "[") {
 			step();
 			auto index_expr = expr();
 			expect_and_drop(TokenType::Symbol, "]");
-			base = ast_manager_.MakeIndexExpr(base, index_expr);
+			base = builder_.MakeIndexExpr(base, index_expr);
 		}
 		else {
 			break;
 		}
+		is_call = false;
 	}
+	primary_is_call_ = is_call;
 	return base;
 }
 
-AstNode* Parser::simpleexpr()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::simpleexpr()
 {
 	Token* token = peek();
 
 	if (token->type_ == TokenType::Number) {
-		return ast_manager_.MakeNumberLiteral(get());
+		return builder_.MakeNumberLiteral(get());
 	}
 
 	if (token->type_ == TokenType::String) {
-		return ast_manager_.MakeStringLiteral(get());
+		return builder_.MakeStringLiteral(get());
 	}
 
 	if (token->source_ == "nil") {
-		return ast_manager_.MakeNilLiteral(get());
+		return builder_.MakeNilLiteral(get());
 	}
 
 	if (token->source_ == "true" || token->source_ == "false") {
-		return ast_manager_.MakeBooleanLiteral(get());
+		return builder_.MakeBooleanLiteral(get());
 	}
 
 	if (token->source_ == "...") {
-		return ast_manager_.MakeVargLiteral(get());
+		return builder_.MakeVargLiteral(get());
 	}
 
 	if (token->source_ == "{") {
@@ -378,7 +418,8 @@ static constexpr size_t binop_priority_1(std::string_view op)
 	return 0;
 }
 
-AstNode* Parser::subexpr(const size_t priority_limit)
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::subexpr(const size_t priority_limit)
 {
 	const static std::unordered_map<std::string_view, size_t> binop_priority_2 = {{"+", 6},
 																				  {"-", 6},
@@ -395,22 +436,22 @@ AstNode* Parser::subexpr(const size_t priority_limit)
 																				  {"<=", 3},
 																				  {"and", 2},
 																				  {"or", 1}};
-	AstNode*                                                  current_node;
+	Node                                                      current_node;
 	const auto&                                               op = peek()->source_;
 	if (op == "not") {
 		auto operator_token = get();
 		auto ex             = subexpr(UNARY_PRIORITY);
-		current_node        = ast_manager_.MakeNotExpr(ex, operator_token);
+		current_node        = builder_.MakeNotExpr(ex, operator_token);
 	}
 	else if (op == "-") {
 		auto operator_token = get();
 		auto ex             = subexpr(UNARY_PRIORITY);
-		current_node        = ast_manager_.MakeNegativeExpr(ex, operator_token);
+		current_node        = builder_.MakeNegativeExpr(ex, operator_token);
 	}
 	else if (op == "#") {
 		auto operator_token = get();
 		auto ex             = subexpr(UNARY_PRIORITY);
-		current_node        = ast_manager_.MakeLengthExpr(ex, operator_token);
+		current_node        = builder_.MakeLengthExpr(ex, operator_token);
 	}
 	else {
 		current_node = simpleexpr();
@@ -421,77 +462,77 @@ AstNode* Parser::subexpr(const size_t priority_limit)
 		if (next_op == "+" && binop_priority_1("+") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeAddExpr(current_node, rhs);
+			current_node        = builder_.MakeAddExpr(current_node, rhs);
 		}
 		else if (next_op == "-" && binop_priority_1("-") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeSubExpr(current_node, rhs);
+			current_node        = builder_.MakeSubExpr(current_node, rhs);
 		}
 		else if (next_op == "*" && binop_priority_1("*") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeMulExpr(current_node, rhs);
+			current_node        = builder_.MakeMulExpr(current_node, rhs);
 		}
 		else if (next_op == "/" && binop_priority_1("/") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeDivExpr(current_node, rhs);
+			current_node        = builder_.MakeDivExpr(current_node, rhs);
 		}
 		else if (next_op == "%" && binop_priority_1("%") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeModExpr(current_node, rhs);
+			current_node        = builder_.MakeModExpr(current_node, rhs);
 		}
 		else if (next_op == "^" && binop_priority_1("^") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakePowExpr(current_node, rhs);
+			current_node        = builder_.MakePowExpr(current_node, rhs);
 		}
 		else if (next_op == ".." && binop_priority_1("..") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeConcatExpr(current_node, rhs);
+			current_node        = builder_.MakeConcatExpr(current_node, rhs);
 		}
 		else if (next_op == "==" && binop_priority_1("==") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeEqExpr(current_node, rhs);
+			current_node        = builder_.MakeEqExpr(current_node, rhs);
 		}
 		else if (next_op == "~=" && binop_priority_1("~=") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeNeqExpr(current_node, rhs);
+			current_node        = builder_.MakeNeqExpr(current_node, rhs);
 		}
 		else if (next_op == ">" && binop_priority_1(">") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeGtExpr(current_node, rhs);
+			current_node        = builder_.MakeGtExpr(current_node, rhs);
 		}
 		else if (next_op == "<" && binop_priority_1("<") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeLtExpr(current_node, rhs);
+			current_node        = builder_.MakeLtExpr(current_node, rhs);
 		}
 		else if (next_op == ">=" && binop_priority_1(">=") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeGeExpr(current_node, rhs);
+			current_node        = builder_.MakeGeExpr(current_node, rhs);
 		}
 		else if (next_op == "<=" && binop_priority_1("<=") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeLeExpr(current_node, rhs);
+			current_node        = builder_.MakeLeExpr(current_node, rhs);
 		}
 		else if (next_op == "and" && binop_priority_1("and") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeAndExpr(current_node, rhs);
+			current_node        = builder_.MakeAndExpr(current_node, rhs);
 		}
 		else if (next_op == "or" && binop_priority_1("or") > priority_limit) {
 			auto operator_token = get();
 			auto rhs            = subexpr(binop_priority_2.at(operator_token->source_));
-			current_node        = ast_manager_.MakeOrExpr(current_node, rhs);
+			current_node        = builder_.MakeOrExpr(current_node, rhs);
 		}
 		else {
 			break;
@@ -501,203 +542,191 @@ AstNode* Parser::subexpr(const size_t priority_limit)
 	return current_node;
 }
 
-inline AstNode* Parser::expr()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::expr()
 {
 	return subexpr(0);
 }
 
-AstNode* Parser::exprstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::exprstat()
 {
 	auto ex = primaryexpr();
 
-	if (ex->type_ == AstNodeType::MethodExpr || ex->type_ == AstNodeType::CallExpr) {
-		return ast_manager_.MakeCallExprStat(ex);
+	if (primary_is_call_) {
+		return builder_.MakeCallExprStat(ex);
 	}
-	auto  lhs_ptr = ast_manager_.MakeAstNodeVector();
-	auto& lhs     = *lhs_ptr;
-	lhs.push_back(ex);
+	const size_t mark = builder_.BeginNodeList();
+	builder_.PushNode(ex);
 	while (peek()->source_ == ",") {
 		// lhs_separator.push_back(get());
 		step();
 		auto lhs_expr = primaryexpr();
-		if (lhs_expr->type_ == AstNodeType::MethodExpr ||
-			lhs_expr->type_ == AstNodeType::CallExpr) {
+		if (primary_is_call_) {
 			error("Bad left-hand side in assignment");
 		}
-		lhs.push_back(lhs_expr);
+		builder_.PushNode(lhs_expr);
 	}
+	auto lhs_span = builder_.EndNodeList(mark);
 	expect_and_drop(TokenType::Symbol, "=");
-	auto  rhs_ptr = ast_manager_.MakeAstNodeVector();
-	auto& rhs     = *rhs_ptr;
-	rhs.push_back(expr());
-	while (peek()->source_ == ",") {
-		step();
-		rhs.push_back(expr());
-	}
-	return ast_manager_.MakeAssignmentStat(lhs_ptr, rhs_ptr);
+	return builder_.MakeAssignmentStat(lhs_span, exprlist());
 }
 
-AstNode* Parser::ifstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::ifstat()
 {
 	auto if_token  = get();
 	auto condition = expr();
 	expect_and_drop(TokenType::Keyword, "then");
-	auto  if_body          = block();
-	auto  else_clauses_ptr = ast_manager_.MakeGeneralElseClauseVector();
-	auto& else_clauses     = *else_clauses_ptr;
+	auto         if_body = block();
+	const size_t mark    = builder_.BeginElseClauseList();
 	while (peek()->source_ == "elseif" || peek()->source_ == "else") {
 		auto else_if_token = get();
 		if (else_if_token->source_ == "elseif") {
 			auto else_if_condition = expr();
 			expect_and_drop(TokenType::Keyword, "then");
 			auto else_if_body = block();
-			else_clauses.emplace_back(
-				AstNode::IfStat::ElseIfClause{else_if_condition}, else_if_body, else_if_token);
+			builder_.PushElseIfClause(else_if_condition, else_if_body, else_if_token);
 		}
 		else {
 			auto else_body = block();
-			else_clauses.emplace_back(AstNode::IfStat::ElseClause{}, else_body, else_if_token);
+			builder_.PushElseClause(else_body, else_if_token);
 			break;
 		}
 	}
 
-	auto end_token = expect(TokenType::Keyword, "end");
-	return ast_manager_.MakeIfStat(condition, if_body, else_clauses_ptr, if_token, end_token);
+	auto else_clauses_span = builder_.EndElseClauseList(mark);
+	auto end_token         = expect(TokenType::Keyword, "end");
+	return builder_.MakeIfStat(condition, if_body, else_clauses_span, if_token, end_token);
 }
 
-AstNode* Parser::dostat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::dostat()
 {
 	auto     do_token = get();
-	AstNode* body;
+	Node     body;
 	Token*   end_token;
 	blockbody("end", body, end_token);
-	return ast_manager_.MakeDoStat(body, do_token, end_token);
+	return builder_.MakeDoStat(body, do_token, end_token);
 }
 
-AstNode* Parser::whilestat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::whilestat()
 {
 	auto while_token = get();
 	auto condition   = expr();
 	expect_and_drop(TokenType::Keyword, "do");
-	AstNode* body;
+	Node     body;
 	Token*   end_token;
 	blockbody("end", body, end_token);
-	return ast_manager_.MakeWhileStat(condition, body, while_token, end_token);
+	return builder_.MakeWhileStat(condition, body, while_token, end_token);
 }
 
-AstNode* Parser::forstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::forstat()
 {
-	auto  for_token     = get();
-	auto  loop_vars_ptr = ast_manager_.MakeTokenVector();
-	auto& loop_vars     = *loop_vars_ptr;
-	varlist(loop_vars);
+	auto for_token = get();
+	auto loop_vars = varlist();
 	if (peek()->source_ == "=") {
 		step();
-		auto  loop_expr_list_ptr = ast_manager_.MakeAstNodeVector();
-		auto& loop_expr_list     = *loop_expr_list_ptr;
-
-		exprlist(loop_expr_list);
-		if (loop_expr_list.size() > 3 || loop_expr_list.size() < 2) {
+		size_t range_count;
+		auto   loop_expr_list = exprlist(range_count);
+		if (range_count > 3 || range_count < 2) {
 			error("Numeric for loop must have 2 or 3 values for range bounds");
 		}
 		expect_and_drop(TokenType::Keyword, "do");
-		AstNode* body;
+		Node     body;
 		Token*   end_token;
 		blockbody("end", body, end_token);
-		return ast_manager_.MakeNumericForStat(
-			loop_vars_ptr, loop_expr_list_ptr, body, for_token, end_token);
+		return builder_.MakeNumericForStat(
+			loop_vars, loop_expr_list, body, for_token, end_token);
 	}
 
 	if (peek()->source_ == "in") {
 		step();
-		auto  loop_expr_list_ptr = ast_manager_.MakeAstNodeVector();
-		auto& loop_expr_list     = *loop_expr_list_ptr;
-		exprlist(loop_expr_list);
+		auto loop_expr_list = exprlist();
 		expect_and_drop(TokenType::Keyword, "do");
-		AstNode* body;
+		Node     body;
 		Token*   end_token;
 		blockbody("end", body, end_token);
-		return ast_manager_.MakeGenericForStat(
-			loop_vars_ptr, loop_expr_list_ptr, body, for_token, end_token);
+		return builder_.MakeGenericForStat(
+			loop_vars, loop_expr_list, body, for_token, end_token);
 	}
 
 	error("Expected '=' or 'in' in for statement");
 }
 
-AstNode* Parser::repeatstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::repeatstat()
 {
 	auto     repeat_token = get();
-	AstNode* body;
+	Node     body;
 	Token*   until_token;
 	blockbody("until", body, until_token);
 	auto condition = expr();
-	return ast_manager_.MakeRepeatStat(body, condition, repeat_token, until_token);
+	return builder_.MakeRepeatStat(body, condition, repeat_token, until_token);
 }
 
-AstNode* Parser::localdecl()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::localdecl()
 {
 	auto local_token = get();
 
 	if (peek()->source_ == "function") {
-		auto function_stat = funcdecl_named();
-		if (function_stat->function_stat_.name_chain_->size() > 1) {
-			error("Invalid function name in local function declaration");
-		}
-		return ast_manager_.MakeLocalFunctionStat(function_stat, local_token);
+		auto function_stat = funcdecl_named(true);
+		return builder_.MakeLocalFunctionStat(function_stat, local_token);
 	}
 
 	if (peek()->type_ == TokenType::Identifier) {
-		auto  var_list_ptr = ast_manager_.MakeTokenVector();
-		auto& var_list     = *var_list_ptr;
-
-		varlist(var_list);
-
-		auto  expr_list_ptr = ast_manager_.MakeAstNodeVector();
-		auto& expr_list     = *expr_list_ptr;
-
-
+		auto     var_list = varlist();
+		NodeList expr_list{};
 		if (peek()->source_ == "=") {
 			step();
-			exprlist(expr_list);
+			expr_list = exprlist();
 		}
-		return ast_manager_.MakeLocalVarStat(var_list_ptr, expr_list_ptr, local_token);
+		return builder_.MakeLocalVarStat(var_list, expr_list, local_token);
 	}
 
 	error("`function` or identifier expected after `local`");
 }
 
-AstNode* Parser::retstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::retstat()
 {
-	auto                  return_token = get();
-    auto expr_list_ptr   = ast_manager_.MakeAstNodeVector();
+	auto     return_token = get();
+	NodeList expr_list{};
 	if (!(is_block_follow() || peek()->source_ == ";")) {
-		exprlist(*expr_list_ptr);
+		expr_list = exprlist();
 	}
-	return ast_manager_.MakeReturnStat(expr_list_ptr, return_token);
+	return builder_.MakeReturnStat(expr_list, return_token);
 }
 
-AstNode* Parser::breakstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::breakstat()
 {
 	auto break_token = get();
-	return ast_manager_.MakeBreakStat(break_token);
+	return builder_.MakeBreakStat(break_token);
 }
 
-AstNode* Parser::gotostat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::gotostat()
 {
 	auto goto_token  = get();
 	auto label_token = expect(TokenType::Identifier);
-	return ast_manager_.MakeGotoStat(label_token, goto_token);
+	return builder_.MakeGotoStat(label_token, goto_token);
 }
 
-AstNode* Parser::labelstat()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::labelstat()
 {
 	auto label_start_token = get();
 	auto label_name_token  = expect(TokenType::Identifier);
 	expect_and_drop(TokenType::Symbol, "::");
-	return ast_manager_.MakeLabelStat(label_name_token, label_start_token);
+	return builder_.MakeLabelStat(label_name_token, label_start_token);
 }
 
-AstNode* Parser::statement(bool& is_last)
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::statement(bool& is_last)
 {
 	Token* token = peek();
 	if (token->source_ == "::") {
@@ -726,7 +755,7 @@ AstNode* Parser::statement(bool& is_last)
 	}
 	if (token->source_ == "function") {
 		is_last = false;
-		return funcdecl_named();
+		return funcdecl_named(false);
 	}
 	if (token->source_ == "local") {
 		is_last = false;
@@ -748,26 +777,40 @@ AstNode* Parser::statement(bool& is_last)
 	return exprstat();
 }
 
-AstNode* Parser::block()
+template<typename Builder>
+typename Parser<Builder>::Node Parser<Builder>::block()
 {
-    auto statements_ptr = ast_manager_.MakeAstNodeVector();
-    auto& statements = *statements_ptr;
-	bool                  is_last = false;
+	const size_t mark    = builder_.BeginNodeList();
+	bool         is_last = false;
 	while (!is_last && !is_block_follow()) {
-		statements.push_back(statement(is_last));
+		builder_.PushNode(statement(is_last));
 		if (peek()->source_ == ";" && peek()->type_ == TokenType::Symbol) {
             step();
 		}
 	}
-	return ast_manager_.MakeStatList(statements_ptr);
+	return builder_.MakeStatList(builder_.EndNodeList(mark));
 }
 
-Parser::Parser(std::vector<Token>& tokens, const std::string& file_name)
+template<typename Builder>
+Parser<Builder>::Parser(std::vector<Token>& tokens, const std::string& file_name)
+	: Parser(tokens, file_name, own_builder_)
+{}
+
+template<typename Builder>
+Parser<Builder>::Parser(std::vector<Token>& tokens, const std::string& file_name,
+						Builder& builder)
 	: file_name_(file_name)
 	, position_(0)
 	, tokens_(tokens)
-	, reached_eof_(false)
-
+	, builder_(builder)
+	// 只有注释或空白的文件没有 token，一开始就处在末尾
+	, reached_eof_(tokens.empty())
 {
 	ast_root_ = block();
 }
+
+namespace dl {
+template class Parser<AstManager>;
+template class Parser<NullAstBuilder>;
+template class Parser<EventAstBuilder>;
+}   // namespace dl
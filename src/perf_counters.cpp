@@ -0,0 +1,186 @@
+#include "dl/perf_counters.h"
+#include <cstring>
+#include <memory>
+#include <string>
+
+#ifdef __linux__
+#	include <linux/perf_event.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#	include <cerrno>
+#endif
+
+using namespace dl;
+
+const char* dl::perf_event_name(PerfEvent event) noexcept
+{
+	switch (event) {
+	case PerfEvent::Cycles: return "cycles";
+	case PerfEvent::Instructions: return "instructions";
+	case PerfEvent::Branches: return "branches";
+	case PerfEvent::BranchMisses: return "branch-misses";
+	case PerfEvent::L1dMisses: return "l1d-misses";
+	case PerfEvent::LlcMisses: return "llc-misses";
+	default: return "unknown";
+	}
+}
+
+#ifdef __linux__
+namespace {
+void event_attr(PerfEvent event, perf_event_attr& attr)
+{
+	constexpr auto cache_read_miss = [](uint64_t cache) {
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	};
+	attr.type = PERF_TYPE_HARDWARE;
+	switch (event) {
+	case PerfEvent::Cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+	case PerfEvent::Instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+	case PerfEvent::Branches: attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+	case PerfEvent::BranchMisses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+	case PerfEvent::L1dMisses:
+		attr.type   = PERF_TYPE_HW_CACHE;
+		attr.config = cache_read_miss(PERF_COUNT_HW_CACHE_L1D);
+		break;
+	case PerfEvent::LlcMisses:
+		attr.type   = PERF_TYPE_HW_CACHE;
+		attr.config = cache_read_miss(PERF_COUNT_HW_CACHE_LL);
+		break;
+	default: break;
+	}
+}
+}   // namespace
+
+PerfCounters::PerfCounters()
+{
+	fds_.fill(-1);
+	slots_.fill(-1);
+	for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		event_attr(static_cast<PerfEvent>(i), attr);
+		attr.read_format =
+			PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+		// 只计调用线程，不跟随它创建的线程
+		const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+		if (fd < 0) {
+			if (!error_) {
+				error_ = errno;
+			}
+			continue;
+		}
+		if (leader_ < 0) {
+			leader_ = fd;
+		}
+		fds_[i]   = fd;
+		slots_[i] = opened_++;
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (int fd : fds_) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+bool PerfCounters::Read(PerfCounts& counts) const noexcept
+{
+	if (leader_ < 0) {
+		return false;
+	}
+	// PERF_FORMAT_GROUP 的布局：事件数、启用时间、运行时间，然后是各事件的值
+	uint64_t buffer[3 + PERF_EVENT_COUNT];
+	const auto size = static_cast<ssize_t>(sizeof(uint64_t) * (3 + static_cast<size_t>(opened_)));
+	if (read(leader_, buffer, sizeof(buffer)) != size) {
+		return false;
+	}
+	const uint64_t enabled = buffer[1];
+	const uint64_t running = buffer[2];
+	if (running == 0) {
+		return false;
+	}
+	for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+		if (slots_[i] < 0) {
+			counts.values[i] = 0;
+			continue;
+		}
+		const uint64_t value = buffer[3 + slots_[i]];
+		// 计数器被轮换出去的时间按比例补上
+		counts.values[i] = running == enabled
+							   ? value
+							   : static_cast<uint64_t>(static_cast<double>(value) *
+													   static_cast<double>(enabled) /
+													   static_cast<double>(running));
+	}
+	return true;
+}
+
+PerfCounters& PerfCounters::local()
+{
+	thread_local std::unique_ptr<PerfCounters> counters(new PerfCounters);
+	return *counters;
+}
+
+const PerfCounters* PerfCounters::ThreadLocal()
+{
+	const PerfCounters& counters = local();
+	return counters.leader_ >= 0 ? &counters : nullptr;
+}
+
+bool PerfCounters::Probe(std::string& reason)
+{
+	const PerfCounters& counters = local();
+	if (counters.leader_ >= 0) {
+		return true;
+	}
+	switch (counters.error_) {
+	case ENOENT:
+	case EOPNOTSUPP:
+		reason = "the CPU or hypervisor exposes no hardware counters";
+		break;
+	case EACCES:
+	case EPERM:
+		reason = "permission denied, lower /proc/sys/kernel/perf_event_paranoid or grant "
+				 "CAP_PERFMON";
+		break;
+	case ENOSYS:
+		reason = "the kernel has no perf_event_open";
+		break;
+	default:
+		reason = std::strerror(counters.error_);
+		break;
+	}
+	return false;
+}
+#else
+PerfCounters::PerfCounters()
+{
+	fds_.fill(-1);
+	slots_.fill(-1);
+}
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::Read(PerfCounts&) const noexcept
+{
+	return false;
+}
+
+const PerfCounters* PerfCounters::ThreadLocal()
+{
+	return nullptr;
+}
+
+bool PerfCounters::Probe(std::string& reason)
+{
+	reason = "hardware counters are only supported on Linux";
+	return false;
+}
+#endif
@@ -0,0 +1,226 @@
+#include "dl/require_collector.h"
+#include "dl/ast.h"
+#include "dl/lua_literal.h"
+#include "dl/token.h"
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace dl;
+
+RequireCollector::RequireCollector(const AstNode* root)
+{
+	visit_stat(root);
+}
+
+bool RequireCollector::is_local(std::string_view name) const
+{
+	return std::find(locals_.begin(), locals_.end(), name) != locals_.end();
+}
+
+void RequireCollector::check_call(const AstNode* call)
+{
+	const AstNode* base = call->call_expr_.base_;
+	if (base->type_ != AstNodeType::VariableExpr ||
+		base->variable_expr_.token_->source_ != "require" || is_local("require")) {
+		return;
+	}
+
+	const AstNode* args = call->call_expr_.function_arguments_;
+	const Token*   name = nullptr;
+	if (args->type_ == AstNodeType::StringCall) {
+		name = args->first_token_;
+	}
+	else if (args->type_ == AstNodeType::ArgCall && args->arg_call_.arg_list_.size() == 1 &&
+			 args->arg_call_.arg_list_[0]->type_ == AstNodeType::StringLiteral) {
+		name = args->arg_call_.arg_list_[0]->first_token_;
+	}
+	std::string module;
+	if (!name || !decode_string_literal(name->source_, module, false)) {
+		return;
+	}
+	if (std::find(modules_.begin(), modules_.end(), module) == modules_.end()) {
+		modules_.push_back(std::move(module));
+	}
+}
+
+void RequireCollector::visit_stat(const AstNode* stat)
+{
+	switch (stat->type_) {
+	case AstNodeType::StatList:
+		for (const AstNode* child : stat->stat_list_.statement_list_) {
+			visit_stat(child);
+		}
+		break;
+	case AstNodeType::CallExprStat: visit_expr(stat->call_expr_stat_.expression_); break;
+	case AstNodeType::AssignmentStat:
+		visit_exprs(stat->assignment_stat_.rhs_);
+		visit_exprs(stat->assignment_stat_.lhs_);
+		break;
+	case AstNodeType::IfStat:
+	{
+		const auto& node = stat->if_stat_;
+		visit_expr(node.condition_);
+		visit_block(node.body_);
+		for (const auto& clause : node.else_clauses_) {
+			if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+				visit_expr(clause.else_if_clause_.condition_);
+			}
+			visit_block(clause.body_);
+		}
+		break;
+	}
+	case AstNodeType::DoStat: visit_block(stat->do_stat_.body_); break;
+	case AstNodeType::WhileStat:
+		visit_expr(stat->while_stat_.condition_);
+		visit_block(stat->while_stat_.body_);
+		break;
+	case AstNodeType::NumericForStat:
+	{
+		const auto& node = stat->numeric_for_stat_;
+		visit_exprs(node.range_list_);
+		enter_scope();
+		for (const Token* var : node.var_list_) {
+			declare(var->source_);
+		}
+		visit_stat(node.body_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::GenericForStat:
+	{
+		const auto& node = stat->generic_for_stat_;
+		visit_exprs(node.generator_list_);
+		enter_scope();
+		for (const Token* var : node.var_list_) {
+			declare(var->source_);
+		}
+		visit_stat(node.body_);
+		exit_scope();
+		break;
+	}
+	case AstNodeType::RepeatStat:
+		// until 的条件仍能看到循环体内声明的局部变量
+		enter_scope();
+		visit_stat(stat->repeat_stat_.body_);
+		visit_expr(stat->repeat_stat_.condition_);
+		exit_scope();
+		break;
+	case AstNodeType::LocalFunctionStat:
+	{
+		const auto& function_stat = stat->local_function_stat_.function_stat_->function_stat_;
+		declare(function_stat.name_chain_[0]->source_);
+		visit_function(function_stat.arg_list_, function_stat.body_, false);
+		break;
+	}
+	case AstNodeType::FunctionStat:
+	{
+		const auto& node = stat->function_stat_;
+		visit_function(node.arg_list_, node.body_, stat->is_method_);
+		break;
+	}
+	case AstNodeType::LocalVarStat:
+	{
+		const auto& node = stat->local_var_stat_;
+		visit_exprs(node.expr_list_);
+		for (const Token* var : node.var_list_) {
+			declare(var->source_);
+		}
+		break;
+	}
+	case AstNodeType::ReturnStat: visit_exprs(stat->return_stat_.expr_list_); break;
+	default: break;
+	}
+}
+
+void RequireCollector::visit_block(const AstNode* body)
+{
+	enter_scope();
+	visit_stat(body);
+	exit_scope();
+}
+
+void RequireCollector::visit_function(const Span<Token*>& args, const AstNode* body,
+									  bool is_method)
+{
+	enter_scope();
+	if (is_method) {
+		declare("self");
+	}
+	for (const Token* arg : args) {
+		declare(arg->source_);
+	}
+	visit_stat(body);
+	exit_scope();
+}
+
+void RequireCollector::visit_exprs(const Span<AstNode*>& exprs)
+{
+	for (const AstNode* expr : exprs) {
+		visit_expr(expr);
+	}
+}
+
+void RequireCollector::visit_expr(const AstNode* expr)
+{
+	switch (expr->type_) {
+	case AstNodeType::ParenExpr: visit_expr(expr->paren_expr_.expression_); break;
+	case AstNodeType::TableLiteral:
+		for (const auto& entry : expr->table_literal_.entry_list_) {
+			switch (entry.type_) {
+			case AstNode::TableEntryType::Index:
+				visit_expr(entry.index_entry_.index_);
+				visit_expr(entry.index_entry_.value_);
+				break;
+			case AstNode::TableEntryType::Field: visit_expr(entry.field_entry_.value_); break;
+			case AstNode::TableEntryType::Value: visit_expr(entry.value_entry_.value_); break;
+			}
+		}
+		break;
+	case AstNodeType::FunctionLiteral:
+	{
+		const auto& node = expr->function_literal_;
+		visit_function(node.arg_list_, node.body_, false);
+		break;
+	}
+	case AstNodeType::ArgCall: visit_exprs(expr->arg_call_.arg_list_); break;
+	case AstNodeType::TableCall: visit_expr(expr->table_call_.table_expr_); break;
+	case AstNodeType::FieldExpr: visit_expr(expr->field_expr_.base_); break;
+	case AstNodeType::MethodExpr:
+		visit_expr(expr->method_expr_.base_);
+		visit_expr(expr->method_expr_.function_arguments_);
+		break;
+	case AstNodeType::IndexExpr:
+		visit_expr(expr->index_expr_.base_);
+		visit_expr(expr->index_expr_.index_);
+		break;
+	case AstNodeType::CallExpr:
+		check_call(expr);
+		visit_expr(expr->call_expr_.base_);
+		visit_expr(expr->call_expr_.function_arguments_);
+		break;
+	case AstNodeType::NotExpr: visit_expr(expr->not_expr_.rhs_); break;
+	case AstNodeType::NegativeExpr: visit_expr(expr->negative_expr_.rhs_); break;
+	case AstNodeType::LengthExpr: visit_expr(expr->length_expr_.rhs_); break;
+	case AstNodeType::AddExpr:
+	case AstNodeType::SubExpr:
+	case AstNodeType::MulExpr:
+	case AstNodeType::DivExpr:
+	case AstNodeType::PowExpr:
+	case AstNodeType::ModExpr:
+	case AstNodeType::ConcatExpr:
+	case AstNodeType::EqExpr:
+	case AstNodeType::NeqExpr:
+	case AstNodeType::LtExpr:
+	case AstNodeType::LeExpr:
+	case AstNodeType::GtExpr:
+	case AstNodeType::GeExpr:
+	case AstNodeType::AndExpr:
+	case AstNodeType::OrExpr:
+		// 所有二元表达式的 lhs_ 与 rhs_ 布局相同
+		visit_expr(expr->add_expr_.lhs_);
+		visit_expr(expr->add_expr_.rhs_);
+		break;
+	default: break;
+	}
+}
@@ -0,0 +1,496 @@
+#include "dl/stats.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace dl;
+
+const char* dl::stats_phase_name(StatsPhase phase) noexcept
+{
+	switch (phase) {
+	case StatsPhase::Collect: return "collect";
+	case StatsPhase::Read: return "read";
+	case StatsPhase::IoRead: return "io-read";
+	case StatsPhase::IoWait: return "io-wait";
+	case StatsPhase::Tokenize: return "tokenize";
+	case StatsPhase::Parse: return "parse";
+	case StatsPhase::Transform: return "transform";
+	case StatsPhase::Print: return "print";
+	case StatsPhase::Write: return "write";
+	case StatsPhase::CacheIo: return "cache-io";
+	default: return "unknown";
+	}
+}
+
+uint64_t FileStats::TotalNs() const noexcept
+{
+	return std::accumulate(phase_ns.begin(), phase_ns.end(), uint64_t{0});
+}
+
+Stats& Stats::Instance()
+{
+	static Stats stats;
+	return stats;
+}
+
+bool Stats::EnablePerf(std::string& reason)
+{
+	enabled_ = true;
+	if (!PerfCounters::Probe(reason)) {
+		return false;
+	}
+	const PerfCounters* counters = PerfCounters::ThreadLocal();
+	for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+		perf_available_[i] = counters->Available(static_cast<PerfEvent>(i));
+	}
+	perf_ = true;
+	return true;
+}
+
+void Stats::AddFile(FileStats&& file)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	files_.push_back(std::move(file));
+}
+
+void Stats::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	files_.clear();
+	global_ns_    = {};
+	global_alloc_ = {};
+	global_spans_.clear();
+}
+
+std::vector<uint64_t> Stats::ThreadBusyNs(size_t threads) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<uint64_t>       busy(threads, 0);
+	for (const auto& file : files_) {
+		if (file.thread >= 0 && static_cast<size_t>(file.thread) < threads) {
+			busy[static_cast<size_t>(file.thread)] += file.TotalNs();
+		}
+	}
+	return busy;
+}
+
+namespace {
+/**
+ * @brief 报告用到的汇总结果
+ */
+struct Summary
+{
+	struct Thread
+	{
+		size_t   files   = 0;
+		size_t   bytes   = 0;
+		uint64_t busy_ns = 0;
+	};
+
+	size_t                                    bytes     = 0;
+	size_t                                    tokens    = 0;
+	size_t                                    ast_nodes = 0;
+	std::array<uint64_t, STATS_PHASE_COUNT>   phase_ns{};
+	std::map<int, Thread>                     threads;
+	// 按总耗时从大到小排列的文件下标
+	std::vector<size_t>                       slowest;
+	// 以下只在分配统计构建中汇总
+	std::array<AllocStats, STATS_PHASE_COUNT> phase_alloc{};
+	// 只在开启硬件计数器时汇总
+	std::array<PerfCounts, STATS_PHASE_COUNT> phase_perf{};
+	// 按申请字节数从大到小排列的文件下标
+	std::vector<size_t>                       most_allocating;
+};
+
+/**
+ * @brief 取 files 中按 key 从大到小的前 top 个下标
+ */
+template<typename Key>
+std::vector<size_t> top_files(const std::vector<FileStats>& files, size_t top, Key key)
+{
+	std::vector<size_t> indices(files.size());
+	std::iota(indices.begin(), indices.end(), size_t{0});
+	top = std::min(top, files.size());
+	std::partial_sort(indices.begin(),
+					  indices.begin() + static_cast<std::ptrdiff_t>(top),
+					  indices.end(),
+					  [&](size_t a, size_t b) { return key(files[a]) > key(files[b]); });
+	indices.resize(top);
+	return indices;
+}
+
+Summary summarize(const std::vector<FileStats>&                  files,
+				  const std::array<uint64_t, STATS_PHASE_COUNT>&   global_ns,
+				  const std::array<AllocStats, STATS_PHASE_COUNT>& global_alloc, size_t top)
+{
+	Summary summary;
+	summary.phase_ns    = global_ns;
+	summary.phase_alloc = global_alloc;
+	for (const auto& file : files) {
+		summary.bytes += file.bytes;
+		summary.tokens += file.tokens;
+		summary.ast_nodes += file.ast_nodes;
+		for (size_t i = 0; i < STATS_PHASE_COUNT; ++i) {
+			summary.phase_ns[i] += file.phase_ns[i];
+			summary.phase_alloc[i] += file.phase_alloc[i];
+			summary.phase_perf[i] += file.phase_perf[i];
+		}
+		auto& thread = summary.threads[file.thread];
+		++thread.files;
+		thread.bytes += file.bytes;
+		thread.busy_ns += file.TotalNs();
+	}
+	summary.slowest = top_files(files, top, [](const FileStats& file) { return file.TotalNs(); });
+	if (ALLOC_STATS_ENABLED) {
+		summary.most_allocating =
+			top_files(files, top, [](const FileStats& file) { return file.alloc.bytes; });
+	}
+	return summary;
+}
+
+double to_ms(uint64_t ns)
+{
+	return static_cast<double>(ns) / 1e6;
+}
+
+double per_second(double amount, uint64_t ns)
+{
+	return ns ? amount * 1e9 / static_cast<double>(ns) : 0.0;
+}
+
+double to_mb(uint64_t bytes)
+{
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+nlohmann::json alloc_json(const AllocStats& alloc)
+{
+	return nlohmann::json{{"count", alloc.count},
+						  {"bytes", alloc.bytes},
+						  {"peak_bytes", alloc.peak_bytes},
+						  {"arena_count", alloc.arena_count},
+						  {"arena_bytes", alloc.arena_bytes}};
+}
+
+/**
+ * @brief 由计数导出的比率，分母或所需事件不可用时为空
+ */
+struct PerfRates
+{
+	std::optional<double> ipc;
+	// 分支预测失败占分支指令的比例
+	std::optional<double> branch_miss_rate;
+	// 每千条指令的缓存缺失数
+	std::optional<double> l1d_mpki;
+	std::optional<double> llc_mpki;
+};
+
+PerfRates perf_rates(const PerfCounts& counts, const std::array<bool, PERF_EVENT_COUNT>& available)
+{
+	const auto ratio = [&](PerfEvent numerator,
+						   PerfEvent denominator,
+						   double    scale) -> std::optional<double> {
+		if (!available[static_cast<size_t>(numerator)] ||
+			!available[static_cast<size_t>(denominator)] || !counts[denominator]) {
+			return std::nullopt;
+		}
+		return scale * static_cast<double>(counts[numerator]) /
+			   static_cast<double>(counts[denominator]);
+	};
+	PerfRates rates;
+	rates.ipc              = ratio(PerfEvent::Instructions, PerfEvent::Cycles, 1.0);
+	rates.branch_miss_rate = ratio(PerfEvent::BranchMisses, PerfEvent::Branches, 1.0);
+	rates.l1d_mpki         = ratio(PerfEvent::L1dMisses, PerfEvent::Instructions, 1000.0);
+	rates.llc_mpki         = ratio(PerfEvent::LlcMisses, PerfEvent::Instructions, 1000.0);
+	return rates;
+}
+
+nlohmann::json phases_alloc_json(const std::array<AllocStats, STATS_PHASE_COUNT>& phase_alloc)
+{
+	nlohmann::json phases = nlohmann::json::object();
+	for (size_t i = 0; i < STATS_PHASE_COUNT; ++i) {
+		phases[stats_phase_name(static_cast<StatsPhase>(i))] = alloc_json(phase_alloc[i]);
+	}
+	return phases;
+}
+}   // namespace
+
+std::string Stats::TextReport(uint64_t wall_ns, size_t top) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	const Summary summary     = summarize(files_, global_ns_, global_alloc_, top);
+	const double  megabytes   = to_mb(summary.bytes);
+	const auto    tokenize_ns = summary.phase_ns[static_cast<size_t>(StatsPhase::Tokenize)];
+	const auto    parse_ns    = summary.phase_ns[static_cast<size_t>(StatsPhase::Parse)];
+
+	std::string out;
+	out += fmt::format("Files: {}  Threads: {}  Wall: {:.3f} ms\n",
+					   files_.size(),
+					   summary.threads.size(),
+					   to_ms(wall_ns));
+	out += fmt::format("Input: {:.2f} MB  Tokens: {}  AST nodes: {}\n",
+					   megabytes,
+					   summary.tokens,
+					   summary.ast_nodes);
+	out += fmt::format("Throughput (wall): {:.1f} MB/s  {:.0f} tokens/s\n",
+					   per_second(megabytes, wall_ns),
+					   per_second(static_cast<double>(summary.tokens), wall_ns));
+	out += fmt::format("Tokenizer: {:.1f} MB/s  Parser: {:.0f} tokens/s (per thread)\n",
+					   per_second(megabytes, tokenize_ns),
+					   per_second(static_cast<double>(summary.tokens), parse_ns));
+
+	// 各阶段耗时为所有线程之和，占比按这个和计算
+	const uint64_t phase_total =
+		std::accumulate(summary.phase_ns.begin(), summary.phase_ns.end(), uint64_t{0});
+	out += "\nPhase          Total ms    Share\n";
+	for (size_t i = 0; i < STATS_PHASE_COUNT; ++i) {
+		if (!summary.phase_ns[i]) {
+			continue;
+		}
+		out += fmt::format("{:<12} {:>10.3f} {:>7.1f}%\n",
+						   stats_phase_name(static_cast<StatsPhase>(i)),
+						   to_ms(summary.phase_ns[i]),
+						   phase_total ? 100.0 * static_cast<double>(summary.phase_ns[i]) /
+											 static_cast<double>(phase_total)
+									   : 0.0);
+	}
+
+	out += "\nThread    Files    Busy ms       MB\n";
+	for (const auto& [id, thread] : summary.threads) {
+		out += fmt::format("{:<6} {:>8} {:>10.3f} {:>8.2f}\n",
+						   id,
+						   thread.files,
+						   to_ms(thread.busy_ns),
+						   to_mb(thread.bytes));
+	}
+
+	if (!summary.slowest.empty()) {
+		out += fmt::format("\nSlowest {} files, in ms: total = read + tokenize + parse + "
+						   "transform + print + write\n",
+						   summary.slowest.size());
+		for (size_t index : summary.slowest) {
+			const auto& file = files_[index];
+			const auto  ms   = [&](StatsPhase phase) {
+				return to_ms(file.phase_ns[static_cast<size_t>(phase)]);
+			};
+			out += fmt::format("{:>9.3f} = {:.3f} + {:.3f} + {:.3f} + {:.3f} + {:.3f} + {:.3f}  "
+							   "{}\n",
+							   to_ms(file.TotalNs()),
+							   ms(StatsPhase::Read),
+							   ms(StatsPhase::Tokenize),
+							   ms(StatsPhase::Parse),
+							   ms(StatsPhase::Transform),
+							   ms(StatsPhase::Print),
+							   ms(StatsPhase::Write),
+							   file.path);
+		}
+	}
+
+	if (perf_) {
+		const auto cell = [](const std::optional<double>& value, double scale, const char* suffix) {
+			return value ? fmt::format("{:.2f}{}", *value * scale, suffix) : std::string("n/a");
+		};
+		out += "\nPhase              Cycles   Instructions    IPC  Branch miss  L1d MPKI  "
+			   "LLC MPKI\n";
+		for (StatsPhase phase : {StatsPhase::Tokenize, StatsPhase::Parse, StatsPhase::Print}) {
+			const PerfCounts& counts = summary.phase_perf[static_cast<size_t>(phase)];
+			if (!counts[PerfEvent::Cycles] && !counts[PerfEvent::Instructions]) {
+				continue;
+			}
+			const PerfRates rates = perf_rates(counts, perf_available_);
+			out += fmt::format("{:<12} {:>12} {:>14} {:>6} {:>12} {:>9} {:>9}\n",
+							   stats_phase_name(phase),
+							   counts[PerfEvent::Cycles],
+							   counts[PerfEvent::Instructions],
+							   cell(rates.ipc, 1.0, ""),
+							   cell(rates.branch_miss_rate, 100.0, "%"),
+							   cell(rates.l1d_mpki, 1.0, ""),
+							   cell(rates.llc_mpki, 1.0, ""));
+		}
+	}
+
+	if (ALLOC_STATS_ENABLED) {
+		// 峰值是单个文件在该阶段内存活堆内存的最大增量，各线程同时占用的内存不相加
+		out += "\nPhase          Allocs   Alloc MB    Peak MB  Arena allocs   Arena MB\n";
+		for (size_t i = 0; i < STATS_PHASE_COUNT; ++i) {
+			const AllocStats& alloc = summary.phase_alloc[i];
+			if (!alloc.count && !alloc.arena_count) {
+				continue;
+			}
+			out += fmt::format("{:<12} {:>8} {:>10.2f} {:>10.2f} {:>13} {:>10.2f}\n",
+							   stats_phase_name(static_cast<StatsPhase>(i)),
+							   alloc.count,
+							   to_mb(alloc.bytes),
+							   to_mb(alloc.peak_bytes),
+							   alloc.arena_count,
+							   to_mb(alloc.arena_bytes));
+		}
+		if (!summary.most_allocating.empty()) {
+			out += fmt::format("\nMost allocating {} files: allocs, alloc MB, peak MB\n",
+							   summary.most_allocating.size());
+			for (size_t index : summary.most_allocating) {
+				const auto& file = files_[index];
+				out += fmt::format("{:>9} {:>9.2f} {:>9.2f}  {}\n",
+								   file.alloc.count,
+								   to_mb(file.alloc.bytes),
+								   to_mb(file.alloc.peak_bytes),
+								   file.path);
+			}
+		}
+	}
+	return out;
+}
+
+std::string Stats::JsonReport(uint64_t wall_ns, size_t top) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	const Summary summary = summarize(files_, global_ns_, global_alloc_, top);
+
+	const auto phases_json = [](const std::array<uint64_t, STATS_PHASE_COUNT>& phase_ns) {
+		nlohmann::json phases = nlohmann::json::object();
+		for (size_t i = 0; i < STATS_PHASE_COUNT; ++i) {
+			phases[stats_phase_name(static_cast<StatsPhase>(i))] = phase_ns[i];
+		}
+		return phases;
+	};
+	const auto file_json = [&](const FileStats& file) {
+		nlohmann::json json{{"path", file.path},
+							{"thread", file.thread},
+							{"bytes", file.bytes},
+							{"tokens", file.tokens},
+							{"ast_nodes", file.ast_nodes},
+							{"total_ns", file.TotalNs()},
+							{"phase_ns", phases_json(file.phase_ns)}};
+		if (ALLOC_STATS_ENABLED) {
+			json["alloc"]       = alloc_json(file.alloc);
+			json["phase_alloc"] = phases_alloc_json(file.phase_alloc);
+		}
+		return json;
+	};
+
+	nlohmann::json report;
+	report["wall_ns"]    = wall_ns;
+	report["files"]      = files_.size();
+	report["bytes"]      = summary.bytes;
+	report["tokens"]     = summary.tokens;
+	report["ast_nodes"]  = summary.ast_nodes;
+	report["phase_ns"]   = phases_json(summary.phase_ns);
+	report["throughput"] = {
+		{"bytes_per_second", per_second(static_cast<double>(summary.bytes), wall_ns)},
+		{"tokens_per_second", per_second(static_cast<double>(summary.tokens), wall_ns)}};
+	report["threads"] = nlohmann::json::array();
+	for (const auto& [id, thread] : summary.threads) {
+		report["threads"].push_back({{"thread", id},
+									 {"files", thread.files},
+									 {"bytes", thread.bytes},
+									 {"busy_ns", thread.busy_ns}});
+	}
+	if (ALLOC_STATS_ENABLED) {
+		report["phase_alloc"]     = phases_alloc_json(summary.phase_alloc);
+		report["most_allocating"] = nlohmann::json::array();
+		for (size_t index : summary.most_allocating) {
+			report["most_allocating"].push_back(file_json(files_[index]));
+		}
+	}
+	if (perf_) {
+		report["phase_perf"] = nlohmann::json::object();
+		for (StatsPhase phase : {StatsPhase::Tokenize, StatsPhase::Parse, StatsPhase::Print}) {
+			const PerfCounts& counts = summary.phase_perf[static_cast<size_t>(phase)];
+			const PerfRates   rates  = perf_rates(counts, perf_available_);
+			nlohmann::json    json;
+			for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+				const char* name = perf_event_name(static_cast<PerfEvent>(i));
+				json[name] = perf_available_[i] ? nlohmann::json(counts.values[i]) : nlohmann::json();
+			}
+			const auto optional_json = [](const std::optional<double>& value) {
+				return value ? nlohmann::json(*value) : nlohmann::json();
+			};
+			json["ipc"]              = optional_json(rates.ipc);
+			json["branch_miss_rate"] = optional_json(rates.branch_miss_rate);
+			json["l1d_mpki"]         = optional_json(rates.l1d_mpki);
+			json["llc_mpki"]         = optional_json(rates.llc_mpki);
+			report["phase_perf"][stats_phase_name(phase)] = std::move(json);
+		}
+	}
+	report["slowest"] = nlohmann::json::array();
+	for (size_t index : summary.slowest) {
+		report["slowest"].push_back(file_json(files_[index]));
+	}
+	report["per_file"] = nlohmann::json::array();
+	for (const auto& file : files_) {
+		report["per_file"].push_back(file_json(file));
+	}
+	return report.dump(2);
+}
+
+std::string Stats::TraceReport() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t                    origin = UINT64_MAX;
+	for (const auto& span : global_spans_) {
+		origin = std::min(origin, span.start_ns);
+	}
+	for (const auto& file : files_) {
+		origin = std::min(origin, file.start_ns);
+	}
+	// trace event 的时间单位是微秒
+	const auto to_us = [&](uint64_t ns) { return static_cast<double>(ns - origin) / 1e3; };
+	const auto span_json = [&](const TraceSpan& span, int thread) {
+		return nlohmann::json{{"name", stats_phase_name(span.phase)},
+							  {"cat", "phase"},
+							  {"ph", "X"},
+							  {"pid", 1},
+							  {"tid", thread},
+							  {"ts", to_us(span.start_ns)},
+							  {"dur", static_cast<double>(span.duration_ns) / 1e3}};
+	};
+
+	nlohmann::json events = nlohmann::json::array();
+	events.push_back(
+		{{"name", "process_name"}, {"ph", "M"}, {"pid", 1}, {"args", {{"name", "dlfmt"}}}});
+	std::set<int> threads{0};
+	for (const auto& file : files_) {
+		threads.insert(file.thread);
+	}
+	for (int thread : threads) {
+		events.push_back({{"name", "thread_name"},
+						  {"ph", "M"},
+						  {"pid", 1},
+						  {"tid", thread},
+						  {"args", {{"name", fmt::format("worker {}", thread)}}}});
+	}
+	// 收集文件、读写缓存都在并行区域外，放在主线程的轨道上
+	for (const auto& span : global_spans_) {
+		events.push_back(span_json(span, 0));
+	}
+	for (const auto& file : files_) {
+		events.push_back({{"name", file.path.empty() ? "<unnamed>" : file.path},
+						  {"cat", "file"},
+						  {"ph", "X"},
+						  {"pid", 1},
+						  {"tid", file.thread},
+						  {"ts", to_us(file.start_ns)},
+						  {"dur", static_cast<double>(file.end_ns - file.start_ns) / 1e3},
+						  {"args",
+						   {{"bytes", file.bytes},
+							{"tokens", file.tokens},
+							{"ast_nodes", file.ast_nodes}}}});
+		for (const auto& span : file.spans) {
+			events.push_back(span_json(span, file.thread));
+		}
+	}
+
+	nlohmann::json trace;
+	trace["traceEvents"]     = std::move(events);
+	trace["displayTimeUnit"] = "ms";
+	return trace.dump();
+}
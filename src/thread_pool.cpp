@@ -0,0 +1,232 @@
+#include "dl/thread_pool.h"
+#include <algorithm>
+#include <utility>
+
+#ifdef __linux__
+#	include <pthread.h>
+#	include <sched.h>
+#endif
+
+using namespace dl;
+
+namespace {
+// 当前线程所属的线程池与在其中的编号，池外的线程为空与 0
+thread_local const ThreadPool* current_pool  = nullptr;
+thread_local size_t            current_index = 0;
+
+std::mutex                  global_mutex;
+std::unique_ptr<ThreadPool> global_pool;
+size_t                      global_threads = 0;
+bool                        global_pin     = false;
+
+/**
+ * @brief 进程可用的 CPU 编号，取不到时为空
+ */
+std::vector<int> allowed_cpus()
+{
+	std::vector<int> cpus;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if (CPU_ISSET(cpu, &set)) {
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#endif
+	return cpus;
+}
+
+void pin_current_thread(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)cpu;
+#endif
+}
+}   // namespace
+
+ThreadPool::ThreadPool(size_t threads, bool pin_threads)
+	: slots_(std::max<size_t>(threads, 1))
+{
+	// 调用线程占 0 号队列，不绑核；工作线程从 1 号起依次绑到可用的 CPU 上
+	const std::vector<int> cpus = pin_threads ? allowed_cpus() : std::vector<int>();
+	threads_.reserve(slots_.size() - 1);
+	for (size_t i = 1; i < slots_.size(); ++i) {
+		const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+		threads_.emplace_back([this, i, cpu] { worker(i, cpu); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		stop_ = true;
+	}
+	sleep_cv_.notify_all();
+	for (auto& thread : threads_) {
+		thread.join();
+	}
+}
+
+size_t ThreadPool::DefaultThreads() noexcept
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		return std::max(CPU_COUNT(&set), 1);
+	}
+#endif
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+ThreadPool& ThreadPool::Global()
+{
+	std::lock_guard<std::mutex> lock(global_mutex);
+	if (!global_pool) {
+		global_pool = std::make_unique<ThreadPool>(
+			global_threads ? global_threads : DefaultThreads(), global_pin);
+	}
+	return *global_pool;
+}
+
+void ThreadPool::Configure(size_t threads, bool pin_threads)
+{
+	std::lock_guard<std::mutex> lock(global_mutex);
+	global_pool.reset();
+	global_threads = threads;
+	global_pin     = pin_threads;
+}
+
+size_t ThreadPool::CurrentIndex() noexcept
+{
+	return current_index;
+}
+
+void ThreadPool::Submit(TaskGroup& group, std::function<void()> task)
+{
+	group.pending_.fetch_add(1, std::memory_order_relaxed);
+	Slot& slot = slots_[current_slot()];
+	{
+		std::lock_guard<std::mutex> lock(slot.mutex);
+		slot.tasks.push_back({std::move(task), &group});
+	}
+	// 与等待方先登记 sleepers_ 再检查 queued_ 配对，两边都用顺序一致的原子操作，不会漏掉唤醒
+	queued_.fetch_add(1);
+	if (sleepers_.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		sleep_cv_.notify_one();
+	}
+}
+
+void ThreadPool::Wait(TaskGroup& group)
+{
+	const size_t self = current_slot();
+	Task         task;
+	while (group.pending_.load(std::memory_order_acquire) > 0) {
+		if (find_task(self, task)) {
+			run(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		sleepers_.fetch_add(1);
+		sleep_cv_.wait(lock, [&] { return group.pending_.load() == 0 || queued_.load() > 0; });
+		sleepers_.fetch_sub(1);
+	}
+	if (group.error_) {
+		std::rethrow_exception(group.error_);
+	}
+}
+
+void ThreadPool::worker(size_t index, int cpu)
+{
+	current_pool  = this;
+	current_index = index;
+	if (cpu >= 0) {
+		pin_current_thread(cpu);
+	}
+	Task task;
+	while (true) {
+		if (find_task(index, task)) {
+			run(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		sleepers_.fetch_add(1);
+		sleep_cv_.wait(lock, [&] { return stop_ || queued_.load() > 0; });
+		sleepers_.fetch_sub(1);
+		if (stop_ && queued_.load() <= 0) {
+			return;
+		}
+	}
+}
+
+size_t ThreadPool::current_slot() const noexcept
+{
+	return current_pool == this ? current_index : 0;
+}
+
+bool ThreadPool::find_task(size_t self, Task& task)
+{
+	// 先取自己队尾最新放入的任务
+	{
+		Slot&                       slot = slots_[self];
+		std::lock_guard<std::mutex> lock(slot.mutex);
+		if (!slot.tasks.empty()) {
+			task = std::move(slot.tasks.back());
+			slot.tasks.pop_back();
+			queued_.fetch_sub(1);
+			return true;
+		}
+	}
+	// 再从其他队列的队头偷最早放入的任务
+	for (size_t i = 1; i < slots_.size(); ++i) {
+		Slot&                       slot = slots_[(self + i) % slots_.size()];
+		std::lock_guard<std::mutex> lock(slot.mutex);
+		if (!slot.tasks.empty()) {
+			task = std::move(slot.tasks.front());
+			slot.tasks.pop_front();
+			queued_.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::run(Task& task) noexcept
+{
+	TaskGroup& group = *task.group;
+	if (!group.Cancelled()) {
+		try {
+			task.run();
+		}
+		catch (...) {
+			if (!group.failed_.exchange(true)) {
+				group.error_ = std::current_exception();
+			}
+			group.Cancel();
+		}
+	}
+	// 先释放任务捕获的状态，组结束后等待方可能立即销毁它们
+	task.run = nullptr;
+	// 组可能在计数归零后立即被销毁，之后不能再访问 group
+	if (group.pending_.fetch_sub(1) == 1) {
+		wake_all();
+	}
+}
+
+void ThreadPool::wake_all()
+{
+	if (sleepers_.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		sleep_cv_.notify_all();
+	}
+}
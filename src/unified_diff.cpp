@@ -0,0 +1,211 @@
+#include "dl/unified_diff.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace dl;
+
+// 编辑距离超过它时不再细分，Myers 算法保存的轨迹约为它的平方个整数
+static constexpr int32_t MAX_EDIT_DISTANCE = 2048;
+
+enum class EditType : uint8_t
+{
+	Equal,
+	Delete,
+	Insert
+};
+
+struct Edit
+{
+	EditType type;
+	// 对应行在原文本与新文本中的下标，插入时 old_index 为插入位置，删除时 new_index 同理
+	size_t old_index;
+	size_t new_index;
+};
+
+/**
+ * @brief 把文本切成行，每行保留结尾的换行符，最后一行可能没有换行符
+ *
+ */
+static std::vector<std::string_view> split_lines(std::string_view text)
+{
+	std::vector<std::string_view> lines;
+	size_t                        start = 0;
+	while (start < text.size()) {
+		const size_t end = text.find('\n', start);
+		if (end == std::string_view::npos) {
+			lines.push_back(text.substr(start));
+			break;
+		}
+		lines.push_back(text.substr(start, end - start + 1));
+		start = end + 1;
+	}
+	return lines;
+}
+
+/**
+ * @brief 求 a[a_begin, a_end) 到 b[b_begin, b_end) 的最短编辑脚本，按顺序追加到 edits
+ *
+ * @return false 编辑距离超过 MAX_EDIT_DISTANCE，edits 未被修改
+ */
+static bool myers_diff(const std::vector<std::string_view>& a, size_t a_begin, size_t a_end,
+					   const std::vector<std::string_view>& b, size_t b_begin, size_t b_end,
+					   std::vector<Edit>& edits)
+{
+	const int32_t n      = static_cast<int32_t>(a_end - a_begin);
+	const int32_t m      = static_cast<int32_t>(b_end - b_begin);
+	const int32_t max    = std::min(n + m, MAX_EDIT_DISTANCE);
+	const int32_t offset = max + 1;
+	std::vector<int32_t> v(2 * static_cast<size_t>(max) + 3, 0);
+	// 第 d 步开始前 v 在 k ∈ [-d-1, d+1] 上的取值，起点为 d * d + 2 * d
+	std::vector<int32_t> trace;
+
+	int32_t distance = -1;
+	for (int32_t d = 0; d <= max && distance < 0; ++d) {
+		trace.insert(trace.end(), v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+		for (int32_t k = -d; k <= d; k += 2) {
+			int32_t x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+							? v[offset + k + 1]
+							: v[offset + k - 1] + 1;
+			int32_t y = x - k;
+			while (x < n && y < m && a[a_begin + x] == b[b_begin + y]) {
+				++x;
+				++y;
+			}
+			v[offset + k] = x;
+			if (x >= n && y >= m) {
+				distance = d;
+				break;
+			}
+		}
+	}
+	if (distance < 0) {
+		return false;
+	}
+
+	// 从终点沿轨迹回溯，得到逆序的编辑脚本
+	std::vector<Edit> reversed;
+	int32_t           x = n;
+	int32_t           y = m;
+	for (int32_t d = distance; d >= 0; --d) {
+		const int32_t* band   = trace.data() + static_cast<size_t>(d) * d + 2 * d;
+		const auto     prev_v = [&](int32_t k) { return band[k + d + 1]; };
+		const int32_t  k      = x - y;
+		const int32_t  prev_k =
+			(k == -d || (k != d && prev_v(k - 1) < prev_v(k + 1))) ? k + 1 : k - 1;
+		const int32_t prev_x = d == 0 ? 0 : prev_v(prev_k);
+		const int32_t prev_y = d == 0 ? 0 : prev_x - prev_k;
+		while (x > prev_x && y > prev_y) {
+			--x;
+			--y;
+			reversed.push_back({EditType::Equal, a_begin + x, b_begin + y});
+		}
+		if (d > 0) {
+			if (x == prev_x) {
+				reversed.push_back({EditType::Insert, a_begin + x, b_begin + prev_y});
+			}
+			else {
+				reversed.push_back({EditType::Delete, a_begin + prev_x, b_begin + y});
+			}
+			x = prev_x;
+			y = prev_y;
+		}
+	}
+	edits.insert(edits.end(), reversed.rbegin(), reversed.rend());
+	return true;
+}
+
+/**
+ * @brief 输出一行，没有换行符时补上 diff 的提示行
+ *
+ */
+static void append_line(std::string& out, char prefix, std::string_view line)
+{
+	out += prefix;
+	out += line;
+	if (line.empty() || line.back() != '\n') {
+		out += "\n\\ No newline at end of file\n";
+	}
+}
+
+std::string dl::unified_diff(std::string_view old_text, std::string_view new_text,
+							 std::string_view old_name, std::string_view new_name,
+							 size_t context)
+{
+	if (old_text == new_text) {
+		return {};
+	}
+	const auto a = split_lines(old_text);
+	const auto b = split_lines(new_text);
+
+	// 先剥去相同的首尾行，Myers 算法只处理中间部分
+	size_t prefix = 0;
+	while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) {
+		++prefix;
+	}
+	size_t suffix = 0;
+	while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+		   a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) {
+		++suffix;
+	}
+
+	std::vector<Edit> edits;
+	edits.reserve(std::max(a.size(), b.size()));
+	for (size_t i = 0; i < prefix; ++i) {
+		edits.push_back({EditType::Equal, i, i});
+	}
+	const size_t a_end = a.size() - suffix;
+	const size_t b_end = b.size() - suffix;
+	if (!myers_diff(a, prefix, a_end, b, prefix, b_end, edits)) {
+		for (size_t i = prefix; i < a_end; ++i) {
+			edits.push_back({EditType::Delete, i, prefix});
+		}
+		for (size_t i = prefix; i < b_end; ++i) {
+			edits.push_back({EditType::Insert, a_end, i});
+		}
+	}
+	for (size_t i = 0; i < suffix; ++i) {
+		edits.push_back({EditType::Equal, a_end + i, b_end + i});
+	}
+
+	std::string out = fmt::format("--- {}\n+++ {}\n", old_name, new_name);
+	size_t      i   = 0;
+	while (i < edits.size()) {
+		if (edits[i].type == EditType::Equal) {
+			++i;
+			continue;
+		}
+		// 相邻两处修改之间的相同行不超过 2 * context 时合并为一段
+		const size_t begin = i > context ? i - context : 0;
+		size_t       end   = i;
+		size_t       equal = 0;
+		while (end < edits.size() && equal <= 2 * context) {
+			equal = edits[end].type == EditType::Equal ? equal + 1 : 0;
+			++end;
+		}
+		end -= equal > context ? equal - context : 0;
+
+		size_t old_count = 0;
+		size_t new_count = 0;
+		for (size_t j = begin; j < end; ++j) {
+			old_count += edits[j].type != EditType::Insert;
+			new_count += edits[j].type != EditType::Delete;
+		}
+		// 行数为 0 时起始行号指向差异前的一行
+		const size_t old_start = edits[begin].old_index + (old_count ? 1 : 0);
+		const size_t new_start = edits[begin].new_index + (new_count ? 1 : 0);
+		out += fmt::format("@@ -{},{} +{},{} @@\n", old_start, old_count, new_start, new_count);
+		for (size_t j = begin; j < end; ++j) {
+			switch (edits[j].type) {
+			case EditType::Equal: append_line(out, ' ', a[edits[j].old_index]); break;
+			case EditType::Delete: append_line(out, '-', a[edits[j].old_index]); break;
+			case EditType::Insert: append_line(out, '+', b[edits[j].new_index]); break;
+			}
+		}
+		i = end;
+	}
+	return out;
+}
@@ -0,0 +1,906 @@
+#include "dl_bench_core.h"
+#include "dl/ast_manager.h"
+#include "dl/ast_printer.h"
+#include "dl/output_sink.h"
+#include "dl/parser.h"
+#include "dl/stats.h"
+#include "dl/thread_pool.h"
+#include "dl/tokenizer.h"
+#include "dlfmt_core.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace dl;
+
+// 每个样本至少的耗时，快的基准把连续几遍合成一个样本，免得计时与调度的抖动淹没结果
+static constexpr uint64_t MIN_SAMPLE_NS = 1'000'000;
+// 各基准轮流运行的轮数，与基线比较时检验的是各轮样本的中位数
+static constexpr size_t ROUNDS = 10;
+
+struct CorpusFile
+{
+	std::string path;
+	std::string source;
+};
+
+static uint64_t now_ns()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+									 std::chrono::steady_clock::now().time_since_epoch())
+									 .count());
+}
+
+static std::string read_file(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		SPDLOG_ERROR("Failed to open file: {}", path);
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief 读入语料，目录按路径排序，保证每次运行的顺序相同
+ *
+ */
+static std::vector<CorpusFile> load_corpus(const std::string& corpus)
+{
+	std::vector<std::string> paths;
+	if (std::filesystem::is_directory(corpus)) {
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(corpus)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".lua") {
+				paths.emplace_back(entry.path().string());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+	}
+	else {
+		paths.push_back(corpus);
+	}
+	std::vector<CorpusFile> files;
+	files.reserve(paths.size());
+	for (auto& path : paths) {
+		std::string source = read_file(path);
+		files.push_back({std::move(path), std::move(source)});
+	}
+	return files;
+}
+
+/**
+ * @brief 丢弃写入内容的 sink，只测量输出代码本身的开销
+ *
+ */
+struct DiscardSink
+{
+	void write(const char*, size_t) noexcept {}
+};
+
+/**
+ * @brief 一项基准，每轮处理一遍全部语料，只对各文件中被测的部分计时
+ *
+ */
+class Benchmark
+{
+public:
+	virtual ~Benchmark() = default;
+
+	virtual const char* Name() const = 0;
+
+	/**
+	 * @brief 准备语料，不计时
+	 *
+	 * @return size_t 每轮处理的 token 数
+	 */
+	virtual size_t Prepare(const std::vector<CorpusFile>& corpus) = 0;
+
+	/**
+	 * @brief 处理一遍语料
+	 *
+	 * @return uint64_t 计时部分的耗时
+	 */
+	virtual uint64_t Run(const std::vector<CorpusFile>& corpus) = 0;
+};
+
+static constexpr const char* tokenize_mode_name(TokenizeMode mode)
+{
+	switch (mode) {
+	case TokenizeMode::Compress: return "compress";
+	case TokenizeMode::FormatAuto: return "format-auto";
+	case TokenizeMode::FormatManual: return "format-manual";
+	}
+	return "unknown";
+}
+
+static constexpr const char* print_mode_name(AstPrintMode mode)
+{
+	switch (mode) {
+	case AstPrintMode::Compress: return "compress";
+	case AstPrintMode::Auto: return "auto";
+	case AstPrintMode::Manual: return "manual";
+	}
+	return "unknown";
+}
+
+/**
+ * @brief 各种输出模式对应的切分模式
+ *
+ */
+static constexpr TokenizeMode print_tokenize_mode(AstPrintMode mode)
+{
+	switch (mode) {
+	case AstPrintMode::Compress: return TokenizeMode::Compress;
+	case AstPrintMode::Auto: return TokenizeMode::FormatAuto;
+	case AstPrintMode::Manual: return TokenizeMode::FormatManual;
+	}
+	return TokenizeMode::FormatAuto;
+}
+
+/**
+ * @brief 每个文件各自切分好的结果，token 指向 tokenizer 持有的源码，所以用指针保存
+ *
+ */
+template<TokenizeMode mode>
+static std::vector<std::unique_ptr<Tokenizer<mode>>> tokenize_corpus(
+	const std::vector<CorpusFile>& corpus, size_t& tokens)
+{
+	std::vector<std::unique_ptr<Tokenizer<mode>>> tokenizers;
+	tokens = 0;
+	for (const auto& file : corpus) {
+		tokenizers.push_back(
+			std::make_unique<Tokenizer<mode>>(std::string(file.source), file.path));
+		tokens += tokenizers.back()->getTokens().size();
+	}
+	return tokenizers;
+}
+
+template<TokenizeMode mode> class TokenizeBenchmark : public Benchmark
+{
+public:
+	TokenizeBenchmark()
+		: name_(std::string("tokenize/") + tokenize_mode_name(mode))
+	{}
+
+	const char* Name() const override { return name_.c_str(); }
+
+	size_t Prepare(const std::vector<CorpusFile>& corpus) override
+	{
+		size_t tokens = 0;
+		tokenize_corpus<mode>(corpus, tokens);
+		return tokens;
+	}
+
+	uint64_t Run(const std::vector<CorpusFile>& corpus) override
+	{
+		uint64_t elapsed = 0;
+		for (const auto& file : corpus) {
+			// 与 dlfmt 一样复用缓冲区，复制源码不计时
+			text_ = file.source;
+			const uint64_t start = now_ns();
+			tokenizer_.Reset(text_, file.path);
+			elapsed += now_ns() - start;
+		}
+		return elapsed;
+	}
+
+private:
+	std::string     name_;
+	std::string     text_;
+	Tokenizer<mode> tokenizer_;
+};
+
+class ParseBenchmark : public Benchmark
+{
+public:
+	const char* Name() const override { return "parse"; }
+
+	size_t Prepare(const std::vector<CorpusFile>& corpus) override
+	{
+		size_t tokens = 0;
+		tokenizers_   = tokenize_corpus<TokenizeMode::FormatAuto>(corpus, tokens);
+		return tokens;
+	}
+
+	uint64_t Run(const std::vector<CorpusFile>& corpus) override
+	{
+		uint64_t elapsed = 0;
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			manager_.Reset();
+			const uint64_t start = now_ns();
+			Parser         parser(tokenizers_[i]->getTokens(), corpus[i].path, manager_);
+			elapsed += now_ns() - start;
+		}
+		return elapsed;
+	}
+
+private:
+	std::vector<std::unique_ptr<Tokenizer<TokenizeMode::FormatAuto>>> tokenizers_;
+	AstManager                                                        manager_;
+};
+
+template<AstPrintMode mode> class PrintBenchmark : public Benchmark
+{
+public:
+	PrintBenchmark()
+		: name_(std::string("print/") + print_mode_name(mode))
+	{}
+
+	const char* Name() const override { return name_.c_str(); }
+
+	size_t Prepare(const std::vector<CorpusFile>& corpus) override
+	{
+		size_t tokens = 0;
+		tokenizers_   = tokenize_corpus<tokenize_mode>(corpus, tokens);
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			managers_.push_back(std::make_unique<AstManager>());
+			Parser parser(tokenizers_[i]->getTokens(), corpus[i].path, *managers_.back());
+			roots_.push_back(parser.GetAstRoot());
+		}
+		return tokens;
+	}
+
+	uint64_t Run(const std::vector<CorpusFile>& corpus) override
+	{
+		uint64_t elapsed = 0;
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			DiscardSink                   out;
+			AstPrinter<mode, DiscardSink> printer(out, &tokenizers_[i]->getCommentTokens());
+			const uint64_t                start = now_ns();
+			printer.PrintAst(roots_[i]);
+			elapsed += now_ns() - start;
+		}
+		return elapsed;
+	}
+
+private:
+	static constexpr TokenizeMode tokenize_mode = print_tokenize_mode(mode);
+
+	std::string                                            name_;
+	std::vector<std::unique_ptr<Tokenizer<tokenize_mode>>> tokenizers_;
+	std::vector<std::unique_ptr<AstManager>>               managers_;
+	std::vector<AstNode*>                                  roots_;
+};
+
+/**
+ * @brief 端到端处理临时目录中的语料副本，包括读写文件
+ *
+ */
+template<bool compress> class EndToEndBenchmark : public Benchmark
+{
+public:
+	~EndToEndBenchmark() override
+	{
+		if (!directory_.empty()) {
+			std::error_code ec;
+			std::filesystem::remove_all(directory_, ec);
+		}
+	}
+
+	const char* Name() const override { return compress ? "compress-file" : "format-file"; }
+
+	size_t Prepare(const std::vector<CorpusFile>& corpus) override
+	{
+		directory_ = std::filesystem::temp_directory_path() /
+					 ("dl_bench-" + std::to_string(now_ns()));
+		std::filesystem::create_directories(directory_);
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			paths_.push_back((directory_ / (std::to_string(i) + ".lua")).string());
+		}
+		size_t tokens = 0;
+		if constexpr (compress) {
+			tokenize_corpus<TokenizeMode::Compress>(corpus, tokens);
+		}
+		else {
+			tokenize_corpus<TokenizeMode::FormatAuto>(corpus, tokens);
+		}
+		return tokens;
+	}
+
+	uint64_t Run(const std::vector<CorpusFile>& corpus) override
+	{
+		uint64_t elapsed = 0;
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			// 每次都从原始语料开始，格式化后的文件不会再被改写
+			write_file(paths_[i], corpus[i].source);
+			const uint64_t start = now_ns();
+			if constexpr (compress) {
+				CompressFile(paths_[i], options_);
+			}
+			else {
+				FormatFile(paths_[i], dlfmt_param::auto_format);
+			}
+			elapsed += now_ns() - start;
+		}
+		return elapsed;
+	}
+
+private:
+	std::filesystem::path    directory_;
+	std::vector<std::string> paths_;
+	dlfmt_compress_options   options_;
+};
+
+enum class WriteSink : uint8_t
+{
+	Ostream,
+	Fd,
+	Mmap,
+};
+
+/**
+ * @brief 把格式化结果经不同的 sink 写入临时文件，计时包括打开、打印与关闭
+ *
+ */
+template<WriteSink sink> class WriteBenchmark : public Benchmark
+{
+public:
+	~WriteBenchmark() override
+	{
+		if (!directory_.empty()) {
+			std::error_code ec;
+			std::filesystem::remove_all(directory_, ec);
+		}
+	}
+
+	const char* Name() const override
+	{
+		switch (sink) {
+		case WriteSink::Ostream: return "write/ofstream";
+		case WriteSink::Fd: return "write/fd";
+		default: return "write/mmap";
+		}
+	}
+
+	size_t Prepare(const std::vector<CorpusFile>& corpus) override
+	{
+		directory_ = std::filesystem::temp_directory_path() /
+					 ("dl_bench-" + std::to_string(now_ns()));
+		std::filesystem::create_directories(directory_);
+		size_t tokens = 0;
+		tokenizers_   = tokenize_corpus<TokenizeMode::FormatAuto>(corpus, tokens);
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			paths_.push_back((directory_ / (std::to_string(i) + ".lua")).string());
+			managers_.push_back(std::make_unique<AstManager>());
+			Parser parser(tokenizers_[i]->getTokens(), corpus[i].path, *managers_.back());
+			roots_.push_back(parser.GetAstRoot());
+		}
+		return tokens;
+	}
+
+	uint64_t Run(const std::vector<CorpusFile>& corpus) override
+	{
+		const uint64_t start = now_ns();
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			const auto* comments = &tokenizers_[i]->getCommentTokens();
+			if constexpr (sink == WriteSink::Ostream) {
+				std::ofstream out(paths_[i], std::ios::binary | std::ios::trunc);
+				AstPrinter<AstPrintMode::Auto> printer(out, comments);
+				printer.PrintAst(roots_[i]);
+			}
+			else if constexpr (sink == WriteSink::Fd) {
+				FdSink                                 out(paths_[i]);
+				AstPrinter<AstPrintMode::Auto, FdSink> printer(out, comments);
+				printer.PrintAst(roots_[i]);
+				out.Close();
+			}
+			else {
+				// 格式化结果与原文大小相近
+				MmapFileSink out(paths_[i], corpus[i].source.size() + corpus[i].source.size() / 4);
+				AstPrinter<AstPrintMode::Auto, MmapFileSink> printer(out, comments);
+				printer.PrintAst(roots_[i]);
+				out.Close();
+			}
+		}
+		return now_ns() - start;
+	}
+
+private:
+	std::filesystem::path                                             directory_;
+	std::vector<std::string>                                          paths_;
+	std::vector<std::unique_ptr<Tokenizer<TokenizeMode::FormatAuto>>> tokenizers_;
+	std::vector<std::unique_ptr<AstManager>>                          managers_;
+	std::vector<AstNode*>                                             roots_;
+};
+
+static std::vector<std::unique_ptr<Benchmark>> make_benchmarks()
+{
+	std::vector<std::unique_ptr<Benchmark>> benchmarks;
+	benchmarks.push_back(std::make_unique<TokenizeBenchmark<TokenizeMode::Compress>>());
+	benchmarks.push_back(std::make_unique<TokenizeBenchmark<TokenizeMode::FormatAuto>>());
+	benchmarks.push_back(std::make_unique<TokenizeBenchmark<TokenizeMode::FormatManual>>());
+	benchmarks.push_back(std::make_unique<ParseBenchmark>());
+	benchmarks.push_back(std::make_unique<PrintBenchmark<AstPrintMode::Compress>>());
+	benchmarks.push_back(std::make_unique<PrintBenchmark<AstPrintMode::Auto>>());
+	benchmarks.push_back(std::make_unique<PrintBenchmark<AstPrintMode::Manual>>());
+	benchmarks.push_back(std::make_unique<WriteBenchmark<WriteSink::Ostream>>());
+	benchmarks.push_back(std::make_unique<WriteBenchmark<WriteSink::Fd>>());
+	benchmarks.push_back(std::make_unique<WriteBenchmark<WriteSink::Mmap>>());
+	benchmarks.push_back(std::make_unique<EndToEndBenchmark<false>>());
+	benchmarks.push_back(std::make_unique<EndToEndBenchmark<true>>());
+	return benchmarks;
+}
+
+std::vector<dl_bench_result> RunBenchmarks(const dl_bench_options& options)
+{
+	const auto corpus = load_corpus(options.corpus);
+	if (corpus.empty()) {
+		SPDLOG_ERROR("No .lua files found in corpus '{}'", options.corpus);
+		throw std::invalid_argument("No .lua files found in corpus: " + options.corpus);
+	}
+	size_t bytes = 0;
+	for (const auto& file : corpus) {
+		bytes += file.source.size();
+	}
+	SPDLOG_INFO("{} corpus files, {} bytes.", corpus.size(), bytes);
+
+	// 先准备好全部基准，再轮流运行 ROUNDS 轮，每轮各取同样多的样本。机器的忙闲随时间变化，
+	// 轮流运行使一段忙碌落在各个基准的某几轮上，而不是整个落在某一个基准的全部样本上
+	std::vector<std::unique_ptr<Benchmark>> benchmarks;
+	std::vector<dl_bench_result>            results;
+	std::vector<size_t>                     samples_per_round;
+	for (auto& benchmark : make_benchmarks()) {
+		if (std::string(benchmark->Name()).find(options.filter) == std::string::npos) {
+			continue;
+		}
+		dl_bench_result result;
+		result.name   = benchmark->Name();
+		result.bytes  = bytes;
+		result.tokens = benchmark->Prepare(corpus);
+		// 预热一遍，让缓冲区与页缓存就位，顺便估计一个样本的耗时
+		const uint64_t warmup = std::max(benchmark->Run(corpus), MIN_SAMPLE_NS);
+		samples_per_round.push_back(
+			std::max((options.min_iterations + ROUNDS - 1) / ROUNDS,
+					 static_cast<size_t>(options.min_time_ns / (ROUNDS * warmup) + 1)));
+		benchmarks.push_back(std::move(benchmark));
+		results.push_back(std::move(result));
+	}
+	for (size_t round = 0; round < ROUNDS; ++round) {
+		for (size_t i = 0; i < benchmarks.size(); ++i) {
+			for (size_t sample = 0; sample < samples_per_round[i]; ++sample) {
+				uint64_t elapsed = 0;
+				uint64_t runs    = 0;
+				do {
+					elapsed += benchmarks[i]->Run(corpus);
+					++runs;
+				} while (elapsed < MIN_SAMPLE_NS);
+				results[i].samples_ns.push_back(elapsed / runs);
+			}
+		}
+	}
+	return results;
+}
+
+static uint64_t median(std::vector<uint64_t> samples)
+{
+	const size_t middle = samples.size() / 2;
+	std::nth_element(samples.begin(), samples.begin() + middle, samples.end());
+	return samples[middle];
+}
+
+// 中位数绝对偏差，对个别慢轮不敏感，用来衡量噪声
+static uint64_t median_absolute_deviation(const std::vector<uint64_t>& samples)
+{
+	const uint64_t        middle = median(samples);
+	std::vector<uint64_t> deviations;
+	deviations.reserve(samples.size());
+	for (uint64_t sample : samples) {
+		deviations.push_back(sample > middle ? sample - middle : middle - sample);
+	}
+	return median(std::move(deviations));
+}
+
+static double megabytes_per_second(size_t bytes, uint64_t ns)
+{
+	return ns ? static_cast<double>(bytes) / (1024.0 * 1024.0) * 1e9 / static_cast<double>(ns)
+			  : 0.0;
+}
+
+void PrintResults(const std::vector<dl_bench_result>& results)
+{
+	printf("%-24s %7s %12s %12s %10s %10s\n",
+		   "Benchmark",
+		   "Samples",
+		   "Median ms",
+		   "Min ms",
+		   "MB/s",
+		   "ns/token");
+	for (const auto& result : results) {
+		const uint64_t middle = median(result.samples_ns);
+		const uint64_t fastest =
+			*std::min_element(result.samples_ns.begin(), result.samples_ns.end());
+		printf("%-24s %7zu %12.3f %12.3f %10.1f %10.2f\n",
+			   result.name.c_str(),
+			   result.samples_ns.size(),
+			   static_cast<double>(middle) / 1e6,
+			   static_cast<double>(fastest) / 1e6,
+			   megabytes_per_second(result.bytes, middle),
+			   result.tokens ? static_cast<double>(middle) / static_cast<double>(result.tokens)
+							 : 0.0);
+	}
+}
+
+void SaveBaseline(const std::vector<dl_bench_result>& results, const std::string& path)
+{
+	nlohmann::json benchmarks = nlohmann::json::array();
+	for (const auto& result : results) {
+		const uint64_t middle = median(result.samples_ns);
+		benchmarks.push_back({{"name", result.name},
+							  {"bytes", result.bytes},
+							  {"tokens", result.tokens},
+							  {"median_ns", middle},
+							  {"mad_ns", median_absolute_deviation(result.samples_ns)},
+							  {"mb_per_s", megabytes_per_second(result.bytes, middle)},
+							  {"samples_ns", result.samples_ns}});
+	}
+	nlohmann::json baseline;
+	baseline["version"]    = 1;
+	baseline["benchmarks"] = std::move(benchmarks);
+	write_file(path, baseline.dump(2) + "\n");
+	SPDLOG_INFO("Saved baseline of {} benchmarks to '{}'.", results.size(), path);
+}
+
+std::vector<dl_bench_result> LoadBaseline(const std::string& path)
+{
+	nlohmann::json baseline;
+	try {
+		baseline = nlohmann::json::parse(read_file(path));
+	}
+	catch (const nlohmann::json::exception& e) {
+		SPDLOG_ERROR("Failed to parse baseline '{}': {}", path, e.what());
+		throw std::runtime_error("Failed to parse baseline: " + path);
+	}
+	if (baseline.value("version", 0) != 1 || !baseline["benchmarks"].is_array()) {
+		SPDLOG_ERROR("'{}' is not a dl_bench baseline", path);
+		throw std::runtime_error("Not a dl_bench baseline: " + path);
+	}
+	std::vector<dl_bench_result> results;
+	for (const auto& benchmark : baseline["benchmarks"]) {
+		dl_bench_result result;
+		result.name       = benchmark.at("name").get<std::string>();
+		result.bytes      = benchmark.at("bytes").get<size_t>();
+		result.tokens     = benchmark.at("tokens").get<size_t>();
+		result.samples_ns = benchmark.at("samples_ns").get<std::vector<uint64_t>>();
+		if (result.samples_ns.empty()) {
+			SPDLOG_ERROR("Benchmark '{}' in baseline '{}' has no samples", result.name, path);
+			throw std::runtime_error("Baseline benchmark without samples: " + result.name);
+		}
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+/**
+ * @brief Mann-Whitney U 检验的双侧 p 值，用带连续性校正与结校正的正态近似
+ *
+ * 不假设耗时服从正态分布，少数受干扰的慢轮也不会让结果失真。
+ */
+static double mann_whitney_p(const std::vector<uint64_t>& first,
+							 const std::vector<uint64_t>& second)
+{
+	std::vector<std::pair<uint64_t, bool>> merged;
+	merged.reserve(first.size() + second.size());
+	for (uint64_t sample : first) {
+		merged.emplace_back(sample, true);
+	}
+	for (uint64_t sample : second) {
+		merged.emplace_back(sample, false);
+	}
+	std::sort(merged.begin(), merged.end());
+
+	// 相同的值取平均秩，同时累计结校正项
+	const double n          = static_cast<double>(merged.size());
+	double       rank_sum   = 0.0;
+	double       tie_adjust = 0.0;
+	for (size_t begin = 0; begin < merged.size();) {
+		size_t end = begin;
+		while (end < merged.size() && merged[end].first == merged[begin].first) {
+			++end;
+		}
+		const double rank = static_cast<double>(begin + end + 1) / 2.0;
+		for (size_t i = begin; i < end; ++i) {
+			if (merged[i].second) {
+				rank_sum += rank;
+			}
+		}
+		const double ties = static_cast<double>(end - begin);
+		tie_adjust += ties * ties * ties - ties;
+		begin = end;
+	}
+
+	const double n1       = static_cast<double>(first.size());
+	const double n2       = static_cast<double>(second.size());
+	const double u        = rank_sum - n1 * (n1 + 1.0) / 2.0;
+	const double mean     = n1 * n2 / 2.0;
+	const double variance = n1 * n2 / 12.0 * ((n + 1.0) - tie_adjust / (n * (n - 1.0)));
+	if (variance <= 0.0) {
+		return 1.0;
+	}
+	const double z = std::max(0.0, std::abs(u - mean) - 0.5) / std::sqrt(variance);
+	return std::erfc(z / std::sqrt(2.0));
+}
+
+/**
+ * @brief 把样本按顺序分成 ROUNDS 组，返回各组的中位数，RunBenchmarks 的样本每组恰好是一轮
+ *
+ * 同一段时间里的样本并不独立，样本成千上万时，两次运行间微小的系统性差别也会被检验判为显著。
+ * 分组后检验的是十来个数，只有大部分轮都变慢时才显著。
+ */
+static std::vector<uint64_t> round_medians(const std::vector<uint64_t>& samples)
+{
+	if (samples.size() <= ROUNDS) {
+		return samples;
+	}
+	std::vector<uint64_t> medians;
+	medians.reserve(ROUNDS);
+	for (size_t i = 0; i < ROUNDS; ++i) {
+		const size_t begin = samples.size() * i / ROUNDS;
+		const size_t end   = samples.size() * (i + 1) / ROUNDS;
+		medians.push_back(median({samples.begin() + begin, samples.begin() + end}));
+	}
+	return medians;
+}
+
+std::vector<dl_bench_comparison> CompareResults(const std::vector<dl_bench_result>& baseline,
+												const std::vector<dl_bench_result>& current,
+												const dl_bench_options&             options)
+{
+	std::vector<dl_bench_comparison> comparisons;
+	for (const auto& result : current) {
+		const auto old = std::find_if(baseline.begin(),
+									  baseline.end(),
+									  [&](const dl_bench_result& base) {
+										  return base.name == result.name;
+									  });
+		if (old == baseline.end()) {
+			SPDLOG_WARN("Benchmark '{}' is not in the baseline", result.name);
+			continue;
+		}
+		dl_bench_comparison comparison;
+		comparison.name        = result.name;
+		comparison.baseline_ns = median(old->samples_ns);
+		comparison.current_ns  = median(result.samples_ns);
+		comparison.change      = comparison.baseline_ns
+									 ? static_cast<double>(comparison.current_ns) /
+										   static_cast<double>(comparison.baseline_ns) -
+										   1.0
+									 : 0.0;
+		if (old->bytes != result.bytes || old->tokens != result.tokens) {
+			// 语料变了，耗时的变化说明不了什么
+			SPDLOG_WARN("Benchmark '{}' ran on {} bytes and {} tokens, the baseline on {} bytes "
+						"and {} tokens",
+						result.name,
+						result.bytes,
+						result.tokens,
+						old->bytes,
+						old->tokens);
+			comparison.incomparable = true;
+			comparisons.push_back(std::move(comparison));
+			continue;
+		}
+		comparison.p_value = mann_whitney_p(round_medians(old->samples_ns),
+											round_medians(result.samples_ns));
+		comparisons.push_back(std::move(comparison));
+	}
+
+	// 一次比较十几个基准，每个都按 alpha 检验的话，总有一个会碰巧显著。
+	// 按 Bonferroni 校正把 alpha 平分给参与检验的基准，alpha 成为整次比较误报的上限
+	const auto tested = std::count_if(comparisons.begin(),
+									  comparisons.end(),
+									  [](const dl_bench_comparison& comparison) {
+										  return !comparison.incomparable;
+									  });
+	for (auto& comparison : comparisons) {
+		if (comparison.incomparable) {
+			continue;
+		}
+		const bool significant = comparison.p_value < options.alpha / static_cast<double>(tested);
+		comparison.regression  = significant && comparison.change > options.threshold;
+		comparison.improvement = significant && comparison.change < -options.threshold;
+	}
+	return comparisons;
+}
+
+size_t PrintComparison(const std::vector<dl_bench_comparison>& comparisons)
+{
+	printf("%-24s %12s %12s %9s %8s  %s\n",
+		   "Benchmark",
+		   "Base ms",
+		   "Median ms",
+		   "Change",
+		   "p",
+		   "Verdict");
+	size_t regressions = 0;
+	for (const auto& comparison : comparisons) {
+		if (comparison.incomparable) {
+			printf("%-24s %12.3f %12.3f %9s %8s  %s\n",
+				   comparison.name.c_str(),
+				   static_cast<double>(comparison.baseline_ns) / 1e6,
+				   static_cast<double>(comparison.current_ns) / 1e6,
+				   "-",
+				   "-",
+				   "incomparable");
+			continue;
+		}
+		const char* verdict = "same";
+		if (comparison.regression) {
+			verdict = "REGRESSION";
+			++regressions;
+		}
+		else if (comparison.improvement) {
+			verdict = "faster";
+		}
+		printf("%-24s %12.3f %12.3f %+8.1f%% %8.4f  %s\n",
+			   comparison.name.c_str(),
+			   static_cast<double>(comparison.baseline_ns) / 1e6,
+			   static_cast<double>(comparison.current_ns) / 1e6,
+			   comparison.change * 100.0,
+			   comparison.p_value,
+			   verdict);
+	}
+	return regressions;
+}
+
+/**
+ * @brief 目录的一份副本，每轮开始前用内存中的原始内容覆盖，保证每轮处理的输入相同
+ *
+ */
+class ScratchTree
+{
+public:
+	ScratchTree(const std::string& source, const std::string& scratch)
+	{
+		std::filesystem::path base = scratch;
+		if (base.empty()) {
+			// 放在 tmpfs 上，读写副本不受磁盘影响
+			base = std::filesystem::is_directory("/dev/shm")
+					   ? std::filesystem::path("/dev/shm")
+					   : std::filesystem::temp_directory_path();
+		}
+		root_ = base / ("dl_bench-scaling-" + std::to_string(now_ns()));
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(source)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".lua") {
+				const auto target = root_ / std::filesystem::relative(entry.path(), source);
+				std::filesystem::create_directories(target.parent_path());
+				files_.push_back({target.string(), read_file(entry.path().string())});
+			}
+		}
+	}
+	~ScratchTree()
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(root_, ec);
+	}
+	ScratchTree(const ScratchTree&)            = delete;
+	ScratchTree& operator=(const ScratchTree&) = delete;
+
+	void Restore() const
+	{
+		for (const auto& file : files_) {
+			write_file(file.path, file.source);
+		}
+	}
+
+	std::string Root() const { return root_.string(); }
+	size_t      FileCount() const noexcept { return files_.size(); }
+
+private:
+	std::filesystem::path   root_;
+	std::vector<CorpusFile> files_;
+};
+
+std::vector<dl_bench_scaling_result> RunScaling(const dl_bench_scaling_options& options)
+{
+	const ScratchTree tree(options.directory, options.scratch);
+	if (tree.FileCount() == 0) {
+		SPDLOG_ERROR("No .lua files found in '{}'", options.directory);
+		throw std::invalid_argument("No .lua files found in: " + options.directory);
+	}
+	const int max_threads = options.max_threads > 0
+								? options.max_threads
+								: static_cast<int>(ThreadPool::DefaultThreads());
+	SPDLOG_INFO("{} files copied to '{}', up to {} threads.",
+				tree.FileCount(),
+				tree.Root(),
+				max_threads);
+
+	std::vector<int> thread_counts;
+	for (int threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+
+	// 用统计得到各线程处理文件的时间，目录任务自己的日志在这里没有意义
+	auto& stats = Stats::Instance();
+	stats.Enable();
+	const auto level = spdlog::get_level();
+	spdlog::set_level(spdlog::level::warn);
+
+	struct Run
+	{
+		uint64_t              wall_ns;
+		std::vector<uint64_t> idle_ns;
+	};
+	std::vector<dl_bench_scaling_result> results;
+	for (int threads : thread_counts) {
+		ThreadPool::Configure(static_cast<size_t>(threads));
+		std::vector<Run> runs;
+		// 第一轮只用来预热
+		for (size_t i = 0; i <= options.iterations; ++i) {
+			tree.Restore();
+			stats.Reset();
+			const uint64_t start = now_ns();
+			if (options.compress) {
+				CompressDirectory(tree.Root(), dlfmt_compress_options{});
+			}
+			else {
+				FormatDirectory(tree.Root(), dlfmt_param::auto_format);
+			}
+			const uint64_t wall = now_ns() - start;
+			if (i == 0) {
+				continue;
+			}
+			Run run{wall, stats.ThreadBusyNs(static_cast<size_t>(threads))};
+			for (auto& busy : run.idle_ns) {
+				busy = busy < wall ? wall - busy : 0;
+			}
+			runs.push_back(std::move(run));
+		}
+		std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) {
+			return a.wall_ns < b.wall_ns;
+		});
+		dl_bench_scaling_result result;
+		result.threads = threads;
+		for (const auto& run : runs) {
+			result.samples_ns.push_back(run.wall_ns);
+		}
+		result.idle_ns = std::move(runs[runs.size() / 2].idle_ns);
+		results.push_back(std::move(result));
+	}
+	ThreadPool::Configure(0);
+	spdlog::set_level(level);
+	return results;
+}
+
+void PrintScaling(const std::vector<dl_bench_scaling_result>& results)
+{
+	if (results.empty()) {
+		return;
+	}
+	// 以单线程的结果为基准，samples 已按耗时排好序
+	const auto wall_of = [](const dl_bench_scaling_result& result) {
+		return static_cast<double>(result.samples_ns[result.samples_ns.size() / 2]);
+	};
+	const double serial = wall_of(results.front());
+	printf("%7s %12s %9s %11s %30s\n",
+		   "Threads",
+		   "Wall ms",
+		   "Speedup",
+		   "Efficiency",
+		   "Idle ms per thread min/avg/max");
+	for (const auto& result : results) {
+		const double wall    = wall_of(result);
+		const double speedup = wall > 0 ? serial / wall : 0.0;
+		uint64_t     total   = 0;
+		for (uint64_t idle : result.idle_ns) {
+			total += idle;
+		}
+		const auto [least, most] =
+			std::minmax_element(result.idle_ns.begin(), result.idle_ns.end());
+		printf("%7d %12.3f %8.2fx %10.1f%% %10.3f / %7.3f / %7.3f\n",
+			   result.threads,
+			   wall / 1e6,
+			   speedup,
+			   100.0 * speedup / result.threads,
+			   static_cast<double>(*least) / 1e6,
+			   static_cast<double>(total) / static_cast<double>(result.idle_ns.size()) / 1e6,
+			   static_cast<double>(*most) / 1e6);
+	}
+}
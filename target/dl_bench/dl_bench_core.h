@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct dl_bench_options{
+    // 语料文件或目录，目录下的 .lua 文件都会用到
+    std::string corpus;
+    // 只运行名字中含有该子串的基准，为空时全部运行
+    std::string filter;
+    // 每个基准至少取的样本数
+    size_t min_iterations = 5;
+    // 每个基准大约运行的总时间
+    uint64_t min_time_ns = 500'000'000;
+    // 中位耗时变慢超过该比例，且检验显著时判为退化
+    double threshold = 0.05;
+    // Mann-Whitney U 检验的显著性水平，由参与比较的基准平分
+    double alpha = 0.05;
+};
+
+struct dl_bench_result{
+    std::string name;
+    // 每轮处理的字节数与 token 数
+    size_t bytes = 0;
+    size_t tokens = 0;
+    // 每个样本为连续几遍的平均耗时，只计计时部分，几遍加起来不短于 1ms
+    std::vector<uint64_t> samples_ns;
+};
+
+struct dl_bench_comparison{
+    std::string name;
+    // 基线与本次的中位耗时
+    uint64_t baseline_ns = 0;
+    uint64_t current_ns = 0;
+    // 中位耗时的相对变化，正数表示变慢
+    double change = 0.0;
+    // 两边各轮样本的中位数来自同一分布的双侧 p 值
+    double p_value = 1.0;
+    bool regression = false;
+    bool improvement = false;
+    // 语料与基线不同，不做检验，也不计入退化
+    bool incomparable = false;
+};
+
+struct dl_bench_scaling_options{
+    // 要处理的目录，只读取，不会被改写
+    std::string directory;
+    // 为 true 时运行 CompressDirectory，否则运行 FormatDirectory
+    bool compress = false;
+    // 最多使用的线程数，为 0 时取进程可用的 CPU 数
+    int max_threads = 0;
+    // 存放副本的目录，为空时优先使用 /dev/shm，其次是系统临时目录
+    std::string scratch;
+    // 每种线程数运行的轮数
+    size_t iterations = 5;
+};
+
+struct dl_bench_scaling_result{
+    int threads = 0;
+    // 每轮的墙钟时间
+    std::vector<uint64_t> samples_ns;
+    // 墙钟时间居中的那一轮里，各线程没有在处理文件的时间
+    std::vector<uint64_t> idle_ns;
+};
+
+/**
+ * @brief 依次运行各个基准，每轮处理一遍全部语料
+ *
+ */
+std::vector<dl_bench_result> RunBenchmarks(const dl_bench_options& options);
+
+/**
+ * @brief 打印每个基准的中位耗时、吞吐量与每个 token 的耗时
+ *
+ */
+void PrintResults(const std::vector<dl_bench_result>& results);
+
+/**
+ * @brief 把每个基准的中位耗时、MAD、吞吐量与全部样本写成 JSON 基线
+ *
+ */
+void SaveBaseline(const std::vector<dl_bench_result>& results, const std::string& path);
+
+/**
+ * @brief 读取 SaveBaseline 写出的基线
+ *
+ */
+std::vector<dl_bench_result> LoadBaseline(const std::string& path);
+
+/**
+ * @brief 逐个比较两边都有的基准，变慢超过阈值且 U 检验显著的记为退化。
+ * 两边的样本先按轮取中位数，样本再多，检验的也只是十来个数；alpha 由各基准平分
+ *
+ */
+std::vector<dl_bench_comparison> CompareResults(const std::vector<dl_bench_result>& baseline,
+												const std::vector<dl_bench_result>& current,
+												const dl_bench_options&             options);
+
+/**
+ * @brief 打印与基线的对比，返回退化的基准数，不可比的基准不算在内
+ *
+ */
+size_t PrintComparison(const std::vector<dl_bench_comparison>& comparisons);
+
+/**
+ * @brief 分别用 1、2、4 直到 max_threads 个线程处理目录的副本
+ *
+ */
+std::vector<dl_bench_scaling_result> RunScaling(const dl_bench_scaling_options& options);
+
+/**
+ * @brief 打印每种线程数的墙钟时间、加速比、并行效率与各线程的空闲时间
+ *
+ */
+void PrintScaling(const std::vector<dl_bench_scaling_result>& results);
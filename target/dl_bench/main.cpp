@@ -0,0 +1,194 @@
+#include "dl_bench_core.h"
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#ifndef DL_BENCH_CORPUS
+#	define DL_BENCH_CORPUS "data"
+#endif
+
+static void ShowHelp()
+{
+	printf(R"(Usage: dl_bench [options]
+Options:
+  --help                     Show this help message and exit
+  --corpus <path>            Lua file or directory to run on, by default bench-corpus in the build
+                             directory: data/all-bench.lua and 512K of code, data and long
+                             strings generated by dl_gen
+  --filter <text>            Only run benchmarks whose name contains the text
+  --min-iterations <n>       Take at least n samples of each benchmark, 5 by default. A sample
+                             averages as many runs as it takes to reach 1 ms
+  --min-time <ms>            Run each benchmark for at least this long, 500 by default
+  --save-baseline <file>     Save median, MAD, throughput and samples of each benchmark as JSON
+  --baseline <file>          Compare against a saved baseline, exit with 1 if any benchmark regressed
+  --threshold <percent>      With --baseline, how much slower counts as a regression, 5 by default
+  --alpha <p>                With --baseline, significance level of the U tests, 0.05 by default,
+                             shared by all compared benchmarks
+  --scaling <dir>            Instead of the benchmarks, format a copy of the directory with 1, 2,
+                             4, ... threads and report speedup, efficiency and idle time per thread
+  --scaling-compress         With --scaling, compress instead of format
+  --max-threads <n>          With --scaling, the largest thread count, the number of CPUs
+                             available to the process by default
+  --scratch <dir>            With --scaling, where to put the copy, /dev/shm if it exists by default
+Benchmarks: tokenize/<mode>, parse, print/<mode>, write/<sink>, format-file, compress-file
+)");
+}
+
+int main(int argc, char* argv[])
+{
+	const auto console = spdlog::stdout_color_mt("console");
+	console->set_pattern("[%^%l %s:%#%$] %v");
+	spdlog::set_default_logger(console);
+	dl_bench_options         options;
+	dl_bench_scaling_options scaling;
+	std::string              baseline_file;
+	std::string              save_baseline_file;
+	options.corpus = DL_BENCH_CORPUS;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--help") {
+			ShowHelp();
+			return 0;
+		}
+		else if (arg == "--corpus") {
+			if (i + 1 < argc) {
+				options.corpus = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No path specified after --corpus");
+				return 1;
+			}
+		}
+		else if (arg == "--filter") {
+			if (i + 1 < argc) {
+				options.filter = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No text specified after --filter");
+				return 1;
+			}
+		}
+		else if (arg == "--min-iterations") {
+			if (i + 1 < argc) {
+				options.min_iterations = std::strtoul(argv[++i], nullptr, 10);
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --min-iterations");
+				return 1;
+			}
+		}
+		else if (arg == "--min-time") {
+			if (i + 1 < argc) {
+				options.min_time_ns = std::strtoull(argv[++i], nullptr, 10) * 1'000'000;
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --min-time");
+				return 1;
+			}
+		}
+		else if (arg == "--save-baseline") {
+			if (i + 1 < argc) {
+				save_baseline_file = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --save-baseline");
+				return 1;
+			}
+		}
+		else if (arg == "--baseline") {
+			if (i + 1 < argc) {
+				baseline_file = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --baseline");
+				return 1;
+			}
+		}
+		else if (arg == "--threshold") {
+			if (i + 1 < argc) {
+				options.threshold = std::strtod(argv[++i], nullptr) / 100.0;
+			}
+			else {
+				SPDLOG_ERROR("No percentage specified after --threshold");
+				return 1;
+			}
+		}
+		else if (arg == "--alpha") {
+			if (i + 1 < argc) {
+				options.alpha = std::strtod(argv[++i], nullptr);
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --alpha");
+				return 1;
+			}
+		}
+		else if (arg == "--scaling") {
+			if (i + 1 < argc) {
+				scaling.directory = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No directory specified after --scaling");
+				return 1;
+			}
+		}
+		else if (arg == "--scaling-compress") {
+			scaling.compress = true;
+		}
+		else if (arg == "--max-threads") {
+			if (i + 1 < argc) {
+				scaling.max_threads = std::atoi(argv[++i]);
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --max-threads");
+				return 1;
+			}
+		}
+		else if (arg == "--scratch") {
+			if (i + 1 < argc) {
+				scaling.scratch = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No directory specified after --scratch");
+				return 1;
+			}
+		}
+		else {
+			SPDLOG_ERROR("Unknown option: {}", arg);
+			return 1;
+		}
+	}
+
+	try {
+		if (!scaling.directory.empty()) {
+			scaling.iterations = options.min_iterations;
+			PrintScaling(RunScaling(scaling));
+		}
+		else {
+			// 先读基线，文件有问题时不必白跑一遍
+			const auto baseline = baseline_file.empty() ? std::vector<dl_bench_result>{}
+														: LoadBaseline(baseline_file);
+			const auto results = RunBenchmarks(options);
+			PrintResults(results);
+			if (!save_baseline_file.empty()) {
+				SaveBaseline(results, save_baseline_file);
+			}
+			if (!baseline_file.empty()) {
+				printf("\n");
+				const size_t regressions =
+					PrintComparison(CompareResults(baseline, results, options));
+				if (regressions > 0) {
+					SPDLOG_ERROR(
+						"{} benchmarks regressed against '{}'", regressions, baseline_file);
+					return 1;
+				}
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		SPDLOG_ERROR("{}", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,1099 @@
+#include "dl_gen_core.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+void ShowHelp()
+{
+	printf(R"(Usage: dl_gen [options]
+Options:
+  --help                     Show this help message and exit
+  --kind <kind>              code, data, strings, nested or mixed (default)
+  --size <size>              Target size of each file, e.g. 4096, 64K, 10M; 64K by default
+  --seed <n>                 Seed, the same options always give the same output; 1 by default
+  --output <file>            Write to the file instead of stdout
+  --directory <dir>          Write --count files named gen-<i>.lua into the directory
+  --count <n>                Number of files for --directory, seeded seed, seed + 1, ...
+Every file loads in Lua 5.1. Data files also run. Modules are only meant to load: they call
+globals and fields that do not exist, although operands match their operators.
+)");
+}
+
+namespace {
+/**
+ * @brief splitmix64，标准库分布的实现因平台而异，这里自己把随机数映射到区间
+ *
+ */
+class Rng
+{
+public:
+	explicit Rng(uint64_t seed)
+		: state_(seed)
+	{}
+
+	uint64_t Next()
+	{
+		uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+		z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// [0, n)
+	uint32_t Below(uint32_t n) { return static_cast<uint32_t>(Next() % n); }
+
+	// [low, high]
+	int Range(int low, int high) { return low + static_cast<int>(Below(high - low + 1)); }
+
+	bool Chance(uint32_t percent) { return Below(100) < percent; }
+
+	template<typename T, size_t N> const T& Pick(const std::array<T, N>& items)
+	{
+		return items[Below(N)];
+	}
+
+private:
+	uint64_t state_;
+};
+
+constexpr std::array<std::string_view, 48> WORDS = {
+	"hero",   "tower",  "damage", "speed",  "range",   "level",  "unit",   "enemy",
+	"path",   "wave",   "cost",   "sprite", "anim",    "sound",  "target", "bullet",
+	"effect", "state",  "timer",  "count",  "health",  "armor",  "gold",   "bonus",
+	"skill",  "buff",   "slot",   "node",   "frame",   "offset", "scale",  "angle",
+	"radius", "entity", "owner",  "group",  "spawn",   "queue",  "index",  "cache",
+	"config", "layer",  "render", "input",  "handler", "event",  "result", "value"};
+
+constexpr std::array<std::string_view, 12> CJK_WORDS = {
+	"伤害", "攻击速度", "英雄", "防御塔", "敌人", "路径",
+	"技能", "冷却",     "金币", "波次",   "护甲", "生命值"};
+
+constexpr std::array<std::string_view, 12> LIBRARY_CALLS = {"math.floor",
+															"math.max",
+															"math.min",
+															"math.abs",
+															"math.sqrt",
+															"string.format",
+															"string.sub",
+															"table.insert",
+															"table.remove",
+															"tostring",
+															"tonumber",
+															"type"};
+
+constexpr std::array<std::string_view, 13> BINARY_OPERATORS = {
+	"+", "-", "*", "/", "%", "..", "==", "~=", "<", "<=", ">", ">=", "and"};
+
+// 深层嵌套的上限，留足余量，避免超出 Lua 自身的 C 调用层数限制
+constexpr int MAX_NESTING = 48;
+
+class LuaGenerator
+{
+public:
+	LuaGenerator(uint64_t seed, size_t size)
+		: rng_(seed)
+		, size_(size)
+	{
+		out_.reserve(size + 4096);
+	}
+
+	std::string Generate(dl_gen_kind kind)
+	{
+		switch (kind) {
+		case dl_gen_kind::data: data_file(); break;
+		case dl_gen_kind::code:
+		case dl_gen_kind::strings:
+		case dl_gen_kind::nested:
+		case dl_gen_kind::mixed: module_file(kind); break;
+		}
+		return std::move(out_);
+	}
+
+private:
+	bool full() const noexcept { return out_.size() >= size_; }
+
+	void newline()
+	{
+		out_ += '\n';
+		out_.append(static_cast<size_t>(indent_), '\t');
+	}
+
+	// 偶尔省略或多加空格，让格式化有事可做
+	void space()
+	{
+		const uint32_t roll = rng_.Below(100);
+		if (roll < 3) {
+			return;
+		}
+		out_ += roll < 6 ? "  " : " ";
+	}
+
+	std::string name()
+	{
+		std::string result(rng_.Pick(WORDS));
+		if (rng_.Chance(40)) {
+			result += '_';
+			result += rng_.Pick(WORDS);
+		}
+		if (rng_.Chance(15)) {
+			result += std::to_string(rng_.Below(100));
+		}
+		return result;
+	}
+
+	std::string local_name()
+	{
+		if (!locals_.empty() && rng_.Chance(70)) {
+			return locals_[rng_.Below(static_cast<uint32_t>(locals_.size()))];
+		}
+		return name();
+	}
+
+	std::string declare_local()
+	{
+		std::string result = name();
+		locals_.push_back(result);
+		return result;
+	}
+
+	void sentence(int words)
+	{
+		for (int i = 0; i < words; ++i) {
+			if (i) {
+				out_ += ' ';
+			}
+			out_ += rng_.Chance(10) ? rng_.Pick(CJK_WORDS) : rng_.Pick(WORDS);
+		}
+	}
+
+	void comment()
+	{
+		out_ += "-- ";
+		sentence(rng_.Range(2, 10));
+		newline();
+	}
+
+	// ---------- 字面量 ----------
+
+	void number()
+	{
+		switch (rng_.Below(6)) {
+		case 0: out_ += std::to_string(rng_.Below(10)); break;
+		case 1: out_ += std::to_string(rng_.Below(100000)); break;
+		case 2:
+			out_ += std::to_string(rng_.Below(1000));
+			out_ += '.';
+			out_ += std::to_string(rng_.Below(100));
+			break;
+		case 3:
+		{
+			char buffer[16];
+			snprintf(buffer, sizeof(buffer), "0x%X", rng_.Below(0x10000));
+			out_ += buffer;
+			break;
+		}
+		case 4:
+			out_ += std::to_string(rng_.Range(1, 9));
+			out_ += 'e';
+			out_ += std::to_string(rng_.Range(1, 8));
+			break;
+		default:
+			out_ += '.';
+			out_ += std::to_string(rng_.Range(1, 99));
+			break;
+		}
+	}
+
+	void quoted_string()
+	{
+		const char quote = rng_.Chance(70) ? '"' : '\'';
+		out_ += quote;
+		const int words = rng_.Range(1, 6);
+		for (int i = 0; i < words; ++i) {
+			if (i) {
+				out_ += rng_.Chance(10) ? "\\t" : " ";
+			}
+			out_ += rng_.Chance(8) ? rng_.Pick(CJK_WORDS) : rng_.Pick(WORDS);
+			switch (rng_.Below(30)) {
+			case 0: out_ += "\\n"; break;
+			case 1: out_ += quote == '"' ? "\\\"" : "\\'"; break;
+			case 2: out_ += "\\\\"; break;
+			case 3: out_ += "\\065"; break;
+			case 4: out_ += "%d"; break;
+			default: break;
+			}
+		}
+		out_ += quote;
+	}
+
+	/**
+	 * @brief 长字符串，level 大于 0 时内容里会出现 ]]，只有正确匹配等号才能切分
+	 *
+	 */
+	void long_bracket(int level, int lines)
+	{
+		const std::string equals(static_cast<size_t>(level), '=');
+		out_ += '[' + equals + '[';
+		if (rng_.Chance(50)) {
+			out_ += '\n';
+		}
+		for (int line = 0; line < lines; ++line) {
+			sentence(rng_.Range(3, 14));
+			if (level > 0 && rng_.Chance(20)) {
+				out_ += " t[i[1]] = \"]]\"";
+			}
+			out_ += '\n';
+		}
+		out_ += ']' + equals + ']';
+	}
+
+	// ---------- 表达式 ----------
+
+	void primary(int depth)
+	{
+		out_ += local_name();
+		const int suffixes = rng_.Chance(50) ? 0 : rng_.Range(1, 3);
+		for (int i = 0; i < suffixes; ++i) {
+			switch (rng_.Below(4)) {
+			case 0:
+			case 1:
+				out_ += '.';
+				out_ += rng_.Pick(WORDS);
+				break;
+			case 2:
+				out_ += '[';
+				simple_expression(depth + 1);
+				out_ += ']';
+				break;
+			default: call_arguments(depth + 1); break;
+			}
+		}
+	}
+
+	void call_arguments(int depth)
+	{
+		if (rng_.Chance(5)) {
+			out_ += rng_.Chance(50) ? " " : "";
+			quoted_string();
+			return;
+		}
+		out_ += '(';
+		const int count = rng_.Range(0, 3);
+		for (int i = 0; i < count; ++i) {
+			if (i) {
+				out_ += ',';
+				space();
+			}
+			expression(depth + 1);
+		}
+		out_ += ')';
+	}
+
+	void call(int depth)
+	{
+		switch (rng_.Below(3)) {
+		case 0: out_ += rng_.Pick(LIBRARY_CALLS); break;
+		case 1:
+			out_ += local_name();
+			out_ += ':';
+			out_ += rng_.Pick(WORDS);
+			break;
+		default: out_ += local_name(); break;
+		}
+		call_arguments(depth);
+	}
+
+	// 不含二元运算的表达式，用于下标与实参
+	void simple_expression(int depth)
+	{
+		switch (rng_.Below(5)) {
+		case 0: number(); break;
+		case 1: quoted_string(); break;
+		default: primary(depth); break;
+		}
+	}
+
+	// 算术与大小比较的操作数，不会是字符串、表之类一定出错的字面量
+	void numeric_operand(int depth)
+	{
+		if (rng_.Chance(40)) {
+			number();
+		}
+		else {
+			primary(depth);
+		}
+	}
+
+	// .. 的操作数，字符串或数字
+	void concat_operand(int depth)
+	{
+		switch (rng_.Below(3)) {
+		case 0: quoted_string(); break;
+		case 1: number(); break;
+		default: primary(depth); break;
+		}
+	}
+
+	/**
+	 * @brief 二元运算，操作数的字面量类型与运算符相符，如不会出现 "text" - .42
+	 *
+	 */
+	void binary_expression(int depth)
+	{
+		const std::string_view op       = rng_.Pick(BINARY_OPERATORS);
+		const bool             any_type = op == "==" || op == "~=" || op == "and";
+		const auto             operand  = [&] {
+			if (op == "..") {
+				concat_operand(depth + 1);
+			}
+			else if (any_type) {
+				simple_expression(depth + 1);
+			}
+			else {
+				numeric_operand(depth + 1);
+			}
+		};
+		operand();
+		// .. 与 - 两侧必须留空格，否则可能连成畸形数字或注释
+		if (op == ".." || op == "-" || op == "and") {
+			out_ += ' ';
+			out_ += op;
+			out_ += ' ';
+		}
+		else {
+			space();
+			out_ += op;
+			space();
+		}
+		// 只有 and 的右侧是任意表达式，其余的右侧若再接运算，优先级会让类型对不上
+		if (op == "and") {
+			expression(depth + 1);
+		}
+		else {
+			operand();
+		}
+	}
+
+	void expression(int depth)
+	{
+		if (depth > 6) {
+			simple_expression(depth);
+			return;
+		}
+		switch (rng_.Below(16)) {
+		case 0:
+		case 1: number(); break;
+		case 2: quoted_string(); break;
+		case 3: out_ += rng_.Chance(50) ? "true" : (rng_.Chance(50) ? "false" : "nil"); break;
+		case 4: call(depth); break;
+		case 5:
+			// 一元负号后不能紧跟另一个负号，否则成了注释
+			out_ += rng_.Chance(50) ? "not " : (rng_.Chance(50) ? "#" : "-");
+			primary(depth + 1);
+			break;
+		case 6:
+			out_ += '(';
+			expression(depth + 1);
+			out_ += ')';
+			break;
+		case 7: table(depth + 1, 0); break;
+		case 8:
+			if (depth < 3) {
+				function_literal(depth + 1);
+			}
+			else {
+				primary(depth);
+			}
+			break;
+		case 9:
+		case 10:
+		case 11: binary_expression(depth); break;
+		default: primary(depth); break;
+		}
+	}
+
+	void function_literal(int depth)
+	{
+		out_ += "function(";
+		parameters();
+		out_ += ')';
+		++indent_;
+		const size_t scope = locals_.size();
+		block(depth + 1, rng_.Range(1, 3), false);
+		locals_.resize(scope);
+		--indent_;
+		newline();
+		out_ += "end";
+	}
+
+	void parameters()
+	{
+		const int count = rng_.Range(0, 4);
+		for (int i = 0; i < count; ++i) {
+			if (i) {
+				out_ += ", ";
+			}
+			out_ += declare_local();
+		}
+		if (count && rng_.Chance(5)) {
+			out_ += ", ...";
+		}
+	}
+
+	/**
+	 * @brief 表构造，混合列表项、命名字段与方括号键
+	 *
+	 * @param nest 大于 0 时强制向内嵌套这么多层
+	 */
+	void table(int depth, int nest)
+	{
+		if (nest > 0) {
+			out_ += '{';
+			table(depth + 1, nest - 1);
+			out_ += '}';
+			return;
+		}
+		out_ += '{';
+		const int count = depth > 4 ? rng_.Range(0, 2) : rng_.Range(0, 5);
+		for (int i = 0; i < count; ++i) {
+			if (i) {
+				out_ += rng_.Chance(90) ? "," : ";";
+				space();
+			}
+			switch (rng_.Below(3)) {
+			case 0: out_ += rng_.Pick(WORDS); out_ += " = "; break;
+			case 1:
+				out_ += '[';
+				quoted_string();
+				out_ += "] = ";
+				break;
+			default: break;
+			}
+			expression(depth + 1);
+		}
+		out_ += '}';
+	}
+
+	// ---------- 语句 ----------
+
+	void assignment(int depth)
+	{
+		const int targets = rng_.Chance(85) ? 1 : 2;
+		for (int i = 0; i < targets; ++i) {
+			if (i) {
+				out_ += ", ";
+			}
+			out_ += local_name();
+			if (rng_.Chance(50)) {
+				out_ += '.';
+				out_ += rng_.Pick(WORDS);
+			}
+			else if (rng_.Chance(30)) {
+				out_ += '[';
+				simple_expression(depth + 1);
+				out_ += ']';
+			}
+		}
+		space();
+		out_ += '=';
+		space();
+		for (int i = 0; i < targets; ++i) {
+			if (i) {
+				out_ += ", ";
+			}
+			expression(depth + 1);
+		}
+	}
+
+	void local_statement(int depth)
+	{
+		out_ += "local ";
+		// 先生成右侧，避免引用刚声明的名字
+		const int        count = rng_.Chance(80) ? 1 : 2;
+		std::vector<std::string> names;
+		for (int i = 0; i < count; ++i) {
+			names.push_back(name());
+		}
+		for (int i = 0; i < count; ++i) {
+			if (i) {
+				out_ += ", ";
+			}
+			out_ += names[static_cast<size_t>(i)];
+		}
+		if (rng_.Chance(90)) {
+			space();
+			out_ += '=';
+			space();
+			for (int i = 0; i < count; ++i) {
+				if (i) {
+					out_ += ", ";
+				}
+				expression(depth + 1);
+			}
+		}
+		locals_.insert(locals_.end(), names.begin(), names.end());
+	}
+
+	void condition(int depth)
+	{
+		const uint32_t kind = rng_.Below(4);
+		if (kind == 2) {
+			numeric_operand(depth + 1);
+		}
+		else {
+			simple_expression(depth + 1);
+		}
+		switch (kind) {
+		case 0: break;
+		case 1:
+			out_ += rng_.Chance(50) ? " == " : " ~= ";
+			simple_expression(depth + 1);
+			break;
+		case 2:
+			out_ += rng_.Chance(50) ? " < " : " >= ";
+			number();
+			break;
+		default:
+			out_ += rng_.Chance(50) ? " and " : " or ";
+			simple_expression(depth + 1);
+			break;
+		}
+	}
+
+	/**
+	 * @brief 缩进一层生成语句块，返回时作用域内声明的局部变量失效
+	 *
+	 */
+	void body(int depth, int statements, bool in_loop)
+	{
+		++indent_;
+		const size_t scope = locals_.size();
+		block(depth, statements, in_loop);
+		locals_.resize(scope);
+		--indent_;
+		newline();
+	}
+
+	void statement(int depth, bool in_loop)
+	{
+		// 超过深度上限后只生成简单语句
+		const uint32_t roll = depth >= max_depth_ ? rng_.Below(5) : rng_.Below(15);
+		switch (roll) {
+		case 0:
+		case 1: local_statement(depth); break;
+		case 2:
+		case 3: assignment(depth); break;
+		case 4: call(depth); break;
+		case 5:
+		{
+			out_ += "if ";
+			condition(depth);
+			out_ += " then";
+			body(depth + 1, rng_.Range(1, 4), in_loop);
+			const int branches = rng_.Range(0, 2);
+			for (int i = 0; i < branches; ++i) {
+				out_ += "elseif ";
+				condition(depth);
+				out_ += " then";
+				body(depth + 1, rng_.Range(1, 3), in_loop);
+			}
+			if (rng_.Chance(40)) {
+				out_ += "else";
+				body(depth + 1, rng_.Range(1, 3), in_loop);
+			}
+			out_ += "end";
+			break;
+		}
+		case 6:
+		{
+			const std::string index = name();
+			out_ += "for " + index + " = ";
+			if (rng_.Chance(70)) {
+				out_ += "1, ";
+				simple_expression(depth + 1);
+			}
+			else {
+				out_ += '#' + local_name() + ", 1, -1";
+			}
+			out_ += " do";
+			locals_.push_back(index);
+			body(depth + 1, rng_.Range(1, 4), true);
+			locals_.pop_back();
+			out_ += "end";
+			break;
+		}
+		case 7:
+		{
+			const std::string key   = rng_.Chance(50) ? "_" : "k";
+			const std::string value = name();
+			out_ += "for " + key + ", " + value + " in ";
+			out_ += rng_.Chance(50) ? "ipairs(" : "pairs(";
+			out_ += local_name() + ") do";
+			locals_.push_back(value);
+			body(depth + 1, rng_.Range(1, 4), true);
+			locals_.pop_back();
+			out_ += "end";
+			break;
+		}
+		case 8:
+			out_ += "while ";
+			condition(depth);
+			out_ += " do";
+			body(depth + 1, rng_.Range(1, 3), true);
+			out_ += "end";
+			break;
+		case 9:
+			out_ += "repeat";
+			body(depth + 1, rng_.Range(1, 3), true);
+			out_ += "until ";
+			condition(depth);
+			break;
+		case 10:
+			out_ += "do";
+			body(depth + 1, rng_.Range(1, 3), in_loop);
+			out_ += "end";
+			break;
+		case 11:
+		{
+			const std::string function_name = declare_local();
+			out_ += "local function " + function_name + '(';
+			const size_t scope = locals_.size();
+			parameters();
+			out_ += ')';
+			body(depth + 1, rng_.Range(1, 5), false);
+			locals_.resize(scope);
+			out_ += "end";
+			break;
+		}
+		case 12:
+			out_ += "table.sort(" + local_name() + ", function(a, b)";
+			++indent_;
+			newline();
+			out_ += "return a." + std::string(rng_.Pick(WORDS)) + " < b." +
+					std::string(rng_.Pick(WORDS));
+			--indent_;
+			newline();
+			out_ += "end)";
+			break;
+		case 13:
+			out_ += "local " + declare_local() + " = " + local_name() + " .. ";
+			quoted_string();
+			out_ += " .. ";
+			call(depth + 1);
+			break;
+		default: comment(); return;
+		}
+		newline();
+	}
+
+	/**
+	 * @brief 生成若干条语句，最后可能是 return 或循环中的 break，Lua 5.1 要求它们位于块末尾
+	 *
+	 */
+	void block(int depth, int statements, bool in_loop)
+	{
+		newline();
+		for (int i = 0; i < statements; ++i) {
+			statement(depth, in_loop);
+		}
+		if (in_loop && rng_.Chance(15)) {
+			out_ += "break";
+			newline();
+		}
+		else if (rng_.Chance(25)) {
+			out_ += "return";
+			if (rng_.Chance(80)) {
+				out_ += ' ';
+				expression(depth + 1);
+			}
+			newline();
+		}
+		// 去掉最后的换行与缩进，由调用方换行后输出 end
+		while (!out_.empty() && out_.back() == '\t') {
+			out_.pop_back();
+		}
+		if (!out_.empty() && out_.back() == '\n') {
+			out_.pop_back();
+		}
+	}
+
+	// ---------- 顶层 ----------
+
+	void module_function()
+	{
+		if (rng_.Chance(40)) {
+			comment();
+		}
+		const size_t scope = locals_.size();
+		// local function 的名字在函数体内与之后都可见
+		std::string  declared;
+		switch (rng_.Below(3)) {
+		case 0: out_ += "function M." + name() + '('; break;
+		case 1:
+			out_ += "function M:" + name() + '(';
+			locals_.push_back("self");
+			break;
+		default:
+			declared = name();
+			locals_.push_back(declared);
+			out_ += "local function " + declared + '(';
+			break;
+		}
+		parameters();
+		out_ += ')';
+		// 剩余空间不多时函数写短、写浅一些，小文件才不会超出目标太多
+		const bool small = size_ - out_.size() < 2048;
+		max_depth_       = small ? 2 : DEFAULT_MAX_DEPTH;
+		body(1, small ? rng_.Range(1, 3) : rng_.Range(3, 10), false);
+		max_depth_ = DEFAULT_MAX_DEPTH;
+		locals_.resize(scope);
+		if (!declared.empty()) {
+			locals_.push_back(declared);
+		}
+		out_ += "end";
+		newline();
+		newline();
+	}
+
+	void strings_chunk()
+	{
+		switch (rng_.Below(4)) {
+		case 0:
+			out_ += "--";
+			long_bracket(rng_.Range(0, 2), rng_.Range(2, 12));
+			break;
+		case 1:
+			out_ += "local " + declare_local() + " = ";
+			long_bracket(rng_.Range(0, 3), rng_.Range(4, 40));
+			break;
+		case 2:
+			out_ += "M." + name() + " = ";
+			for (int i = rng_.Range(2, 8); i > 0; --i) {
+				quoted_string();
+				if (i > 1) {
+					out_ += " ..";
+					++indent_;
+					newline();
+					--indent_;
+				}
+			}
+			break;
+		default:
+			out_ += "local " + declare_local() + " = string.format(";
+			quoted_string();
+			for (int i = rng_.Range(1, 4); i > 0; --i) {
+				out_ += ", ";
+				quoted_string();
+			}
+			out_ += ')';
+			break;
+		}
+		newline();
+		newline();
+	}
+
+	void nested_chunk()
+	{
+		max_depth_ = rng_.Range(MAX_NESTING / 2, MAX_NESTING);
+		switch (rng_.Below(3)) {
+		case 0:
+		{
+			// 一层套一层的语句，每层只有一条语句以保持体积可控
+			const size_t scope = locals_.size();
+			out_ += "function M." + name() + "()";
+			nested_statement(1);
+			locals_.resize(scope);
+			out_ += "end";
+			break;
+		}
+		case 1:
+			out_ += "local " + declare_local() + " = ";
+			table(0, max_depth_);
+			break;
+		default:
+			out_ += "local " + declare_local() + " = ";
+			for (int i = 0; i < max_depth_; ++i) {
+				out_ += '(';
+				number();
+				out_ += rng_.Chance(50) ? " + " : " * ";
+			}
+			number();
+			out_.append(static_cast<size_t>(max_depth_), ')');
+			break;
+		}
+		max_depth_ = DEFAULT_MAX_DEPTH;
+		newline();
+		newline();
+	}
+
+	void nested_statement(int depth)
+	{
+		++indent_;
+		newline();
+		if (depth >= max_depth_) {
+			assignment(depth);
+		}
+		else {
+			switch (rng_.Below(4)) {
+			case 0:
+				out_ += "if ";
+				condition(depth);
+				out_ += " then";
+				nested_statement(depth + 1);
+				out_ += "end";
+				break;
+			case 1:
+				out_ += "for i = 1, 10 do";
+				nested_statement(depth + 1);
+				out_ += "end";
+				break;
+			case 2:
+				out_ += "while ";
+				condition(depth);
+				out_ += " do";
+				nested_statement(depth + 1);
+				out_ += "end";
+				break;
+			default:
+				out_ += "local " + declare_local() + " = function()";
+				nested_statement(depth + 1);
+				out_ += "end";
+				break;
+			}
+		}
+		--indent_;
+		newline();
+	}
+
+	/**
+	 * @brief 类似 go_towers.lua 的配置项，字段名固定、数值随机，嵌套若干层
+	 *
+	 */
+	void data_record(int depth)
+	{
+		out_ += '{';
+		++indent_;
+		const int fields = depth == 0 ? rng_.Range(4, 12) : rng_.Range(1, 6);
+		for (int i = 0; i < fields; ++i) {
+			newline();
+			switch (rng_.Below(depth < 3 ? 8 : 6)) {
+			case 0:
+			case 1: out_ += std::string(rng_.Pick(WORDS)) + " = "; number(); break;
+			case 2:
+				out_ += std::string(rng_.Pick(WORDS)) + " = ";
+				quoted_string();
+				break;
+			case 3:
+				out_ += rng_.Pick(WORDS);
+				out_ += rng_.Chance(50) ? " = true" : " = false";
+				break;
+			case 4:
+				// 坐标之类的数字数组
+				out_ += std::string(rng_.Pick(WORDS)) + " = {";
+				for (int j = rng_.Range(2, 16); j > 0; --j) {
+					if (rng_.Chance(20)) {
+						out_ += '-';
+					}
+					number();
+					out_ += j > 1 ? ", " : "";
+				}
+				out_ += '}';
+				break;
+			case 5:
+				out_ += "[";
+				out_ += std::to_string(rng_.Below(1000));
+				out_ += "] = ";
+				quoted_string();
+				break;
+			default:
+				out_ += std::string(rng_.Pick(WORDS)) + " = ";
+				data_record(depth + 1);
+				break;
+			}
+			out_ += ',';
+		}
+		--indent_;
+		newline();
+		out_ += '}';
+	}
+
+	void data_file()
+	{
+		out_ += "-- generated data file";
+		newline();
+		out_ += "return {";
+		++indent_;
+		while (!full()) {
+			newline();
+			switch (rng_.Below(4)) {
+			case 0: out_ += name() + " = "; break;
+			case 1:
+				out_ += "[\"";
+				out_ += name();
+				out_ += "\"] = ";
+				break;
+			default: break;
+			}
+			data_record(0);
+			out_ += ',';
+		}
+		--indent_;
+		newline();
+		out_ += "}\n";
+	}
+
+	void module_file(dl_gen_kind kind)
+	{
+		out_ += "-- generated module";
+		newline();
+		out_ += "local M = {}";
+		newline();
+		for (int i = rng_.Range(1, 4); i > 0; --i) {
+			const std::string_view library = rng_.Pick(LIBRARY_CALLS);
+			std::string            alias(library);
+			for (auto& c : alias) {
+				c = c == '.' ? '_' : c;
+			}
+			// 同一个库函数只取一次别名
+			if (std::find(locals_.begin(), locals_.end(), alias) != locals_.end()) {
+				continue;
+			}
+			out_ += "local " + alias + " = " + std::string(library);
+			locals_.push_back(alias);
+			newline();
+		}
+		newline();
+		// Lua 5.1 的主函数最多有 200 个局部变量，函数最多引用 60 个上值。顶层每声明 SECTION_LOCALS
+		// 个局部变量，就把之后的代码放进新的 do ... end，上一段的局部变量随之失效
+		size_t section_scope = locals_.size();
+		bool   in_section    = false;
+		while (!full()) {
+			if (locals_.size() - section_scope >= SECTION_LOCALS) {
+				// 第一段不在 do ... end 中，它的局部变量一直可见
+				if (in_section) {
+					end_section();
+					locals_.resize(section_scope);
+				}
+				section_scope = locals_.size();
+				in_section    = true;
+				out_ += "do";
+				++indent_;
+				newline();
+			}
+			dl_gen_kind chunk = kind;
+			if (kind == dl_gen_kind::mixed) {
+				const uint32_t roll = rng_.Below(100);
+				chunk               = roll < 55   ? dl_gen_kind::code
+									  : roll < 75 ? dl_gen_kind::data
+									  : roll < 92 ? dl_gen_kind::strings
+												  : dl_gen_kind::nested;
+			}
+			switch (chunk) {
+			case dl_gen_kind::strings: strings_chunk(); break;
+			case dl_gen_kind::nested: nested_chunk(); break;
+			case dl_gen_kind::data:
+				out_ += "M." + name() + " = ";
+				data_record(1);
+				newline();
+				newline();
+				break;
+			default: module_function(); break;
+			}
+		}
+		if (in_section) {
+			end_section();
+		}
+		out_ += "return M\n";
+	}
+
+	/**
+	 * @brief 结束 module_file 中的一段 do ... end，块内最后的空行去掉
+	 *
+	 */
+	void end_section()
+	{
+		--indent_;
+		while (!out_.empty() && (out_.back() == '\t' || out_.back() == '\n')) {
+			out_.pop_back();
+		}
+		newline();
+		out_ += "end";
+		newline();
+		newline();
+	}
+
+	static constexpr int    DEFAULT_MAX_DEPTH = 4;
+	// 每段 do ... end 中顶层局部变量的上限，连同第一段与开头的别名，可见的顶层局部变量不超过 40 个
+	static constexpr size_t SECTION_LOCALS    = 16;
+
+	Rng                      rng_;
+	size_t                   size_;
+	std::string              out_;
+	int                      indent_    = 0;
+	int                      max_depth_ = DEFAULT_MAX_DEPTH;
+	// 当前可见的局部变量，表达式优先引用它们
+	std::vector<std::string> locals_;
+};
+}   // namespace
+
+std::string GenerateLua(const dl_gen_options& options)
+{
+	return LuaGenerator(options.seed, options.size).Generate(options.kind);
+}
+
+bool ParseGenKind(const std::string& text, dl_gen_kind& kind)
+{
+	if (text == "code") {
+		kind = dl_gen_kind::code;
+	}
+	else if (text == "data") {
+		kind = dl_gen_kind::data;
+	}
+	else if (text == "strings") {
+		kind = dl_gen_kind::strings;
+	}
+	else if (text == "nested") {
+		kind = dl_gen_kind::nested;
+	}
+	else if (text == "mixed") {
+		kind = dl_gen_kind::mixed;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+bool ParseGenSize(const std::string& text, size_t& size)
+{
+	size_t position = 0;
+	size_t value    = 0;
+	while (position < text.size() && std::isdigit(static_cast<unsigned char>(text[position]))) {
+		value = value * 10 + static_cast<size_t>(text[position] - '0');
+		++position;
+	}
+	if (position == 0) {
+		return false;
+	}
+	std::string unit = text.substr(position);
+	for (auto& c : unit) {
+		c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	}
+	if (unit.empty() || unit == "B") {
+		size = value;
+	}
+	else if (unit == "K" || unit == "KB") {
+		size = value * 1024;
+	}
+	else if (unit == "M" || unit == "MB") {
+		size = value * 1024 * 1024;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
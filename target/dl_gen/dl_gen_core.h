@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class dl_gen_kind{
+    // 函数、循环、分支与注释为主的模块
+    code,
+    // 类似 go_towers.lua 的巨大嵌套表构造
+    data,
+    // 长字符串、长注释与转义字符串
+    strings,
+    // 深层嵌套的语句、表与表达式
+    nested,
+    // 以上几种按比例混合
+    mixed
+};
+
+struct dl_gen_options{
+    dl_gen_kind kind = dl_gen_kind::mixed;
+    // 目标大小，生成的文件会略微超出
+    size_t size = 64 * 1024;
+    uint64_t seed = 1;
+};
+
+void ShowHelp();
+
+/**
+ * @brief 按种子生成 Lua 源码，同样的参数在任何平台上都生成同样的内容
+ *
+ */
+std::string GenerateLua(const dl_gen_options& options);
+
+/**
+ * @brief 解析 --kind 的取值
+ *
+ * @return false 未知的种类
+ */
+bool ParseGenKind(const std::string& text, dl_gen_kind& kind);
+
+/**
+ * @brief 解析形如 4096、64K、10M、100MB 的大小
+ *
+ * @return false 格式不对
+ */
+bool ParseGenSize(const std::string& text, size_t& size);
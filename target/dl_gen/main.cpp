@@ -0,0 +1,112 @@
+#include "dl_gen_core.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <string>
+
+static bool WriteFile(const std::string& path, const std::string& content)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		SPDLOG_ERROR("Failed to open file: {}", path);
+		return false;
+	}
+	file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const auto console = spdlog::stderr_color_mt("console");
+	console->set_pattern("[%^%l %s:%#%$] %v");
+	spdlog::set_default_logger(console);
+	dl_gen_options options;
+	std::string    output_file;
+	std::string    output_directory;
+	size_t         count = 1;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--help") {
+			ShowHelp();
+			return 0;
+		}
+		else if (arg == "--kind") {
+			if (i + 1 >= argc || !ParseGenKind(argv[++i], options.kind)) {
+				SPDLOG_ERROR("Expected code, data, strings, nested or mixed after --kind");
+				return 1;
+			}
+		}
+		else if (arg == "--size") {
+			if (i + 1 >= argc || !ParseGenSize(argv[++i], options.size)) {
+				SPDLOG_ERROR("Expected a size such as 4096, 64K or 10M after --size");
+				return 1;
+			}
+		}
+		else if (arg == "--seed") {
+			if (i + 1 < argc) {
+				options.seed = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --seed");
+				return 1;
+			}
+		}
+		else if (arg == "--output") {
+			if (i + 1 < argc) {
+				output_file = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --output");
+				return 1;
+			}
+		}
+		else if (arg == "--directory") {
+			if (i + 1 < argc) {
+				output_directory = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No directory specified after --directory");
+				return 1;
+			}
+		}
+		else if (arg == "--count") {
+			if (i + 1 < argc) {
+				count = std::strtoul(argv[++i], nullptr, 10);
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --count");
+				return 1;
+			}
+		}
+		else {
+			SPDLOG_ERROR("Unknown option: {}", arg);
+			return 1;
+		}
+	}
+
+	if (!output_directory.empty()) {
+		std::filesystem::create_directories(output_directory);
+		const uint64_t seed = options.seed;
+		for (size_t i = 0; i < count; ++i) {
+			options.seed           = seed + i;
+			const std::string path = (std::filesystem::path(output_directory) /
+									  ("gen-" + std::to_string(i) + ".lua"))
+										 .string();
+			if (!WriteFile(path, GenerateLua(options))) {
+				return 1;
+			}
+		}
+		SPDLOG_INFO("Generated {} files in '{}'.", count, output_directory);
+		return 0;
+	}
+
+	const std::string content = GenerateLua(options);
+	if (output_file.empty()) {
+		fwrite(content.data(), 1, content.size(), stdout);
+		return 0;
+	}
+	return WriteFile(output_file, content) ? 0 : 1;
+}
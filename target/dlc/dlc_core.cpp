@@ -0,0 +1,115 @@
+#include "dlc_core.h"
+#include "dl/bytecode.h"
+#include "dl/compiler.h"
+#include "dl/mpsc_queue.h"
+#include "dl/parser.h"
+#include "dl/thread_pool.h"
+#include "dl/tokenizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+#include <vector>
+static constexpr const char* VERSION = "0.1.2";
+using namespace dl;
+void ShowHelp()
+{
+	printf(R"(Usage: dlc [options]
+Options:
+  --help                    Show this help message and exit
+  --version                 Show version information and exit
+  --compile-file <file>     Compile the specified file to a Lua 5.1 binary chunk in place
+  --compile-directory <dir> Compile all files in the specified directory recursively
+  --jobs <n>                Number of threads for --compile-directory, 0 (default) for one per
+                            CPU available to the process
+  --param <parameter>       Specify additional parameters for compiling, repeatable
+                            Available parameters: strip
+  still mysterious? find more in https://crazyspotteddove.github.io/projects/dlfmt
+)");
+}
+
+void ShowVersion()
+{
+	printf("dlc version %s\n", VERSION);
+}
+
+void CompileFile(const std::string& compile_file, const dlc_compile_options& options)
+{
+	std::ifstream file(compile_file, std::ios::binary);
+	if (!file) {
+		SPDLOG_ERROR("Failed to open file: {}", compile_file.c_str());
+		throw std::runtime_error("Failed to open file: " + compile_file);
+	}
+
+	file.seekg(0, std::ios::end);
+	const auto size = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+	std::string content;
+	if (size) {
+		content.resize(size);
+		file.read(&content[0], static_cast<std::streamsize>(size));
+	}
+	file.close();
+
+	// 已经是二进制代码块，跳过
+	if (content.compare(0, 4, "\x1bLua") == 0) {
+		SPDLOG_INFO("Skipped precompiled file: {}", compile_file);
+		return;
+	}
+
+	// tokenize
+	Tokenizer<TokenizeMode::Compress> tokenizer(std::move(content), compile_file);
+
+	// parse
+	Parser parser(tokenizer.getTokens(), compile_file);
+
+	// compile
+	Compiler compiler(parser.GetAstRoot(), "@" + compile_file);
+	const std::string chunk = DumpChunk(compiler.GetProto(), options.strip);
+
+	// 写入
+	std::ofstream out_file(compile_file, std::ios::binary | std::ios::trunc);
+	out_file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+	out_file.flush();
+	out_file.close();
+}
+
+void CompileDirectory(const std::string& compile_directory, const dlc_compile_options& options)
+{
+	if (compile_directory.empty()) {
+		SPDLOG_ERROR("No directory specified for compiling.");
+		throw std::invalid_argument("No directory specified for compiling.");
+	}
+
+	// 收集所有 .lua 文件
+	std::vector<std::string> files;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(compile_directory)) {
+		if (entry.is_regular_file()) {
+			const auto& path = entry.path();
+			if (path.has_extension() && path.extension() == ".lua") {
+				files.emplace_back(path.string());
+			}
+		}
+	}
+	SPDLOG_INFO("{} .lua files collected.", files.size());
+
+	// 并行编译，失败的文件先放进无锁队列，编译完按路径顺序统一打印
+	MpscQueue<std::pair<std::string, std::string>> failures;
+	ThreadPool::Global().ParallelFor(files.size(), [&](size_t i) {
+		try {
+			CompileFile(files[i], options);
+		}
+		catch (const std::exception& e) {
+			failures.Push({files[i], e.what()});
+		}
+		catch (...) {
+			failures.Push({files[i], "unknown error"});
+		}
+	});
+	auto failed = failures.Drain();
+	std::sort(failed.begin(), failed.end());
+	for (const auto& [path, reason] : failed) {
+		SPDLOG_ERROR("Compile failed: {} ({})", path, reason);
+	}
+}
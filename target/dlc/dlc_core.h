@@ -0,0 +1,25 @@
+#pragma once
+#include <spdlog/common.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <string>
+
+enum class dlc_mode{
+    show_help,
+    show_version,
+    compile_file,
+    compile_directory
+};
+
+struct dlc_compile_options{
+    // 去掉行号、局部变量名与上值名等调试信息，对应 luac -s
+    bool strip = false;
+};
+
+void ShowHelp();
+
+void ShowVersion();
+
+void CompileFile(const std::string& compile_file, const dlc_compile_options& options);
+
+void CompileDirectory(const std::string& compile_directory, const dlc_compile_options& options);
@@ -0,0 +1,128 @@
+#include "dl/thread_pool.h"
+#include "dl/timer.h"
+#include "dlc_core.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+
+/**
+ * @brief 解析非负整数，整串都须是数字
+ *
+ */
+static bool ParseCount(const char* text, size_t& count)
+{
+	if (*text < '0' || *text > '9') {
+		return false;
+	}
+	char* end = nullptr;
+	errno     = 0;
+	const unsigned long long value = std::strtoull(text, &end, 10);
+	if (*end != '\0' || errno == ERANGE || value > SIZE_MAX) {
+		return false;
+	}
+	count = static_cast<size_t>(value);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const auto console = spdlog::stdout_color_mt("console");
+	console->set_pattern("[%^%l %s:%#%$] %v");
+	spdlog::set_default_logger(console);
+	dlc_mode            work_mode = dlc_mode::show_help;
+	dlc_compile_options compile_options;
+	std::string         file_or_directory;
+	size_t              jobs = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--help") {
+			work_mode = dlc_mode::show_help;
+		}
+		else if (arg == "--version") {
+			work_mode = dlc_mode::show_version;
+		}
+		else if (arg == "--compile-file") {
+			if (i + 1 < argc) {
+				file_or_directory = argv[++i];
+				work_mode         = dlc_mode::compile_file;
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --compile-file");
+				return 1;
+			}
+		}
+		else if (arg == "--compile-directory") {
+			if (i + 1 < argc) {
+				file_or_directory = argv[++i];
+				work_mode         = dlc_mode::compile_directory;
+			}
+			else {
+				SPDLOG_ERROR("No directory specified after --compile-directory");
+				return 1;
+			}
+		}
+		else if (arg == "--jobs") {
+			if (i + 1 < argc && ParseCount(argv[i + 1], jobs)) {
+				++i;
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --jobs");
+				return 1;
+			}
+		}
+		else if (arg == "--param") {
+			if (i + 1 < argc) {
+				std::string param = argv[++i];
+				if (param == "strip") {
+					compile_options.strip = true;
+				}
+				else {
+					SPDLOG_ERROR("Unknown param: {}", param);
+					return 1;
+				}
+			}
+		}
+	}
+
+    if(work_mode == dlc_mode::show_help){
+        ShowHelp();
+        return 0;
+    }
+
+    if(work_mode == dlc_mode::show_version){
+        ShowVersion();
+        return 0;
+    }
+
+    dl::ThreadPool::Configure(jobs);
+
+    int   status = 0;
+    Timer timer;
+    timer.start();
+    try {
+        switch (work_mode) {
+            case dlc_mode::compile_file:{
+                timer.setLabel(fmt::format("Compiled file '{}'", file_or_directory));
+                CompileFile(file_or_directory, compile_options);
+                break;
+            }
+            case dlc_mode::compile_directory:{
+                timer.setLabel(fmt::format("Compiled directory '{}'", file_or_directory));
+                CompileDirectory(file_or_directory, compile_options);
+                break;
+            }
+            default:
+                SPDLOG_ERROR("No valid work mode specified.");
+                return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        // 单个文件编译失败时，解析错误只在这里报告
+        SPDLOG_ERROR("{}", e.what());
+        status = 1;
+    }
+    timer.stop();
+    timer.print();
+    return status;
+}
@@ -1,14 +1,33 @@
 #include "dlfmt_core.h"
 #include "dl/ast_printer.h"
+#include "dl/constant_folder.h"
+#include "dl/dead_code_stripper.h"
+#include "dl/global_hoister.h"
+#include "dl/io_engine.h"
+#include "dl/local_renamer.h"
+#include "dl/memory_budget.h"
+#include "dl/mpsc_queue.h"
 #include "dl/parser.h"
+#include "dl/require_collector.h"
+#include "dl/stats.h"
+#include "dl/thread_pool.h"
 #include "dl/tokenizer.h"
+#include "dl/unified_diff.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <ostream>
+#include <string_view>
 #include <system_error>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 static constexpr const char* VERSION = "0.1.2";
 using namespace dl;
@@ -22,9 +41,37 @@ Options:
   --format-directory <dir>   Format all files in the specified directory recursively
   --compress-file <file>     Compress the specified file
   --compress-directory <dir> Compress all files in the specified directory recursively
+  --bundle-directory <dir>   Compress all files in the specified directory into one file that
+                             registers every module in package.preload, see --output
+  --output <file>            Output file for --bundle-directory
+  --check                    With --format-file, --format-directory or --json-task, format in
+                             memory without writing; list files that would change and exit with 1
+  --diff                     With --check, also print a unified diff for each file that would change
+  --stats                    Print where the time went: per-phase timings, throughput, per-thread
+                             totals and the slowest files
+  --stats-json <file>        Write the --stats report as JSON to the file, - for stdout
+  --stats-top <n>            Number of slowest files in the --stats report, 10 by default
+  --perf-counters            Like --stats, plus cycles, IPC, branch and cache miss rates of the
+                             tokenize, parse and print phases from Linux perf_event counters
+  --trace <file>             Write a Chrome/Perfetto trace with one track per thread and a span
+                             per file and per phase
+  --io <backend>             How --format-directory and --compress-directory read and write files:
+                             auto (default, uring if available), uring, threads or sync
+  --memory-limit <size>      Limit the estimated memory of files being processed at once, and of
+                             read-ahead and write buffers, e.g. 512M; larger files run alone.
+                             An estimate of working memory, not an RSS cap: per-thread buffers
+                             kept between files are not counted. Applies to --format-directory,
+                             --compress-directory and --json-task
+  --jobs <n>                 Number of threads for directory and json tasks, 0 (default) for one
+                             per CPU available to the process
+  --affinity                 Pin each worker thread to one CPU available to the process (Linux)
+  --check-syntax <path>      Check that the file, or every file in the directory recursively,
+                             parses; print each error and exit with 1 if any file fails
   --json-task <file>         Process tasks defined in the specified JSON file
-  --param <parameter>        Specify additional parameters for formatting/compressing
+  --param <parameter>        Specify additional parameters for formatting/compressing/bundling, repeatable
                              Available parameters for format: auto, manual
+                             Available parameters for compress: rename-locals, fold-constants,
+                             strip-dead-branches, hoist-globals
   still mysterious? find more in https://crazyspotteddove.github.io/projects/dlfmt
 )");
 }
@@ -34,69 +81,472 @@ void ShowVersion()
 	printf("dlfmt version %s\n", VERSION);
 }
 
-void FormatFile(const std::string& format_file, dlfmt_param param)
+/**
+ * @brief 读取整个文件到 content，尽量复用 content 已有的容量
+ *
+ */
+static void ReadFile(const std::string& path, std::string& content)
 {
-
-	std::ifstream file(format_file, std::ios::binary);
+	std::ifstream file(path, std::ios::binary);
 	if (!file) {
-		SPDLOG_ERROR("Failed to open file: {}", format_file.c_str());
-		throw std::runtime_error("Failed to open file: " + format_file);
+		SPDLOG_ERROR("Failed to open file: {}", path.c_str());
+		throw std::runtime_error("Failed to open file: " + path);
 	}
 
 	file.seekg(0, std::ios::end);
 	const auto size = static_cast<size_t>(file.tellg());
 	file.seekg(0);
-	std::string content;
+	content.resize(size);
 	if (size) {
-		content.resize(size);
 		file.read(&content[0], static_cast<std::streamsize>(size));
 	}
 	file.close();
+}
 
-	switch (param) {
-	case dlfmt_param::manual_format:
+/**
+ * @brief 每个线程一份的处理上下文，跨文件复用源码、token 与 AST 的缓冲区
+ * @details 目录任务中同一线程会依次处理很多文件，复用缓冲区省去了每个文件重新申请内存。处理完一个
+ * 文件后，容量超过上限的缓冲区会被释放，一个大文件不会一直占着内存。
+ */
+class FileContext
+{
+public:
+	// 单个源码或 token 缓冲区保留的容量上限
+	static constexpr size_t MAX_KEPT_BUFFER_BYTES = 8 * 1024 * 1024;
+	// AST 节点与列表保留的内存上限
+	static constexpr size_t MAX_KEPT_AST_BYTES = 32 * 1024 * 1024;
+
+	/**
+	 * @brief 借用当前线程的上下文，析构时归还并释放超出上限的缓冲区
+	 */
+	class Lease
+	{
+	public:
+		Lease()
+			: context_(local())
+		{
+			// 上个文件可能中途抛出异常，留下的节点与暂存元素都不再需要
+			context_.ast_manager_.Reset();
+			context_.stats_        = {};
+			context_.stats_.thread = ThreadPool::CurrentIndex();
+			if (Stats::Instance().Tracing()) {
+				context_.stats_.start_ns = steady_ns(std::chrono::steady_clock::now());
+			}
+			if (ALLOC_STATS_ENABLED && Stats::Instance().Enabled()) {
+				alloc_start_ = AllocMark::Begin();
+			}
+		}
+		~Lease()
+		{
+			if (Stats::Instance().Enabled()) {
+				if (Stats::Instance().Tracing()) {
+					context_.stats_.end_ns = steady_ns(std::chrono::steady_clock::now());
+				}
+				context_.stats_.ast_nodes = context_.ast_manager_.NodeCount();
+				if (ALLOC_STATS_ENABLED) {
+					alloc_start_.End(context_.stats_.alloc);
+				}
+				Stats::Instance().AddFile(std::move(context_.stats_));
+			}
+			context_.trim();
+		}
+		Lease(const Lease&)            = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		FileContext& operator*() const noexcept { return context_; }
+		FileContext* operator->() const noexcept { return &context_; }
+
+	private:
+		FileContext& context_;
+		AllocMark    alloc_start_;
+	};
+
+	/**
+	 * @brief 读入文件并切分，返回的 tokenizer 在下一次调用前有效
+	 *
+	 */
+	template<TokenizeMode mode> Tokenizer<mode>& Tokenize(const std::string& path)
+	{
+		stats_.path = path;
+		{
+			ScopedPhase phase(Slot(StatsPhase::Read));
+			ReadFile(path, text_);
+		}
+		return TokenizeText<mode>(path);
+	}
+
+	/**
+	 * @brief 切分已读入的源码，与 source 交换缓冲区，source 换回上个文件用过的缓冲区
+	 *
+	 */
+	template<TokenizeMode mode> Tokenizer<mode>& Tokenize(const std::string& path,
+														  std::string&       source)
+	{
+		stats_.path = path;
+		text_.swap(source);
+		return TokenizeText<mode>(path);
+	}
+
+	/**
+	 * @brief 在上下文的 AstManager 中解析 tokens，返回的 AST 在归还上下文前有效
+	 *
+	 */
+	AstNode* Parse(std::vector<Token>& tokens, const std::string& path)
+	{
+		ScopedPhase phase(Slot(StatsPhase::Parse));
+		return Parser(tokens, path, ast_manager_).GetAstRoot();
+	}
+
+	AstManager& GetAstManager() noexcept { return ast_manager_; }
+
+	/**
+	 * @brief 当前文件的源码、token、AST 与输出实际占用的内存，用于校正内存预算的估计
+	 *
+	 */
+	size_t WorkingBytes() const noexcept
 	{
-		// tokenize
-		Tokenizer<TokenizeMode::FormatManual> tokenizer(std::move(content), format_file);
+		return token_bytes_ + ast_manager_.UsedBytes() + output_.str().size();
+	}
+
+	/**
+	 * @brief 清空并返回输出缓冲区，内容在归还上下文前有效
+	 *
+	 */
+	StringSink& Output() noexcept
+	{
+		output_.clear();
+		return output_;
+	}
+
+	/**
+	 * @brief 当前文件某个阶段的耗时，未开启统计时为空
+	 *
+	 */
+	PhaseSlot Slot(StatsPhase phase) noexcept
+	{
+		const Stats& stats = Stats::Instance();
+		if (!stats.Enabled()) {
+			return {};
+		}
+		// 硬件计数器只读 CPU 密集的阶段，读写文件主要耗在内核里
+		const bool perf = stats.PerfEnabled() &&
+						  (phase == StatsPhase::Tokenize || phase == StatsPhase::Parse ||
+						   phase == StatsPhase::Print);
+		return {&stats_.phase_ns[static_cast<size_t>(phase)],
+				stats.Tracing() ? &stats_.spans : nullptr,
+				phase,
+				ALLOC_STATS_ENABLED ? &stats_.phase_alloc[static_cast<size_t>(phase)] : nullptr,
+				perf ? &stats_.phase_perf[static_cast<size_t>(phase)] : nullptr};
+	}
+
+private:
+	template<TokenizeMode mode> Tokenizer<mode>& TokenizeText(const std::string& path)
+	{
+		auto& tokenizer = std::get<Tokenizer<mode>>(tokenizers_);
+		{
+			ScopedPhase phase(Slot(StatsPhase::Tokenize));
+			tokenizer.Reset(text_, path);
+		}
+		stats_.bytes  = tokenizer.getText().size();
+		stats_.tokens = tokenizer.getTokens().size();
+		token_bytes_  = tokenizer.getText().size() + tokenizer.getTokens().size() * sizeof(Token) +
+					   tokenizer.getCommentTokens().size() * sizeof(CommentToken);
+		return tokenizer;
+	}
+
+	static FileContext& local()
+	{
+		thread_local FileContext context;
+		return context;
+	}
+
+	void trim() noexcept
+	{
+		if (text_.capacity() > MAX_KEPT_BUFFER_BYTES) {
+			std::string().swap(text_);
+		}
+		if (output_.str().capacity() > MAX_KEPT_BUFFER_BYTES) {
+			std::string().swap(output_.str());
+		}
+		std::apply([](auto&... tokenizer) { (tokenizer.TrimBuffers(MAX_KEPT_BUFFER_BYTES), ...); },
+				   tokenizers_);
+		if (ast_manager_.ReservedBytes() > MAX_KEPT_AST_BYTES) {
+			ast_manager_.Clear();
+		}
+		else {
+			ast_manager_.Reset();
+		}
+	}
+
+	// 与 tokenizer 交换着使用的源码缓冲区
+	std::string text_;
+	// 打印结果，比较后再写入文件
+	StringSink  output_;
+	std::tuple<Tokenizer<TokenizeMode::Compress>, Tokenizer<TokenizeMode::FormatAuto>,
+			   Tokenizer<TokenizeMode::FormatManual>>
+			   tokenizers_;
+	AstManager ast_manager_;
+	// 当前文件的源码与 token 占用的内存
+	size_t     token_bytes_ = 0;
+	// 当前文件的统计，只在开启统计时提交
+	FileStats  stats_;
+};
+
+/**
+ * @brief 递归收集目录下所有 .lua 文件
+ *
+ */
+static std::vector<std::string> CollectLuaFiles(const std::string& directory)
+{
+	ScopedPhase              phase(Stats::Instance().GlobalSlot(StatsPhase::Collect));
+	std::vector<std::string> files;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+		if (entry.is_regular_file()) {
+			const auto& path = entry.path();
+			if (path.has_extension() && path.extension() == ".lua") {
+				files.emplace_back(path.string());
+			}
+		}
+	}
+	return files;
+}
+
+/**
+ * @brief 把打印结果写入文件，与原文相同时不写，文件的修改时间保持不变
+ *
+ * @param io 非空时交给 IoEngine 在后台写出，不等待写完
+ */
+static void WriteIfChanged(FileContext& context, const std::string& path, std::string_view source,
+						   const StringSink& output, IoEngine* io = nullptr)
+{
+	if (output.str() == source) {
+		return;
+	}
+	ScopedPhase phase(context.Slot(StatsPhase::Write));
+	if (io) {
+		// 复制一份交出去，输出缓冲区的容量留给下一个文件
+		io->Write(path, output.str());
+	}
+	else {
+		write_file(path, output.str());
+	}
+}
+
+/**
+ * @brief 切分文件，source 非空时为 IoEngine 已读入的源码，不再读文件
+ *
+ */
+template<TokenizeMode mode>
+static Tokenizer<mode>& TokenizeFile(FileContext& context, const std::string& path,
+									 std::string* source)
+{
+	return source ? context.Tokenize<mode>(path, *source) : context.Tokenize<mode>(path);
+}
+
+template<TokenizeMode tokenize_mode, AstPrintMode print_mode>
+static void FormatFileWith(FileContext& context, const std::string& format_file,
+						   std::string* source, IoEngine* io)
+{
+	// tokenize
+	auto& tokenizer = TokenizeFile<tokenize_mode>(context, format_file, source);
 
 #ifndef NDEBUG
+	if constexpr (tokenize_mode == TokenizeMode::FormatManual) {
 		tokenizer.Print();
+	}
 #endif
 
-		// parse
-		Parser parser(tokenizer.getTokens(), format_file);
+	// parse
+	AstNode* root = context.Parse(tokenizer.getTokens(), format_file);
 
-		// 打开输出
-		std::ofstream out_file(format_file, std::ios::binary | std::ios::trunc);
+	// 先在内存中打印，再整块写入
+	StringSink& output = context.Output();
+	{
+		ScopedPhase                        phase(context.Slot(StatsPhase::Print));
+		AstPrinter<print_mode, StringSink> printer(output, &tokenizer.getCommentTokens());
+		printer.PrintAst(root);
+	}
+	WriteIfChanged(context, format_file, tokenizer.getText(), output, io);
+}
 
-		// 写入
-		AstPrinter<AstPrintMode::Manual> printer(out_file, &tokenizer.getCommentTokens());
-		printer.PrintAst(parser.GetAstRoot());
-		out_file.flush();
-		out_file.close();
+static void FormatFileIn(FileContext& context, const std::string& format_file, dlfmt_param param,
+						 std::string* source = nullptr, IoEngine* io = nullptr)
+{
+	switch (param) {
+	case dlfmt_param::manual_format:
+		FormatFileWith<TokenizeMode::FormatManual, AstPrintMode::Manual>(
+			context, format_file, source, io);
 		break;
-	}
 	default:
+		FormatFileWith<TokenizeMode::FormatAuto, AstPrintMode::Auto>(
+			context, format_file, source, io);
+		break;
+	}
+}
+
+void FormatFile(const std::string& format_file, dlfmt_param param)
+{
+	FileContext::Lease context;
+	FormatFileIn(*context, format_file, param);
+}
+
+/**
+ * @brief 并行处理时单个文件的失败，处理完统一打印
+ * @details 工作线程只往无锁队列里放，处理期间不争抢日志；打印前按路径排序，报告与调度顺序无关。
+ */
+class FileFailures
+{
+public:
+	void Add(const std::string& path, std::string reason)
 	{
-		// tokenize
-		Tokenizer<TokenizeMode::FormatAuto> tokenizer(std::move(content), format_file);
+		queue_.Push({path, std::move(reason)});
+	}
+
+	/**
+	 * @brief 按路径顺序打印目前的全部失败，返回条数
+	 *
+	 * @param action 日志中的动作名，如 Format
+	 */
+	size_t Report(const char* action)
+	{
+		auto failures = queue_.Drain();
+		std::sort(failures.begin(), failures.end());
+		for (const auto& [path, reason] : failures) {
+			SPDLOG_ERROR("{} failed: {} ({})", action, path, reason);
+		}
+		return failures.size();
+	}
+
+private:
+	MpscQueue<std::pair<std::string, std::string>> queue_;
+};
+
+/**
+ * @brief 在全局线程池上并行处理每个文件，单个文件失败只记入 failures，不影响其他文件
+ *
+ * @param process 处理第 i 个文件：process(i)
+ */
+template<typename Process>
+static void ForEachFile(const std::vector<std::string>& files, FileFailures& failures,
+						Process process)
+{
+	ThreadPool::Global().ParallelFor(files.size(), [&](size_t i) {
+		try {
+			process(i);
+		}
+		catch (const std::exception& e) {
+			failures.Add(files[i], e.what());
+		}
+		catch (...) {
+			failures.Add(files[i], "unknown error");
+		}
+	});
+}
+
+/**
+ * @brief 文件大小，取不到时为 0，读文件时会再报错
+ *
+ */
+static size_t FileBytes(const std::string& path)
+{
+	std::error_code ec;
+	const auto      size = std::filesystem::file_size(path, ec);
+	return ec ? 0 : static_cast<size_t>(size);
+}
 
-		// parse
-		Parser parser(tokenizer.getTokens(), format_file);
+/**
+ * @brief 在内存预算内处理一个文件，budget 为空时不限制
+ * @details 先按估计占用排队，处理完用实际占用校正之后的估计。预算在归还上下文之后才释放，
+ * 上下文释放超限缓冲区的时间也算在内。
+ *
+ * @param process 处理文件：process(context)
+ */
+template<typename Process>
+static void ProcessInBudget(MemoryBudget* budget, size_t file_bytes, Process process)
+{
+	MemoryBudget::Reservation reservation;
+	if (budget) {
+		reservation = budget->Acquire(file_bytes);
+	}
+	FileContext::Lease context;
+	process(*context);
+	if (budget) {
+		budget->Observe(file_bytes, context->WorkingBytes());
+	}
+}
 
-		// 打开输出
-		std::ofstream out_file(format_file, std::ios::binary | std::ios::trunc);
+static void LogBudget(const std::optional<MemoryBudget>& budget)
+{
+	if (!budget) {
+		return;
+	}
+	constexpr double MB = 1024.0 * 1024.0;
+	SPDLOG_INFO("Memory budget {:.1f} MB: peak {:.1f} MB estimated in flight, {} files over budget "
+				"processed alone.",
+				budget->Limit() / MB,
+				budget->PeakBytes() / MB,
+				budget->SoloCount());
+}
 
-		// 写入
-		AstPrinter<AstPrintMode::Auto> printer(out_file, &tokenizer.getCommentTokens());
-		printer.PrintAst(parser.GetAstRoot());
-		out_file.flush();
-		out_file.close();
+/**
+ * @brief 由 IoEngine 提前读入文件、在后台写出，线程池只负责处理
+ * @details 处理线程不再按下标分配文件，而是谁空闲谁从引擎取下一个读完的文件。有内存预算时，
+ * 一半留给同时处理的文件，提前读入与排队写入的缓冲各占四分之一。
+ *
+ * @param action 出错时日志中的动作名，如 Format
+ * @param process 处理一个文件：process(context, path, source, engine)
+ */
+template<typename Process>
+static void ProcessWithEngine(std::vector<std::string> files, dlfmt_io io, size_t memory_limit,
+							  const char* action, Process process)
+{
+	std::optional<MemoryBudget> budget;
+	if (memory_limit) {
+		budget.emplace(memory_limit / 2);
 	}
+	IoEngine engine(std::move(files),
+					io == dlfmt_io::io_uring      ? IoBackend::Uring
+					: io == dlfmt_io::thread_pool ? IoBackend::Threads
+												  : IoBackend::Auto,
+					memory_limit / 4);
+	SPDLOG_DEBUG("I/O backend: {}", engine.BackendName());
+
+	// 每个线程一个任务，各自从引擎取文件直到取完
+	FileFailures failures;
+	ThreadPool&  pool = ThreadPool::Global();
+	pool.ParallelFor(pool.Size(), [&](size_t) {
+		IoEngine::File file;
+		while (engine.Next(file)) {
+			try {
+				if (!file.error.empty()) {
+					throw std::runtime_error(file.error);
+				}
+				ProcessInBudget(budget ? &*budget : nullptr,
+								file.content.size(),
+								[&](FileContext& context) {
+									process(context, file.path, file.content, engine);
+								});
+			}
+			catch (const std::exception& e) {
+				failures.Add(file.path, e.what());
+			}
+			catch (...) {
+				failures.Add(file.path, "unknown error");
+			}
+		}
+	});
+
+	for (auto& [path, error] : engine.Finish()) {
+		failures.Add(path, std::move(error));
 	}
+	Stats::Instance().AddGlobalNs(StatsPhase::IoRead, engine.ReadNs());
+	Stats::Instance().AddGlobalNs(StatsPhase::IoWait, engine.WaitNs());
+	failures.Report(action);
+	LogBudget(budget);
 }
 
-void FormatDirectory(const std::string& format_directory, dlfmt_param param)
+void FormatDirectory(const std::string& format_directory, dlfmt_param param, dlfmt_io io,
+					 size_t memory_limit)
 {
 	if (format_directory.empty()) {
 		SPDLOG_ERROR("No directory specified for formatting.");
@@ -104,73 +554,212 @@ void FormatDirectory(const std::string& format_directory, dlfmt_param param)
 	}
 
 	// 收集所有 .lua 文件
-	std::vector<std::string> files;
-	for (const auto& entry : std::filesystem::recursive_directory_iterator(format_directory)) {
-		if (entry.is_regular_file()) {
-			const auto& path = entry.path();
-			if (path.has_extension() && path.extension() == ".lua") {
-				files.emplace_back(path.string());
-			}
-		}
-	}
+	std::vector<std::string> files = CollectLuaFiles(format_directory);
 	SPDLOG_INFO("{} .lua files collected.", files.size());
 
-// 并行格式化
-#pragma omp parallel for
-	for (int i = 0; i < static_cast<int>(files.size()); ++i) {
+	if (io != dlfmt_io::blocking) {
+		ProcessWithEngine(std::move(files),
+						  io,
+						  memory_limit,
+						  "Format",
+						  [param](FileContext& context, const std::string& path,
+								  std::string& source, IoEngine& engine) {
+							  FormatFileIn(context, path, param, &source, &engine);
+						  });
+		return;
+	}
+
+	std::optional<MemoryBudget> budget;
+	if (memory_limit) {
+		budget.emplace(memory_limit);
+	}
+
+	// 并行格式化
+	FileFailures failures;
+	ForEachFile(files, failures, [&](size_t i) {
+		ProcessInBudget(budget ? &*budget : nullptr,
+						budget ? FileBytes(files[i]) : 0,
+						[&](FileContext& context) { FormatFileIn(context, files[i], param); });
+	});
+	failures.Report("Format");
+	LogBudget(budget);
+}
+
+/**
+ * @brief 在内存中格式化文件并与原文比较，不写入文件
+ *
+ * @param diff 非空时写入原文到格式化结果的 unified diff
+ * @return true 格式化会改变文件
+ */
+template<TokenizeMode tokenize_mode, AstPrintMode print_mode>
+static bool CheckFormatted(const std::string& path, std::string* diff)
+{
+	FileContext::Lease context;
+	auto&              tokenizer = context->Tokenize<tokenize_mode>(path);
+	AstNode*           root      = context->Parse(tokenizer.getTokens(), path);
+	const std::string& source    = tokenizer.getText();
+	ScopedPhase        phase(context->Slot(StatsPhase::Print));
+
+	if (diff) {
+		StringSink&                        out = context->Output();
+		AstPrinter<print_mode, StringSink> printer(out, &tokenizer.getCommentTokens());
+		printer.PrintAst(root);
+		*diff = unified_diff(source,
+							 out.str(),
+							 fmt::format("{}\t(original)", path),
+							 fmt::format("{}\t(formatted)", path));
+		return !diff->empty();
+	}
+
+	// 只判断是否相同时边输出边比较，不保存格式化结果
+	CompareSink                         out(source);
+	AstPrinter<print_mode, CompareSink> printer(out, &tokenizer.getCommentTokens());
+	printer.PrintAst(root);
+	return !out.Matches();
+}
+
+/**
+ * @brief 并行检查文件是否已格式化，打印需要格式化的文件，以及 diff
+ *
+ * @return size_t 需要格式化或检查失败的文件数
+ */
+static size_t CheckFiles(std::vector<std::string> files, dlfmt_param param, bool print_diff)
+{
+	// 排序保证报告稳定
+	std::sort(files.begin(), files.end());
+	std::vector<uint8_t>     changed(files.size(), 0);
+	std::vector<std::string> diffs(print_diff ? files.size() : 0);
+	std::vector<std::string> errors(files.size());
+
+	// 与 FormatDirectory 相同的并行方式，结果写入各自的下标，不需要同步
+	ThreadPool::Global().ParallelFor(files.size(), [&](size_t i) {
+		std::string* diff = print_diff ? &diffs[i] : nullptr;
 		try {
-			FormatFile(files[i], param);
+			if (param == dlfmt_param::manual_format) {
+				changed[i] = CheckFormatted<TokenizeMode::FormatManual, AstPrintMode::Manual>(
+					files[i], diff);
+			}
+			else {
+				changed[i] =
+					CheckFormatted<TokenizeMode::FormatAuto, AstPrintMode::Auto>(files[i], diff);
+			}
 		}
 		catch (const std::exception& e) {
-#pragma omp critical
-			{
-				SPDLOG_ERROR("Format failed: {} ({})", files[i], e.what());
-			}
+			errors[i] = e.what();
 		}
 		catch (...) {
-#pragma omp critical
-			{
-				SPDLOG_ERROR("Format failed: {} (unknown error)", files[i]);
+			errors[i] = "unknown error";
+		}
+	});
+
+	size_t failed = 0;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (!errors[i].empty()) {
+			SPDLOG_ERROR("Check failed: {} ({})", files[i], errors[i]);
+			++failed;
+		}
+		else if (changed[i]) {
+			if (print_diff) {
+				fputs(diffs[i].c_str(), stdout);
 			}
+			printf("would reformat %s\n", files[i].c_str());
+			++failed;
 		}
 	}
+	if (failed) {
+		SPDLOG_ERROR(
+			"{} of {} files would be reformatted or failed to parse.", failed, files.size());
+	}
+	else {
+		SPDLOG_INFO("All {} files are formatted.", files.size());
+	}
+	return failed;
 }
 
-void CompressFile(const std::string& compress_file, [[maybe_unused]] dlfmt_param param)
+size_t CheckFormatFile(const std::string& format_file, dlfmt_param param, bool print_diff)
 {
-	std::ifstream file(compress_file, std::ios::binary);
-	if (!file) {
-		SPDLOG_ERROR("Failed to open file: {}", compress_file.c_str());
-		throw std::runtime_error("Failed to open file: " + compress_file);
+	return CheckFiles({format_file}, param, print_diff);
+}
+
+size_t CheckFormatDirectory(const std::string& format_directory, dlfmt_param param,
+							bool print_diff)
+{
+	if (format_directory.empty()) {
+		SPDLOG_ERROR("No directory specified for checking.");
+		throw std::invalid_argument("No directory specified for checking.");
 	}
 
-	file.seekg(0, std::ios::end);
-	const auto size = static_cast<size_t>(file.tellg());
-	file.seekg(0);
-	std::string content;
-	if (size) {
-		content.resize(size);
-		file.read(&content[0], static_cast<std::streamsize>(size));
+	// 收集所有 .lua 文件
+	std::vector<std::string> files = CollectLuaFiles(format_directory);
+	SPDLOG_INFO("{} .lua files collected.", files.size());
+	return CheckFiles(std::move(files), param, print_diff);
+}
+
+/**
+ * @brief 对 AST 依次执行开启的压缩步骤，并把压缩结果写入 out
+ *
+ */
+template<typename Sink>
+static void CompressAst(FileContext& context, AstNode* root, const dlfmt_compress_options& options,
+						Sink& out)
+{
+	// 各步骤的耗时计入 transform 阶段
+	std::optional<ScopedPhase> transform_phase(std::in_place, context.Slot(StatsPhase::Transform));
+
+	// 折叠常量，新节点归 folder 所有，需活到写入结束
+	std::optional<ConstantFolder> folder;
+	if (options.fold_constants) {
+		folder.emplace(root);
 	}
-	file.close();
 
+	// 删除调试调用与不可达分支，新节点归 stripper 所有，需活到写入结束
+	std::optional<DeadCodeStripper> stripper;
+	if (!options.strip_calls.empty() || options.strip_dead_branches) {
+		stripper.emplace(root, options.strip_calls, options.defines, options.strip_dead_branches);
+	}
+
+	// 提升全局变量，新节点归 hoister 所有，需活到写入结束
+	std::optional<GlobalHoister> hoister;
+	if (options.hoist_globals) {
+		hoister.emplace(root, options.extra_globals);
+	}
+
+	// 重命名局部变量，新名字归 renamer 所有，需活到写入结束
+	std::optional<LocalRenamer> renamer;
+	if (options.rename_locals) {
+		renamer.emplace(root);
+	}
+	transform_phase.reset();
+
+	// 写入
+	AstPrinter<AstPrintMode::Compress, Sink> printer(out);
+	ScopedPhase                              print_phase(context.Slot(StatsPhase::Print));
+	printer.PrintAst(root);
+}
+
+static void CompressFileIn(FileContext& context, const std::string& compress_file,
+						   const dlfmt_compress_options& options, std::string* source = nullptr,
+						   IoEngine* io = nullptr)
+{
 	// tokenize
-	Tokenizer<TokenizeMode::Compress> tokenizer(std::move(content), compress_file);
+	auto& tokenizer = TokenizeFile<TokenizeMode::Compress>(context, compress_file, source);
 
 	// parse
-	Parser parser(tokenizer.getTokens(), compress_file);
+	AstNode* root = context.Parse(tokenizer.getTokens(), compress_file);
 
-	// 打开输出
-	std::ofstream out_file(compress_file, std::ios::binary | std::ios::trunc);
+	StringSink& output = context.Output();
+	CompressAst(context, root, options, output);
+	WriteIfChanged(context, compress_file, tokenizer.getText(), output, io);
+}
 
-	// 写入
-	AstPrinter<AstPrintMode::Compress> printer(out_file);
-	printer.PrintAst(parser.GetAstRoot());
-	out_file.flush();
-	out_file.close();
+void CompressFile(const std::string& compress_file, const dlfmt_compress_options& options)
+{
+	FileContext::Lease context;
+	CompressFileIn(*context, compress_file, options);
 }
 
-void CompressDirectory(const std::string& compress_directory, [[maybe_unused]] dlfmt_param param)
+void CompressDirectory(const std::string& compress_directory, const dlfmt_compress_options& options,
+					   dlfmt_io io, size_t memory_limit)
 {
 	if (compress_directory.empty()) {
 		SPDLOG_ERROR("No directory specified for formatting.");
@@ -178,36 +767,234 @@ void CompressDirectory(const std::string& compress_directory, [[maybe_unused]] d
 	}
 
 	// 收集所有 .lua 文件
-	std::vector<std::string> files;
-	for (const auto& entry : std::filesystem::recursive_directory_iterator(compress_directory)) {
-		if (entry.is_regular_file()) {
-			const auto& path = entry.path();
-			if (path.has_extension() && path.extension() == ".lua") {
-				files.emplace_back(path.string());
+	std::vector<std::string> files = CollectLuaFiles(compress_directory);
+	SPDLOG_INFO("{} .lua files collected.", files.size());
+
+	if (io != dlfmt_io::blocking) {
+		ProcessWithEngine(std::move(files),
+						  io,
+						  memory_limit,
+						  "Compress",
+						  [&options](FileContext& context, const std::string& path,
+									 std::string& source, IoEngine& engine) {
+							  CompressFileIn(context, path, options, &source, &engine);
+						  });
+		return;
+	}
+
+	std::optional<MemoryBudget> budget;
+	if (memory_limit) {
+		budget.emplace(memory_limit);
+	}
+
+	// 并行压缩
+	FileFailures failures;
+	ForEachFile(files, failures, [&](size_t i) {
+		ProcessInBudget(budget ? &*budget : nullptr,
+						budget ? FileBytes(files[i]) : 0,
+						[&](FileContext& context) { CompressFileIn(context, files[i], options); });
+	});
+	failures.Report("Compress");
+	LogBudget(budget);
+}
+
+/**
+ * @brief 由文件相对目录的路径得到模块名，a/b.lua 为 a.b，a/init.lua 为 a
+ *
+ */
+static std::string ModuleName(const std::filesystem::path& file, const std::filesystem::path& root)
+{
+	std::string name = std::filesystem::relative(file, root).replace_extension().generic_string();
+	std::replace(name.begin(), name.end(), '/', '.');
+	const std::string init_suffix = ".init";
+	if (name.size() > init_suffix.size() &&
+		name.compare(name.size() - init_suffix.size(), init_suffix.size(), init_suffix) == 0) {
+		name.resize(name.size() - init_suffix.size());
+	}
+	return name;
+}
+
+void BundleDirectory(const std::string& bundle_directory, const std::string& output_file,
+					 const dlfmt_compress_options& options)
+{
+	if (bundle_directory.empty()) {
+		SPDLOG_ERROR("No directory specified for bundling.");
+		throw std::invalid_argument("No directory specified for bundling.");
+	}
+	if (output_file.empty()) {
+		SPDLOG_ERROR("No output file specified for bundling.");
+		throw std::invalid_argument("No output file specified for bundling.");
+	}
+
+	struct Module
+	{
+		std::string              path;
+		std::string              name;
+		std::string              code;
+		std::vector<std::string> dependencies;
+	};
+
+	// 收集所有 .lua 文件，排序保证输出稳定
+	std::vector<Module> modules;
+	for (const auto& path : CollectLuaFiles(bundle_directory)) {
+		modules.push_back({path, ModuleName(path, bundle_directory), {}, {}});
+	}
+	std::sort(modules.begin(), modules.end(), [](const Module& a, const Module& b) {
+		return a.path < b.path;
+	});
+	SPDLOG_INFO("{} .lua files collected.", modules.size());
+
+	std::unordered_map<std::string, size_t> module_index;
+	for (size_t i = 0; i < modules.size(); ++i) {
+		if (!module_index.emplace(modules[i].name, i).second) {
+			SPDLOG_ERROR("Module '{}' is provided by both {} and {}",
+						 modules[i].name,
+						 modules[module_index[modules[i].name]].path,
+						 modules[i].path);
+			throw std::runtime_error("Duplicate module: " + modules[i].name);
+		}
+	}
+
+	// 并行压缩各模块，同时收集 require 依赖
+	FileFailures failures;
+	ThreadPool::Global().ParallelFor(modules.size(), [&](size_t i) {
+		auto& module = modules[i];
+		try {
+			FileContext::Lease context;
+			auto& tokenizer = context->Tokenize<TokenizeMode::Compress>(module.path);
+			AstNode* root       = context->Parse(tokenizer.getTokens(), module.path);
+			module.dependencies = RequireCollector(root).GetModules();
+			StringSink& out = context->Output();
+			CompressAst(*context, root, options, out);
+			module.code = out.str();
+			while (!module.code.empty() && module.code.back() == '\n') {
+				module.code.pop_back();
+			}
+		}
+		catch (const std::exception& e) {
+			failures.Add(module.path, e.what());
+		}
+		catch (...) {
+			failures.Add(module.path, "unknown error");
+		}
+	});
+	if (failures.Report("Bundle")) {
+		throw std::runtime_error("Failed to bundle directory: " + bundle_directory);
+	}
+
+	// 按依赖顺序排列：被 require 的模块排在前面，目录外的模块忽略
+	enum class VisitState : uint8_t
+	{
+		Unvisited,
+		Visiting,
+		Done
+	};
+	std::vector<VisitState> states(modules.size(), VisitState::Unvisited);
+	std::vector<size_t>     order;
+	order.reserve(modules.size());
+	// 栈中保存模块下标与下一个要访问的依赖
+	std::vector<std::pair<size_t, size_t>> stack;
+	for (size_t root = 0; root < modules.size(); ++root) {
+		if (states[root] != VisitState::Unvisited) {
+			continue;
+		}
+		states[root] = VisitState::Visiting;
+		stack.emplace_back(root, 0);
+		while (!stack.empty()) {
+			auto& [index, next] = stack.back();
+			const auto& dependencies = modules[index].dependencies;
+			if (next == dependencies.size()) {
+				states[index] = VisitState::Done;
+				order.push_back(index);
+				stack.pop_back();
+				continue;
+			}
+			const auto it = module_index.find(dependencies[next++]);
+			if (it == module_index.end()) {
+				continue;
+			}
+			if (states[it->second] == VisitState::Visiting) {
+				SPDLOG_WARN("Circular require: {} -> {}", modules[index].name, modules[it->second].name);
+			}
+			else if (states[it->second] == VisitState::Unvisited) {
+				states[it->second] = VisitState::Visiting;
+				stack.emplace_back(it->second, 0);
 			}
 		}
 	}
+
+	// 每个模块注册为 package.preload 中的加载函数，require 时才执行
+	std::ofstream out_file(output_file, std::ios::binary | std::ios::trunc);
+	if (!out_file) {
+		SPDLOG_ERROR("Failed to open file: {}", output_file.c_str());
+		throw std::runtime_error("Failed to open file: " + output_file);
+	}
+	for (const size_t index : order) {
+		const auto& module = modules[index];
+		out_file << "package.preload[\"";
+		for (const char c : module.name) {
+			if (c == '"' || c == '\\') {
+				out_file << '\\';
+			}
+			out_file << c;
+		}
+		out_file << "\"]=function(...) " << module.code << " end\n";
+	}
+	out_file.flush();
+	out_file.close();
+	SPDLOG_INFO("{} modules bundled into {}", order.size(), output_file);
+}
+
+size_t CheckSyntax(const std::string& check_path)
+{
+	if (check_path.empty()) {
+		SPDLOG_ERROR("No file or directory specified for syntax checking.");
+		throw std::invalid_argument("No file or directory specified for syntax checking.");
+	}
+
+	// 收集所有 .lua 文件，排序保证报告稳定
+	std::vector<std::string> files;
+	if (std::filesystem::is_regular_file(check_path)) {
+		files.push_back(check_path);
+	}
+	else {
+		files = CollectLuaFiles(check_path);
+		std::sort(files.begin(), files.end());
+	}
 	SPDLOG_INFO("{} .lua files collected.", files.size());
 
-// 并行格式化
-#pragma omp parallel for
-	for (int i = 0; i < static_cast<int>(files.size()); ++i) {
+	// 错误信息已经带有位置，统一在最后报告
+	std::vector<std::string> errors(files.size());
+	// 并行检查，只做语法分析，不构建 AST
+	ThreadPool::Global().ParallelFor(files.size(), [&](size_t i) {
 		try {
-			CompressFile(files[i], param);
+			FileContext::Lease context;
+			auto&       tokenizer = context->Tokenize<TokenizeMode::Compress>(files[i]);
+			ScopedPhase phase(context->Slot(StatsPhase::Parse));
+			Parser<NullAstBuilder> parser(tokenizer.getTokens(), files[i]);
 		}
 		catch (const std::exception& e) {
-#pragma omp critical
-			{
-				SPDLOG_ERROR("Compress failed: {} ({})", files[i], e.what());
-			}
+			errors[i] = e.what();
 		}
 		catch (...) {
-#pragma omp critical
-			{
-				SPDLOG_ERROR("Compress failed: {} (unknown error)", files[i]);
-			}
+			errors[i] = files[i] + ": unknown error";
+		}
+	});
+
+	size_t failed = 0;
+	for (const auto& error : errors) {
+		if (!error.empty()) {
+			printf("%s\n", error.c_str());
+			++failed;
 		}
 	}
+	if (failed) {
+		SPDLOG_ERROR("{} of {} files failed the syntax check.", failed, files.size());
+	}
+	else {
+		SPDLOG_INFO("All {} files passed the syntax check.", files.size());
+	}
+	return failed;
 }
 
 using json         = nlohmann::json;
@@ -239,21 +1026,26 @@ static bool ShouldProcessFile(const std::string&
 	return true;
 }
 
-void JsonTask(const std::string& json_file)
+/**
+ * @brief json 任务文件中收集到的参数与文件
+ */
+struct JsonTaskList
 {
-	// 加载任务缓存记录
-	std::unordered_map<std::string, file_cache_t> file_cache;
-	const std::string                             cache_path = ".dlfmt_cache.json";
-	file_cache.clear();
-	std::ifstream cache_in(cache_path);
-	if (cache_in) {
-		json cache_j;
-		cache_in >> cache_j;
-		for (auto& [k, v] : cache_j.items()) {
-			file_cache[k] = {v.get<file_cache_t>()};
-		}
-		cache_in.close();
-	}
+	dlfmt_param              format_param = dlfmt_param::auto_format;
+	dlfmt_compress_options   compress_options;
+	std::vector<std::string> format_tasks;
+	std::vector<std::string> compress_tasks;
+};
+
+/**
+ * @brief 解析 json 任务文件，收集参数与要处理的文件
+ *
+ * @param file_cache 其中记录的修改时间未变的文件不会被收集
+ */
+static JsonTaskList LoadJsonTask(const std::string&                                   json_file,
+								 const std::unordered_map<std::string, file_cache_t>& file_cache)
+{
+	ScopedPhase phase(Stats::Instance().GlobalSlot(StatsPhase::Collect));
 
 	// 解析 dlua_task.json
 	std::ifstream task_in(json_file);
@@ -262,8 +1054,9 @@ void JsonTask(const std::string& json_file)
 	task_in >> task_j;
 	task_in.close();
 
-	dlfmt_param param_format   = dlfmt_param::auto_format;
-	dlfmt_param param_compress = dlfmt_param::auto_format;
+	JsonTaskList            list;
+	dlfmt_param&            param_format     = list.format_param;
+	dlfmt_compress_options& options_compress = list.compress_options;
 	if (task_j.contains("params")) {
 		auto params = task_j["params"];
 		if (params.contains("format")) {
@@ -273,16 +1066,37 @@ void JsonTask(const std::string& json_file)
 			}
 		}
 
-		if (params.contains("compress")) {
-			std::string cmp_param = params["compress"];
-			// TODO: no param available for compress now
+		// "compress": "auto" 为旧写法，等价于不开启任何额外选项
+		if (params.contains("compress") && params["compress"].is_object()) {
+			const auto& cmp_params               = params["compress"];
+			options_compress.rename_locals       = cmp_params.value("rename_locals", false);
+			options_compress.fold_constants      = cmp_params.value("fold_constants", false);
+			options_compress.strip_dead_branches = cmp_params.value("strip_dead_branches", false);
+			options_compress.hoist_globals       = cmp_params.value("hoist_globals", false);
+			if (cmp_params.contains("extra_globals")) {
+				for (const auto& global : cmp_params["extra_globals"]) {
+					options_compress.extra_globals.push_back(global.get<std::string>());
+				}
+			}
+			if (cmp_params.contains("strip_calls")) {
+				for (const auto& call : cmp_params["strip_calls"]) {
+					options_compress.strip_calls.push_back(call.get<std::string>());
+				}
+			}
+			if (cmp_params.contains("defines")) {
+				// 与 Lua 一致，只有 false 与 null 为假
+				for (const auto& [name, value] : cmp_params["defines"].items()) {
+					options_compress.defines[name] =
+						!(value.is_null() || (value.is_boolean() && !value.get<bool>()));
+				}
+			}
 		}
 	}
 
 	auto tasks = task_j["tasks"];
 
-	std::vector<std::string> format_tasks;
-	std::vector<std::string> compress_tasks;
+	std::vector<std::string>& format_tasks   = list.format_tasks;
+	std::vector<std::string>& compress_tasks = list.compress_tasks;
 
 	std::filesystem::path work_dir = std::filesystem::current_path();
 
@@ -372,22 +1186,75 @@ void JsonTask(const std::string& json_file)
 		}
 	}
 
+	return list;
+}
+
+void JsonTask(const std::string& json_file, size_t memory_limit)
+{
+	// 加载任务缓存记录
+	std::unordered_map<std::string, file_cache_t> file_cache;
+	const std::string                             cache_path = ".dlfmt_cache.json";
+	file_cache.clear();
+	{
+		ScopedPhase   phase(Stats::Instance().GlobalSlot(StatsPhase::CacheIo));
+		std::ifstream cache_in(cache_path);
+		if (cache_in) {
+			json cache_j;
+			cache_in >> cache_j;
+			for (auto& [k, v] : cache_j.items()) {
+				file_cache[k] = {v.get<file_cache_t>()};
+			}
+			cache_in.close();
+		}
+	}
+
+	const JsonTaskList list           = LoadJsonTask(json_file, file_cache);
+	const auto&        format_tasks   = list.format_tasks;
+	const auto&        compress_tasks = list.compress_tasks;
+
 	SPDLOG_INFO("{} files to format collected.", format_tasks.size());
 	SPDLOG_INFO("{} files to compress collected.", compress_tasks.size());
 
-// 然后处理任务。先 format，后 compress
-#pragma omp parallel for
-	for (int i = 0; i < static_cast<int>(format_tasks.size()); ++i) {
-		const auto& abs_path = format_tasks[i];
-		FormatFile(abs_path, param_format);
+	std::optional<MemoryBudget> budget;
+	if (memory_limit) {
+		budget.emplace(memory_limit);
 	}
+	MemoryBudget* const budget_ptr = budget ? &*budget : nullptr;
 
-#pragma omp parallel for
-	for (int i = 0; i < static_cast<int>(compress_tasks.size()); ++i) {
-		const auto& abs_path = compress_tasks[i];
-		CompressFile(abs_path, param_compress);
-	}
+	// 然后处理任务。先 format，后 compress
+	// 任一文件失败即取消剩余任务，异常在已开始的任务结束后抛出，不写回缓存
+	ThreadPool& pool = ThreadPool::Global();
+	pool.ParallelFor(format_tasks.size(), [&](size_t i) {
+		const auto&  abs_path   = format_tasks[i];
+		const size_t file_bytes = budget_ptr ? FileBytes(abs_path) : 0;
+		try {
+			ProcessInBudget(budget_ptr, file_bytes, [&](FileContext& context) {
+				FormatFileIn(context, abs_path, list.format_param);
+			});
+		}
+		catch (const std::exception& e) {
+			SPDLOG_ERROR("Format failed: {} ({})", abs_path, e.what());
+			throw std::runtime_error("Failed to process json task: " + json_file);
+		}
+	});
 
+	pool.ParallelFor(compress_tasks.size(), [&](size_t i) {
+		const auto&  abs_path   = compress_tasks[i];
+		const size_t file_bytes = budget_ptr ? FileBytes(abs_path) : 0;
+		try {
+			ProcessInBudget(budget_ptr, file_bytes, [&](FileContext& context) {
+				CompressFileIn(context, abs_path, list.compress_options);
+			});
+		}
+		catch (const std::exception& e) {
+			SPDLOG_ERROR("Compress failed: {} ({})", abs_path, e.what());
+			throw std::runtime_error("Failed to process json task: " + json_file);
+		}
+	});
+	LogBudget(budget);
+
+	// 记录处理后的修改时间并写回缓存
+	ScopedPhase phase(Stats::Instance().GlobalSlot(StatsPhase::CacheIo));
 	for (const auto& abs_path : format_tasks) {
 		std::error_code ec;
 		auto            mtime = std::filesystem::last_write_time(abs_path, ec);
@@ -411,4 +1278,12 @@ void JsonTask(const std::string& json_file)
 	std::ofstream cache_out(cache_path);
 	cache_out << cache_out_j.dump();
 	cache_out.close();
-}
\ No newline at end of file
+}
+
+size_t CheckJsonTask(const std::string& json_file, bool print_diff)
+{
+	// 检查全部要格式化的文件，不读也不写任务缓存，压缩任务不参与检查
+	JsonTaskList list = LoadJsonTask(json_file, {});
+	SPDLOG_INFO("{} files to check collected.", list.format_tasks.size());
+	return CheckFiles(std::move(list.format_tasks), list.format_param, print_diff);
+}
@@ -1,10 +1,12 @@
 
 #include <nlohmann/json.hpp>
-#include <omp.h>
 #include <spdlog/common.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 enum class dlfmt_mode{
     show_help,
@@ -13,6 +15,8 @@ enum class dlfmt_mode{
     format_directory,
     compress_file,
     compress_directory,
+    bundle_directory,
+    check_syntax,
     json_task
 };
 
@@ -21,16 +25,89 @@ enum class dlfmt_param{
     manual_format
 };
 
+// 目录任务读写文件的方式
+enum class dlfmt_io{
+    // io_uring 可用时用 io_uring，否则用线程池
+    auto_select,
+    io_uring,
+    // 后台线程阻塞读写
+    thread_pool,
+    // 处理线程自己阻塞读写
+    blocking
+};
+
+struct dlfmt_compress_options{
+    // 重命名局部变量、参数和上值
+    bool rename_locals = false;
+    // 折叠常量表达式
+    bool fold_constants = false;
+    // 删除名字链在列表中的调用语句，如 log.debug、assert、logger:trace
+    std::vector<std::string> strip_calls;
+    // 删除条件恒为假的 if/elseif 分支
+    bool strip_dead_branches = false;
+    // 判断分支条件时视为常量的全局变量及其真值，如 DEBUG = false
+    std::unordered_map<std::string, bool> defines;
+    // 把只读的标准库全局变量提升为代码块顶部的局部变量
+    bool hoist_globals = false;
+    // 额外要提升的全局变量，形如 name 或 name.field
+    std::vector<std::string> extra_globals;
+};
+
 void ShowHelp();
 
 void ShowVersion();
 
 void FormatFile(const std::string& format_file, dlfmt_param param);
 
-void FormatDirectory(const std::string& format_directory, dlfmt_param param);
+/**
+ * @brief 并行格式化目录下所有文件，io 不为 blocking 时由 IoEngine 提前读入文件并在后台写出
+ *
+ * @param memory_limit 非 0 时为内存预算的字节数，同时处理的文件与读写缓冲的估计占用不超过它
+ */
+void FormatDirectory(const std::string& format_directory, dlfmt_param param,
+                     dlfmt_io io = dlfmt_io::auto_select, size_t memory_limit = 0);
+
+/**
+ * @brief 在内存中格式化文件并与原文比较，不写入文件，打印会被格式化改变的文件
+ *
+ * @param print_diff 同时打印 unified diff
+ * @return size_t 会被改变或解析失败的文件数
+ */
+size_t CheckFormatFile(const std::string& format_file, dlfmt_param param, bool print_diff);
+
+/**
+ * @brief 对目录下所有文件执行 CheckFormatFile
+ *
+ * @return size_t 会被改变或解析失败的文件数
+ */
+size_t CheckFormatDirectory(const std::string& format_directory, dlfmt_param param, bool print_diff);
+
+void CompressFile(const std::string& compress_file, const dlfmt_compress_options& options);
+
+/**
+ * @brief 并行压缩目录下所有文件，io 与 memory_limit 的含义同 FormatDirectory
+ */
+void CompressDirectory(const std::string& compress_directory, const dlfmt_compress_options& options,
+                       dlfmt_io io = dlfmt_io::auto_select, size_t memory_limit = 0);
+
+void BundleDirectory(const std::string& bundle_directory, const std::string& output_file,
+                     const dlfmt_compress_options& options);
 
-void CompressFile(const std::string& compress_file, [[maybe_unused]] dlfmt_param param);
+/**
+ * @brief 检查文件或目录下的所有文件能否通过语法分析，逐个打印错误
+ *
+ * @return size_t 未通过检查的文件数
+ */
+size_t CheckSyntax(const std::string& check_path);
 
-void CompressDirectory(const std::string& compress_directory, [[maybe_unused]] dlfmt_param param);
+/**
+ * @param memory_limit 含义同 FormatDirectory
+ */
+void JsonTask(const std::string& json_file, size_t memory_limit = 0);
 
-void JsonTask(const std::string& json_file);
\ No newline at end of file
+/**
+ * @brief 对 json 任务中所有要格式化的文件执行 CheckFormatFile，忽略任务缓存
+ *
+ * @return size_t 会被改变或解析失败的文件数
+ */
+size_t CheckJsonTask(const std::string& json_file, bool print_diff);
\ No newline at end of file
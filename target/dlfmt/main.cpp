@@ -1,7 +1,104 @@
+#include "dl/stats.h"
+#include "dl/thread_pool.h"
 #include "dl/timer.h"
 #include "dlfmt_core.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <spdlog/spdlog.h>
 
+/**
+ * @brief 打印统计报告，stats_json 非空时改为写入 JSON 报告，为 - 时写到标准输出
+ *
+ */
+static void PrintStats(const Timer& timer, const std::string& stats_json, size_t top)
+{
+	const auto& stats   = dl::Stats::Instance();
+	const auto  wall_ns = static_cast<uint64_t>(timer.elapsedNs());
+	if (stats_json.empty()) {
+		printf("%s", stats.TextReport(wall_ns, top).c_str());
+	}
+	else if (stats_json == "-") {
+		printf("%s\n", stats.JsonReport(wall_ns, top).c_str());
+	}
+	else {
+		std::ofstream out(stats_json, std::ios::binary | std::ios::trunc);
+		out << stats.JsonReport(wall_ns, top) << '\n';
+	}
+}
+
+/**
+ * @brief 写出 Chrome trace event 格式的 trace 文件
+ *
+ */
+static void WriteTrace(const std::string& trace_file)
+{
+	std::ofstream out(trace_file, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		SPDLOG_ERROR("Failed to open trace file '{}'", trace_file);
+		return;
+	}
+	out << dl::Stats::Instance().TraceReport() << '\n';
+}
+
+/**
+ * @brief 解析字节数，可带 K、M、G 后缀（1024 进制），如 512M
+ *
+ */
+static bool ParseByteSize(const char* text, size_t& bytes)
+{
+	// strtoull 会接受负号并取反，这里只认以数字开头的
+	if (*text < '0' || *text > '9') {
+		return false;
+	}
+	char* end = nullptr;
+	errno     = 0;
+	const unsigned long long value = std::strtoull(text, &end, 10);
+	if (errno == ERANGE) {
+		return false;
+	}
+	const std::string suffix = end;
+	size_t            shift  = 0;
+	if (suffix == "K" || suffix == "KB") {
+		shift = 10;
+	}
+	else if (suffix == "M" || suffix == "MB") {
+		shift = 20;
+	}
+	else if (suffix == "G" || suffix == "GB") {
+		shift = 30;
+	}
+	else if (!suffix.empty()) {
+		return false;
+	}
+	if (value > (SIZE_MAX >> shift)) {
+		return false;
+	}
+	bytes = static_cast<size_t>(value) << shift;
+	return true;
+}
+
+/**
+ * @brief 解析非负整数，整串都须是数字
+ *
+ */
+static bool ParseCount(const char* text, size_t& count)
+{
+	if (*text < '0' || *text > '9') {
+		return false;
+	}
+	char* end = nullptr;
+	errno     = 0;
+	const unsigned long long value = std::strtoull(text, &end, 10);
+	if (*end != '\0' || errno == ERANGE || value > SIZE_MAX) {
+		return false;
+	}
+	count = static_cast<size_t>(value);
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
 	const auto console = spdlog::stdout_color_mt("console");
@@ -9,7 +106,19 @@ int main(int argc, char* argv[])
 	spdlog::set_default_logger(console);
 	dlfmt_mode  work_mode  = dlfmt_mode::show_help;
 	dlfmt_param work_param = dlfmt_param::auto_format;
+	dlfmt_compress_options compress_options;
 	std::string file_or_directory;
+	std::string output_file;
+	bool        check      = false;
+	bool        print_diff = false;
+	bool        print_stats = false;
+	std::string stats_json;
+	size_t      stats_top = 10;
+	std::string trace_file;
+	dlfmt_io    io = dlfmt_io::auto_select;
+	size_t      memory_limit = 0;
+	size_t      jobs         = 0;
+	bool        affinity     = false;
 	for (int i = 1; i < argc; ++i) {
 		std::string arg = argv[i];
 		if (arg == "--help") {
@@ -58,6 +167,129 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 		}
+		else if (arg == "--bundle-directory") {
+			if (i + 1 < argc) {
+				file_or_directory = argv[++i];
+				work_mode         = dlfmt_mode::bundle_directory;
+			}
+			else {
+				SPDLOG_ERROR("No directory specified after --bundle-directory");
+				return 1;
+			}
+		}
+		else if (arg == "--check-syntax") {
+			if (i + 1 < argc) {
+				file_or_directory = argv[++i];
+				work_mode         = dlfmt_mode::check_syntax;
+			}
+			else {
+				SPDLOG_ERROR("No file or directory specified after --check-syntax");
+				return 1;
+			}
+		}
+		else if (arg == "--check") {
+			check = true;
+		}
+		else if (arg == "--diff") {
+			print_diff = true;
+		}
+		else if (arg == "--stats") {
+			print_stats = true;
+			dl::Stats::Instance().Enable();
+		}
+		else if (arg == "--stats-json") {
+			if (i + 1 < argc) {
+				stats_json  = argv[++i];
+				print_stats = true;
+				dl::Stats::Instance().Enable();
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --stats-json");
+				return 1;
+			}
+		}
+		else if (arg == "--perf-counters") {
+			print_stats = true;
+			std::string reason;
+			if (!dl::Stats::Instance().EnablePerf(reason)) {
+				SPDLOG_WARN("Hardware counters are unavailable ({}), reporting timings only",
+							reason);
+			}
+		}
+		else if (arg == "--stats-top") {
+			if (i + 1 < argc && ParseCount(argv[i + 1], stats_top)) {
+				++i;
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --stats-top");
+				return 1;
+			}
+		}
+		else if (arg == "--trace") {
+			if (i + 1 < argc) {
+				trace_file = argv[++i];
+				dl::Stats::Instance().EnableTrace();
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --trace");
+				return 1;
+			}
+		}
+		else if (arg == "--io") {
+			if (i + 1 < argc) {
+				const std::string backend = argv[++i];
+				if (backend == "auto") {
+					io = dlfmt_io::auto_select;
+				}
+				else if (backend == "uring") {
+					io = dlfmt_io::io_uring;
+				}
+				else if (backend == "threads") {
+					io = dlfmt_io::thread_pool;
+				}
+				else if (backend == "sync") {
+					io = dlfmt_io::blocking;
+				}
+				else {
+					SPDLOG_ERROR("Unknown I/O backend: {}", backend);
+					return 1;
+				}
+			}
+			else {
+				SPDLOG_ERROR("No backend specified after --io");
+				return 1;
+			}
+		}
+		else if (arg == "--memory-limit") {
+			if (i + 1 < argc && ParseByteSize(argv[i + 1], memory_limit)) {
+				++i;
+			}
+			else {
+				SPDLOG_ERROR("No size such as 512M specified after --memory-limit");
+				return 1;
+			}
+		}
+		else if (arg == "--jobs") {
+			if (i + 1 < argc && ParseCount(argv[i + 1], jobs)) {
+				++i;
+			}
+			else {
+				SPDLOG_ERROR("No number specified after --jobs");
+				return 1;
+			}
+		}
+		else if (arg == "--affinity") {
+			affinity = true;
+		}
+		else if (arg == "--output") {
+			if (i + 1 < argc) {
+				output_file = argv[++i];
+			}
+			else {
+				SPDLOG_ERROR("No file specified after --output");
+				return 1;
+			}
+		}
 		else if (arg == "--json-task") {
 			if (i + 1 < argc) {
 				file_or_directory = argv[++i];
@@ -77,6 +309,18 @@ int main(int argc, char* argv[])
 				else if (param == "manual") {
 					work_param = dlfmt_param::manual_format;
 				}
+				else if (param == "rename-locals") {
+					compress_options.rename_locals = true;
+				}
+				else if (param == "fold-constants") {
+					compress_options.fold_constants = true;
+				}
+				else if (param == "strip-dead-branches") {
+					compress_options.strip_dead_branches = true;
+				}
+				else if (param == "hoist-globals") {
+					compress_options.hoist_globals = true;
+				}
 				else {
 					SPDLOG_ERROR("Unknown param: {}", param);
 					return 1;
@@ -95,39 +339,90 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    if ((check || print_diff) && work_mode != dlfmt_mode::format_file &&
+        work_mode != dlfmt_mode::format_directory && work_mode != dlfmt_mode::json_task) {
+        SPDLOG_ERROR("--check only works with --format-file, --format-directory or --json-task");
+        return 1;
+    }
+
+    dl::ThreadPool::Configure(jobs, affinity);
+
+    int   status = 0;
     Timer timer;
     timer.start();
-    switch (work_mode) {
-        case dlfmt_mode::format_file:{
-			timer.setLabel(fmt::format("Formatted file '{}'", file_or_directory));
-			FormatFile(file_or_directory, work_param);
-			break;
-		}
-        case dlfmt_mode::format_directory:{
-            timer.setLabel(fmt::format("Formatted directory '{}'", file_or_directory));
-            FormatDirectory(file_or_directory, work_param);
-            break;
-        }
-        case dlfmt_mode::compress_file:{
-            timer.setLabel(fmt::format("Compressed file '{}'", file_or_directory));
-            CompressFile(file_or_directory, work_param);
-            break;
-        }
-        case dlfmt_mode::compress_directory:{
-            timer.setLabel(fmt::format("Compressed directory '{}'", file_or_directory));
-            CompressDirectory(file_or_directory, work_param);
-            break;
+    try {
+        if (check || print_diff) {
+            timer.setLabel(fmt::format("Checked '{}'", file_or_directory));
+            size_t failed = 0;
+            switch (work_mode) {
+                case dlfmt_mode::format_file:
+                    failed = CheckFormatFile(file_or_directory, work_param, print_diff);
+                    break;
+                case dlfmt_mode::format_directory:
+                    failed = CheckFormatDirectory(file_or_directory, work_param, print_diff);
+                    break;
+                default:
+                    failed = CheckJsonTask(file_or_directory, print_diff);
+                    break;
+            }
+            status = failed > 0 ? 1 : 0;
         }
-        case dlfmt_mode::json_task:{
-            timer.setLabel(fmt::format("Processed json task file '{}'", file_or_directory));
-            JsonTask(file_or_directory);
-            break;
+        else {
+            switch (work_mode) {
+                case dlfmt_mode::format_file:{
+                    timer.setLabel(fmt::format("Formatted file '{}'", file_or_directory));
+                    FormatFile(file_or_directory, work_param);
+                    break;
+                }
+                case dlfmt_mode::format_directory:{
+                    timer.setLabel(fmt::format("Formatted directory '{}'", file_or_directory));
+                    FormatDirectory(file_or_directory, work_param, io, memory_limit);
+                    break;
+                }
+                case dlfmt_mode::compress_file:{
+                    timer.setLabel(fmt::format("Compressed file '{}'", file_or_directory));
+                    CompressFile(file_or_directory, compress_options);
+                    break;
+                }
+                case dlfmt_mode::compress_directory:{
+                    timer.setLabel(fmt::format("Compressed directory '{}'", file_or_directory));
+                    CompressDirectory(file_or_directory, compress_options, io, memory_limit);
+                    break;
+                }
+                case dlfmt_mode::bundle_directory:{
+                    timer.setLabel(fmt::format("Bundled directory '{}'", file_or_directory));
+                    BundleDirectory(file_or_directory, output_file, compress_options);
+                    break;
+                }
+                case dlfmt_mode::check_syntax:{
+                    timer.setLabel(fmt::format("Checked syntax of '{}'", file_or_directory));
+                    status = CheckSyntax(file_or_directory) > 0 ? 1 : 0;
+                    break;
+                }
+                case dlfmt_mode::json_task:{
+                    timer.setLabel(
+                        fmt::format("Processed json task file '{}'", file_or_directory));
+                    JsonTask(file_or_directory, memory_limit);
+                    break;
+                }
+                default:
+                    SPDLOG_ERROR("No valid work mode specified.");
+                    return 1;
+            }
         }
-        default:
-            SPDLOG_ERROR("No valid work mode specified.");
-            return 1;
+    }
+    catch (const std::exception& e) {
+        // 让整个任务中止的错误，如单个文件的解析失败、json 任务中第一个失败的文件
+        SPDLOG_ERROR("{}", e.what());
+        status = 1;
     }
     timer.stop();
     timer.print();
-    return 0;
+    if (print_stats) {
+        PrintStats(timer, stats_json, stats_top);
+    }
+    if (!trace_file.empty()) {
+        WriteTrace(trace_file);
+    }
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+# cmake -DDL_BENCH=<dl_bench> -DWORK_DIR=<临时目录> -P bench_self_compare.cmake
+# 同一个 dl_bench 跑两遍，与自己的基线比较不能判出退化；换了语料的基准判为不可比，不影响退出码。
+# 共享的机器上整次运行可能慢上两三成，检验挡不住这种噪声，所以阈值放宽到 50%
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+execute_process(COMMAND ${DL_BENCH} --min-time 200 --save-baseline base.json
+    WORKING_DIRECTORY ${WORK_DIR}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+if(NOT result STREQUAL "0")
+    message(FATAL_ERROR "saving the baseline failed with '${result}':\n${output}")
+endif()
+
+execute_process(COMMAND ${DL_BENCH} --min-time 200 --baseline base.json --threshold 50
+    WORKING_DIRECTORY ${WORK_DIR}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+string(FIND "${output}" "REGRESSION" found)
+if(NOT result STREQUAL "0" OR NOT found EQUAL -1)
+    message(FATAL_ERROR "the same binary regressed against its own baseline ('${result}'):\n${output}")
+endif()
+
+file(WRITE ${WORK_DIR}/other.lua "local x = 1\nreturn x\n")
+execute_process(COMMAND ${DL_BENCH} --min-time 10 --corpus other.lua --baseline base.json
+        --filter parse
+    WORKING_DIRECTORY ${WORK_DIR}
+    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+string(FIND "${output}" "incomparable" found)
+if(NOT result STREQUAL "0" OR found EQUAL -1)
+    message(FATAL_ERROR "another corpus must be incomparable, not a verdict ('${result}'):\n${output}")
+endif()
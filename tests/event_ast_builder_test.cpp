@@ -0,0 +1,241 @@
+#include "dl/ast.h"
+#include "dl/ast_builder.h"
+#include "dl/ast_manager.h"
+#include "dl/parser.h"
+#include "dl/token.h"
+#include "dl/tokenizer.h"
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <magic_enum/magic_enum.hpp>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace dl;
+
+// event_ast_builder_test <文件>...
+// 同一组 token 分别交给 AstManager 与 EventAstBuilder 解析，回调序列须与 AST 的后序遍历逐项相同
+
+namespace {
+using Event = std::pair<AstNodeType, const Token*>;
+
+/**
+ * @brief 按 Parser 构建节点的顺序后序遍历 AST：子节点按源码顺序，父节点最后
+ */
+void walk(const AstNode* node, std::vector<Event>& events)
+{
+	const auto walk_list = [&](const Span<AstNode*>& nodes) {
+		for (const AstNode* child : nodes) {
+			walk(child, events);
+		}
+	};
+	switch (node->type_) {
+	case AstNodeType::ParenExpr: walk(node->paren_expr_.expression_, events); break;
+	case AstNodeType::TableLiteral:
+		for (const auto& entry : node->table_literal_.entry_list_) {
+			switch (entry.type_) {
+			case AstNode::TableEntryType::Index:
+				walk(entry.index_entry_.index_, events);
+				walk(entry.index_entry_.value_, events);
+				break;
+			case AstNode::TableEntryType::Field: walk(entry.field_entry_.value_, events); break;
+			case AstNode::TableEntryType::Value: walk(entry.value_entry_.value_, events); break;
+			}
+		}
+		break;
+	case AstNodeType::FunctionLiteral: walk(node->function_literal_.body_, events); break;
+	case AstNodeType::FunctionStat: walk(node->function_stat_.body_, events); break;
+	case AstNodeType::ArgCall: walk_list(node->arg_call_.arg_list_); break;
+	case AstNodeType::TableCall: walk(node->table_call_.table_expr_, events); break;
+	case AstNodeType::FieldExpr: walk(node->field_expr_.base_, events); break;
+	case AstNodeType::MethodExpr:
+		walk(node->method_expr_.base_, events);
+		walk(node->method_expr_.function_arguments_, events);
+		break;
+	case AstNodeType::IndexExpr:
+		walk(node->index_expr_.base_, events);
+		walk(node->index_expr_.index_, events);
+		break;
+	case AstNodeType::CallExpr:
+		walk(node->call_expr_.base_, events);
+		walk(node->call_expr_.function_arguments_, events);
+		break;
+	case AstNodeType::NotExpr: walk(node->not_expr_.rhs_, events); break;
+	case AstNodeType::NegativeExpr: walk(node->negative_expr_.rhs_, events); break;
+	case AstNodeType::LengthExpr: walk(node->length_expr_.rhs_, events); break;
+	case AstNodeType::AddExpr:
+		walk(node->add_expr_.lhs_, events);
+		walk(node->add_expr_.rhs_, events);
+		break;
+	case AstNodeType::SubExpr:
+		walk(node->sub_expr_.lhs_, events);
+		walk(node->sub_expr_.rhs_, events);
+		break;
+	case AstNodeType::MulExpr:
+		walk(node->mul_expr_.lhs_, events);
+		walk(node->mul_expr_.rhs_, events);
+		break;
+	case AstNodeType::DivExpr:
+		walk(node->div_expr_.lhs_, events);
+		walk(node->div_expr_.rhs_, events);
+		break;
+	case AstNodeType::PowExpr:
+		walk(node->pow_expr_.lhs_, events);
+		walk(node->pow_expr_.rhs_, events);
+		break;
+	case AstNodeType::ModExpr:
+		walk(node->mod_expr_.lhs_, events);
+		walk(node->mod_expr_.rhs_, events);
+		break;
+	case AstNodeType::ConcatExpr:
+		walk(node->concat_expr_.lhs_, events);
+		walk(node->concat_expr_.rhs_, events);
+		break;
+	case AstNodeType::EqExpr:
+		walk(node->eq_expr_.lhs_, events);
+		walk(node->eq_expr_.rhs_, events);
+		break;
+	case AstNodeType::NeqExpr:
+		walk(node->neq_expr_.lhs_, events);
+		walk(node->neq_expr_.rhs_, events);
+		break;
+	case AstNodeType::LtExpr:
+		walk(node->lt_expr_.lhs_, events);
+		walk(node->lt_expr_.rhs_, events);
+		break;
+	case AstNodeType::LeExpr:
+		walk(node->le_expr_.lhs_, events);
+		walk(node->le_expr_.rhs_, events);
+		break;
+	case AstNodeType::GtExpr:
+		walk(node->gt_expr_.lhs_, events);
+		walk(node->gt_expr_.rhs_, events);
+		break;
+	case AstNodeType::GeExpr:
+		walk(node->ge_expr_.lhs_, events);
+		walk(node->ge_expr_.rhs_, events);
+		break;
+	case AstNodeType::AndExpr:
+		walk(node->and_expr_.lhs_, events);
+		walk(node->and_expr_.rhs_, events);
+		break;
+	case AstNodeType::OrExpr:
+		walk(node->or_expr_.lhs_, events);
+		walk(node->or_expr_.rhs_, events);
+		break;
+	case AstNodeType::CallExprStat: walk(node->call_expr_stat_.expression_, events); break;
+	case AstNodeType::AssignmentStat:
+		walk_list(node->assignment_stat_.lhs_);
+		walk_list(node->assignment_stat_.rhs_);
+		break;
+	case AstNodeType::IfStat:
+		walk(node->if_stat_.condition_, events);
+		walk(node->if_stat_.body_, events);
+		for (const auto& clause : node->if_stat_.else_clauses_) {
+			if (clause.type_ == AstNode::ElseClauseType::ElseIfClause) {
+				walk(clause.else_if_clause_.condition_, events);
+			}
+			walk(clause.body_, events);
+		}
+		break;
+	case AstNodeType::DoStat: walk(node->do_stat_.body_, events); break;
+	case AstNodeType::WhileStat:
+		walk(node->while_stat_.condition_, events);
+		walk(node->while_stat_.body_, events);
+		break;
+	case AstNodeType::NumericForStat:
+		walk_list(node->numeric_for_stat_.range_list_);
+		walk(node->numeric_for_stat_.body_, events);
+		break;
+	case AstNodeType::GenericForStat:
+		walk_list(node->generic_for_stat_.generator_list_);
+		walk(node->generic_for_stat_.body_, events);
+		break;
+	case AstNodeType::RepeatStat:
+		walk(node->repeat_stat_.body_, events);
+		walk(node->repeat_stat_.condition_, events);
+		break;
+	case AstNodeType::LocalFunctionStat:
+		walk(node->local_function_stat_.function_stat_, events);
+		break;
+	case AstNodeType::LocalVarStat: walk_list(node->local_var_stat_.expr_list_); break;
+	case AstNodeType::ReturnStat: walk_list(node->return_stat_.expr_list_); break;
+	case AstNodeType::StatList: walk_list(node->stat_list_.statement_list_); break;
+	default: break;
+	}
+	events.emplace_back(node->type_, node->first_token_);
+}
+
+/**
+ * @brief 检查一个文件，不一致时打印第一处差异
+ */
+bool check_file(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		SPDLOG_ERROR("Failed to open file: {}", path);
+		return false;
+	}
+	std::string                       text{std::istreambuf_iterator<char>(file), {}};
+	Tokenizer<TokenizeMode::Compress> tokenizer(std::move(text), path);
+	std::vector<Token>&               tokens = tokenizer.getTokens();
+	Parser<AstManager>                tree_parser(tokens, path);
+	std::vector<Event>                expected;
+	walk(tree_parser.GetAstRoot(), expected);
+
+	std::vector<Event> events;
+	const auto         record = [&](AstNodeType type, const Token* first_token) {
+		events.emplace_back(type, first_token);
+	};
+	EventAstBuilder         builder(record);
+	Parser<EventAstBuilder> event_parser(tokens, path, builder);
+
+	if (event_parser.GetAstRoot() != tree_parser.GetAstRoot()->first_token_) {
+		SPDLOG_ERROR("{}: the root handle is not the first token of the root", path);
+		return false;
+	}
+	for (size_t i = 0; i < expected.size() || i < events.size(); ++i) {
+		if (i >= expected.size() || i >= events.size() || events[i] != expected[i]) {
+			const auto describe = [&](const std::vector<Event>& list, size_t index) {
+				if (index >= list.size()) {
+					return std::string("end of sequence");
+				}
+				const auto& [type, token] = list[index];
+				if (!token) {
+					return fmt::format("{} without a token", magic_enum::enum_name(type));
+				}
+				return fmt::format("{} '{}' (token {}, line {})",
+								   magic_enum::enum_name(type),
+								   token->source_,
+								   token - tokens.data(),
+								   token->line_);
+			};
+			SPDLOG_ERROR("{}: event {} differs: expected {}, got {}",
+						 path,
+						 i,
+						 describe(expected, i),
+						 describe(events, i));
+			return false;
+		}
+	}
+	SPDLOG_INFO("{}: {} events match", path, events.size());
+	return true;
+}
+}   // namespace
+
+int main(int argc, char* argv[])
+{
+	bool ok = argc > 1;
+	for (int i = 1; i < argc; ++i) {
+		try {
+			ok = check_file(argv[i]) && ok;
+		}
+		catch (const std::exception& e) {
+			SPDLOG_ERROR("{}", e.what());
+			ok = false;
+		}
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+# cmake -DDLFMT=<dlfmt> -DCASE_DIR=<golden/名字> -DWORK_DIR=<临时目录> -P golden.cmake
+# 压缩 CASE_DIR/input.lua 的副本，与 expected.lua 比较；再压缩一次结果应不变
+# 目录名即参数，多个参数用 + 连接，如 fold-constants+strip-dead-branches
+get_filename_component(name ${CASE_DIR} NAME)
+set(params)
+if(NOT name STREQUAL "compress")
+    string(REPLACE "+" ";" names ${name})
+    foreach(param IN LISTS names)
+        list(APPEND params --param ${param})
+    endforeach()
+endif()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+configure_file(${CASE_DIR}/input.lua ${WORK_DIR}/output.lua COPYONLY)
+
+foreach(round first second)
+    execute_process(COMMAND ${DLFMT} --compress-file ${WORK_DIR}/output.lua ${params}
+        RESULT_VARIABLE result OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${name}: dlfmt exited with '${result}' in the ${round} round")
+    endif()
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/output.lua ${CASE_DIR}/expected.lua
+        RESULT_VARIABLE different)
+    if(different)
+        file(READ ${WORK_DIR}/output.lua output)
+        message(FATAL_ERROR "${name}: the ${round} round does not match expected.lua, got:\n${output}")
+    endif()
+endforeach()
@@ -0,0 +1,37 @@
+-- 行注释与块注释都应去掉
+local M = {}
+
+--[[
+	多行注释
+]]
+local function greet(name, greeting)
+	greeting = greeting or "hello"
+	return greeting .. ", " .. name .. "!"
+end
+
+function M.sum(list)
+	local total = 0
+	for i = 1, #list do
+		total = total + list[i]
+	end
+	return total
+end
+
+function M:describe()
+	local parts = { "a", "b", [3] = "c", key = 'value' }
+	local text = [[
+long string
+keeps its lines]]
+	if #parts > 2 and not self.quiet then
+		print(greet(text, nil))
+	elseif self.quiet then
+		return nil
+	else
+		repeat
+			parts[#parts] = nil
+		until #parts == 0
+	end
+	return -1 - -2, 2 ^ -3, "x" .. 1
+end
+
+return M
@@ -0,0 +1 @@
+local LEVEL=2 local VERBOSE=1==2 do print("always") end if LEVEL>1 then print("runtime, kept") end return VERBOSE
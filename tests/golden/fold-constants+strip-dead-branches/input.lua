@@ -0,0 +1,21 @@
+local LEVEL = 2
+local VERBOSE = 1 == 2
+
+-- 比较折叠成 false 比原文长，不会被改写，但分支仍应删掉
+if 1 == 2 then
+	print("never")
+end
+
+if 60 * 60 > 3000 then
+	print("always")
+else
+	print("unreachable")
+end
+
+if LEVEL > 1 then
+	print("runtime, kept")
+elseif "x" .. 1 == "x2" then
+	print("dropped")
+end
+
+return VERBOSE
@@ -0,0 +1 @@
+local SECONDS_PER_DAY=86400 local HALF=0.5 local NEGATIVE=-7 local POWER=1024 local ROOT=2^0.5 local PREFIX="dlfmt-1" local SAME=true local DIFFERENT=false local NOT_NIL=true local PICK="default" local FIRST=2 local DIV_ZERO=1/0 local MOD_ZERO=1%0 local NAN=0/0 local LONG=1/3 local MIXED=SECONDS_PER_DAY*2+12 return SECONDS_PER_DAY,HALF,NEGATIVE,POWER,ROOT,PREFIX,SAME,DIFFERENT,NOT_NIL,PICK,FIRST,DIV_ZERO,MOD_ZERO,NAN,LONG,MIXED
@@ -0,0 +1,18 @@
+local SECONDS_PER_DAY = 60 * 60 * 24
+local HALF = 1 / 2
+local NEGATIVE = -(3 + 4)
+local POWER = 2 ^ 10
+local ROOT = 2 ^ 0.5
+local PREFIX = "dl" .. "fmt" .. "-" .. 1
+local SAME = 3 == 3
+local DIFFERENT = "a" ~= "a"
+local NOT_NIL = not nil
+local PICK = nil or false or "default"
+local FIRST = 1 and 2
+local DIV_ZERO = 1 / 0
+local MOD_ZERO = 1 % 0
+local NAN = 0 / 0
+local LONG = 1 / 3
+local MIXED = SECONDS_PER_DAY * 2 + 3 * 4
+return SECONDS_PER_DAY, HALF, NEGATIVE, POWER, ROOT, PREFIX, SAME, DIFFERENT, NOT_NIL, PICK, FIRST,
+	DIV_ZERO, MOD_ZERO, NAN, LONG, MIXED
@@ -0,0 +1 @@
+local math_sqrt,tostring=math.sqrt,tostring local M={} function M.distance(points) local total=0 for i=2,#points do local dx=points[i].x-points[i-1].x local dy=points[i].y-points[i-1].y total=total+math_sqrt(dx*dx+dy*dy) end return math.floor(total+0.5) end function M.describe(values) local parts={} for _,value in ipairs(values) do parts[#parts+1]=tostring(value) end return table.concat(parts,", ")..string.format(" (%d)",#parts) end function M.once() return os.time() end function M.patch() print=function() end print("silenced") print("twice") end return M
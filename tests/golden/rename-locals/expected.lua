@@ -0,0 +1 @@
+local a=0 local b={} local function c(c,d) a=a+1 b[c]=d return a end local function d(a) return function(b) local a=a+b return a end end function register_all(e) for a,b in ipairs(e) do c(b.name,a) end for a,b in pairs(b) do print(a,b) end local b=d(a) local a={add=b,count=a} function a:get() return self.count end return a:get()+b(1) end global_value=a return register_all
@@ -0,0 +1,34 @@
+local counter = 0
+local names = {}
+
+local function register(name, value)
+	counter = counter + 1
+	names[name] = value
+	return counter
+end
+
+local function make_adder(base)
+	return function(delta)
+		local result = base + delta
+		return result
+	end
+end
+
+function register_all(items)
+	for index, item in ipairs(items) do
+		register(item.name, index)
+	end
+	for key, value in pairs(names) do
+		print(key, value)
+	end
+	local add = make_adder(counter)
+	local self_ref = { add = add, count = counter }
+	function self_ref:get()
+		return self.count
+	end
+	return self_ref:get() + add(1)
+end
+
+-- 全局与字段名保持不变
+global_value = counter
+return register_all
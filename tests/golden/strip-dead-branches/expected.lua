@@ -0,0 +1 @@
+local result={} do result[#result+1]="always" end if DEBUG then result[#result+1]="global, kept" end local function check(value) if value then return "runtime, kept" end do return "else body stays" end end while false do result[#result+1]="loops are left alone" end result[#result+1]=check(1) return result
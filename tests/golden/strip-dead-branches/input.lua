@@ -0,0 +1,45 @@
+local result = {}
+
+if false then
+	result[#result + 1] = "never"
+end
+
+if nil then
+	result[#result + 1] = "never"
+elseif true then
+	result[#result + 1] = "always"
+else
+	result[#result + 1] = "unreachable"
+end
+
+if 1 == 2 then
+	result[#result + 1] = "comparison, dropped"
+elseif "a" .. "b" ~= "ab" or not (2 < 3) then
+	result[#result + 1] = "folded condition, dropped"
+end
+
+if DEBUG then
+	result[#result + 1] = "global, kept"
+elseif false then
+	result[#result + 1] = "dropped"
+end
+
+local function check(value)
+	if value then
+		return "runtime, kept"
+	elseif nil then
+		return "dropped"
+	end
+	if false then
+		return "dropped"
+	else
+		return "else body stays"
+	end
+end
+
+while false do
+	result[#result + 1] = "loops are left alone"
+end
+
+result[#result + 1] = check(1)
+return result
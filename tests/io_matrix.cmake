@@ -0,0 +1,62 @@
+# cmake -DDLFMT=<dlfmt> -DDL_GEN=<dl_gen> -DMODE=<format|compress> -DWORK_DIR=<临时目录> -P io_matrix.cmake
+# 用每个 --io 后端与几种 --jobs 处理同一批生成的文件，结果须逐字节相同；再处理一次结果须不变
+set(backends sync threads uring auto)
+set(job_counts 1 2 4 0)
+set(params)
+if(MODE STREQUAL "compress")
+    set(params --param rename-locals --param fold-constants --param strip-dead-branches
+        --param hoist-globals)
+endif()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+# 文件数超过提前读入的 64 个，并带一层子目录
+execute_process(COMMAND ${DL_GEN} --directory ${WORK_DIR}/corpus --count 120 --size 16K
+    RESULT_VARIABLE result OUTPUT_QUIET)
+if(result EQUAL 0)
+    execute_process(COMMAND ${DL_GEN} --directory ${WORK_DIR}/corpus/sub --count 40 --size 4K --seed 1000
+        RESULT_VARIABLE result OUTPUT_QUIET)
+endif()
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "dl_gen exited with '${result}'")
+endif()
+file(GLOB_RECURSE files RELATIVE ${WORK_DIR}/corpus ${WORK_DIR}/corpus/*.lua)
+
+function(run_dlfmt dir)
+    execute_process(COMMAND ${DLFMT} --${MODE}-directory ${dir} ${params} ${ARGN}
+        RESULT_VARIABLE result OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "dlfmt --${MODE}-directory ${ARGN} exited with '${result}'")
+    endif()
+endfunction()
+
+# 与 reference 目录逐个比较文件
+function(compare_dirs dir reference what)
+    foreach(file IN LISTS files)
+        file(SHA256 ${dir}/${file} hash)
+        file(SHA256 ${reference}/${file} expected)
+        if(NOT hash STREQUAL expected)
+            message(FATAL_ERROR "${MODE}: ${file} differs ${what}")
+        endif()
+    endforeach()
+endfunction()
+
+set(reference)
+foreach(io IN LISTS backends)
+    foreach(jobs IN LISTS job_counts)
+        set(options --io ${io} --jobs ${jobs})
+        set(dir ${WORK_DIR}/${io}-${jobs})
+        file(COPY ${WORK_DIR}/corpus/ DESTINATION ${dir})
+        run_dlfmt(${dir} ${options})
+        if(reference)
+            compare_dirs(${dir} ${reference} "between ${reference_options} and ${options}")
+        else()
+            set(reference ${dir})
+            set(reference_options ${options})
+        endif()
+    endforeach()
+endforeach()
+
+set(again ${WORK_DIR}/again)
+file(COPY ${reference}/ DESTINATION ${again})
+run_dlfmt(${again})
+compare_dirs(${again} ${reference} "after a second --${MODE}-directory")
@@ -0,0 +1,28 @@
+# cmake -DDLFMT=<dlfmt> -DWORK_DIR=<临时目录> -P json_task_failure.cmake
+# json 任务中有文件解析失败时，dlfmt 须报告该文件并以 1 退出，而不是 abort；format 与 compress 各试一次
+file(REMOVE_RECURSE ${WORK_DIR})
+foreach(type format compress)
+    file(WRITE ${WORK_DIR}/${type}/good.lua "local x = 1\nreturn x\n")
+    file(WRITE ${WORK_DIR}/${type}/bad.lua "local x = = 1\n")
+    file(WRITE ${WORK_DIR}/${type}.json
+        "{\"tasks\": [{\"type\": \"${type}\", \"directory\": \"${type}\"}], \"params\": {\"format\": \"auto\"}}\n")
+endforeach()
+
+foreach(type format compress)
+    foreach(jobs 1 4)
+        file(REMOVE ${WORK_DIR}/.dlfmt_cache.json)
+        execute_process(COMMAND ${DLFMT} --json-task ${type}.json --jobs ${jobs}
+            WORKING_DIRECTORY ${WORK_DIR}
+            RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+        if(NOT result STREQUAL "1")
+            message(FATAL_ERROR "${type}, --jobs ${jobs}: expected exit status 1, got '${result}':\n${output}")
+        endif()
+        string(FIND "${output}" "${type}/bad.lua" found)
+        if(found EQUAL -1)
+            message(FATAL_ERROR "${type}, --jobs ${jobs}: bad.lua is not reported:\n${output}")
+        endif()
+        if(EXISTS ${WORK_DIR}/.dlfmt_cache.json)
+            message(FATAL_ERROR "${type}, --jobs ${jobs}: the cache was written despite the failure")
+        endif()
+    endforeach()
+endforeach()
@@ -0,0 +1,34 @@
+# cmake -DDLFMT=<dlfmt> -DDL_GEN=<dl_gen> -DLUA=<lua5.1> -DSCRIPT=<lua51_load.lua> -DWORK_DIR=<临时目录>
+#     -P lua51_load.cmake
+# dl_gen 生成的各类文件，以及它们格式化、压缩后的结果，都须能被 Lua 5.1 加载，
+# 不超过 200 个局部变量与 60 个上值的限制
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/generated)
+foreach(kind code data strings nested mixed)
+    foreach(size 64K 1M)
+        execute_process(COMMAND ${DL_GEN} --kind ${kind} --size ${size}
+            --output ${WORK_DIR}/generated/${kind}-${size}.lua
+            RESULT_VARIABLE result OUTPUT_QUIET)
+        if(NOT result EQUAL 0)
+            message(FATAL_ERROR "dl_gen --kind ${kind} --size ${size} exited with '${result}'")
+        endif()
+    endforeach()
+endforeach()
+
+foreach(mode format compress)
+    file(COPY ${WORK_DIR}/generated/ DESTINATION ${WORK_DIR}/${mode})
+endforeach()
+execute_process(COMMAND ${DLFMT} --format-directory ${WORK_DIR}/format
+    RESULT_VARIABLE format_result OUTPUT_QUIET)
+execute_process(COMMAND ${DLFMT} --compress-directory ${WORK_DIR}/compress
+    --param rename-locals --param fold-constants --param strip-dead-branches --param hoist-globals
+    RESULT_VARIABLE compress_result OUTPUT_QUIET)
+if(NOT format_result EQUAL 0 OR NOT compress_result EQUAL 0)
+    message(FATAL_ERROR "dlfmt exited with '${format_result}' and '${compress_result}'")
+endif()
+
+file(GLOB_RECURSE files ${WORK_DIR}/*.lua)
+execute_process(COMMAND ${LUA} ${SCRIPT} ${files} RESULT_VARIABLE result ERROR_VARIABLE errors)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Lua 5.1 failed to load some files:\n${errors}")
+endif()
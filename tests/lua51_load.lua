@@ -0,0 +1,10 @@
+-- lua5.1 lua51_load.lua <文件>...：每个文件都须能被 loadfile 编译，失败时打印原因并以 1 退出
+local failed = 0
+for i = 1, #arg do
+	local chunk, err = loadfile(arg[i])
+	if not chunk then
+		io.stderr:write(err, "\n")
+		failed = failed + 1
+	end
+end
+os.exit(failed == 0 and 0 or 1)